@@ -0,0 +1,605 @@
+// ======================================================================
+/*!
+ * \brief Replay requests at configurable concurrency against the plugin
+ *
+ * Loads the plugin and the engines exactly like PluginTest does, using
+ * cnf/reactor.conf and the local test data, and then replays a list of
+ * requests from several threads. Reports throughput, latency percentiles
+ * per product, allocation counts, image cache hit rates and the per-stage
+ * timings collected by the plugin.
+ *
+ * Usage: LoadTest [options] [requests...]
+ *
+ *   --log=<file>            request log to replay. Lines may be plain URIs
+ *                           ("/dali?..."), request lines ("GET /dali?... HTTP/1.0")
+ *                           or access log lines containing a quoted request line.
+ *   --concurrency=<n,...>   number of threads, or a comma separated list of
+ *                           thread counts to measure the scaling (default 1)
+ *   --repeat=<n>            how many times the request list is replayed (default 1)
+ *   --no-warmup             do not replay the list once before measuring
+ *   --json=<file>           write the report as JSON as well
+ *
+ * Without --log the named files in input/ are replayed, or all of them if
+ * no names are given.
+ */
+// ======================================================================
+
+#include <boost/algorithm/string.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/StaticCleanup.h>
+#include <smartmet/spine/HTTP.h>
+#include <smartmet/spine/Options.h>
+#include <smartmet/spine/Reactor.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ----------------------------------------------------------------------
+// Allocation counting. The plugin and engines are loaded into this
+// process, so replacing the global operator new counts their allocations
+// too. Allocations made by helper threads are included in the totals but
+// not in the per-request figures, which are counted in the request thread.
+// ----------------------------------------------------------------------
+
+namespace
+{
+std::atomic<std::uint64_t> total_allocations{0};
+std::atomic<std::uint64_t> total_allocated_bytes{0};
+thread_local std::uint64_t thread_allocations = 0;
+thread_local std::uint64_t thread_allocated_bytes = 0;
+
+void* counted_malloc(std::size_t size)
+{
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+  total_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  ++thread_allocations;
+  thread_allocated_bytes += size;
+  return std::malloc(size == 0 ? 1 : size);
+}
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  void* ptr = counted_malloc(size);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+  void* ptr = counted_malloc(size);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t& /* tag */) noexcept
+{
+  return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& /* tag */) noexcept
+{
+  return counted_malloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /* size */) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t /* size */) noexcept
+{
+  std::free(ptr);
+}
+
+// ----------------------------------------------------------------------
+// IMPLEMENTATION DETAILS
+// ----------------------------------------------------------------------
+
+namespace
+{
+namespace ba = boost::algorithm;
+namespace fs = std::filesystem;
+
+struct Settings
+{
+  std::string log;
+  std::vector<std::string> inputs;
+  std::vector<unsigned int> concurrency{1};
+  unsigned int repeat = 1;
+  bool warmup = true;
+  std::string json;
+};
+
+// A request to replay, preparsed into the raw HTTP text
+struct Replay
+{
+  std::string text;      // "GET ... HTTP/1.0\r\n\r\n"
+  std::string category;  // resource plus product or layer name
+};
+
+// Outcome of a single request
+struct Sample
+{
+  std::size_t replay = 0;
+  double milliseconds = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t allocated_bytes = 0;
+  bool ok = false;
+};
+
+std::string get_file_contents(const fs::path& filename)
+{
+  std::string content;
+  std::ifstream in(filename.c_str());
+  if (in)
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return content;
+}
+
+std::string get_full_response(SmartMet::Spine::HTTP::Response& response)
+{
+  std::string result = response.getContent();
+  if (result.empty() || !response.hasStreamContent())
+    return result;
+  while (true)
+  {
+    std::string tmp = response.getContent();
+    if (tmp.empty())
+      break;
+    result += tmp;
+  }
+  return result;
+}
+
+// Extract "GET /uri HTTP/1.x" from a plain URI, a request line or an access log line
+std::string request_line(const std::string& theLine)
+{
+  auto line = ba::trim_copy(theLine);
+  if (line.empty() || line[0] == '#')
+    return {};
+
+  auto pos = line.find("\"GET ");
+  if (pos != std::string::npos)
+  {
+    auto end = line.find('"', pos + 1);
+    return line.substr(pos + 1, end == std::string::npos ? end : end - pos - 1);
+  }
+  if (ba::starts_with(line, "GET "))
+    return line;
+  if (line[0] == '/')
+    return "GET " + line + " HTTP/1.0";
+  return {};
+}
+
+// Group requests by the resource and the product, WMS layers or tile path
+std::string category(const SmartMet::Spine::HTTP::Request& theRequest)
+{
+  std::string ret = theRequest.getResource();
+  for (const char* name : {"product", "layers", "LAYERS", "layer", "LAYER"})
+  {
+    auto value = theRequest.getParameter(name);
+    if (value)
+      return ret + " " + *value;
+  }
+  return ret;
+}
+
+std::vector<Replay> read_requests(const Settings& theSettings)
+{
+  std::vector<std::string> lines;
+  if (!theSettings.log.empty())
+  {
+    std::ifstream input(theSettings.log);
+    if (!input)
+      throw Fmi::Exception(BCP, "Failed to open request log")
+          .addParameter("log", theSettings.log);
+    std::string line;
+    while (std::getline(input, line))
+      lines.push_back(request_line(line));
+  }
+  else
+  {
+    auto inputs = theSettings.inputs;
+    if (inputs.empty())
+    {
+      for (const auto& entry : fs::directory_iterator("input"))
+        if (entry.path().extension() == ".get")
+          inputs.push_back(entry.path().filename().string());
+      std::sort(inputs.begin(), inputs.end());
+    }
+    for (const auto& name : inputs)
+      lines.push_back(request_line(get_file_contents(fs::path("input") / name)));
+  }
+
+  std::vector<Replay> ret;
+  for (auto& line : lines)
+  {
+    if (line.empty())
+      continue;
+    Replay replay;
+    replay.text = line + "\r\n\r\n";
+    auto query = SmartMet::Spine::HTTP::parseRequest(replay.text);
+    if (query.first != SmartMet::Spine::HTTP::ParsingStatus::COMPLETE)
+    {
+      std::cerr << "Skipping unparseable request: " << line << std::endl;
+      continue;
+    }
+    replay.category = category(*query.second);
+    ret.push_back(std::move(replay));
+  }
+  if (ret.empty())
+    throw Fmi::Exception(BCP, "No requests to replay");
+  return ret;
+}
+
+Sample run_one(SmartMet::Spine::Reactor& theReactor,
+               const std::vector<Replay>& theReplays,
+               std::size_t theIndex)
+{
+  Sample sample;
+  sample.replay = theIndex;
+
+  const auto allocations = thread_allocations;
+  const auto allocated_bytes = thread_allocated_bytes;
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    auto query = SmartMet::Spine::HTTP::parseRequest(theReplays[theIndex].text);
+    auto view = theReactor.getHandlerView(*query.second);
+    if (view)
+    {
+      SmartMet::Spine::HTTP::Response response;
+      view->handle(theReactor, *query.second, response);
+      auto content = get_full_response(response);
+      sample.ok = (static_cast<int>(response.getStatus()) < 400 && !content.empty());
+    }
+  }
+  catch (...)
+  {
+    sample.ok = false;
+  }
+
+  sample.milliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  sample.allocations = thread_allocations - allocations;
+  sample.allocated_bytes = thread_allocated_bytes - allocated_bytes;
+  return sample;
+}
+
+// Replay the list theRepeat times from theThreads threads
+std::vector<Sample> run(SmartMet::Spine::Reactor& theReactor,
+                        const std::vector<Replay>& theReplays,
+                        unsigned int theThreads,
+                        unsigned int theRepeat,
+                        double& theSeconds)
+{
+  const std::size_t total = theReplays.size() * theRepeat;
+  std::atomic<std::size_t> next{0};
+  std::vector<std::vector<Sample>> results(theThreads);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < theThreads; t++)
+  {
+    threads.emplace_back(
+        [&, t]()
+        {
+          for (auto i = next++; i < total; i = next++)
+            results[t].push_back(run_one(theReactor, theReplays, i % theReplays.size()));
+        });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  theSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<Sample> ret;
+  for (auto& samples : results)
+    ret.insert(ret.end(), samples.begin(), samples.end());
+  return ret;
+}
+
+double percentile(const std::vector<double>& theSorted, double theFraction)
+{
+  if (theSorted.empty())
+    return 0;
+  const auto last = static_cast<double>(theSorted.size() - 1);
+  auto pos = static_cast<std::size_t>(theFraction * last + 0.5);
+  return theSorted[std::min(pos, theSorted.size() - 1)];
+}
+
+struct Summary
+{
+  std::size_t count = 0;
+  std::size_t errors = 0;
+  double mean_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p99_ms = 0;
+  double max_ms = 0;
+  double allocations = 0;      // per request
+  double allocated_kbytes = 0;  // per request
+};
+
+Summary summarize(const std::vector<const Sample*>& theSamples)
+{
+  Summary ret;
+  std::vector<double> ms;
+  for (const auto* sample : theSamples)
+  {
+    ms.push_back(sample->milliseconds);
+    ret.mean_ms += sample->milliseconds;
+    ret.allocations += static_cast<double>(sample->allocations);
+    ret.allocated_kbytes += static_cast<double>(sample->allocated_bytes) / 1024.0;
+    if (!sample->ok)
+      ++ret.errors;
+  }
+  ret.count = theSamples.size();
+  if (ret.count == 0)
+    return ret;
+  std::sort(ms.begin(), ms.end());
+  const auto n = static_cast<double>(ret.count);
+  ret.mean_ms /= n;
+  ret.allocations /= n;
+  ret.allocated_kbytes /= n;
+  ret.p50_ms = percentile(ms, 0.5);
+  ret.p90_ms = percentile(ms, 0.9);
+  ret.p99_ms = percentile(ms, 0.99);
+  ret.max_ms = ms.back();
+  return ret;
+}
+
+std::string summary_json(const Summary& theSummary)
+{
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3) << "{\"count\": " << theSummary.count
+      << ", \"errors\": " << theSummary.errors << ", \"mean_ms\": " << theSummary.mean_ms
+      << ", \"p50_ms\": " << theSummary.p50_ms << ", \"p90_ms\": " << theSummary.p90_ms
+      << ", \"p99_ms\": " << theSummary.p99_ms << ", \"max_ms\": " << theSummary.max_ms
+      << ", \"allocations\": " << theSummary.allocations
+      << ", \"allocated_kb\": " << theSummary.allocated_kbytes << "}";
+  return out.str();
+}
+
+void print_row(const std::string& theName, const Summary& theSummary)
+{
+  std::cout << std::left << std::setw(48) << theName.substr(0, 47) << std::right << std::fixed
+            << std::setprecision(2) << std::setw(7) << theSummary.count << std::setw(6)
+            << theSummary.errors << std::setw(10) << theSummary.mean_ms << std::setw(10)
+            << theSummary.p50_ms << std::setw(10) << theSummary.p90_ms << std::setw(10)
+            << theSummary.p99_ms << std::setw(10) << theSummary.max_ms << std::setw(11)
+            << std::setprecision(0) << theSummary.allocations << std::endl;
+}
+
+// Image cache hits and misses, the difference between two snapshots
+std::string cache_report(const Fmi::Cache::CacheStatistics& theBefore,
+                         const Fmi::Cache::CacheStatistics& theAfter,
+                         std::string& theJson)
+{
+  std::ostringstream out;
+  theJson = "{";
+  bool first = true;
+  for (const auto& name_stats : theAfter)
+  {
+    if (!ba::starts_with(name_stats.first, "Wms::"))
+      continue;
+    auto hits = name_stats.second.hits;
+    auto misses = name_stats.second.misses;
+    auto pos = theBefore.find(name_stats.first);
+    if (pos != theBefore.end())
+    {
+      hits -= pos->second.hits;
+      misses -= pos->second.misses;
+    }
+    const double rate = (hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+    out << "  " << std::left << std::setw(46) << name_stats.first << std::right << std::setw(10)
+        << hits << " hits" << std::setw(10) << misses << " misses" << std::fixed
+        << std::setprecision(1) << std::setw(8) << rate << " %" << std::endl;
+    theJson += (first ? "" : ", ");
+    theJson += "\"" + name_stats.first + "\": {\"hits\": " + std::to_string(hits) +
+               ", \"misses\": " + std::to_string(misses) + "}";
+    first = false;
+  }
+  theJson += "}";
+  return out.str();
+}
+
+// The per-stage latency histograms collected by the plugin itself
+std::string timing_statistics(SmartMet::Spine::Reactor& theReactor)
+{
+  Replay replay;
+  replay.text = "GET /dali?request=GetTimingStatistics HTTP/1.0\r\n\r\n";
+  auto query = SmartMet::Spine::HTTP::parseRequest(replay.text);
+  auto view = theReactor.getHandlerView(*query.second);
+  if (!view)
+    return "{}";
+  SmartMet::Spine::HTTP::Response response;
+  view->handle(theReactor, *query.second, response);
+  auto content = get_full_response(response);
+  return (content.empty() ? "{}" : content);
+}
+
+void report(SmartMet::Spine::Reactor& theReactor,
+            const Settings& theSettings,
+            const std::vector<Replay>& theReplays)
+{
+  std::ostringstream json;
+  json << "{\n  \"runs\": [";
+
+  for (std::size_t c = 0; c < theSettings.concurrency.size(); c++)
+  {
+    const auto threads = theSettings.concurrency[c];
+    const auto cache_before = theReactor.getCacheStats();
+    double seconds = 0;
+    const auto samples = run(theReactor, theReplays, threads, theSettings.repeat, seconds);
+    const auto cache_after = theReactor.getCacheStats();
+
+    std::map<std::string, std::vector<const Sample*>> by_category;
+    std::vector<const Sample*> all;
+    for (const auto& sample : samples)
+    {
+      by_category[theReplays[sample.replay].category].push_back(&sample);
+      all.push_back(&sample);
+    }
+
+    const auto total = summarize(all);
+    const double throughput = (seconds > 0 ? static_cast<double>(samples.size()) / seconds : 0.0);
+
+    std::cout << std::endl
+              << "Concurrency " << threads << ": " << samples.size() << " requests in "
+              << std::fixed << std::setprecision(2) << seconds << " s, " << throughput
+              << " requests/s" << std::endl
+              << std::endl
+              << std::left << std::setw(48) << "category" << std::right << std::setw(7) << "count"
+              << std::setw(6) << "err" << std::setw(10) << "mean ms" << std::setw(10) << "p50"
+              << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max"
+              << std::setw(11) << "allocs" << std::endl;
+
+    json << (c == 0 ? "" : ",") << "\n    {\"concurrency\": " << threads
+         << ", \"requests\": " << samples.size() << ", \"seconds\": " << seconds
+         << ", \"requests_per_second\": " << throughput
+         << ",\n     \"total\": " << summary_json(total) << ",\n     \"categories\": {";
+
+    bool first = true;
+    for (const auto& name_samples : by_category)
+    {
+      const auto summary = summarize(name_samples.second);
+      print_row(name_samples.first, summary);
+      json << (first ? "" : ",") << "\n       \"" << name_samples.first
+           << "\": " << summary_json(summary);
+      first = false;
+    }
+    print_row("TOTAL", total);
+
+    std::string cache_json;
+    std::cout << std::endl
+              << "Cache hit rates:" << std::endl
+              << cache_report(cache_before, cache_after, cache_json);
+    json << "},\n     \"caches\": " << cache_json << "}";
+  }
+
+  std::cout << std::endl
+            << "Total allocations: " << total_allocations.load() << " ("
+            << total_allocated_bytes.load() / (1024 * 1024) << " MB)" << std::endl;
+
+  const auto stages = timing_statistics(theReactor);
+  std::cout << std::endl
+            << "Per-stage timings including the warm-up (GetTimingStatistics):" << std::endl
+            << stages << std::endl;
+
+  json << "\n  ],\n  \"stages\": " << stages << "\n}\n";
+
+  if (!theSettings.json.empty())
+  {
+    std::ofstream out(theSettings.json);
+    if (!out)
+      throw Fmi::Exception(BCP, "Failed to open JSON report for writing")
+          .addParameter("file", theSettings.json);
+    out << json.str();
+  }
+}
+
+Settings parse_settings(int argc, char* argv[])
+{
+  Settings settings;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+
+    if (ba::starts_with(arg, "--log="))
+      settings.log = value();
+    else if (ba::starts_with(arg, "--json="))
+      settings.json = value();
+    else if (ba::starts_with(arg, "--repeat="))
+      settings.repeat = std::max(1, std::stoi(value()));
+    else if (arg == "--no-warmup")
+      settings.warmup = false;
+    else if (ba::starts_with(arg, "--concurrency="))
+    {
+      std::vector<std::string> parts;
+      ba::split(parts, value(), ba::is_any_of(","));
+      settings.concurrency.clear();
+      for (const auto& part : parts)
+        settings.concurrency.push_back(std::max(1, std::stoi(part)));
+    }
+    else if (ba::starts_with(arg, "--"))
+      throw Fmi::Exception(BCP, "Unknown option").addParameter("option", arg);
+    else
+      settings.inputs.push_back(arg);
+  }
+  return settings;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+try
+{
+  const auto settings = parse_settings(argc, argv);
+
+  SmartMet::Spine::Options options;
+  options.quiet = true;
+  options.defaultlogging = false;
+  options.configfile = "cnf/reactor.conf";
+  options.parseConfig();
+
+  Fmi::StaticCleanup::AtExit cleanup;
+  auto* reactor = new SmartMet::Spine::Reactor(options);
+  reactor->init();
+  if (reactor->isShuttingDown())
+    throw Fmi::Exception(BCP, "SmartMet::Spine::Reactor shutdown detected while init phase.");
+
+  auto handlers = reactor->getURIMap();
+  while (handlers.find("/dali") == handlers.end())
+  {
+    sleep(1);
+    handlers = reactor->getURIMap();
+  }
+
+  const auto replays = read_requests(settings);
+  std::cout << "Replaying " << replays.size() << " requests" << std::endl;
+
+  if (settings.warmup)
+  {
+    for (std::size_t i = 0; i < replays.size(); i++)
+      if (!run_one(*reactor, replays, i).ok)
+        std::cerr << "Warm-up request failed: " << replays[i].text;
+  }
+
+  report(*reactor, settings, replays);
+
+  reactor->shutdown();
+  return 0;
+}
+catch (...)
+{
+  Fmi::Exception ex(BCP, "Load test failed", nullptr);
+  ex.printError();
+  return 1;
+}
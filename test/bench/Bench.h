@@ -0,0 +1,246 @@
+// ======================================================================
+/*!
+ * \brief Minimal micro-benchmark harness for the test/bench programs
+ *
+ * Each benchmark program registers its cases and calls Bench::main:
+ *
+ *   BENCH_CASE("bezier/fit_closed_2000", [](Bench::State& state) {
+ *     while (state.keepRunning())
+ *       Bench::doNotOptimize(fitPolyline(points, 2.0));
+ *   });
+ *
+ *   int main(int argc, char** argv) { return Bench::main(argc, argv); }
+ *
+ * The iteration count is calibrated so that one sample takes roughly
+ * --min-time seconds, after which --samples samples are taken and the
+ * median time per iteration is reported. Results are written as JSON with
+ * a fixed key order and sorted case names so that files from different
+ * runs can be diffed and compared with compare.py.
+ *
+ * Options:
+ *   --filter=<substring>   run only the matching cases
+ *   --min-time=<seconds>   target duration of one sample (default 0.2)
+ *   --samples=<n>          number of samples per case (default 5)
+ *   --json=<file>          write the results to a file instead of stdout
+ */
+// ======================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+// Prevent the compiler from discarding a computed value
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class State
+{
+ public:
+  explicit State(std::uint64_t theIterations) : itsRemaining(theIterations) {}
+
+  bool keepRunning()
+  {
+    if (itsRemaining == 0)
+      return false;
+    --itsRemaining;
+    return true;
+  }
+
+  // Number of processed items (pixels, vertices, labels...) per iteration
+  void setItemsPerIteration(std::uint64_t theItems) { itsItems = theItems; }
+  std::uint64_t itemsPerIteration() const { return itsItems; }
+
+ private:
+  std::uint64_t itsRemaining = 0;
+  std::uint64_t itsItems = 0;
+};
+
+using Function = std::function<void(State&)>;
+
+inline std::map<std::string, Function>& registry()
+{
+  static std::map<std::string, Function> cases;
+  return cases;
+}
+
+struct Registrar
+{
+  Registrar(const std::string& theName, Function theFunction)
+  {
+    if (!registry().emplace(theName, std::move(theFunction)).second)
+      throw std::runtime_error("Duplicate benchmark case " + theName);
+  }
+};
+
+struct Result
+{
+  std::string name;
+  std::uint64_t iterations = 0;
+  double ns_per_op = 0;  // median of the samples
+  double min_ns = 0;
+  double max_ns = 0;
+  double items_per_second = 0;
+};
+
+namespace detail
+{
+inline double runSample(const Function& theFunction, std::uint64_t theIterations, State& theState)
+{
+  theState = State(theIterations);
+  auto start = std::chrono::steady_clock::now();
+  theFunction(theState);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+inline Result measure(const std::string& theName,
+                      const Function& theFunction,
+                      double theMinTime,
+                      int theSamples)
+{
+  State state(0);
+
+  // Warm up caches and calibrate the iteration count of one sample
+  std::uint64_t iterations = 1;
+  double elapsed = runSample(theFunction, iterations, state);
+  while (elapsed < theMinTime * 1e9 && iterations < (std::uint64_t{1} << 40))
+  {
+    const double scale = (elapsed > 0 ? 1.4 * theMinTime * 1e9 / elapsed : 10.0);
+    iterations = std::max(iterations + 1,
+                          static_cast<std::uint64_t>(static_cast<double>(iterations) *
+                                                     std::min(scale, 10.0)));
+    elapsed = runSample(theFunction, iterations, state);
+  }
+
+  std::vector<double> per_op;
+  for (int i = 0; i < theSamples; i++)
+    per_op.push_back(runSample(theFunction, iterations, state) / static_cast<double>(iterations));
+  std::sort(per_op.begin(), per_op.end());
+
+  Result result;
+  result.name = theName;
+  result.iterations = iterations;
+  result.ns_per_op = per_op[per_op.size() / 2];
+  result.min_ns = per_op.front();
+  result.max_ns = per_op.back();
+  if (state.itemsPerIteration() > 0 && result.ns_per_op > 0)
+    result.items_per_second =
+        static_cast<double>(state.itemsPerIteration()) * 1e9 / result.ns_per_op;
+  return result;
+}
+
+inline std::string toJson(const std::vector<Result>& theResults)
+{
+  std::string out = "{\n  \"benchmarks\": [";
+  char buffer[512];
+  for (std::size_t i = 0; i < theResults.size(); i++)
+  {
+    const auto& r = theResults[i];
+    std::snprintf(buffer,
+                  sizeof(buffer),
+                  "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, "
+                  "\"min_ns\": %.1f, \"max_ns\": %.1f, \"items_per_second\": %.1f}",
+                  (i == 0 ? "" : ","),
+                  r.name.c_str(),
+                  static_cast<unsigned long long>(r.iterations),
+                  r.ns_per_op,
+                  r.min_ns,
+                  r.max_ns,
+                  r.items_per_second);
+    out += buffer;
+  }
+  out += "\n  ]\n}\n";
+  return out;
+}
+
+inline std::string option(const std::string& theArg, const std::string& theName)
+{
+  const std::string prefix = "--" + theName + "=";
+  if (theArg.compare(0, prefix.size(), prefix) == 0)
+    return theArg.substr(prefix.size());
+  return {};
+}
+
+}  // namespace detail
+
+inline int main(int argc, char** argv)
+{
+  try
+  {
+    std::string filter;
+    std::string json;
+    double min_time = 0.2;
+    int samples = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg = argv[i];
+      std::string value;
+      if (!(value = detail::option(arg, "filter")).empty())
+        filter = value;
+      else if (!(value = detail::option(arg, "json")).empty())
+        json = value;
+      else if (!(value = detail::option(arg, "min-time")).empty())
+        min_time = std::stod(value);
+      else if (!(value = detail::option(arg, "samples")).empty())
+        samples = std::max(1, std::stoi(value));
+      else
+        throw std::runtime_error("Unknown option " + arg);
+    }
+
+    std::vector<Result> results;
+    for (const auto& name_function : registry())
+    {
+      if (!filter.empty() && name_function.first.find(filter) == std::string::npos)
+        continue;
+      results.push_back(
+          detail::measure(name_function.first, name_function.second, min_time, samples));
+      std::fprintf(stderr,
+                   "%-48s %14.1f ns/op\n",
+                   results.back().name.c_str(),
+                   results.back().ns_per_op);
+    }
+
+    const auto text = detail::toJson(results);
+    if (json.empty())
+    {
+      std::cout << text;
+    }
+    else
+    {
+      FILE* out = std::fopen(json.c_str(), "w");
+      if (out == nullptr)
+        throw std::runtime_error("Failed to open " + json + " for writing");
+      std::fputs(text.c_str(), out);
+      std::fclose(out);
+    }
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
+
+}  // namespace Bench
+
+#define BENCH_CONCAT_IMPL(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_IMPL(a, b)
+#define BENCH_CASE(name, function) \
+  static const Bench::Registrar BENCH_CONCAT(bench_registrar_, __LINE__)(name, function)
@@ -0,0 +1,87 @@
+// ======================================================================
+/*!
+ * \brief Deterministic synthetic inputs for the benchmarks
+ *
+ * The fields resemble smooth model data (a few pressure systems on top of
+ * a gradient) and the rings resemble isoband boundaries at typical WMS
+ * tile and full-map sizes. Everything is generated from fixed parameters
+ * so that every run measures exactly the same work.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Bench
+{
+// Row-major field of width*height values in the range of about -30...30
+inline std::vector<float> syntheticField(int theWidth, int theHeight)
+{
+  std::vector<float> values;
+  values.reserve(static_cast<std::size_t>(theWidth) * theHeight);
+  for (int j = 0; j < theHeight; j++)
+  {
+    const double y = static_cast<double>(j) / theHeight;
+    for (int i = 0; i < theWidth; i++)
+    {
+      const double x = static_cast<double>(i) / theWidth;
+      double v = 20 * (y - 0.5);
+      v += 12 * std::exp(-((x - 0.3) * (x - 0.3) + (y - 0.4) * (y - 0.4)) / 0.02);
+      v -= 15 * std::exp(-((x - 0.7) * (x - 0.7) + (y - 0.6) * (y - 0.6)) / 0.03);
+      v += 3 * std::sin(17 * x) * std::cos(11 * y);
+      values.push_back(static_cast<float>(v));
+    }
+  }
+  return values;
+}
+
+// Land/sea mask with a diagonal coastline, 1 = land
+inline std::vector<float> syntheticLandMask(int theWidth, int theHeight)
+{
+  std::vector<float> land;
+  land.reserve(static_cast<std::size_t>(theWidth) * theHeight);
+  for (int j = 0; j < theHeight; j++)
+    for (int i = 0; i < theWidth; i++)
+      land.push_back(i + 0.3 * theWidth * std::sin(0.01 * j) > j ? 1.0F : 0.0F);
+  return land;
+}
+
+// Closed wavy ring around (cx,cy), the first vertex repeated at the end
+inline std::vector<std::pair<double, double>> syntheticRing(
+    double theCx, double theCy, double theRadius, int theVertices, int theLobes = 7)
+{
+  std::vector<std::pair<double, double>> ring;
+  ring.reserve(theVertices + 1);
+  for (int i = 0; i < theVertices; i++)
+  {
+    const double t = 2 * M_PI * i / theVertices;
+    const double r = theRadius * (1 + 0.15 * std::sin(theLobes * t) + 0.05 * std::sin(31 * t));
+    ring.emplace_back(theCx + r * std::cos(t), theCy + r * std::sin(t));
+  }
+  ring.push_back(ring.front());
+  return ring;
+}
+
+// Small deterministic linear congruential generator (std:: engines differ
+// between library versions, which would make results incomparable)
+class Random
+{
+ public:
+  explicit Random(std::uint64_t theSeed) : itsState(theSeed) {}
+
+  // Uniform in [0,1)
+  double next()
+  {
+    itsState = itsState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<double>(itsState >> 11) / 9007199254740992.0;
+  }
+
+ private:
+  std::uint64_t itsState;
+};
+
+}  // namespace Bench
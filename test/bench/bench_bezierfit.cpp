@@ -0,0 +1,75 @@
+// ======================================================================
+// Benchmarks for the Bezier fitting of smoothed isolines (BezierFit.cpp).
+//
+// The rings are the size of isoband boundaries on a full-map PNG (2000
+// vertices) and on a typical 256x256 WMS tile (300 vertices). Accuracy
+// 2 px is the smallest value IsolineFilter accepts. Note that the
+// coarse tile ring is by far the slower one to fit: with only a few
+// vertices per wiggle the fit keeps subdividing down to the maximum depth.
+// ======================================================================
+
+#include "BezierFit.h"
+#include "Bench.h"
+#include "Synthetic.h"
+
+using namespace Fmi::BezierFit;
+
+namespace
+{
+std::vector<Point> ring(int theVertices, double theRadius = 400)
+{
+  std::vector<Point> points;
+  for (const auto& xy : Bench::syntheticRing(512, 512, theRadius, theVertices))
+    points.emplace_back(xy.first, xy.second);
+  return points;
+}
+
+std::vector<Point> open_line(int theVertices)
+{
+  auto points = ring(theVertices);
+  points.resize(points.size() / 2);
+  return points;
+}
+
+void fit(Bench::State& state, const std::vector<Point>& points, bool closed)
+{
+  state.setItemsPerIteration(points.size());
+  while (state.keepRunning())
+    Bench::doNotOptimize(fitPolyline(points, 2.0, 10, closed));
+}
+
+}  // namespace
+
+BENCH_CASE("bezier/fit_closed_300", [](Bench::State& state) { fit(state, ring(300, 100), true); });
+BENCH_CASE("bezier/fit_closed_2000", [](Bench::State& state) { fit(state, ring(2000), true); });
+BENCH_CASE("bezier/fit_open_1000", [](Bench::State& state) { fit(state, open_line(2000), false); });
+
+BENCH_CASE("bezier/fit_with_breaks_2000",
+           [](Bench::State& state)
+           {
+             const auto points = ring(2000);
+             std::vector<int> breaks;
+             for (int i = 100; i < 2000; i += 250)
+               breaks.push_back(i);
+             state.setItemsPerIteration(points.size());
+             while (state.keepRunning())
+               Bench::doNotOptimize(fitPolylineWithBreaks(points, breaks, 2.0));
+           });
+
+BENCH_CASE("bezier/svg_2000",
+           [](Bench::State& state)
+           {
+             const auto cubics = fitPolyline(ring(2000), 2.0, 10, true);
+             state.setItemsPerIteration(cubics.size());
+             while (state.keepRunning())
+             {
+               std::string out;
+               appendBezierSvg(out, cubics, true, true, 1);
+               Bench::doNotOptimize(out);
+             }
+           });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
@@ -0,0 +1,59 @@
+// ======================================================================
+// Benchmarks for the raster colour painters (ColorPainter_*.cpp).
+//
+// Only the range painter is measured: it is configured directly through
+// addRange, whereas the others need a State for their colour maps.
+// ======================================================================
+
+#include "Bench.h"
+#include "ColorPainter_range.h"
+#include "Synthetic.h"
+#include <array>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+void paint(Bench::State& state, uint theSize)
+{
+  ColorPainter_range painter;
+  painter.opacity_land = 1.0;
+  painter.opacity_sea = 0.8;
+
+  // A typical temperature scale: blue below zero, red above, with translucent ends
+  const std::vector<std::array<double, 2>> limits = {{-30, -10}, {-10, 0}, {0, 10}, {10, 30}};
+  const std::vector<std::array<uint, 2>> colors = {{0xFF0000A0, 0xFF4060FF},
+                                                   {0xFF4060FF, 0xFFC0D0FF},
+                                                   {0xFFFFE0A0, 0xFFFF8040},
+                                                   {0xFFFF8040, 0xFFA00000}};
+  for (std::size_t i = 0; i < limits.size(); i++)
+  {
+    ColorPainter_range::Range range;
+    range.value_min = limits[i][0];
+    range.value_max = limits[i][1];
+    range.color_min = colors[i][0];
+    range.color_max = colors[i][1];
+    painter.addRange(range);
+  }
+
+  auto values = Bench::syntheticField(theSize, theSize);
+  auto land = Bench::syntheticLandMask(theSize, theSize);
+  std::vector<uint> image(values.size(), 0);
+  Parameters parameters;
+
+  state.setItemsPerIteration(values.size());
+  while (state.keepRunning())
+  {
+    painter.setImageColors(theSize, theSize, 0, 1, image.data(), land, values, parameters);
+    Bench::doNotOptimize(image.data());
+  }
+}
+}  // namespace
+
+BENCH_CASE("colorpainter/range_256", [](Bench::State& state) { paint(state, 256); });
+BENCH_CASE("colorpainter/range_1024", [](Bench::State& state) { paint(state, 1024); });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
@@ -0,0 +1,41 @@
+// ======================================================================
+// Benchmarks for the datatile PNG encoders (DataTileEncoder.cpp).
+//
+// Sizes are a standard 256x256 web map tile and a 512x512 retina tile.
+// ======================================================================
+
+#include "Bench.h"
+#include "DataTile.h"
+#include "Synthetic.h"
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+void single(Bench::State& state, int theSize)
+{
+  const auto values = Bench::syntheticField(theSize, theSize);
+  state.setItemsPerIteration(values.size());
+  while (state.keepRunning())
+    Bench::doNotOptimize(writeSingleBandDataTile(theSize, theSize, values));
+}
+}  // namespace
+
+BENCH_CASE("datatile/single_band_256", [](Bench::State& state) { single(state, 256); });
+BENCH_CASE("datatile/single_band_512", [](Bench::State& state) { single(state, 512); });
+
+BENCH_CASE("datatile/dual_band_256",
+           [](Bench::State& state)
+           {
+             const auto u = Bench::syntheticField(256, 256);
+             auto v = u;
+             std::reverse(v.begin(), v.end());
+             state.setItemsPerIteration(u.size());
+             while (state.keepRunning())
+               Bench::doNotOptimize(writeDualBandDataTile(256, 256, u, v));
+           });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
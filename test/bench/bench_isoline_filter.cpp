@@ -0,0 +1,103 @@
+// ======================================================================
+// Benchmarks for the isoline/isoband smoothing filter (IsolineFilter.cpp).
+//
+// The input is a stack of 20 nested annular isobands whose shared edges
+// are identical, as produced by Trax for adjacent isovalues, so that the
+// topology preserving smoother and the Bezier cache see realistic sharing.
+// Coordinates are pixels, the bbox is the identity transform.
+// ======================================================================
+
+#include "Bench.h"
+#include "BezierCache.h"
+#include "IsolineFilter.h"
+#include "Synthetic.h"
+#include <gis/Box.h>
+#include <ogr_geometry.h>
+
+using SmartMet::Plugin::Dali::BezierCache;
+using SmartMet::Plugin::Dali::IsolineFilter;
+
+namespace
+{
+const int num_bands = 20;
+const int vertices = 1000;
+
+OGRLinearRing* ring(int theIndex)
+{
+  auto* ret = new OGRLinearRing;
+  for (const auto& xy : Bench::syntheticRing(512, 512, 40 + 20 * theIndex, vertices))
+    ret->addPoint(xy.first, xy.second);
+  return ret;
+}
+
+std::vector<OGRGeometryPtr> bands()
+{
+  std::vector<OGRGeometryPtr> ret;
+  for (int i = 0; i < num_bands; i++)
+  {
+    auto* poly = new OGRPolygon;
+    poly->addRingDirectly(ring(i + 1));
+    poly->addRingDirectly(ring(i));
+    ret.emplace_back(poly);
+  }
+  return ret;
+}
+
+IsolineFilter filter(const std::string& theType, double theRadius, bool theValidate, int theBezier)
+{
+  Json::Value json(Json::objectValue);
+  json["type"] = theType;
+  json["radius"] = theRadius;
+  json["iterations"] = 2;
+  json["validate"] = theValidate;
+  if (theBezier > 0)
+    json["bezier"] = theBezier;
+  IsolineFilter ret;
+  ret.init(json);
+  ret.bbox(Fmi::Box::identity());
+  return ret;
+}
+
+void smooth(Bench::State& state, const std::string& theType, bool theValidate)
+{
+  auto f = filter(theType, 5, theValidate, 0);
+  const auto input = bands();
+  state.setItemsPerIteration(num_bands * 2 * vertices);
+  while (state.keepRunning())
+  {
+    std::vector<OGRGeometryPtr> geoms;
+    for (const auto& geom : input)
+      geoms.emplace_back(geom->clone());
+    f.apply(geoms, true);
+    Bench::doNotOptimize(geoms);
+  }
+}
+
+}  // namespace
+
+BENCH_CASE("isoline_filter/average_20x1000",
+           [](Bench::State& state) { smooth(state, "average", false); });
+BENCH_CASE("isoline_filter/gaussian_20x1000",
+           [](Bench::State& state) { smooth(state, "gaussian", false); });
+BENCH_CASE("isoline_filter/gaussian_validate_20x1000",
+           [](Bench::State& state) { smooth(state, "gaussian", true); });
+
+BENCH_CASE("isoline_filter/bezier_svg_20x1000",
+           [](Bench::State& state)
+           {
+             auto f = filter("gaussian", 5, false, 2);
+             auto geoms = bands();
+             f.apply(geoms, true);
+             state.setItemsPerIteration(num_bands * 2 * vertices);
+             while (state.keepRunning())
+             {
+               BezierCache cache;
+               for (const auto& geom : geoms)
+                 Bench::doNotOptimize(f.toBezierSvg(*geom, Fmi::Box::identity(), 1, &cache));
+             }
+           });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
@@ -0,0 +1,68 @@
+// ======================================================================
+// Benchmarks for the location label placement (LabelPlacement.cpp).
+//
+// 500 labels on a 1024x1024 map is roughly the geonames density of a
+// Finland-wide product before the max_labels cap kicks in.
+// ======================================================================
+
+#include "Bench.h"
+#include "LabelPlacement.h"
+#include "Synthetic.h"
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+const double map_size = 1024;
+
+std::vector<LabelCandidate> candidates(int theCount)
+{
+  Bench::Random random(1234);
+  std::vector<LabelCandidate> ret;
+  for (int i = 0; i < theCount; i++)
+  {
+    LabelCandidate c;
+    c.anchor_x = 20 + random.next() * (map_size - 40);
+    c.anchor_y = 20 + random.next() * (map_size - 40);
+    c.text = "Location " + std::to_string(i);
+    c.population = 1000 + random.next() * 500000;
+    c.label_w = 30 + static_cast<unsigned int>(random.next() * 50);
+    c.label_h = 12;
+    ret.push_back(c);
+  }
+  return ret;
+}
+
+void place(Bench::State& state, PlacementAlgorithm theAlgorithm, int theCandidates)
+{
+  LabelConfig config;
+  config.algorithm = theAlgorithm;
+  config.candidates = theCandidates;
+  config.max_labels = 500;
+  const auto input = candidates(500);
+  state.setItemsPerIteration(input.size());
+  while (state.keepRunning())
+    Bench::doNotOptimize(placeLabels(config, input, map_size, map_size));
+}
+
+}  // namespace
+
+BENCH_CASE("labels/candidate_bboxes_16",
+           [](Bench::State& state)
+           {
+             state.setItemsPerIteration(1);
+             while (state.keepRunning())
+               Bench::doNotOptimize(candidateBBoxes(500, 500, 60, 12, 5.0, 16, 4, 4));
+           });
+
+BENCH_CASE("labels/greedy_500",
+           [](Bench::State& state) { place(state, PlacementAlgorithm::Greedy, 8); });
+BENCH_CASE("labels/priority_greedy_500",
+           [](Bench::State& state) { place(state, PlacementAlgorithm::PriorityGreedy, 8); });
+BENCH_CASE("labels/annealing_500",
+           [](Bench::State& state) { place(state, PlacementAlgorithm::SimulatedAnnealing, 8); });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
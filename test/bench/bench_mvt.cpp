@@ -0,0 +1,91 @@
+// ======================================================================
+// Benchmarks for the Mapbox Vector Tile encoder (MapboxVectorTile.cpp).
+//
+// MVTLayerBuilder::encodeGeometry is private, so the geometry encoding is
+// measured through addFeature, which is a thin wrapper around it. A tile
+// of 20 isobands with 2000 vertex rings is a dense temperature tile.
+// ======================================================================
+
+#include "Bench.h"
+#include "MapboxVectorTile.h"
+#include "Synthetic.h"
+#include <ogr_geometry.h>
+#include <memory>
+
+using SmartMet::Plugin::Dali::MVTTileBuilder;
+
+namespace
+{
+const unsigned extent = 4096;
+
+// Annulus shaped isoband: an outer ring with a hole
+std::unique_ptr<OGRPolygon> band(int theIndex, int theVertices)
+{
+  auto poly = std::make_unique<OGRPolygon>();
+  const double r = 200 + 80 * theIndex;
+  for (double radius : {r + 60, r})
+  {
+    auto* ring = new OGRLinearRing;
+    for (const auto& xy : Bench::syntheticRing(2048, 2048, radius, theVertices, 5 + theIndex))
+      ring->addPoint(xy.first, xy.second);
+    poly->addRingDirectly(ring);
+  }
+  return poly;
+}
+
+std::vector<std::unique_ptr<OGRPolygon>> bands(int theCount, int theVertices)
+{
+  std::vector<std::unique_ptr<OGRPolygon>> ret;
+  for (int i = 0; i < theCount; i++)
+    ret.push_back(band(i, theVertices));
+  return ret;
+}
+
+}  // namespace
+
+BENCH_CASE("mvt/add_features_20x2000",
+           [](Bench::State& state)
+           {
+             const auto polygons = bands(20, 2000);
+             state.setItemsPerIteration(20 * 2 * 2000);
+             while (state.keepRunning())
+             {
+               MVTTileBuilder tile(0, 0, extent, extent, extent);
+               auto& layer = tile.layer("temperature");
+               for (std::size_t i = 0; i < polygons.size(); i++)
+                 layer.addFeature(*polygons[i], {{"value", static_cast<double>(i)}});
+               Bench::doNotOptimize(tile);
+             }
+           });
+
+BENCH_CASE("mvt/serialize_20x2000",
+           [](Bench::State& state)
+           {
+             const auto polygons = bands(20, 2000);
+             MVTTileBuilder tile(0, 0, extent, extent, extent);
+             auto& layer = tile.layer("temperature");
+             for (std::size_t i = 0; i < polygons.size(); i++)
+               layer.addFeature(*polygons[i], {{"value", static_cast<double>(i)}});
+             while (state.keepRunning())
+               Bench::doNotOptimize(tile.serialize());
+           });
+
+BENCH_CASE("mvt/add_linestring_10000",
+           [](Bench::State& state)
+           {
+             OGRLineString line;
+             for (const auto& xy : Bench::syntheticRing(2048, 2048, 1500, 10000))
+               line.addPoint(xy.first, xy.second);
+             state.setItemsPerIteration(10000);
+             while (state.keepRunning())
+             {
+               MVTTileBuilder tile(0, 0, extent, extent, extent);
+               tile.layer("isolines").addFeature(line);
+               Bench::doNotOptimize(tile);
+             }
+           });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
@@ -0,0 +1,30 @@
+// ======================================================================
+// Benchmarks for the bilinear subdivision gate (SubdivideGate.h).
+//
+// The gate runs once per isoband layer on the WMS hot path, so it must
+// stay in the nanosecond range regardless of the grid size.
+// ======================================================================
+
+#include "Bench.h"
+#include "SubdivideGate.h"
+
+using SmartMet::Plugin::Dali::effective_subdivide;
+
+namespace
+{
+void gate(Bench::State& state, std::size_t theSize)
+{
+  const Fmi::CoordinateMatrix coords(theSize, theSize, 0.0, 0.0, 1000.0, 1000.0);
+  const Fmi::Box box(0.0, 0.0, 1000.0, 1000.0, 256, 256);
+  while (state.keepRunning())
+    Bench::doNotOptimize(effective_subdivide(4, 2.0, coords, box));
+}
+}  // namespace
+
+BENCH_CASE("subdivide_gate/grid_100", [](Bench::State& state) { gate(state, 100); });
+BENCH_CASE("subdivide_gate/grid_1000", [](Bench::State& state) { gate(state, 1000); });
+
+int main(int argc, char** argv)
+{
+  return Bench::main(argc, argv);
+}
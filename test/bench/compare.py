@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Merge and compare micro-benchmark results written by the test/bench programs.
+
+  compare.py merge results/*.json > results.json
+  compare.py compare [--threshold=PERCENT] baseline.json results.json
+
+merge concatenates the per-program result files into one document with the
+cases sorted by name, so that successive results can be diffed directly.
+
+compare prints the median time per operation of every case in both files and
+the relative change. A case whose median is more than the threshold (default
+10%) slower than the baseline AND whose fastest sample is slower than the
+slowest baseline sample is flagged as a regression; requiring the sample
+ranges not to overlap keeps noisy cases from failing the run. The exit status
+is 1 if any case regressed. Cases present in only one of the files are listed
+but never fail the comparison.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b for b in json.load(f)["benchmarks"]}
+
+
+def merge(paths):
+    cases = {}
+    for path in paths:
+        for name, case in load(path).items():
+            if name in cases:
+                sys.exit(f"Duplicate benchmark case {name} in {path}")
+            cases[name] = case
+    lines = [json.dumps(cases[name]) for name in sorted(cases)]
+    print('{\n  "benchmarks": [\n    ' + ",\n    ".join(lines) + "\n  ]\n}")
+    return 0
+
+
+def fmt_ns(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return f"{ns / scale:.2f} {unit}"
+    return f"{ns:.1f} ns"
+
+
+def compare(baseline_path, current_path, threshold):
+    baseline = load(baseline_path)
+    current = load(current_path)
+
+    regressions = []
+    width = max([len(name) for name in baseline.keys() | current.keys()] + [4])
+    print(f"{'case':<{width}}  {'baseline':>12}  {'current':>12}  {'change':>8}")
+    for name in sorted(baseline.keys() | current.keys()):
+        if name not in current:
+            print(f"{name:<{width}}  {fmt_ns(baseline[name]['ns_per_op']):>12}  {'-':>12}  removed")
+            continue
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>12}  {fmt_ns(current[name]['ns_per_op']):>12}  new")
+            continue
+
+        old = baseline[name]
+        new = current[name]
+        change = 100.0 * (new["ns_per_op"] / old["ns_per_op"] - 1) if old["ns_per_op"] > 0 else 0.0
+        status = ""
+        if change > threshold and new["min_ns"] > old["max_ns"]:
+            status = "  REGRESSION"
+            regressions.append(name)
+        elif change < -threshold and new["max_ns"] < old["min_ns"]:
+            status = "  improved"
+        print(
+            f"{name:<{width}}  {fmt_ns(old['ns_per_op']):>12}  {fmt_ns(new['ns_per_op']):>12}"
+            f"  {change:+7.1f}%{status}"
+        )
+
+    if regressions:
+        print(f"\n{len(regressions)} case(s) regressed by more than {threshold:g}%:")
+        for name in regressions:
+            print(f"  {name}")
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    merge_parser = sub.add_parser("merge", help="merge per-program result files")
+    merge_parser.add_argument("files", nargs="+")
+
+    compare_parser = sub.add_parser("compare", help="compare results against a baseline")
+    compare_parser.add_argument("--threshold", type=float, default=10.0,
+                                help="regression threshold in percent (default 10)")
+    compare_parser.add_argument("baseline")
+    compare_parser.add_argument("current")
+
+    args = parser.parse_args()
+    if args.command == "merge":
+        return merge(args.files)
+    return compare(args.baseline, args.current, args.threshold)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
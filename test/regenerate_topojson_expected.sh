@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Regenerate the TopoJSON test reference outputs.
+#
+# Use this after any change to the TopoJSON encoder (TopologyEncoder.cpp). It
+# runs the plugin IN-PROCESS via PluginTest against the local test data and
+# copies the freshly produced output over the committed references. It needs
+# the same environment as `make test`: the geonames test database and redis.
+#
+# The arc layout depends on the order in which the layers are encoded, so the
+# references must come from the plugin itself -- always review the diff (and
+# rely on unit/test_topology_encoder) after regenerating.
+
+set -e
+cd "$(dirname "$0")"
+
+TOPOJSON_TESTS="wms::grid::temperature_1::pal::topojson.get \
+                wms::grid::temperature_2::pal::topojson.get \
+                wms::grid::wind_speed_1::ecmwf_eurooppa_pinta::topojson.get"
+
+echo "*** Relinking the plugin so PluginTest loads the current encoder..."
+make -C .. wms.so
+
+echo "*** Preparing the test environment (configs, redis, geonames)..."
+make templates cnf/authentication.conf cnf/geonames.conf cnf/gis.conf \
+     cnf/avi.conf cnf/observation.conf start-redis-db start-geonames-db
+
+echo "*** Running the TopoJSON tests; regenerated output lands in failures/..."
+rm -f $(for t in $TOPOJSON_TESTS; do echo "failures/$t"; done)
+INPUTS=$(for t in $TOPOJSON_TESTS; do echo "input/$t"; done)
+./TestRunner.sh $INPUTS || true
+
+echo "*** Updating references from regenerated output..."
+for t in $TOPOJSON_TESTS; do
+  if [ -f "failures/$t" ]; then
+    cp "failures/$t" "output/$t"
+    echo "    updated output/$t"
+  else
+    echo "    output/$t unchanged"
+  fi
+done
+
+echo "*** Stopping the test environment..."
+make stop-redis-db stop-geonames-db
+
+echo "*** Done. Review 'git diff' on test/output/*topojson.get"
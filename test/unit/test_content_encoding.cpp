@@ -0,0 +1,52 @@
+// Unit tests for the content encoding of text responses (ContentEncoding.cpp).
+
+#define BOOST_TEST_MODULE ContentEncoding
+#include "ContentEncoding.h"
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <string>
+
+using namespace SmartMet::Plugin::Dali;
+
+BOOST_AUTO_TEST_CASE(accept_encoding_is_parsed)
+{
+  BOOST_CHECK(ContentEncoding::acceptsGzip("gzip"));
+  BOOST_CHECK(ContentEncoding::acceptsGzip("deflate, GZIP, br"));
+  BOOST_CHECK(ContentEncoding::acceptsGzip("br;q=1.0, gzip;q=0.8"));
+  BOOST_CHECK(ContentEncoding::acceptsGzip("x-gzip"));
+  BOOST_CHECK(ContentEncoding::acceptsGzip("*"));
+
+  BOOST_CHECK(!ContentEncoding::acceptsGzip(""));
+  BOOST_CHECK(!ContentEncoding::acceptsGzip("identity"));
+  BOOST_CHECK(!ContentEncoding::acceptsGzip("br, deflate"));
+  BOOST_CHECK(!ContentEncoding::acceptsGzip("gzip;q=0"));
+  BOOST_CHECK(!ContentEncoding::acceptsGzip("gzip; q=0.000, *"));
+  BOOST_CHECK(!ContentEncoding::acceptsGzip("*;q=0"));
+}
+
+BOOST_AUTO_TEST_CASE(gzip_round_trips)
+{
+  std::string svg;
+  for (int i = 0; i < 1000; i++)
+    svg += "<path d=\"M0 500.2 3.5 500.2 7.5 500.2\"/>\n";
+
+  const auto compressed = ContentEncoding::gzip(svg);
+  BOOST_CHECK_LT(compressed.size(), svg.size() / 10);
+
+  // gzip magic number
+  BOOST_REQUIRE_GT(compressed.size(), 2u);
+  BOOST_CHECK_EQUAL(static_cast<unsigned char>(compressed[0]), 0x1f);
+  BOOST_CHECK_EQUAL(static_cast<unsigned char>(compressed[1]), 0x8b);
+
+  std::istringstream input(compressed);
+  boost::iostreams::filtering_istream in;
+  in.push(boost::iostreams::gzip_decompressor());
+  in.push(input);
+  std::string decompressed;
+  boost::iostreams::copy(in, boost::iostreams::back_inserter(decompressed));
+  BOOST_CHECK(decompressed == svg);
+}
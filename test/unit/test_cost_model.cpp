@@ -0,0 +1,139 @@
+// ======================================================================
+// Unit tests for the request cost model in wms/CostModel.h.
+//
+// Verifies that products are classified by their measured durations,
+// that a recent fast identical request is fast regardless of the
+// product average, that the admission limit holds, that requests are
+// marked rendered only within their own scope, and that admission is
+// required only when the request renders.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE CostModelTest
+#include <boost/test/unit_test.hpp>
+
+#include "CostModel.h"
+
+using namespace SmartMet::Plugin::Dali;
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(unknown_products_use_the_default)
+{
+  CostModel model;
+  BOOST_CHECK(model.isFast(1, 1, true));
+  BOOST_CHECK(!model.isFast(1, 1, false));
+  BOOST_CHECK(!model.predict(1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(products_are_classified_by_moving_average)
+{
+  CostModel model;
+  CostModel::Settings settings;
+  settings.fast_limit = 0.1;
+  settings.smoothing = 0.5;
+  model.init(settings);
+
+  model.record(1, 10, 0.05);
+  BOOST_CHECK(model.isFast(1, 11, false));
+
+  model.record(1, 12, 0.35);  // average 0.2
+  BOOST_CHECK_CLOSE(*model.predict(1, 13), 0.2, 1e-9);
+  BOOST_CHECK(!model.isFast(1, 13, true));
+}
+
+BOOST_AUTO_TEST_CASE(recent_fast_requests_are_fast)
+{
+  CostModel model;
+  model.record(1, 10, 5.0);
+  model.record(1, 11, 0.001);  // served from the cache
+
+  BOOST_CHECK(model.isFast(1, 11, false));
+  BOOST_CHECK(!model.isFast(1, 10, true));
+  BOOST_CHECK(!model.isFast(1, 12, true));
+}
+
+BOOST_AUTO_TEST_CASE(expensive_requests_are_limited)
+{
+  CostModel model;
+  CostModel::Settings settings;
+  settings.max_expensive = 2;
+  model.init(settings);
+
+  auto first = model.admit();
+  auto second = model.admit();
+  BOOST_CHECK(first && second);
+  BOOST_CHECK(!model.admit());
+  BOOST_CHECK_EQUAL(model.expensiveRequests(), 2);
+
+  second.reset();
+  BOOST_CHECK(model.admit());
+  BOOST_CHECK_EQUAL(model.expensiveRequests(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(render_scopes_track_the_current_request)
+{
+  CostModel::markRendered();  // no request, no effect
+
+  CostModel::RenderScope outer;
+  BOOST_CHECK(!outer.rendered());
+  {
+    CostModel::RenderScope inner;
+    CostModel::markRendered();
+    BOOST_CHECK(inner.rendered());
+  }
+  BOOST_CHECK(!outer.rendered());
+
+  CostModel::markRendered();
+  BOOST_CHECK(outer.rendered());
+}
+
+BOOST_AUTO_TEST_CASE(cache_hits_make_the_request_fast)
+{
+  CostModel model;
+  model.record(1, 10, 5.0);
+  model.recordHit(10, 0.001);
+
+  BOOST_CHECK(model.isFast(1, 10, false));
+  BOOST_CHECK(!model.isFast(1, 11, true));
+  BOOST_CHECK_CLOSE(*model.predict(1, 11), 5.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(admission_is_required_only_for_renders)
+{
+  CostModel model;
+  CostModel::Settings settings;
+  settings.max_expensive = 1;
+  model.init(settings);
+
+  auto ticket = model.admit();
+  BOOST_REQUIRE(ticket);
+
+  // A cache hit needs no slot
+  {
+    CostModel::RenderScope scope(&model);
+    BOOST_CHECK(!scope.rejected());
+  }
+
+  // A render over the limit is rejected, also on later attempts
+  {
+    CostModel::RenderScope scope(&model);
+    BOOST_CHECK_THROW(CostModel::markRendered(), std::exception);
+    BOOST_CHECK(scope.rejected());
+    BOOST_CHECK(CostModel::renderRejected());
+    ticket.reset();
+    BOOST_CHECK_THROW(CostModel::markRendered(), std::exception);
+  }
+  BOOST_CHECK(!CostModel::renderRejected());
+
+  // A render within the limit holds the slot until the request is done
+  {
+    CostModel::RenderScope scope(&model);
+    CostModel::markRendered();
+    CostModel::markRendered();
+    BOOST_CHECK(scope.rendered());
+    BOOST_CHECK_EQUAL(model.expensiveRequests(), 1);
+  }
+  BOOST_CHECK_EQUAL(model.expensiveRequests(), 0);
+}
@@ -1,5 +1,5 @@
 // Unit tests for IsolineFilter's adaptive validity backoff (the "validate"
-// option). The backoff re-smooths the whole geometry set at a halved radius
+// option). The backoff re-smooths the offending geometries at a halved radius
 // until every geometry is OGC-valid, so that smoothing never produces a
 // self-intersecting isoband that would be invalid for clipping.
 //
@@ -51,6 +51,22 @@ OGRGeometryPtr makeSpiral(double turns, double width)
   return OGRGeometryPtr(poly);
 }
 
+// Circle which stays valid under any reasonable smoothing radius
+OGRGeometryPtr makeCircle(double cx, double cy, double radius)
+{
+  auto* poly = new OGRPolygon;
+  auto* ring = new OGRLinearRing;
+  const int N = 400;
+  for (int i = 0; i < N; ++i)
+  {
+    double t = 2 * M_PI * i / N;
+    ring->addPoint(cx + radius * std::cos(t), cy + radius * std::sin(t));
+  }
+  ring->closeRings();
+  poly->addRingDirectly(ring);
+  return OGRGeometryPtr(poly);
+}
+
 IsolineFilter makeFilter(double radius, const Json::Value& validate)
 {
   Json::Value json(Json::objectValue);
@@ -114,6 +130,22 @@ BOOST_AUTO_TEST_CASE(validation_retains_some_smoothing)
                       "validation fell back to the unsmoothed input (no smoothing retained)");
 }
 
+// The backoff is local: a geometry which stays valid keeps the full smoothing
+// radius even though another geometry in the same set has to be backed off.
+BOOST_AUTO_TEST_CASE(validation_backs_off_only_the_offending_geometry)
+{
+  std::vector<OGRGeometryPtr> plain{makeSpiral(3, 1.5), makeCircle(200, 0, 50)};
+  std::vector<OGRGeometryPtr> geoms{makeSpiral(3, 1.5), makeCircle(200, 0, 50)};
+  makeFilter(12.0, Json::Value(false)).apply(plain, false);
+  makeFilter(12.0, Json::Value(true)).apply(geoms, false);
+
+  BOOST_REQUIRE(geoms[0] && geoms[1] && plain[1]);
+  BOOST_CHECK(geoms[0]->IsValid());
+  BOOST_CHECK(geoms[1]->IsValid());
+  BOOST_CHECK_MESSAGE(geoms[1]->Equals(plain[1].get()),
+                      "a valid geometry was re-smoothed at a reduced radius");
+}
+
 // A tiny radius does not fold, so validation must be a no-op there: the result
 // equals the plain smoothed geometry and stays valid.
 BOOST_AUTO_TEST_CASE(small_radius_is_unaffected_by_validation)
@@ -0,0 +1,121 @@
+// ======================================================================
+// Unit tests for the memory limited LRU cache in wms/MemoryLimitedCache.h.
+//
+// Verifies that the least recently used values are evicted when the
+// memory limit is exceeded, that lookups refresh the order, that values
+// larger than the limit are not stored, and that getOrCompute computes a
+// value only once for concurrent callers.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE MemoryLimitedCacheTest
+#include <boost/test/unit_test.hpp>
+
+#include "MemoryLimitedCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SmartMet::Plugin::Dali;
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(least_recently_used_values_are_evicted)
+{
+  MemoryLimitedCache<std::string> cache(100);
+  cache.insert(1, "a", 40);
+  cache.insert(2, "b", 40);
+
+  // Refresh 1 so that 2 is the oldest
+  BOOST_CHECK(cache.find(1));
+
+  cache.insert(3, "c", 40);
+  BOOST_CHECK(cache.find(1));
+  BOOST_CHECK(!cache.find(2));
+  BOOST_CHECK_EQUAL(*cache.find(3), "c");
+
+  auto stats = cache.statistics();
+  BOOST_CHECK_EQUAL(stats.size, 80);
+  BOOST_CHECK_EQUAL(stats.count, 2);
+  BOOST_CHECK_EQUAL(stats.evictions, 1);
+  BOOST_CHECK_EQUAL(stats.misses, 1);
+}
+
+BOOST_AUTO_TEST_CASE(replacing_a_value_updates_the_size)
+{
+  MemoryLimitedCache<std::string> cache(100);
+  cache.insert(1, "a", 60);
+  cache.insert(1, "b", 30);
+  BOOST_CHECK_EQUAL(*cache.find(1), "b");
+  BOOST_CHECK_EQUAL(cache.statistics().size, 30);
+}
+
+BOOST_AUTO_TEST_CASE(oversized_values_are_not_stored)
+{
+  MemoryLimitedCache<std::string> cache(100);
+  cache.insert(1, "a", 50);
+  cache.insert(2, "b", 101);
+  BOOST_CHECK(cache.find(1));
+  BOOST_CHECK(!cache.find(2));
+
+  // Shrinking evicts until the rest fits
+  cache.resize(10);
+  BOOST_CHECK(!cache.find(1));
+  BOOST_CHECK_EQUAL(cache.statistics().size, 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_computations_are_shared)
+{
+  MemoryLimitedCache<int> cache(100);
+  std::atomic<int> computed{0};
+
+  auto compute = [&]()
+  {
+    ++computed;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return std::make_pair(42, std::size_t(10));
+  };
+
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 4; i++)
+    results.push_back(
+        std::async(std::launch::async, [&]() { return cache.getOrCompute(1, compute); }));
+  for (auto& result : results)
+    BOOST_CHECK_EQUAL(result.get(), 42);
+
+  BOOST_CHECK_EQUAL(computed.load(), 1);
+  BOOST_CHECK_EQUAL(*cache.find(1), 42);
+}
+
+BOOST_AUTO_TEST_CASE(failed_computations_are_not_cached)
+{
+  MemoryLimitedCache<int> cache(100);
+  auto fail = []() -> std::pair<int, std::size_t> { throw std::runtime_error("failed"); };
+  BOOST_CHECK_THROW(cache.getOrCompute(1, fail), std::runtime_error);
+  BOOST_CHECK(!cache.find(1));
+
+  BOOST_CHECK_EQUAL(cache.getOrCompute(1, []() { return std::make_pair(1, std::size_t(10)); }), 1);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_and_empty_values_are_computed_again)
+{
+  MemoryLimitedCache<int> cache(100);
+  int computed = 0;
+  auto compute = [&]() { return std::make_pair(++computed, std::size_t(10)); };
+  auto valid = [](int theValue) { return theValue > 1; };
+
+  BOOST_CHECK_EQUAL(cache.getOrCompute(1, compute, valid), 1);
+  BOOST_CHECK_EQUAL(cache.getOrCompute(1, compute, valid), 2);
+  BOOST_CHECK_EQUAL(cache.getOrCompute(1, compute, valid), 2);
+
+  // Zero sized values are not stored
+  auto empty = [&]() { return std::make_pair(++computed, std::size_t(0)); };
+  BOOST_CHECK_EQUAL(cache.getOrCompute(2, empty), 3);
+  BOOST_CHECK_EQUAL(cache.getOrCompute(2, empty), 4);
+}
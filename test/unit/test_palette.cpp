@@ -0,0 +1,185 @@
+// ======================================================================
+// Unit tests for the fixed palette mapping in wms/Palette.h.
+//
+// Verifies that exact colours map to their own entries, that anti-aliased
+// pixels map to the nearest entry, that edge blends are only added when
+// they fit, and that the indexed PNG decodes back to the same pixels.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE PaletteTest
+#include <boost/test/unit_test.hpp>
+
+#include "Palette.h"
+
+#include <cstring>
+#include <png.h>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+// Premultiplied ARGB32 as produced by Cairo
+std::uint32_t pixel(int r, int g, int b, int a)
+{
+  return (static_cast<std::uint32_t>(a) << 24) | ((r * a / 255) << 16) | ((g * a / 255) << 8) |
+         (b * a / 255);
+}
+
+std::vector<std::uint8_t> map(const Palette& thePalette,
+                              const std::vector<std::uint32_t>& thePixels)
+{
+  const int width = static_cast<int>(thePixels.size());
+  return thePalette.map(reinterpret_cast<const unsigned char*>(thePixels.data()),
+                        width,
+                        1,
+                        width * 4);
+}
+
+struct ReadBuffer
+{
+  const std::string* data;
+  std::size_t pos = 0;
+};
+
+void readCallback(png_structp png, png_bytep out, png_size_t len)
+{
+  auto* buffer = static_cast<ReadBuffer*>(png_get_io_ptr(png));
+  std::memcpy(out, buffer->data->data() + buffer->pos, len);
+  buffer->pos += len;
+}
+
+// Decode a PNG into RGBA
+std::vector<std::uint8_t> decode(const std::string& thePng, int& theWidth, int& theHeight)
+{
+  auto* png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  auto* info = png_create_info_struct(png);
+  ReadBuffer buffer{&thePng};
+  png_set_read_fn(png, &buffer, readCallback);
+  png_read_info(png, info);
+
+  theWidth = static_cast<int>(png_get_image_width(png, info));
+  theHeight = static_cast<int>(png_get_image_height(png, info));
+  BOOST_CHECK_EQUAL(png_get_color_type(png, info), PNG_COLOR_TYPE_PALETTE);
+
+  png_set_expand(png);
+  png_set_packing(png);
+  if (png_get_valid(png, info, PNG_INFO_tRNS) == 0)
+    png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+  png_read_update_info(png, info);
+
+  std::vector<std::uint8_t> rgba(4UL * theWidth * theHeight);
+  for (int y = 0; y < theHeight; y++)
+    png_read_row(png, rgba.data() + 4UL * y * theWidth, nullptr);
+  png_destroy_read_struct(&png, &info, nullptr);
+  return rgba;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(duplicates_are_ignored)
+{
+  Palette palette;
+  BOOST_CHECK(palette.add({255, 0, 0, 255}));
+  BOOST_CHECK(palette.add({255, 0, 0, 255}));
+  BOOST_CHECK(palette.add({1, 2, 3, 0}));
+  BOOST_CHECK(palette.add({0, 0, 0, 0}));  // all transparent colours are equal
+  BOOST_CHECK_EQUAL(palette.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(palette_is_limited_to_256_colours)
+{
+  Palette palette;
+  for (int i = 0; i < 256; i++)
+    BOOST_CHECK(palette.add({static_cast<std::uint8_t>(i), 0, 0, 255}));
+  BOOST_CHECK(!palette.add({0, 1, 0, 255}));
+  BOOST_CHECK_EQUAL(palette.size(), 256);
+}
+
+BOOST_AUTO_TEST_CASE(edge_blends_are_added_only_if_they_fit)
+{
+  Palette small;
+  small.add({0, 0, 0, 0});
+  small.add({255, 0, 0, 255});
+  small.add({0, 0, 255, 128});  // not opaque, no blends
+  small.addEdgeBlends();
+  BOOST_CHECK_EQUAL(small.size(), 6);
+
+  Palette large;
+  for (int i = 0; i < 100; i++)
+    large.add({static_cast<std::uint8_t>(i), 0, 0, 255});
+  large.addEdgeBlends();
+  BOOST_CHECK_EQUAL(large.size(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(exact_colours_map_to_their_entries)
+{
+  Palette palette;
+  palette.add({0, 0, 0, 0});
+  palette.add({255, 0, 0, 255});
+  palette.add({0, 128, 0, 255});
+  palette.add({0, 0, 255, 128});
+
+  auto indices = map(palette,
+                     {pixel(0, 0, 0, 0),
+                      pixel(255, 0, 0, 255),
+                      pixel(0, 128, 0, 255),
+                      pixel(0, 0, 255, 128),
+                      pixel(255, 0, 0, 255)});
+  std::vector<std::uint8_t> expected{0, 1, 2, 3, 1};
+  BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(edge_pixels_map_to_nearest_colour)
+{
+  Palette palette;
+  palette.add({0, 0, 0, 0});
+  palette.add({255, 0, 0, 255});
+  palette.add({0, 0, 255, 255});
+  palette.addEdgeBlends();
+
+  auto indices = map(palette,
+                     {pixel(250, 5, 0, 255),   // almost red
+                      pixel(255, 0, 0, 60),    // red edge on transparent
+                      pixel(0, 0, 255, 10),    // barely covered
+                      pixel(10, 0, 240, 200)}  // blue edge
+  );
+
+  const auto& colours = palette.colours();
+  BOOST_CHECK((colours[indices[0]] == Palette::Colour{255, 0, 0, 255}));
+  BOOST_CHECK((colours[indices[1]] == Palette::Colour{255, 0, 0, 64}));
+  BOOST_CHECK((colours[indices[2]] == Palette::Colour{0, 0, 0, 0}));
+  BOOST_CHECK((colours[indices[3]] == Palette::Colour{0, 0, 255, 192}));
+}
+
+BOOST_AUTO_TEST_CASE(indexed_png_round_trip)
+{
+  for (int ncolours : {2, 5, 40})
+  {
+    Palette palette;
+    palette.add({0, 0, 0, 0});
+    for (int i = 1; i < ncolours; i++)
+      palette.add({static_cast<std::uint8_t>(6 * i),
+                   100,
+                   static_cast<std::uint8_t>(255 - 6 * i),
+                   255});
+
+    const int width = 37;
+    const int height = 11;
+    std::vector<std::uint8_t> indices;
+    for (int i = 0; i < width * height; i++)
+      indices.push_back(static_cast<std::uint8_t>((i * 7) % ncolours));
+
+    int w = 0;
+    int h = 0;
+    auto rgba = decode(palette.encodePng(indices, width, height), w, h);
+    BOOST_CHECK_EQUAL(w, width);
+    BOOST_CHECK_EQUAL(h, height);
+
+    auto expected = palette.expand(indices);
+    BOOST_CHECK_EQUAL_COLLECTIONS(rgba.begin(), rgba.end(), expected.begin(), expected.end());
+  }
+}
@@ -0,0 +1,95 @@
+// ======================================================================
+// Unit tests for the PMTiles archive writer and reader in wms/PMTiles.cpp.
+//
+// Verifies the Hilbert curve tile ids against the values given in the
+// specification, and that archives written with and without leaf
+// directories read back the same tile contents.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE PMTilesTest
+#include <boost/test/unit_test.hpp>
+
+#include "PMTiles.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace SmartMet::Plugin::Dali;
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(tile_ids_follow_the_hilbert_curve)
+{
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(0, 0, 0), 0);
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(1, 0, 0), 1);
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(1, 0, 1), 2);
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(1, 1, 1), 3);
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(1, 1, 0), 4);
+  BOOST_CHECK_EQUAL(PMTiles::zxy_to_tileid(2, 0, 0), 5);
+
+  for (uint8_t z = 0; z < 6; z++)
+    for (uint32_t x = 0; x < (1U << z); x++)
+      for (uint32_t y = 0; y < (1U << z); y++)
+      {
+        uint8_t zz = 0;
+        uint32_t xx = 0;
+        uint32_t yy = 0;
+        PMTiles::tileid_to_zxy(PMTiles::zxy_to_tileid(z, x, y), zz, xx, yy);
+        BOOST_CHECK(zz == z && xx == x && yy == y);
+      }
+}
+
+BOOST_AUTO_TEST_CASE(small_archive_round_trip)
+{
+  const std::string path = "test_pmtiles_small.pmtiles";
+
+  PMTiles::Writer writer(PMTiles::TileType::PNG, PMTiles::Compression::None);
+  writer.add(0, 0, 0, "world");
+  writer.add(1, 0, 0, "sea");
+  writer.add(1, 0, 1, "sea");
+  writer.add(1, 1, 1, "land");
+  writer.write(path, "{\"name\":\"test\"}");
+
+  PMTiles::Archive archive(path);
+  BOOST_CHECK_EQUAL(archive.metadata(), "{\"name\":\"test\"}");
+  BOOST_CHECK(archive.header().tile_type == PMTiles::TileType::PNG);
+  BOOST_CHECK_EQUAL(archive.header().min_zoom, 0);
+  BOOST_CHECK_EQUAL(archive.header().max_zoom, 1);
+  BOOST_CHECK_EQUAL(archive.header().addressed_tiles_count, 4);
+  BOOST_CHECK_EQUAL(archive.header().tile_contents_count, 3);
+
+  BOOST_CHECK_EQUAL(*archive.tile(0, 0, 0), "world");
+  BOOST_CHECK_EQUAL(*archive.tile(1, 0, 0), "sea");
+  BOOST_CHECK_EQUAL(*archive.tile(1, 0, 1), "sea");
+  BOOST_CHECK_EQUAL(*archive.tile(1, 1, 1), "land");
+  BOOST_CHECK(!archive.tile(1, 1, 0));
+  BOOST_CHECK(!archive.tile(2, 0, 0));
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(large_archive_uses_leaf_directories)
+{
+  const std::string path = "test_pmtiles_large.pmtiles";
+
+  // Every tile is distinct so that the root directory cannot hold them all
+  PMTiles::Writer writer(PMTiles::TileType::MVT, PMTiles::Compression::None);
+  const uint8_t z = 7;
+  for (uint32_t x = 0; x < 128; x++)
+    for (uint32_t y = 0; y < 128; y++)
+      writer.add(z, x, y, std::to_string(x) + "/" + std::to_string(y));
+  BOOST_CHECK_EQUAL(writer.tiles(), 128 * 128);
+  writer.write(path, "{}");
+
+  PMTiles::Archive archive(path);
+  BOOST_CHECK_GT(archive.header().leaf_dirs_length, 0);
+  BOOST_CHECK_LE(archive.header().root_dir_length, 16384 - PMTiles::header_size);
+
+  for (uint32_t x = 0; x < 128; x += 7)
+    for (uint32_t y = 0; y < 128; y += 5)
+      BOOST_CHECK_EQUAL(*archive.tile(z, x, y), std::to_string(x) + "/" + std::to_string(y));
+
+  std::remove(path.c_str());
+}
@@ -0,0 +1,90 @@
+// ======================================================================
+// Unit tests for the static point quadtree in wms/PointIndex.cpp.
+//
+// Verifies that range queries return the same points in the same
+// priority order as a linear scan, and that points which could not be
+// projected are never returned.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE PointIndexTest
+#include <boost/test/unit_test.hpp>
+
+#include "PointIndex.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+std::vector<uint32_t> linear_query(const std::vector<PointIndex::Point>& thePoints,
+                                   double x1,
+                                   double y1,
+                                   double x2,
+                                   double y2)
+{
+  std::vector<uint32_t> result;
+  for (uint32_t i = 0; i < thePoints.size(); i++)
+  {
+    const auto& p = thePoints[i];
+    if (p.x >= x1 && p.x <= x2 && p.y >= y1 && p.y <= y2)
+      result.push_back(i);
+  }
+  return result;
+}
+}  // namespace
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(queries_match_a_linear_scan)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> coord(-1000, 1000);
+
+  // Clustered points and a few duplicates exercise the splitting
+  std::vector<PointIndex::Point> points;
+  for (int i = 0; i < 5000; i++)
+    points.push_back({coord(rng), coord(rng)});
+  for (int i = 0; i < 500; i++)
+    points.push_back({10 + coord(rng) / 1000, 20 + coord(rng) / 1000});
+  for (int i = 0; i < 100; i++)
+    points.push_back({5, 5});
+
+  PointIndex index(points, 16);
+  BOOST_CHECK_EQUAL(index.size(), points.size());
+
+  for (int i = 0; i < 200; i++)
+  {
+    const double x1 = coord(rng);
+    const double y1 = coord(rng);
+    const double x2 = x1 + std::abs(coord(rng)) / 4;
+    const double y2 = y1 + std::abs(coord(rng)) / 4;
+    BOOST_CHECK(index.query(x1, y1, x2, y2) == linear_query(points, x1, y1, x2, y2));
+  }
+
+  // Flipped corners, a cluster and the whole set
+  BOOST_CHECK(index.query(11, 21, 9, 19) == linear_query(points, 9, 19, 11, 21));
+  BOOST_CHECK(index.query(5, 5, 5, 5) == linear_query(points, 5, 5, 5, 5));
+  BOOST_CHECK_EQUAL(index.query(-1000, -1000, 1000, 1000).size(), points.size());
+}
+
+BOOST_AUTO_TEST_CASE(unprojectable_points_are_skipped)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+
+  std::vector<PointIndex::Point> points{{0, 0}, {inf, inf}, {1, 1}, {nan, 0}, {2, 2}};
+  PointIndex index(points, 1);
+
+  const auto all = index.query(-inf, -inf, inf, inf);
+  BOOST_CHECK(all == (std::vector<uint32_t>{0, 2, 4}));
+  BOOST_CHECK(index.query(0.5, 0.5, 1.5, 1.5) == std::vector<uint32_t>{2});
+
+  PointIndex empty;
+  BOOST_CHECK(empty.query(-inf, -inf, inf, inf).empty());
+}
@@ -0,0 +1,68 @@
+// ======================================================================
+// Unit tests for the Space-Saving request counter in wms/PopularitySketch.h.
+//
+// Verifies that frequent keys survive a stream of rare ones in a full
+// table, that values are listed per group in popularity order, and that
+// decay removes keys seen only once.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE PopularitySketchTest
+#include <boost/test/unit_test.hpp>
+
+#include "PopularitySketch.h"
+
+#include <string>
+#include <vector>
+
+using namespace SmartMet::Plugin::Dali;
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(frequent_keys_survive_rare_keys)
+{
+  PopularitySketch<std::string> sketch(10);
+
+  for (int round = 0; round < 100; round++)
+  {
+    sketch.record(1, "hot", {"ecmwf"});
+    sketch.record(2, "warm", {"ecmwf", "hirlam"});
+    if (round % 2 == 0)
+      sketch.record(2, "warm", {"ecmwf", "hirlam"});
+    sketch.record(1000 + round, "cold", {"ecmwf"});
+  }
+
+  BOOST_CHECK_EQUAL(sketch.size(), 10U);
+
+  auto top = sketch.top("ecmwf", 2);
+  BOOST_REQUIRE_EQUAL(top.size(), 2U);
+  BOOST_CHECK_EQUAL(top[0], "warm");
+  BOOST_CHECK_EQUAL(top[1], "hot");
+
+  top = sketch.top("hirlam", 5);
+  BOOST_REQUIRE_EQUAL(top.size(), 1U);
+  BOOST_CHECK_EQUAL(top[0], "warm");
+
+  BOOST_CHECK(sketch.groups() == (std::set<std::string>{"ecmwf", "hirlam"}));
+}
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(decay_forgets_single_requests)
+{
+  PopularitySketch<std::string> sketch(10);
+  sketch.record(1, "once", {"a"});
+  for (int i = 0; i < 4; i++)
+    sketch.record(2, "often", {"b"});
+
+  sketch.decay();
+  BOOST_CHECK_EQUAL(sketch.size(), 1U);
+  BOOST_CHECK(sketch.top("a", 10).empty());
+  BOOST_CHECK_EQUAL(sketch.top("b", 10).size(), 1U);
+
+  // A zero size sketch counts nothing
+  sketch.resize(0);
+  sketch.record(3, "ignored", {"c"});
+  BOOST_CHECK_EQUAL(sketch.size(), 0U);
+}
@@ -0,0 +1,99 @@
+// ======================================================================
+// Unit tests for the background prerendering in wms/Prerenderer.h.
+//
+// Verifies that requests are stored without the ETag probe and
+// conditional headers, so that replaying a recorded frontend probe
+// renders the product into the image cache instead of ending with a
+// 204 or 304 response.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE PrerendererTest
+#include <boost/test/unit_test.hpp>
+
+#include "Prerenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace SmartMet::Plugin::Dali;
+using SmartMet::Spine::HTTP::Request;
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(replayable_requests_have_no_conditionals)
+{
+  Request request;
+  request.setResource("/wms");
+  request.setParameter("layers", "temperature");
+  request.setHeader("X-Request-ETag", "true");
+  request.setHeader("If-None-Match", "\"1234\"");
+  request.setHeader("If-Modified-Since", "Sun, 18 Oct 2026 10:00:00 GMT");
+  request.setHeader("Accept-Encoding", "gzip");
+
+  auto replay = Prerenderer::replayable(request);
+  BOOST_CHECK(!replay.getHeader("X-Request-ETag"));
+  BOOST_CHECK(!replay.getHeader("If-None-Match"));
+  BOOST_CHECK(!replay.getHeader("If-Modified-Since"));
+  BOOST_CHECK(replay.getHeader("Accept-Encoding"));
+  BOOST_CHECK_EQUAL(replay.getResource(), "/wms");
+  BOOST_CHECK(replay.getParameter("layers"));
+}
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(replayed_probes_fill_the_image_cache)
+{
+  // Behaves like the plugin: probes and conditional requests end before rendering
+  std::mutex mutex;
+  std::set<std::string> image_cache;
+  auto renderer = [&](const Request& theRequest)
+  {
+    if (theRequest.getHeader("X-Request-ETag") || theRequest.getHeader("If-None-Match"))
+      return true;
+    std::lock_guard<std::mutex> lock(mutex);
+    image_cache.insert(theRequest.getResource());
+    return true;
+  };
+
+  // The first version is only remembered, the second one triggers the replay
+  std::atomic<int> checks{0};
+  auto version = [&](const std::string& /* theProducer */) -> std::size_t
+  { return (++checks == 1 ? 1 : 2); };
+
+  Prerenderer::Settings settings;
+  settings.enabled = true;
+  settings.interval = 1;
+
+  Prerenderer prerenderer;
+  prerenderer.init(settings, version, renderer);
+
+  Request probe;
+  probe.setResource("/dali");
+  probe.setHeader("X-Request-ETag", "true");
+  prerenderer.record(1, probe, {"ecmwf"});
+
+  Request conditional;
+  conditional.setResource("/wms");
+  conditional.setHeader("If-None-Match", "\"1234\"");
+  prerenderer.record(2, conditional, {"ecmwf"});
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (image_cache.size() == 2)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  prerenderer.shutdown();
+
+  BOOST_CHECK(image_cache == (std::set<std::string>{"/dali", "/wms"}));
+}
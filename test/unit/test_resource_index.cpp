@@ -0,0 +1,144 @@
+// ======================================================================
+// Unit tests for the resource index in wms/ResourceIndex.h.
+//
+// Verifies that only files under customers/ and resources/ are covered,
+// that existence and modification times come from the last scan, that
+// cached contents are refreshed when a rescan sees a change and stay
+// within the memory limit, and that broken entries do not stop a scan.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE ResourceIndexTest
+#include <boost/test/unit_test.hpp>
+
+#include "ResourceIndex.h"
+
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+struct Fixture
+{
+  Fixture()
+      : root(std::filesystem::temp_directory_path() /
+             ("resource_index_test_" + std::to_string(::getpid())))
+  {
+    std::filesystem::create_directories(root / "customers/fmi/symbols");
+    std::filesystem::create_directories(root / "resources/layers/symbols");
+    write("customers/fmi/symbols/rain.svg", "<path/>");
+    write("resources/layers/symbols/snow.svg", "<circle/>");
+    write("other.svg", "<rect/>");
+  }
+
+  ~Fixture() { std::filesystem::remove_all(root); }
+
+  void write(const std::string& theName, const std::string& theContents) const
+  {
+    std::ofstream out(root / theName);
+    out << theContents;
+  }
+
+  std::string path(const std::string& theName) const { return (root / theName).string(); }
+
+  std::filesystem::path root;
+};
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+
+BOOST_FIXTURE_TEST_CASE(only_customers_and_resources_are_covered, Fixture)
+{
+  ResourceIndex index({root.string() + "/"});
+  index.init(0);
+
+  BOOST_CHECK(index.covers(path("customers/fmi/symbols/rain.svg")));
+  BOOST_CHECK(index.covers(path("resources/missing.svg")));
+  BOOST_CHECK(!index.covers(path("other.svg")));
+  BOOST_CHECK(!index.covers(path("resources/../other.svg")));
+  BOOST_CHECK_EQUAL(index.size(), 2);
+
+  // Uncovered paths are checked from the filesystem
+  BOOST_CHECK(index.exists(path("other.svg")));
+  BOOST_CHECK(!index.modified(path("other.svg")));
+  BOOST_CHECK(!index.contents(path("other.svg")));
+}
+
+BOOST_FIXTURE_TEST_CASE(lookups_use_the_last_scan, Fixture)
+{
+  ResourceIndex index({root.string()});
+  index.init(0);
+
+  BOOST_CHECK(index.exists(path("customers/fmi/symbols/rain.svg")));
+  BOOST_CHECK(index.modified(path("resources/layers/symbols/snow.svg")));
+  BOOST_CHECK(!index.exists(path("customers/fmi/symbols/hail.svg")));
+
+  write("customers/fmi/symbols/hail.svg", "<g/>");
+  std::filesystem::remove(path("resources/layers/symbols/snow.svg"));
+  BOOST_CHECK(!index.exists(path("customers/fmi/symbols/hail.svg")));
+  BOOST_CHECK(index.exists(path("resources/layers/symbols/snow.svg")));
+
+  index.update();
+  BOOST_CHECK(index.exists(path("customers/fmi/symbols/hail.svg")));
+  BOOST_CHECK(!index.exists(path("resources/layers/symbols/snow.svg")));
+  BOOST_CHECK(!index.contents(path("resources/layers/symbols/snow.svg")));
+}
+
+BOOST_FIXTURE_TEST_CASE(contents_are_refreshed_after_changes, Fixture)
+{
+  ResourceIndex index({root.string()});
+  index.init(0);
+
+  const auto name = path("customers/fmi/symbols/rain.svg");
+  auto first = index.contents(name);
+  BOOST_REQUIRE(first);
+  BOOST_CHECK_EQUAL(*first, "<path/>");
+  BOOST_CHECK_EQUAL(index.contents(name).get(), first.get());
+
+  write("customers/fmi/symbols/rain.svg", "<path d='M0 0'/>");
+  index.update();
+
+  auto second = index.contents(name);
+  BOOST_REQUIRE(second);
+  BOOST_CHECK_EQUAL(*second, "<path d='M0 0'/>");
+}
+
+BOOST_FIXTURE_TEST_CASE(cached_contents_are_bounded, Fixture)
+{
+  ResourceIndex index({root.string()});
+  index.init(0, 8);
+
+  // Files larger than the limit are read again each time
+  const auto small = path("customers/fmi/symbols/rain.svg");
+  auto first = index.contents(small);
+  BOOST_REQUIRE(first);
+  BOOST_CHECK_EQUAL(index.contents(small).get(), first.get());
+
+  const auto large = path("resources/layers/symbols/snow.svg");
+  auto second = index.contents(large);
+  BOOST_REQUIRE(second);
+  BOOST_CHECK_EQUAL(*second, "<circle/>");
+  BOOST_CHECK(index.contents(large).get() != second.get());
+}
+
+BOOST_FIXTURE_TEST_CASE(broken_entries_are_skipped, Fixture)
+{
+  std::filesystem::create_symlink(root / "customers/missing", root / "customers/dangling");
+  std::filesystem::create_directory_symlink("loop", root / "customers/loop");
+  std::filesystem::create_directories(root / "customers/zzz");
+  write("customers/zzz/last.svg", "<g/>");
+
+  ResourceIndex index({root.string()});
+  index.init(0);
+
+  BOOST_CHECK(index.exists(path("customers/fmi/symbols/rain.svg")));
+  BOOST_CHECK(index.exists(path("customers/zzz/last.svg")));
+  BOOST_CHECK(index.exists(path("resources/layers/symbols/snow.svg")));
+  BOOST_CHECK(!index.exists(path("customers/dangling")));
+  BOOST_CHECK_EQUAL(index.size(), 3);
+}
@@ -0,0 +1,61 @@
+// Unit tests for the compact SVG path encoder (SvgPath.cpp).
+//
+// The encoder writes relative commands with quantised fixed point numbers and
+// drops the vertices which would not change the rendered path at the output
+// precision. The identity box keeps the pixel coordinates as given.
+
+#define BOOST_TEST_MODULE SvgPath
+#include "SvgPath.h"
+#include <boost/test/unit_test.hpp>
+#include <gis/Box.h>
+#include <ogr_geometry.h>
+
+using SmartMet::Plugin::Dali::SvgPath::compact;
+
+namespace
+{
+OGRLinearRing* ring(std::initializer_list<std::pair<double, double>> thePoints)
+{
+  auto* ret = new OGRLinearRing;
+  for (const auto& xy : thePoints)
+    ret->addPoint(xy.first, xy.second);
+  return ret;
+}
+}  // namespace
+
+// Relative moves and implicit linetos, the closing vertex becomes z
+BOOST_AUTO_TEST_CASE(polygon_is_relative)
+{
+  OGRPolygon polygon;
+  polygon.addRingDirectly(ring({{10, 10}, {20, 10}, {20, 20}, {10, 20}, {10, 10}}));
+  polygon.addRingDirectly(ring({{12, 12}, {12, 14}, {14, 14}, {12, 12}}));
+
+  BOOST_CHECK_EQUAL(compact(polygon, Fmi::Box::identity(), 0),
+                    "m10 10 10 0 0 10-10 0zm2 2 0 2 2 0z");
+}
+
+// Collinear and sub-pixel vertices are dropped after quantisation
+BOOST_AUTO_TEST_CASE(redundant_vertices_are_dropped)
+{
+  OGRLineString line;
+  line.addPoint(0, 0);
+  line.addPoint(1, 0);
+  line.addPoint(1.02, 0.01);
+  line.addPoint(2, 0);
+  line.addPoint(3, 0);
+  line.addPoint(3, 5);
+  line.addPoint(3, 2);
+
+  BOOST_CHECK_EQUAL(compact(line, Fmi::Box::identity(), 1), "m0 0 3 0 0 5 0-3");
+}
+
+// Fixed point numbers without leading or trailing zeros
+BOOST_AUTO_TEST_CASE(numbers_are_compact)
+{
+  OGRLineString line;
+  line.addPoint(0.5, 1.25);
+  line.addPoint(0.25, 3.5);
+  line.addPoint(10.3, -0.2);
+
+  BOOST_CHECK_EQUAL(compact(line, Fmi::Box::identity(), 2), "m.5 1.25-.25 2.25 10.05-3.7");
+}
@@ -0,0 +1,227 @@
+// ======================================================================
+// Unit tests for the baked tile index in wms/TileBakery.cpp.
+//
+// Verifies that baking is reserved for the configured apikeys, that
+// tiles are found by product hash as views into the mapped archive, and
+// that completed bakes delete the archives of older model runs only, and
+// that only one bake runs at a time.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE TileBakeryTest
+#include <boost/test/unit_test.hpp>
+
+#include "TileBakery.h"
+
+#include <filesystem>
+#include <future>
+#include <string>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+// Write a one tile archive with the metadata handlers/tiles/Handler.cpp writes
+std::string bake(const std::string& theDirectory,
+                 const std::string& theCollection,
+                 const std::string& theReferenceTime,
+                 const std::string& theOriginTime,
+                 const std::string& theTime,
+                 const std::string& theHash,
+                 const std::string& theData)
+{
+  const auto directory =
+      theDirectory + "/" + theCollection + "/WebMercatorQuad/" +
+      (theReferenceTime.empty() ? std::string("latest") : theReferenceTime);
+  std::filesystem::create_directories(directory);
+  const auto path = directory + "/" + theTime + ".png.pmtiles";
+
+  PMTiles::Writer writer(PMTiles::TileType::PNG, PMTiles::Compression::None);
+  writer.add(0, 0, 0, theData);
+  writer.write(path,
+               "{\"format\":\"png\",\"name\":\"" + theCollection + "\",\"dali\":{\"collection\":\"" +
+                   theCollection + "\",\"tileMatrixSet\":\"WebMercatorQuad\",\"datetime\":\"" +
+                   theTime + "\",\"reference_time\":\"" + theReferenceTime + "\",\"origin_time\":\"" +
+                   theOriginTime + "\",\"hashes\":{\"0\":\"" + theHash + "\"}}}");
+  return path;
+}
+
+struct Fixture
+{
+  const std::string directory = "test_tile_bakery.d";
+  Fixture() { std::filesystem::remove_all(directory); }
+  ~Fixture() { std::filesystem::remove_all(directory); }
+};
+}  // namespace
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(baking_requires_a_configured_apikey)
+{
+  Fixture fixture;
+
+  TileBakery disabled;
+  disabled.init("", {"secret"});
+  BOOST_CHECK(!disabled.authorized(std::string("secret")));
+
+  TileBakery nokeys;
+  nokeys.init(fixture.directory);
+  BOOST_CHECK(nokeys.enabled());
+  BOOST_CHECK(!nokeys.authorized(std::string("secret")));
+  BOOST_CHECK(!nokeys.authorized(std::nullopt));
+
+  TileBakery bakery;
+  bakery.init(fixture.directory, {"secret"});
+  BOOST_CHECK(bakery.authorized(std::string("secret")));
+  BOOST_CHECK(!bakery.authorized(std::string("other")));
+  BOOST_CHECK(!bakery.authorized(std::nullopt));
+}
+
+BOOST_AUTO_TEST_CASE(tiles_are_found_without_copying)
+{
+  Fixture fixture;
+  const auto path = bake(fixture.directory, "t2m", "", "20260101T000000", "t1", "abc", "tile");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+  BOOST_CHECK_EQUAL(bakery.statistics().archives, 1);
+
+  BOOST_CHECK(!bakery.find(0xabd));
+  auto tile = bakery.find(0xabc);
+  BOOST_REQUIRE(tile);
+  BOOST_CHECK_EQUAL(tile->data, "tile");
+  BOOST_CHECK_EQUAL(tile->archive->path(), path);
+  BOOST_CHECK(tile->data.data() == tile->archive->tile(0, 0, 0)->data());
+  BOOST_CHECK_EQUAL(bakery.statistics().hits, 1);
+}
+
+BOOST_AUTO_TEST_CASE(newer_latest_runs_replace_older_latest_runs)
+{
+  Fixture fixture;
+  const auto old1 = bake(fixture.directory, "t2m", "", "20260101T000000", "t1", "a1", "old");
+  const auto old2 = bake(fixture.directory, "t2m", "", "20260101T000000", "t2", "a2", "old");
+  const auto other = bake(fixture.directory, "wind", "", "20260101T000000", "t1", "b1", "other");
+  const auto run = bake(fixture.directory, "t2m", "20251231T000000", "", "t1", "c1", "run");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+  BOOST_CHECK_EQUAL(bakery.statistics().archives, 4);
+
+  const auto new2 = bake(fixture.directory, "t2m", "", "20260101T060000", "t2", "d2", "new");
+  const auto new3 = bake(fixture.directory, "t2m", "", "20260101T060000", "t3", "d3", "new");
+  bakery.add(new2);
+  bakery.add(new3);
+  BOOST_CHECK_EQUAL(bakery.prune(new2), 1);
+  BOOST_CHECK_EQUAL(bakery.prune(new3), 0);
+
+  // The archive of the same valid time was replaced when added, t1 of the older run is pruned
+  BOOST_CHECK_EQUAL(new2, old2);
+  BOOST_CHECK(!std::filesystem::exists(old1));
+  BOOST_CHECK(!bakery.find(0xa1));
+  BOOST_CHECK(!bakery.find(0xa2));
+  BOOST_CHECK(std::filesystem::exists(new2));
+  BOOST_CHECK(std::filesystem::exists(new3));
+  BOOST_CHECK(bakery.find(0xd2));
+  BOOST_CHECK(bakery.find(0xd3));
+
+  // Other collections and explicit runs are not affected
+  BOOST_CHECK(std::filesystem::exists(other));
+  BOOST_CHECK(std::filesystem::exists(run));
+  BOOST_CHECK(bakery.find(0xb1));
+  BOOST_CHECK(bakery.find(0xc1));
+  BOOST_CHECK_EQUAL(bakery.statistics().archives, 4);
+}
+
+BOOST_AUTO_TEST_CASE(valid_times_of_the_same_run_can_be_baked_separately)
+{
+  Fixture fixture;
+  const auto first = bake(fixture.directory, "t2m", "", "20260101T000000", "t1", "a1", "first");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+
+  const auto second = bake(fixture.directory, "t2m", "", "20260101T000000", "t2", "a2", "second");
+  bakery.add(second);
+  BOOST_CHECK_EQUAL(bakery.prune(second), 0);
+
+  BOOST_CHECK(std::filesystem::exists(first));
+  BOOST_CHECK(std::filesystem::exists(second));
+  BOOST_CHECK(bakery.find(0xa1));
+  BOOST_CHECK(bakery.find(0xa2));
+}
+
+BOOST_AUTO_TEST_CASE(archives_without_a_model_run_are_kept)
+{
+  Fixture fixture;
+  const auto unknown = bake(fixture.directory, "obs", "", "", "t1", "a1", "unknown");
+  const auto known = bake(fixture.directory, "obs", "", "20260101T000000", "t2", "a2", "known");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+
+  const auto newer = bake(fixture.directory, "obs", "", "", "t3", "a3", "newer");
+  bakery.add(newer);
+  BOOST_CHECK_EQUAL(bakery.prune(newer), 0);
+
+  const auto latest = bake(fixture.directory, "obs", "", "20260101T060000", "t4", "a4", "latest");
+  bakery.add(latest);
+  BOOST_CHECK_EQUAL(bakery.prune(latest), 1);
+
+  BOOST_CHECK(std::filesystem::exists(unknown));
+  BOOST_CHECK(!std::filesystem::exists(known));
+  BOOST_CHECK(std::filesystem::exists(newer));
+}
+
+BOOST_AUTO_TEST_CASE(newer_runs_replace_older_runs)
+{
+  Fixture fixture;
+  const auto old = bake(fixture.directory, "t2m", "20260101T000000", "", "t1", "a1", "old");
+  const auto same = bake(fixture.directory, "t2m", "20260101T060000", "", "t1", "b1", "same");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+
+  // A later bake of the same run for another valid time keeps the earlier archives
+  const auto newer = bake(fixture.directory, "t2m", "20260101T060000", "", "t2", "b2", "new");
+  bakery.add(newer);
+  BOOST_CHECK_EQUAL(bakery.prune(newer), 1);
+
+  BOOST_CHECK(!std::filesystem::exists(old));
+  BOOST_CHECK(!std::filesystem::exists(std::filesystem::path(old).parent_path()));
+  BOOST_CHECK(!bakery.find(0xa1));
+  BOOST_CHECK(std::filesystem::exists(same));
+  BOOST_CHECK(bakery.find(0xb1));
+  BOOST_CHECK(bakery.find(0xb2));
+}
+
+BOOST_AUTO_TEST_CASE(pruned_tiles_stay_readable)
+{
+  Fixture fixture;
+  bake(fixture.directory, "t2m", "", "20260101T000000", "t1", "a1", "old");
+
+  TileBakery bakery;
+  bakery.init(fixture.directory);
+  auto tile = bakery.find(0xa1);
+  BOOST_REQUIRE(tile);
+
+  const auto path = bake(fixture.directory, "t2m", "", "20260101T060000", "t2", "b1", "new");
+  bakery.add(path);
+  BOOST_CHECK_EQUAL(bakery.prune(path), 1);
+
+  // The mapping outlives the deleted file as long as the tile is in use
+  BOOST_CHECK_EQUAL(tile->data, "old");
+}
+
+BOOST_AUTO_TEST_CASE(one_bake_runs_at_a_time)
+{
+  TileBakery bakery;
+  auto other = [&bakery]() { return bakery.reserve().owns_lock(); };
+
+  auto first = bakery.reserve();
+  BOOST_CHECK(first.owns_lock());
+  BOOST_CHECK(!std::async(std::launch::async, other).get());
+
+  first.unlock();
+  BOOST_CHECK(std::async(std::launch::async, other).get());
+}
@@ -0,0 +1,132 @@
+// ======================================================================
+// Unit tests for the per-stage request timing in wms/Timing.h.
+//
+// Verifies that spans are recorded only while a request scope is active,
+// that the Server-Timing header sums repeated stages into valid tokens,
+// and that finished requests show up in the histogram statistics.
+//
+// Run with: make test
+// ======================================================================
+
+#define BOOST_TEST_MODULE TimingTest
+#include <boost/test/unit_test.hpp>
+
+#include "Timing.h"
+
+#include <json/json.h>
+#include <json/reader.h>
+#include <memory>
+#include <sstream>
+
+using namespace SmartMet::Plugin::Dali;
+
+namespace
+{
+Json::Value parse(const std::string& theText)
+{
+  Json::Value json;
+  Json::CharReaderBuilder builder;
+  std::string errors;
+  std::istringstream in(theText);
+  BOOST_REQUIRE(Json::parseFromStream(builder, in, &json, &errors));
+  return json;
+}
+}  // namespace
+
+// ---------------------------------------------------------------------------
+
+BOOST_AUTO_TEST_CASE(span_without_request_is_ignored)
+{
+  Timing::RequestTiming timing;
+  {
+    Timing::ScopedSpan span("generate");
+  }
+  BOOST_CHECK(timing.spans().empty());
+}
+
+BOOST_AUTO_TEST_CASE(spans_are_recorded_into_the_active_request)
+{
+  Timing::RequestTiming timing;
+  {
+    Timing::RequestScope scope(timing);
+    Timing::ScopedSpan outer("generate", "png");
+    {
+      Timing::ScopedSpan inner("layer", "isoband");
+    }
+  }
+  BOOST_REQUIRE_EQUAL(timing.spans().size(), 2U);
+  BOOST_CHECK_EQUAL(timing.spans()[0].stage, "layer");
+  BOOST_CHECK_EQUAL(timing.spans()[0].tag, "isoband");
+  BOOST_CHECK_EQUAL(timing.spans()[1].stage, "generate");
+
+  // The scope has ended, nothing more is recorded
+  {
+    Timing::ScopedSpan span("template");
+  }
+  BOOST_CHECK_EQUAL(timing.spans().size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(nested_scopes_restore_the_outer_request)
+{
+  Timing::RequestTiming outer;
+  Timing::RequestTiming inner;
+  Timing::RequestScope outer_scope(outer);
+  {
+    Timing::RequestScope inner_scope(inner);
+    Timing::ScopedSpan span("hash");
+  }
+  {
+    Timing::ScopedSpan span("json");
+  }
+  BOOST_REQUIRE_EQUAL(inner.spans().size(), 1U);
+  BOOST_REQUIRE_EQUAL(outer.spans().size(), 1U);
+  BOOST_CHECK_EQUAL(outer.spans()[0].stage, "json");
+}
+
+BOOST_AUTO_TEST_CASE(server_timing_sums_repeated_stages)
+{
+  Timing::RequestTiming timing;
+  timing.add("layer", "isoband:ecmwf", 1500);
+  timing.add("template", "", 250);
+  timing.add("layer", "isoband:ecmwf", 500);
+
+  BOOST_CHECK_EQUAL(timing.serverTiming(),
+                    "layer-isoband_ecmwf;dur=2.000, template;dur=0.250");
+}
+
+BOOST_AUTO_TEST_CASE(recorded_requests_appear_in_statistics)
+{
+  Timing::RequestTiming timing;
+  timing.add("unit-test", "a", 3000);
+  timing.add("unit-test", "a", 5000);
+  timing.add("unit-test", "b", 0);
+  Timing::record(timing);
+
+  auto json = parse(Timing::statistics());
+  const auto& stages = json["stages"];
+  BOOST_REQUIRE(stages.isArray());
+
+  bool found_a = false;
+  bool found_b = false;
+  for (const auto& stage : stages)
+  {
+    if (stage["stage"].asString() != "unit-test")
+      continue;
+    if (stage["tag"].asString() == "a")
+    {
+      found_a = true;
+      BOOST_CHECK_EQUAL(stage["count"].asUInt64(), 2U);
+      BOOST_CHECK_CLOSE(stage["mean_ms"].asDouble(), 4.0, 1e-9);
+      BOOST_CHECK_CLOSE(stage["max_ms"].asDouble(), 5.0, 1e-9);
+      // 3000 and 5000 us fall into the [2048, 4096) and [4096, 8192) buckets
+      BOOST_CHECK_CLOSE(stage["p50_ms"].asDouble(), 8.192, 1e-9);
+    }
+    else if (stage["tag"].asString() == "b")
+    {
+      found_b = true;
+      BOOST_CHECK_EQUAL(stage["p99_ms"].asDouble(), 0.0);
+    }
+  }
+  BOOST_CHECK(found_a);
+  BOOST_CHECK(found_b);
+}
@@ -0,0 +1,120 @@
+// Unit tests for the TopoJSON topology encoder (TopologyEncoder.cpp).
+//
+// The encoder cuts rings at junctions so that the boundary between two
+// adjacent polygons is written once and referenced by both, one of them in
+// reverse (~index). These tests pin the arc references and the quantised
+// delta coordinates of small topologies.
+
+#define BOOST_TEST_MODULE TopologyEncoder
+#include "TopologyEncoder.h"
+#include <boost/test/unit_test.hpp>
+#include <ogr_geometry.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+using SmartMet::Plugin::Dali::TopologyEncoder;
+
+namespace
+{
+OGRPolygon* square(double x, double y, double size)
+{
+  auto* ring = new OGRLinearRing;
+  ring->addPoint(x, y);
+  ring->addPoint(x + size, y);
+  ring->addPoint(x + size, y + size);
+  ring->addPoint(x, y + size);
+  ring->addPoint(x, y);
+  auto* polygon = new OGRPolygon;
+  polygon->addRingDirectly(ring);
+  return polygon;
+}
+}  // namespace
+
+// Two unit squares sharing the edge x=1. The shared edge becomes its own arc,
+// referenced forwards by the first square and backwards by the second.
+BOOST_AUTO_TEST_CASE(adjacent_polygons_share_the_common_edge)
+{
+  std::unordered_map<std::size_t, uint> hashes;
+  uint counter = 0;
+
+  std::unique_ptr<OGRPolygon> left(square(0, 0, 1));
+  std::unique_ptr<OGRPolygon> right(square(1, 0, 1));
+
+  TopologyEncoder encoder(0);
+  auto i = encoder.add(*left);
+  auto j = encoder.add(*right);
+  encoder.encode(hashes, counter);
+
+  BOOST_CHECK_EQUAL(counter, 3u);
+  BOOST_CHECK_EQUAL(encoder.arcs(i), "[[0,1]]");
+  BOOST_CHECK_EQUAL(encoder.arcs(j), "[[2,-1]]");
+  BOOST_CHECK_EQUAL(encoder.newArcs(),
+                    "[[1,0],[0,1]],"
+                    "[[1,1],[-1,0],[0,-1],[1,0]],"
+                    "[[1,0],[1,0],[0,1],[-1,0]]");
+  BOOST_CHECK(encoder.coordinates(i).empty());
+}
+
+// Identical rings are shared between encoders whatever their starting
+// points and orientations, and multipolygons nest each polygon separately.
+BOOST_AUTO_TEST_CASE(rings_are_shared_between_encoders)
+{
+  std::unordered_map<std::size_t, uint> hashes;
+  uint counter = 0;
+
+  OGRMultiPolygon multi;
+  multi.addGeometryDirectly(square(0, 0, 1));
+  multi.addGeometryDirectly(square(5, 5, 1));
+
+  TopologyEncoder first(0);
+  auto i = first.add(multi);
+  first.encode(hashes, counter);
+  BOOST_CHECK_EQUAL(first.arcs(i), "[[[0]],[[1]]]");
+  BOOST_CHECK_EQUAL(first.newArcs(),
+                    "[[0,0],[1,0],[0,1],[-1,0],[0,-1]],"
+                    "[[5,5],[1,0],[0,1],[-1,0],[0,-1]]");
+
+  // The first square clockwise, starting from the opposite corner
+  OGRPolygon polygon;
+  auto* ring = new OGRLinearRing;
+  ring->addPoint(1, 1);
+  ring->addPoint(1, 0);
+  ring->addPoint(0, 0);
+  ring->addPoint(0, 1);
+  ring->addPoint(1, 1);
+  polygon.addRingDirectly(ring);
+
+  TopologyEncoder second(0);
+  auto j = second.add(polygon);
+  second.encode(hashes, counter);
+  BOOST_CHECK_EQUAL(second.arcs(j), "[[-1]]");
+  BOOST_CHECK(second.newArcs().empty());
+  BOOST_CHECK_EQUAL(counter, 2u);
+}
+
+// Coordinates are multiplied by 10^precision and truncated, duplicates are dropped
+BOOST_AUTO_TEST_CASE(lines_and_points_are_quantised)
+{
+  std::unordered_map<std::size_t, uint> hashes;
+  uint counter = 0;
+
+  OGRLineString line;
+  line.addPoint(0.123, -0.456);
+  line.addPoint(0.1231, -0.4561);
+  line.addPoint(1.0, 1.0);
+
+  OGRMultiPoint points;
+  points.addGeometryDirectly(new OGRPoint(0.5, -1.256));
+  points.addGeometryDirectly(new OGRPoint(2, 3));
+
+  TopologyEncoder encoder(2);
+  auto i = encoder.add(line);
+  auto j = encoder.add(points);
+  encoder.encode(hashes, counter);
+
+  BOOST_CHECK_EQUAL(encoder.arcs(i), "[0]");
+  BOOST_CHECK_EQUAL(encoder.newArcs(), "[[12,-45],[88,145]]");
+  BOOST_CHECK(encoder.arcs(j).empty());
+  BOOST_CHECK_EQUAL(encoder.coordinates(j), "[[50,-125],[200,300]]");
+}
@@ -1546,11 +1546,17 @@ std::size_t ArrowLayer::hash_value(const State& theState) const
 {
   try
   {
-    if (theState.isObservation(paraminfo.producer))
-      return Fmi::bad_hash;
-
     auto hash = Layer::hash_value(theState);
 
+    // Observation layers are cached only until new observations arrive
+    if (theState.isObservation(paraminfo.producer))
+    {
+      auto obshash = observationHash(theState);
+      if (obshash == Fmi::bad_hash)
+        return Fmi::bad_hash;
+      Fmi::hash_combine(hash, obshash);
+    }
+
     if (paraminfo.source != std::string("grid"))
     {
       auto q = getModel(theState);
@@ -104,8 +104,10 @@ BezierCache::CanonicalRing BezierCache::canonicalizeClosedRing(
 
 const std::vector<Fmi::BezierFit::CubicBez>* BezierCache::find(std::size_t key) const
 {
-  auto it = m_cache.find(key);
-  if (it == m_cache.end())
+  const auto& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  auto it = s.cache.find(key);
+  if (it == s.cache.end())
   {
     ++m_misses;
     return nullptr;
@@ -116,7 +118,20 @@ const std::vector<Fmi::BezierFit::CubicBez>* BezierCache::find(std::size_t key)
 
 void BezierCache::insert(std::size_t key, std::vector<Fmi::BezierFit::CubicBez> cubics)
 {
-  m_cache.emplace(key, std::move(cubics));
+  auto& s = shard(key);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.cache.emplace(key, std::move(cubics));
+}
+
+std::size_t BezierCache::size() const
+{
+  std::size_t n = 0;
+  for (const auto& s : m_shards)
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    n += s.cache.size();
+  }
+  return n;
 }
 
 }  // namespace Dali
@@ -15,6 +15,12 @@
  * The cache is also used for isolines, since an isoline at value V
  * coincides with the V-boundary edges of the surrounding isobands and
  * is frequently rendered on top of them.
+ *
+ * The cache is thread safe, since the rings of a geometry are fitted in
+ * parallel. It is split into shards with separate locks to keep the
+ * fitting threads from contending for a single mutex. Entries are never
+ * modified or removed once inserted, so the pointers returned by find
+ * stay valid for the lifetime of the cache.
  */
 // ======================================================================
 
@@ -22,7 +28,10 @@
 
 #include "BezierFit.h"
 
+#include <array>
+#include <atomic>
 #include <cstddef>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -69,19 +78,31 @@ class BezierCache
   // Returns nullptr on miss.
   const std::vector<Fmi::BezierFit::CubicBez>* find(std::size_t key) const;
 
-  // Store cubics under the given canonical-direction hash.
+  // Store cubics under the given canonical-direction hash. If another
+  // thread stored the same key first its (identical) cubics are kept.
   void insert(std::size_t key, std::vector<Fmi::BezierFit::CubicBez> cubics);
 
-  std::size_t size() const { return m_cache.size(); }
+  std::size_t size() const;
 
   // Hit/miss counters for diagnostics. Updated by find/insert.
   std::size_t hits() const { return m_hits; }
   std::size_t misses() const { return m_misses; }
 
  private:
-  std::unordered_map<std::size_t, std::vector<Fmi::BezierFit::CubicBez>> m_cache;
-  mutable std::size_t m_hits = 0;
-  mutable std::size_t m_misses = 0;
+  static constexpr std::size_t shard_count = 16;
+
+  struct Shard
+  {
+    mutable std::mutex mutex;
+    std::unordered_map<std::size_t, std::vector<Fmi::BezierFit::CubicBez>> cache;
+  };
+
+  Shard& shard(std::size_t key) { return m_shards[key % shard_count]; }
+  const Shard& shard(std::size_t key) const { return m_shards[key % shard_count]; }
+
+  std::array<Shard, shard_count> m_shards;
+  mutable std::atomic<std::size_t> m_hits{0};
+  mutable std::atomic<std::size_t> m_misses{0};
 };
 
 }  // namespace Dali
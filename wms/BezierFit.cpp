@@ -479,6 +479,8 @@ std::optional<QuadPair> factor_quartic_inner(double a, double b, double c, doubl
 
 // ITP root-finding method (Interpolate-Truncate-Project)
 // Returns (a, b) interval bracketing the root, or (cusp, cusp) if cusp detected.
+// The function is a template parameter so that the callback is inlined
+// instead of being called through std::function in the iteration loop.
 struct ItpResult
 {
   double a;
@@ -486,7 +488,8 @@ struct ItpResult
   bool cusp_found = false;
 };
 
-ItpResult solve_itp(const std::function<std::pair<double, bool>(double)>& f,
+template <typename F>
+ItpResult solve_itp(const F& f,
                     double a,
                     double b,
                     double epsilon,
@@ -570,7 +573,9 @@ struct CurveFitSample
   Vec2 tangent;
 };
 
-// Abstract source curve interface (like ParamCurveFit trait)
+// Abstract source curve interface (like ParamCurveFit trait). The fitting
+// functions are templates on the concrete source type, so for a final
+// source class the sampling calls are resolved at compile time.
 struct SourceCurve
 {
   virtual ~SourceCurve() = default;
@@ -638,7 +643,8 @@ struct CurveDist
   double range_end = 1;
   bool spicy = false;
 
-  static CurveDist from_curve(const SourceCurve& source, double t0, double t1)
+  template <typename Source>
+  static CurveDist from_curve(const Source& source, double t0, double t1)
   {
     CurveDist cd;
     cd.range_start = t0;
@@ -666,7 +672,8 @@ struct CurveDist
     return cd;
   }
 
-  void compute_arc_params(const SourceCurve& source)
+  template <typename Source>
+  void compute_arc_params(const Source& source)
   {
     constexpr int N_SUBSAMPLE = 10;
     double dt = (range_end - range_start) / ((N_SAMPLE + 1) * N_SUBSAMPLE);
@@ -728,7 +735,8 @@ struct CurveDist
     return max_err2;
   }
 
-  std::optional<double> eval_dist(const SourceCurve& source, const CubicBez& c, double acc2)
+  template <typename Source>
+  std::optional<double> eval_dist(const Source& source, const CubicBez& c, double acc2)
   {
     auto ray_dist = eval_ray(c, acc2);
     if (!ray_dist)
@@ -893,7 +901,8 @@ CubicBez affine_transform(const CubicBez& c, const Point& origin, double th, dou
 }
 
 // Try fitting a line (for very short chords or near-cusps)
-std::optional<std::pair<CubicBez, double>> try_fit_line(const SourceCurve& source,
+template <typename Source>
+std::optional<std::pair<CubicBez, double>> try_fit_line(const Source& source,
                                                         double accuracy,
                                                         double t0,
                                                         double t1,
@@ -919,7 +928,8 @@ std::optional<std::pair<CubicBez, double>> try_fit_line(const SourceCurve& sourc
 }
 
 // Fit a single cubic to a range of the source curve
-std::optional<std::pair<CubicBez, double>> fit_to_cubic(const SourceCurve& source,
+template <typename Source>
+std::optional<std::pair<CubicBez, double>> fit_to_cubic(const Source& source,
                                                         double t0,
                                                         double t1,
                                                         double accuracy)
@@ -1006,7 +1016,8 @@ std::optional<std::pair<CubicBez, double>> fit_to_cubic(const SourceCurve& sourc
 }
 
 // Recursive Bezier fitting
-void fit_to_bezpath_rec(const SourceCurve& source,
+template <typename Source>
+void fit_to_bezpath_rec(const Source& source,
                         double t0,
                         double t1,
                         double accuracy,
@@ -1065,7 +1076,7 @@ void fit_to_bezpath_rec(const SourceCurve& source,
 // Polyline source curve implementation
 // ======================================================================
 
-class PolylineSource : public SourceCurve
+class PolylineSource final : public SourceCurve
 {
  public:
   PolylineSource(const std::vector<Point>& pts, bool closed = false)
@@ -0,0 +1,1877 @@
+#include "CairoRenderer.h"
+#include "Palette.h"
+#include "StyleSheet.h"
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/regex.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <webp/encode.h>
+#include <algorithm>
+#include <cairo-pdf.h>
+#include <cairo.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace CairoRenderer
+{
+namespace
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Thrown when the product uses an unsupported feature
+ */
+// ----------------------------------------------------------------------
+
+struct Unsupported
+{
+  std::string reason;
+};
+
+[[noreturn]] void unsupported(const std::string& theReason)
+{
+  throw Unsupported{theReason};
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parsed path data in absolute coordinates
+ *
+ * Quadratic curves are converted to cubic ones so that only moveto,
+ * lineto, curveto and closepath remain.
+ */
+// ----------------------------------------------------------------------
+
+struct PathData
+{
+  std::vector<char> ops;        // 'M', 'L', 'C' or 'Z'
+  std::vector<double> coords;  // 2 per M and L, 6 per C
+};
+
+struct Paint
+{
+  bool none = false;
+  double r = 0;
+  double g = 0;
+  double b = 0;
+  double a = 1;
+};
+
+// Inherited properties
+struct Style
+{
+  Paint fill;
+  Paint stroke{true};
+  double fill_opacity = 1;
+  double stroke_opacity = 1;
+  double stroke_width = 1;
+  double stroke_miterlimit = 4;
+  double stroke_dashoffset = 0;
+  std::vector<double> stroke_dasharray;
+  cairo_fill_rule_t fill_rule = CAIRO_FILL_RULE_WINDING;
+  cairo_line_join_t stroke_linejoin = CAIRO_LINE_JOIN_MITER;
+  cairo_line_cap_t stroke_linecap = CAIRO_LINE_CAP_BUTT;
+  cairo_antialias_t antialias = CAIRO_ANTIALIAS_DEFAULT;
+  std::string font_family = "serif";
+  double font_size = 12;  // librsvg default
+  cairo_font_weight_t font_weight = CAIRO_FONT_WEIGHT_NORMAL;
+  cairo_font_slant_t font_slant = CAIRO_FONT_SLANT_NORMAL;
+  double text_anchor = 0;  // 0 = start, 0.5 = middle, 1 = end
+  bool stroke_first = false;
+  bool visible = true;
+};
+
+// Properties which are not inherited
+struct ElementProperties
+{
+  double opacity = 1;
+  bool display = true;
+};
+
+struct Rect
+{
+  double x = 0;
+  double y = 0;
+  double width = 0;
+  double height = 0;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Display list operations
+ */
+// ----------------------------------------------------------------------
+
+struct Op
+{
+  enum class Type
+  {
+    Push,
+    Pop,
+    Shape,
+    Text
+  };
+
+  Type type = Type::Shape;
+  cairo_matrix_t matrix{1, 0, 0, 1, 0, 0};  // Push
+  double opacity = 1;                       // Push and Pop
+  std::optional<Rect> clip;                 // Push
+  std::size_t path = 0;                     // Shape
+  std::size_t style = 0;                    // Shape and Text
+  double x = 0;                             // Shape offset or text position
+  double y = 0;
+  std::string text;  // Text
+};
+
+struct DisplayList
+{
+  int width = 0;
+  int height = 0;
+  std::vector<Op> ops;
+  std::vector<Style> styles;
+  std::vector<PathData> paths;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Number parsing
+ */
+// ----------------------------------------------------------------------
+
+bool is_separator(char ch)
+{
+  return ch == ' ' || ch == ',' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+const char* skip_separators(const char* p)
+{
+  while (*p != '\0' && is_separator(*p))
+    ++p;
+  return p;
+}
+
+bool parse_number(const char*& p, double& theValue)
+{
+  p = skip_separators(p);
+  if (*p != '-' && *p != '+' && *p != '.' && (*p < '0' || *p > '9'))
+    return false;
+  char* end = nullptr;
+  theValue = std::strtod(p, &end);
+  if (end == p || !std::isfinite(theValue))
+    return false;
+  p = end;
+  return true;
+}
+
+// Number with an optional px unit
+double parse_length(const std::string& theValue, const char* theName)
+{
+  std::string value = boost::algorithm::trim_copy(theValue);
+  if (value.size() > 2 && value.compare(value.size() - 2, 2, "px") == 0)
+    value.resize(value.size() - 2);
+  const char* p = value.c_str();
+  double result = 0;
+  if (!parse_number(p, result) || *skip_separators(p) != '\0')
+    unsupported(std::string("unsupported ") + theName + " value '" + theValue + "'");
+  return result;
+}
+
+double parse_opacity(const std::string& theValue)
+{
+  std::string value = boost::algorithm::trim_copy(theValue);
+  double scale = 1;
+  if (!value.empty() && value.back() == '%')
+  {
+    value.pop_back();
+    scale = 0.01;
+  }
+  const char* p = value.c_str();
+  double result = 0;
+  if (!parse_number(p, result) || *skip_separators(p) != '\0')
+    unsupported("unsupported opacity '" + theValue + "'");
+  return std::clamp(scale * result, 0.0, 1.0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief CSS colour names
+ */
+// ----------------------------------------------------------------------
+
+const std::map<std::string, std::uint32_t>& named_colours()
+{
+  static const std::map<std::string, std::uint32_t> colours{
+      {"aliceblue", 0xf0f8ff},      {"antiquewhite", 0xfaebd7},  {"aqua", 0x00ffff},
+      {"aquamarine", 0x7fffd4},     {"azure", 0xf0ffff},         {"beige", 0xf5f5dc},
+      {"bisque", 0xffe4c4},         {"black", 0x000000},         {"blanchedalmond", 0xffebcd},
+      {"blue", 0x0000ff},           {"blueviolet", 0x8a2be2},    {"brown", 0xa52a2a},
+      {"burlywood", 0xdeb887},      {"cadetblue", 0x5f9ea0},     {"chartreuse", 0x7fff00},
+      {"chocolate", 0xd2691e},      {"coral", 0xff7f50},         {"cornflowerblue", 0x6495ed},
+      {"cornsilk", 0xfff8dc},       {"crimson", 0xdc143c},       {"cyan", 0x00ffff},
+      {"darkblue", 0x00008b},       {"darkcyan", 0x008b8b},      {"darkgoldenrod", 0xb8860b},
+      {"darkgray", 0xa9a9a9},       {"darkgreen", 0x006400},     {"darkgrey", 0xa9a9a9},
+      {"darkkhaki", 0xbdb76b},      {"darkmagenta", 0x8b008b},   {"darkolivegreen", 0x556b2f},
+      {"darkorange", 0xff8c00},     {"darkorchid", 0x9932cc},    {"darkred", 0x8b0000},
+      {"darksalmon", 0xe9967a},     {"darkseagreen", 0x8fbc8f},  {"darkslateblue", 0x483d8b},
+      {"darkslategray", 0x2f4f4f},  {"darkslategrey", 0x2f4f4f}, {"darkturquoise", 0x00ced1},
+      {"darkviolet", 0x9400d3},     {"deeppink", 0xff1493},      {"deepskyblue", 0x00bfff},
+      {"dimgray", 0x696969},        {"dimgrey", 0x696969},       {"dodgerblue", 0x1e90ff},
+      {"firebrick", 0xb22222},      {"floralwhite", 0xfffaf0},   {"forestgreen", 0x228b22},
+      {"fuchsia", 0xff00ff},        {"gainsboro", 0xdcdcdc},     {"ghostwhite", 0xf8f8ff},
+      {"gold", 0xffd700},           {"goldenrod", 0xdaa520},     {"gray", 0x808080},
+      {"green", 0x008000},          {"greenyellow", 0xadff2f},   {"grey", 0x808080},
+      {"honeydew", 0xf0fff0},       {"hotpink", 0xff69b4},       {"indianred", 0xcd5c5c},
+      {"indigo", 0x4b0082},         {"ivory", 0xfffff0},         {"khaki", 0xf0e68c},
+      {"lavender", 0xe6e6fa},       {"lavenderblush", 0xfff0f5}, {"lawngreen", 0x7cfc00},
+      {"lemonchiffon", 0xfffacd},   {"lightblue", 0xadd8e6},     {"lightcoral", 0xf08080},
+      {"lightcyan", 0xe0ffff},      {"lightgoldenrodyellow", 0xfafad2},
+      {"lightgray", 0xd3d3d3},      {"lightgreen", 0x90ee90},    {"lightgrey", 0xd3d3d3},
+      {"lightpink", 0xffb6c1},      {"lightsalmon", 0xffa07a},   {"lightseagreen", 0x20b2aa},
+      {"lightskyblue", 0x87cefa},   {"lightslategray", 0x778899},
+      {"lightslategrey", 0x778899}, {"lightsteelblue", 0xb0c4de},
+      {"lightyellow", 0xffffe0},    {"lime", 0x00ff00},          {"limegreen", 0x32cd32},
+      {"linen", 0xfaf0e6},          {"magenta", 0xff00ff},       {"maroon", 0x800000},
+      {"mediumaquamarine", 0x66cdaa}, {"mediumblue", 0x0000cd},  {"mediumorchid", 0xba55d3},
+      {"mediumpurple", 0x9370db},   {"mediumseagreen", 0x3cb371},
+      {"mediumslateblue", 0x7b68ee}, {"mediumspringgreen", 0x00fa9a},
+      {"mediumturquoise", 0x48d1cc}, {"mediumvioletred", 0xc71585},
+      {"midnightblue", 0x191970},   {"mintcream", 0xf5fffa},     {"mistyrose", 0xffe4e1},
+      {"moccasin", 0xffe4b5},       {"navajowhite", 0xffdead},   {"navy", 0x000080},
+      {"oldlace", 0xfdf5e6},        {"olive", 0x808000},         {"olivedrab", 0x6b8e23},
+      {"orange", 0xffa500},         {"orangered", 0xff4500},     {"orchid", 0xda70d6},
+      {"palegoldenrod", 0xeee8aa},  {"palegreen", 0x98fb98},     {"paleturquoise", 0xafeeee},
+      {"palevioletred", 0xdb7093},  {"papayawhip", 0xffefd5},    {"peachpuff", 0xffdab9},
+      {"peru", 0xcd853f},           {"pink", 0xffc0cb},          {"plum", 0xdda0dd},
+      {"powderblue", 0xb0e0e6},     {"purple", 0x800080},        {"rebeccapurple", 0x663399},
+      {"red", 0xff0000},            {"rosybrown", 0xbc8f8f},     {"royalblue", 0x4169e1},
+      {"saddlebrown", 0x8b4513},    {"salmon", 0xfa8072},        {"sandybrown", 0xf4a460},
+      {"seagreen", 0x2e8b57},       {"seashell", 0xfff5ee},      {"sienna", 0xa0522d},
+      {"silver", 0xc0c0c0},         {"skyblue", 0x87ceeb},       {"slateblue", 0x6a5acd},
+      {"slategray", 0x708090},      {"slategrey", 0x708090},     {"snow", 0xfffafa},
+      {"springgreen", 0x00ff7f},    {"steelblue", 0x4682b4},     {"tan", 0xd2b48c},
+      {"teal", 0x008080},           {"thistle", 0xd8bfd8},       {"tomato", 0xff6347},
+      {"turquoise", 0x40e0d0},      {"violet", 0xee82ee},        {"wheat", 0xf5deb3},
+      {"white", 0xffffff},          {"whitesmoke", 0xf5f5f5},    {"yellow", 0xffff00},
+      {"yellowgreen", 0x9acd32}};
+  return colours;
+}
+
+int hex_digit(char ch)
+{
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+  return -1;
+}
+
+// rgb(r,g,b), rgba(r,g,b,a) with numbers or percentages
+bool parse_rgb_function(const std::string& theValue, Paint& thePaint)
+{
+  const bool has_alpha = (theValue.compare(0, 5, "rgba(") == 0);
+  if (!has_alpha && theValue.compare(0, 4, "rgb(") != 0)
+    return false;
+  if (theValue.back() != ')')
+    return false;
+
+  const std::size_t offset = (has_alpha ? 5 : 4);
+  const std::string args = theValue.substr(offset, theValue.size() - offset - 1);
+  std::vector<std::string> parts;
+  boost::algorithm::split(parts, args, [](char ch) { return ch == ','; });
+  if (parts.size() != (has_alpha ? 4U : 3U))
+    return false;
+
+  double rgb[3];
+  for (int i = 0; i < 3; i++)
+  {
+    std::string part = boost::algorithm::trim_copy(parts[i]);
+    double scale = 1.0 / 255;
+    if (!part.empty() && part.back() == '%')
+    {
+      part.pop_back();
+      scale = 0.01;
+    }
+    const char* p = part.c_str();
+    if (!parse_number(p, rgb[i]) || *skip_separators(p) != '\0')
+      return false;
+    rgb[i] = std::clamp(scale * rgb[i], 0.0, 1.0);
+  }
+  thePaint.r = rgb[0];
+  thePaint.g = rgb[1];
+  thePaint.b = rgb[2];
+  thePaint.a = (has_alpha ? parse_opacity(parts[3]) : 1.0);
+  return true;
+}
+
+Paint parse_paint(const std::string& theValue)
+{
+  const std::string value = Fmi::ascii_tolower_copy(boost::algorithm::trim_copy(theValue));
+  Paint paint;
+
+  if (value == "none" || value == "transparent")
+  {
+    paint.none = true;
+    return paint;
+  }
+
+  if (!value.empty() && value[0] == '#')
+  {
+    const auto n = value.size() - 1;
+    std::vector<int> digits;
+    for (std::size_t i = 1; i < value.size(); i++)
+    {
+      int d = hex_digit(value[i]);
+      if (d < 0)
+        unsupported("invalid colour '" + theValue + "'");
+      digits.push_back(d);
+    }
+    if (n == 3 || n == 4)
+    {
+      paint.r = digits[0] * 17 / 255.0;
+      paint.g = digits[1] * 17 / 255.0;
+      paint.b = digits[2] * 17 / 255.0;
+      if (n == 4)
+        paint.a = digits[3] * 17 / 255.0;
+      return paint;
+    }
+    if (n == 6 || n == 8)
+    {
+      paint.r = (digits[0] * 16 + digits[1]) / 255.0;
+      paint.g = (digits[2] * 16 + digits[3]) / 255.0;
+      paint.b = (digits[4] * 16 + digits[5]) / 255.0;
+      if (n == 8)
+        paint.a = (digits[6] * 16 + digits[7]) / 255.0;
+      return paint;
+    }
+    unsupported("invalid colour '" + theValue + "'");
+  }
+
+  if (parse_rgb_function(value, paint))
+    return paint;
+
+  const auto& colours = named_colours();
+  auto pos = colours.find(value);
+  if (pos == colours.end())
+    unsupported("unsupported paint '" + theValue + "'");  // url(#..), currentColor, hsl(...)
+
+  paint.r = ((pos->second >> 16) & 0xff) / 255.0;
+  paint.g = ((pos->second >> 8) & 0xff) / 255.0;
+  paint.b = (pos->second & 0xff) / 255.0;
+  return paint;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse a transform attribute
+ */
+// ----------------------------------------------------------------------
+
+cairo_matrix_t parse_transform(const std::string& theValue)
+{
+  cairo_matrix_t result;
+  cairo_matrix_init_identity(&result);
+
+  const char* p = theValue.c_str();
+  while (true)
+  {
+    p = skip_separators(p);
+    if (*p == '\0')
+      break;
+
+    const char* name_start = p;
+    while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))
+      ++p;
+    const std::string name(name_start, p);
+    while (*p == ' ')
+      ++p;
+    if (name.empty() || *p != '(')
+      unsupported("invalid transform '" + theValue + "'");
+    ++p;
+
+    std::vector<double> args;
+    double value = 0;
+    while (parse_number(p, value))
+      args.push_back(value);
+    p = skip_separators(p);
+    if (*p != ')')
+      unsupported("invalid transform '" + theValue + "'");
+    ++p;
+
+    cairo_matrix_t m;
+    const auto n = args.size();
+    if (name == "translate" && (n == 1 || n == 2))
+      cairo_matrix_init_translate(&m, args[0], n == 2 ? args[1] : 0.0);
+    else if (name == "scale" && (n == 1 || n == 2))
+      cairo_matrix_init_scale(&m, args[0], n == 2 ? args[1] : args[0]);
+    else if (name == "rotate" && (n == 1 || n == 3))
+    {
+      const double cx = (n == 3 ? args[1] : 0.0);
+      const double cy = (n == 3 ? args[2] : 0.0);
+      cairo_matrix_init_translate(&m, cx, cy);
+      cairo_matrix_rotate(&m, args[0] * M_PI / 180);
+      cairo_matrix_translate(&m, -cx, -cy);
+    }
+    else if (name == "matrix" && n == 6)
+      cairo_matrix_init(&m, args[0], args[1], args[2], args[3], args[4], args[5]);
+    else if (name == "skewX" && n == 1)
+      cairo_matrix_init(&m, 1, 0, std::tan(args[0] * M_PI / 180), 1, 0, 0);
+    else if (name == "skewY" && n == 1)
+      cairo_matrix_init(&m, 1, std::tan(args[0] * M_PI / 180), 0, 1, 0, 0);
+    else
+      unsupported("invalid transform '" + theValue + "'");
+
+    // The rightmost transformation is applied first
+    cairo_matrix_multiply(&result, &m, &result);
+  }
+  return result;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse SVG path data
+ */
+// ----------------------------------------------------------------------
+
+PathData parse_path(const std::string& theData)
+{
+  PathData path;
+  path.ops.reserve(theData.size() / 8);
+  path.coords.reserve(theData.size() / 4);
+
+  double x = 0;  // current point
+  double y = 0;
+  double sx = 0;  // start of subpath
+  double sy = 0;
+  double cx = 0;  // last control point for smooth curves
+  double cy = 0;
+  char previous = 0;
+
+  const char* p = theData.c_str();
+  char cmd = 0;
+
+  while (true)
+  {
+    p = skip_separators(p);
+    if (*p == '\0')
+      break;
+
+    if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))
+      cmd = *p++;
+    else if (cmd == 0 || cmd == 'Z' || cmd == 'z')
+      unsupported("invalid path data");
+
+    const bool rel = (cmd >= 'a' && cmd <= 'z');
+    const double ox = (rel ? x : 0.0);
+    const double oy = (rel ? y : 0.0);
+    double v[6];
+
+    auto args = [&](int n)
+    {
+      for (int i = 0; i < n; i++)
+        if (!parse_number(p, v[i]))
+          unsupported("invalid path data");
+    };
+
+    auto add = [&path](char op, std::initializer_list<double> coords)
+    {
+      path.ops.push_back(op);
+      path.coords.insert(path.coords.end(), coords);
+    };
+
+    const char upper = static_cast<char>(rel ? cmd - 'a' + 'A' : cmd);
+    switch (upper)
+    {
+      case 'M':
+        args(2);
+        x = sx = ox + v[0];
+        y = sy = oy + v[1];
+        add('M', {x, y});
+        cmd = (rel ? 'l' : 'L');  // subsequent pairs are implicit linetos
+        break;
+      case 'L':
+        args(2);
+        x = ox + v[0];
+        y = oy + v[1];
+        add('L', {x, y});
+        break;
+      case 'H':
+        args(1);
+        x = ox + v[0];
+        add('L', {x, y});
+        break;
+      case 'V':
+        args(1);
+        y = oy + v[0];
+        add('L', {x, y});
+        break;
+      case 'C':
+        args(6);
+        add('C', {ox + v[0], oy + v[1], ox + v[2], oy + v[3], ox + v[4], oy + v[5]});
+        cx = ox + v[2];
+        cy = oy + v[3];
+        x = ox + v[4];
+        y = oy + v[5];
+        break;
+      case 'S':
+      {
+        args(4);
+        const bool smooth = (previous == 'C' || previous == 'S');
+        const double x1 = (smooth ? 2 * x - cx : x);
+        const double y1 = (smooth ? 2 * y - cy : y);
+        add('C', {x1, y1, ox + v[0], oy + v[1], ox + v[2], oy + v[3]});
+        cx = ox + v[0];
+        cy = oy + v[1];
+        x = ox + v[2];
+        y = oy + v[3];
+        break;
+      }
+      case 'Q':
+      case 'T':
+      {
+        double qx = 0;
+        double qy = 0;
+        if (upper == 'Q')
+        {
+          args(4);
+          qx = ox + v[0];
+          qy = oy + v[1];
+          v[0] = v[2];
+          v[1] = v[3];
+        }
+        else
+        {
+          args(2);
+          const bool smooth = (previous == 'Q' || previous == 'T');
+          qx = (smooth ? 2 * x - cx : x);
+          qy = (smooth ? 2 * y - cy : y);
+        }
+        const double x2 = ox + v[0];
+        const double y2 = oy + v[1];
+        add('C',
+            {x + 2.0 / 3 * (qx - x),
+             y + 2.0 / 3 * (qy - y),
+             x2 + 2.0 / 3 * (qx - x2),
+             y2 + 2.0 / 3 * (qy - y2),
+             x2,
+             y2});
+        cx = qx;
+        cy = qy;
+        x = x2;
+        y = y2;
+        break;
+      }
+      case 'Z':
+        add('Z', {});
+        x = sx;
+        y = sy;
+        break;
+      default:
+        unsupported(std::string("unsupported path command '") + cmd + "'");  // arcs
+    }
+    previous = upper;
+  }
+
+  return path;
+}
+
+PathData rectangle_path(double x, double y, double w, double h)
+{
+  PathData path;
+  path.ops = {'M', 'L', 'L', 'L', 'Z'};
+  path.coords = {x, y, x + w, y, x + w, y + h, x, y + h};
+  return path;
+}
+
+PathData ellipse_path(double cx, double cy, double rx, double ry)
+{
+  // Four cubic Bezier quadrants
+  const double k = 0.5522847498307936;
+  PathData path;
+  path.ops = {'M', 'C', 'C', 'C', 'C', 'Z'};
+  path.coords = {cx + rx, cy,
+                 cx + rx, cy + k * ry, cx + k * rx, cy + ry, cx, cy + ry,
+                 cx - k * rx, cy + ry, cx - rx, cy + k * ry, cx - rx, cy,
+                 cx - rx, cy - k * ry, cx - k * rx, cy - ry, cx, cy - ry,
+                 cx + k * rx, cy - ry, cx + rx, cy - k * ry, cx + rx, cy};
+  return path;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decode XML character references in text content
+ */
+// ----------------------------------------------------------------------
+
+void append_utf8(std::string& theOutput, unsigned long theCode)
+{
+  if (theCode < 0x80)
+    theOutput += static_cast<char>(theCode);
+  else if (theCode < 0x800)
+  {
+    theOutput += static_cast<char>(0xC0 | (theCode >> 6));
+    theOutput += static_cast<char>(0x80 | (theCode & 0x3F));
+  }
+  else if (theCode < 0x10000)
+  {
+    theOutput += static_cast<char>(0xE0 | (theCode >> 12));
+    theOutput += static_cast<char>(0x80 | ((theCode >> 6) & 0x3F));
+    theOutput += static_cast<char>(0x80 | (theCode & 0x3F));
+  }
+  else
+  {
+    theOutput += static_cast<char>(0xF0 | (theCode >> 18));
+    theOutput += static_cast<char>(0x80 | ((theCode >> 12) & 0x3F));
+    theOutput += static_cast<char>(0x80 | ((theCode >> 6) & 0x3F));
+    theOutput += static_cast<char>(0x80 | (theCode & 0x3F));
+  }
+}
+
+std::string decode_text(const std::string& theText)
+{
+  if (theText.find('<') != std::string::npos)
+    unsupported("markup in text content");
+
+  std::string result;
+  result.reserve(theText.size());
+
+  for (std::size_t i = 0; i < theText.size(); i++)
+  {
+    const char ch = theText[i];
+    if (ch != '&')
+    {
+      // Collapse whitespace as in xml:space="default"
+      if (ch == '\n' || ch == '\r' || ch == '\t')
+        result += ' ';
+      else
+        result += ch;
+      continue;
+    }
+
+    const auto end = theText.find(';', i);
+    if (end == std::string::npos)
+      unsupported("invalid entity in text content");
+    const std::string entity = theText.substr(i + 1, end - i - 1);
+    i = end;
+
+    if (entity == "amp")
+      result += '&';
+    else if (entity == "lt")
+      result += '<';
+    else if (entity == "gt")
+      result += '>';
+    else if (entity == "quot")
+      result += '"';
+    else if (entity == "apos")
+      result += '\'';
+    else if (entity.size() > 1 && entity[0] == '#')
+    {
+      const bool hex = (entity[1] == 'x' || entity[1] == 'X');
+      char* stop = nullptr;
+      const unsigned long code = std::strtoul(entity.c_str() + (hex ? 2 : 1), &stop, hex ? 16 : 10);
+      if (*stop != '\0' || code == 0 || code > 0x10FFFF)
+        unsupported("invalid entity in text content");
+      append_utf8(result, code);
+    }
+    else
+      unsupported("unknown entity &" + entity + ";");
+  }
+
+  // Leading and trailing whitespace is removed, internal runs collapsed
+  std::string collapsed;
+  collapsed.reserve(result.size());
+  for (char ch : result)
+    if (ch != ' ' || (!collapsed.empty() && collapsed.back() != ' '))
+      collapsed += ch;
+  if (!collapsed.empty() && collapsed.back() == ' ')
+    collapsed.pop_back();
+  return collapsed;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Style properties
+ */
+// ----------------------------------------------------------------------
+
+// Properties which only affect interactive use or are rendering hints
+bool ignored_property(const std::string& theName)
+{
+  return (theName == "pointer-events" || theName == "cursor" || theName == "text-rendering" ||
+          theName == "color-rendering" || theName == "image-rendering" || theName == "color" ||
+          theName == "color-interpolation");
+}
+
+void apply_property(Style& theStyle,
+                    ElementProperties& theProperties,
+                    const std::string& theName,
+                    const std::string& theValue)
+{
+  const std::string value = boost::algorithm::trim_copy(theValue);
+
+  if (value == "inherit")
+    return;
+
+  if (theName == "fill")
+    theStyle.fill = parse_paint(value);
+  else if (theName == "stroke")
+    theStyle.stroke = parse_paint(value);
+  else if (theName == "fill-opacity")
+    theStyle.fill_opacity = parse_opacity(value);
+  else if (theName == "stroke-opacity")
+    theStyle.stroke_opacity = parse_opacity(value);
+  else if (theName == "opacity")
+    theProperties.opacity = parse_opacity(value);
+  else if (theName == "stroke-width")
+    theStyle.stroke_width = parse_length(value, "stroke-width");
+  else if (theName == "stroke-miterlimit")
+    theStyle.stroke_miterlimit = parse_length(value, "stroke-miterlimit");
+  else if (theName == "stroke-dashoffset")
+    theStyle.stroke_dashoffset = parse_length(value, "stroke-dashoffset");
+  else if (theName == "stroke-dasharray")
+  {
+    theStyle.stroke_dasharray.clear();
+    if (value == "none")
+      return;
+    const char* p = value.c_str();
+    double dash = 0;
+    double total = 0;
+    while (parse_number(p, dash))
+    {
+      if (dash < 0)
+        unsupported("negative stroke-dasharray");
+      theStyle.stroke_dasharray.push_back(dash);
+      total += dash;
+    }
+    if (*skip_separators(p) != '\0')
+      unsupported("unsupported stroke-dasharray '" + value + "'");
+    if (total == 0)
+      theStyle.stroke_dasharray.clear();
+  }
+  else if (theName == "fill-rule")
+  {
+    if (value == "evenodd")
+      theStyle.fill_rule = CAIRO_FILL_RULE_EVEN_ODD;
+    else if (value == "nonzero")
+      theStyle.fill_rule = CAIRO_FILL_RULE_WINDING;
+    else
+      unsupported("unsupported fill-rule '" + value + "'");
+  }
+  else if (theName == "stroke-linejoin")
+  {
+    if (value == "miter")
+      theStyle.stroke_linejoin = CAIRO_LINE_JOIN_MITER;
+    else if (value == "round")
+      theStyle.stroke_linejoin = CAIRO_LINE_JOIN_ROUND;
+    else if (value == "bevel")
+      theStyle.stroke_linejoin = CAIRO_LINE_JOIN_BEVEL;
+    else
+      unsupported("unsupported stroke-linejoin '" + value + "'");
+  }
+  else if (theName == "stroke-linecap")
+  {
+    if (value == "butt")
+      theStyle.stroke_linecap = CAIRO_LINE_CAP_BUTT;
+    else if (value == "round")
+      theStyle.stroke_linecap = CAIRO_LINE_CAP_ROUND;
+    else if (value == "square")
+      theStyle.stroke_linecap = CAIRO_LINE_CAP_SQUARE;
+    else
+      unsupported("unsupported stroke-linecap '" + value + "'");
+  }
+  else if (theName == "shape-rendering")
+  {
+    if (value == "crispEdges" || value == "optimizeSpeed")
+      theStyle.antialias = CAIRO_ANTIALIAS_NONE;
+    else
+      theStyle.antialias = CAIRO_ANTIALIAS_DEFAULT;
+  }
+  else if (theName == "font-family")
+  {
+    // Use the first family of the list, fontconfig resolves generic names
+    std::string family = value.substr(0, value.find(','));
+    boost::algorithm::trim_if(family, boost::algorithm::is_any_of(" '\""));
+    theStyle.font_family = family;
+  }
+  else if (theName == "font-size")
+    theStyle.font_size = parse_length(value, "font-size");
+  else if (theName == "font-weight")
+  {
+    if (value == "bold" || value == "bolder" || value == "600" || value == "700" ||
+        value == "800" || value == "900")
+      theStyle.font_weight = CAIRO_FONT_WEIGHT_BOLD;
+    else
+      theStyle.font_weight = CAIRO_FONT_WEIGHT_NORMAL;
+  }
+  else if (theName == "font-style")
+  {
+    if (value == "italic")
+      theStyle.font_slant = CAIRO_FONT_SLANT_ITALIC;
+    else if (value == "oblique")
+      theStyle.font_slant = CAIRO_FONT_SLANT_OBLIQUE;
+    else
+      theStyle.font_slant = CAIRO_FONT_SLANT_NORMAL;
+  }
+  else if (theName == "text-anchor")
+  {
+    if (value == "start")
+      theStyle.text_anchor = 0;
+    else if (value == "middle")
+      theStyle.text_anchor = 0.5;
+    else if (value == "end")
+      theStyle.text_anchor = 1;
+    else
+      unsupported("unsupported text-anchor '" + value + "'");
+  }
+  else if (theName == "paint-order")
+  {
+    const auto fill = value.find("fill");
+    const auto stroke = value.find("stroke");
+    theStyle.stroke_first = (stroke != std::string::npos && stroke < fill);
+  }
+  else if (theName == "visibility")
+    theStyle.visible = (value == "visible");
+  else if (theName == "display")
+    theProperties.display = (value != "none");
+  else if (!ignored_property(theName))
+    unsupported("unsupported property '" + theName + "'");
+}
+
+// Apply a style attribute such as "fill:red;stroke:none"
+void apply_style_attribute(Style& theStyle,
+                           ElementProperties& theProperties,
+                           const std::string& theValue)
+{
+  std::vector<std::string> declarations;
+  boost::algorithm::split(declarations, theValue, [](char ch) { return ch == ';'; });
+  for (const auto& declaration : declarations)
+  {
+    const auto pos = declaration.find(':');
+    if (pos == std::string::npos)
+    {
+      if (!boost::algorithm::trim_copy(declaration).empty())
+        unsupported("invalid style attribute '" + theValue + "'");
+      continue;
+    }
+    const auto name = boost::algorithm::trim_copy(declaration.substr(0, pos));
+    apply_property(theStyle, theProperties, name, declaration.substr(pos + 1));
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Style rules from the product style sheets
+ *
+ * Only simple selectors are supported: element, .class, element.class
+ * and #id, optionally as comma separated lists.
+ */
+// ----------------------------------------------------------------------
+
+class StyleRules
+{
+ public:
+  void add(const std::string& theSelectors, const StyleSheet::Declarations& theDeclarations)
+  {
+    static const boost::regex simple{R"(^([a-zA-Z]+)?(\.[-_a-zA-Z0-9]+)?$|^#[-_a-zA-Z0-9]+$)"};
+
+    std::vector<std::string> selectors;
+    boost::algorithm::split(selectors, theSelectors, [](char ch) { return ch == ','; });
+    for (auto selector : selectors)
+    {
+      boost::algorithm::trim(selector);
+      if (selector.empty() || !boost::regex_match(selector, simple))
+        unsupported("unsupported CSS selector '" + selector + "'");
+      auto& rule = itsRules[selector];
+      for (const auto& name_value : theDeclarations)
+        rule[name_value.first] = name_value.second;
+    }
+  }
+
+  // Apply rules in increasing order of specificity
+  void apply(Style& theStyle,
+             ElementProperties& theProperties,
+             const std::string& theElement,
+             const std::string& theClasses,
+             const std::string& theId) const
+  {
+    if (itsRules.empty())
+      return;
+
+    apply(theStyle, theProperties, theElement);
+
+    std::vector<std::string> classes;
+    if (!theClasses.empty())
+      boost::algorithm::split(
+          classes, theClasses, [](char ch) { return ch == ' '; }, boost::token_compress_on);
+
+    for (const auto& name : classes)
+      if (!name.empty())
+        apply(theStyle, theProperties, "." + name);
+    for (const auto& name : classes)
+      if (!name.empty())
+        apply(theStyle, theProperties, theElement + "." + name);
+    if (!theId.empty())
+      apply(theStyle, theProperties, "#" + theId);
+  }
+
+ private:
+  void apply(Style& theStyle,
+             ElementProperties& theProperties,
+             const std::string& theSelector) const
+  {
+    auto pos = itsRules.find(theSelector);
+    if (pos != itsRules.end())
+      for (const auto& name_value : pos->second)
+        apply_property(theStyle, theProperties, name_value.first, name_value.second);
+  }
+
+  std::map<std::string, StyleSheet::Declarations> itsRules;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief CDT access helpers which never insert new keys
+ */
+// ----------------------------------------------------------------------
+
+std::string get_string(CTPP::CDT& theCdt, const std::string& theKey)
+{
+  if (!theCdt.Exists(theKey))
+    return {};
+  return theCdt[theKey].GetString();
+}
+
+bool is_nonempty(CTPP::CDT& theCdt, const std::string& theKey)
+{
+  return theCdt.Exists(theKey) && theCdt[theKey].Size() > 0;
+}
+
+using AttributeMap = std::map<std::string, std::string>;
+
+AttributeMap get_attributes(CTPP::CDT& theCdt)
+{
+  AttributeMap attributes;
+  if (!theCdt.Exists("attributes"))
+    return attributes;
+  auto& cdt = theCdt["attributes"];
+  if (cdt.GetType() != CTPP::CDT::HASH_VAL)
+    return attributes;
+  for (auto it = cdt.Begin(); it != cdt.End(); ++it)
+    attributes[it->first] = it->second.GetString();
+  return attributes;
+}
+
+bool blank(const std::string& theText)
+{
+  return std::all_of(theText.begin(), theText.end(), [](char ch) { return is_separator(ch); });
+}
+
+// Split "</text>\n  </g>" or "/>" into closing tag tokens
+std::vector<std::string> closing_tags(const std::string& theEnd)
+{
+  std::vector<std::string> tokens;
+  std::size_t pos = 0;
+  while (true)
+  {
+    while (pos < theEnd.size() && is_separator(theEnd[pos]))
+      ++pos;
+    if (pos >= theEnd.size())
+      break;
+    if (theEnd.compare(pos, 2, "/>") == 0)
+    {
+      tokens.emplace_back("/>");
+      pos += 2;
+    }
+    else if (theEnd.compare(pos, 2, "</") == 0)
+    {
+      const auto stop = theEnd.find('>', pos);
+      if (stop == std::string::npos)
+        unsupported("invalid element end '" + theEnd + "'");
+      tokens.push_back(theEnd.substr(pos, stop - pos + 1));
+      pos = stop + 1;
+    }
+    else
+      unsupported("content in element end '" + theEnd + "'");
+  }
+  return tokens;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compile the template hash into a display list
+ */
+// ----------------------------------------------------------------------
+
+class Compiler
+{
+ public:
+  Compiler(CTPP::CDT& theHash, DisplayList& theList) : itsHash(theHash), itsList(theList) {}
+
+  void compile()
+  {
+    if (!itsHash.Exists("width") || !itsHash.Exists("height"))
+      unsupported("image size is not known");
+    itsList.width = static_cast<int>(std::lround(itsHash["width"].GetFloat()));
+    itsList.height = static_cast<int>(std::lround(itsHash["height"].GetFloat()));
+    if (itsList.width <= 0 || itsList.height <= 0)
+      unsupported("invalid image size");
+
+    if (is_nonempty(itsHash, "includes"))
+      unsupported("product includes symbols, patterns or other definitions");
+    if (is_nonempty(itsHash, "layers"))
+      unsupported("product has layers in the defs section");
+
+    collectStyles();
+
+    // The root frame holds the initial style
+    Frame root;
+    itsRules.apply(root.style, root.properties, "svg", "", "");
+    itsFrames.push_back(root);
+
+    // Product group, views and their layers
+    openGroup(get_string(itsHash, "start"), get_attributes(itsHash));
+
+    if (itsHash.Exists("views"))
+    {
+      auto& views = itsHash["views"];
+      for (unsigned int i = 0; i < views.Size(); i++)
+      {
+        auto& view = views.At(i);
+        openGroup(get_string(view, "start"), get_attributes(view));
+        if (view.Exists("layers"))
+        {
+          auto& layers = view["layers"];
+          for (unsigned int j = 0; j < layers.Size(); j++)
+            element(layers.At(j));
+        }
+        close(get_string(view, "end"), "");
+      }
+    }
+
+    close(get_string(itsHash, "end"), "");
+
+    if (itsFrames.size() != 1)
+      unsupported("unbalanced groups");
+  }
+
+ private:
+  struct Frame
+  {
+    Style style;
+    ElementProperties properties;
+    bool pushed = false;
+    bool hidden = false;
+  };
+
+  void collectStyles()
+  {
+    if (itsHash.Exists("styles"))
+    {
+      auto& styles = itsHash["styles"];
+      for (auto it = styles.Begin(); it != styles.End(); ++it)
+      {
+        StyleSheet::Declarations declarations;
+        for (auto jt = it->second.Begin(); jt != it->second.End(); ++jt)
+          declarations[jt->first] = jt->second.GetString();
+        itsRules.add(it->first, declarations);
+      }
+    }
+
+    if (itsHash.Exists("css"))
+    {
+      auto& css = itsHash["css"];
+      for (auto it = css.Begin(); it != css.End(); ++it)
+      {
+        const auto text = it->second.GetString();
+        if (text.find('@') != std::string::npos)
+          unsupported("CSS at-rules");
+        StyleSheet sheet;
+        sheet.add(text);
+        for (const auto& selector_declarations : sheet.selectors())
+          itsRules.add(selector_declarations.first, selector_declarations.second);
+      }
+    }
+  }
+
+  static std::string element_name(const std::string& theStart)
+  {
+    auto start = boost::algorithm::trim_copy(theStart);
+    if (start.empty())
+      return start;
+    if (start[0] != '<' || start.size() < 2)
+      unsupported("invalid element start '" + theStart + "'");
+    return start.substr(1);
+  }
+
+  // Resolve the style of an element. Geometry attributes are returned separately.
+  void resolve(const std::string& theName,
+               const AttributeMap& theAttributes,
+               const std::set<std::string>& theGeometry,
+               Style& theStyle,
+               ElementProperties& theProperties,
+               AttributeMap& theGeometryValues,
+               std::optional<cairo_matrix_t>& theTransform,
+               std::optional<Rect>& theClip) const
+  {
+    theStyle = itsFrames.back().style;
+
+    std::string classes;
+    std::string id;
+    std::string style;
+
+    // Presentation attributes have the lowest priority
+    for (const auto& name_value : theAttributes)
+    {
+      const auto& name = name_value.first;
+      const auto& value = name_value.second;
+
+      if (theGeometry.count(name) > 0)
+        theGeometryValues[name] = value;
+      else if (name == "class")
+        classes = value;
+      else if (name == "id")
+        id = value;
+      else if (name == "style")
+        style = value;
+      else if (name == "transform")
+        theTransform = parse_transform(value);
+      else if (name == "clip-path")
+        theClip = clipRect(value);
+      else if (name.compare(0, 5, "xmlns") == 0 || name.compare(0, 5, "data-") == 0 ||
+               name == "xml:space")
+        continue;
+      else
+        apply_property(theStyle, theProperties, name, value);
+    }
+
+    itsRules.apply(theStyle, theProperties, theName, classes, id);
+
+    if (!style.empty())
+      apply_style_attribute(theStyle, theProperties, style);
+  }
+
+  Rect clipRect(const std::string& theValue) const
+  {
+    static const boost::regex url{R"(^\s*url\(\s*#([^\)\s]+)\s*\)\s*$)"};
+    boost::smatch match;
+    if (!boost::regex_match(theValue, match, url))
+      unsupported("unsupported clip-path '" + theValue + "'");
+    auto pos = itsClipRects.find(match[1]);
+    if (pos == itsClipRects.end())
+      unsupported("unknown clip-path '" + theValue + "'");
+    return pos->second;
+  }
+
+  bool hidden() const { return itsFrames.back().hidden; }
+
+  void push(const std::optional<cairo_matrix_t>& theTransform,
+            const std::optional<Rect>& theClip,
+            double theOpacity)
+  {
+    Op op;
+    op.type = Op::Type::Push;
+    if (theTransform)
+      op.matrix = *theTransform;
+    op.clip = theClip;
+    op.opacity = theOpacity;
+    itsList.ops.push_back(op);
+  }
+
+  void pop(double theOpacity)
+  {
+    Op op;
+    op.type = Op::Type::Pop;
+    op.opacity = theOpacity;
+    itsList.ops.push_back(op);
+  }
+
+  void openGroup(const std::string& theStart, const AttributeMap& theAttributes)
+  {
+    const auto name = element_name(theStart);
+    if (name != "g")
+      unsupported("unsupported group element '" + theStart + "'");
+
+    Frame frame;
+    std::optional<cairo_matrix_t> transform;
+    std::optional<Rect> clip;
+    AttributeMap geometry;
+    resolve(name, theAttributes, {}, frame.style, frame.properties, geometry, transform, clip);
+
+    frame.hidden = hidden() || !frame.properties.display;
+    if (!frame.hidden && (transform || clip || frame.properties.opacity < 1))
+    {
+      push(transform, clip, frame.properties.opacity);
+      frame.pushed = true;
+    }
+    itsFrames.push_back(frame);
+  }
+
+  void closeGroup()
+  {
+    if (itsFrames.size() <= 1)
+      unsupported("unbalanced groups");
+    const auto& frame = itsFrames.back();
+    if (frame.pushed)
+      pop(frame.properties.opacity);
+    itsFrames.pop_back();
+  }
+
+  // Process the closing tags of an element. The first one closes the
+  // element itself unless it is a group, the rest close open groups.
+  void close(const std::string& theEnd, const std::string& theLeaf)
+  {
+    auto tokens = closing_tags(theEnd);
+    std::size_t first = 0;
+    if (!theLeaf.empty())
+    {
+      if (tokens.empty() || (tokens[0] != "/>" && tokens[0] != "</" + theLeaf + ">"))
+        unsupported("element <" + theLeaf + "> is not closed");
+      first = 1;
+    }
+    for (std::size_t i = first; i < tokens.size(); i++)
+    {
+      if (tokens[i] != "</g>")
+        unsupported("unexpected closing tag " + tokens[i]);
+      closeGroup();
+    }
+  }
+
+  void element(CTPP::CDT& theElement)
+  {
+    const auto start = get_string(theElement, "start");
+    const auto name = element_name(start);
+    const auto attributes = get_attributes(theElement);
+    const auto cdata = get_string(theElement, "cdata");
+    const auto end = get_string(theElement, "end");
+
+    if (name == "clipPath")
+    {
+      clipPath(attributes, cdata);
+      auto tokens = closing_tags(end);
+      if (tokens.empty() || tokens[0] != "</clipPath>")
+        unsupported("clipPath is not closed");
+      close(end.substr(end.find("</clipPath>") + 11), "");
+      return;
+    }
+
+    if (name.empty())
+    {
+      if (!attributes.empty() || !blank(cdata))
+        unsupported("element without a start tag has content");
+    }
+    else if (name == "g")
+    {
+      if (!blank(cdata))
+        unsupported("group with text content");
+      openGroup(start, attributes);
+    }
+    else
+    {
+      if (is_nonempty(theElement, "tags"))
+        unsupported("<" + name + "> with child tags");
+      leaf(name, attributes, cdata);
+      close(end, name);
+      return;
+    }
+
+    if (theElement.Exists("tags"))
+    {
+      auto& tags = theElement["tags"];
+      for (unsigned int i = 0; i < tags.Size(); i++)
+      {
+        auto& tag = tags.At(i);
+        const auto tag_name = element_name(get_string(tag, "start"));
+        if (tag_name.empty() || tag_name == "g" || tag_name == "clipPath")
+          unsupported("unsupported tag '" + get_string(tag, "start") + "'");
+        leaf(tag_name, get_attributes(tag), "");
+        auto tokens = closing_tags(get_string(tag, "end"));
+        if (tokens.size() != 1 || (tokens[0] != "/>" && tokens[0] != "</" + tag_name + ">"))
+          unsupported("unsupported tag end '" + get_string(tag, "end") + "'");
+      }
+    }
+
+    close(end, "");
+  }
+
+  void clipPath(const AttributeMap& theAttributes, const std::string& theCData)
+  {
+    static const boost::regex rect{
+        R"re(^\s*<rect\s+x="([^"]+)"\s+y="([^"]+)"\s+)re"
+        R"re(width="([^"]+)"\s+height="([^"]+)"\s*/>\s*$)re"};
+
+    std::string id;
+    for (const auto& name_value : theAttributes)
+    {
+      if (name_value.first == "id")
+        id = name_value.second;
+      else
+        unsupported("unsupported clipPath attribute '" + name_value.first + "'");
+    }
+
+    boost::smatch match;
+    if (id.empty() || !boost::regex_match(theCData, match, rect))
+      unsupported("unsupported clipPath");
+
+    Rect r;
+    r.x = parse_length(match[1], "x");
+    r.y = parse_length(match[2], "y");
+    r.width = parse_length(match[3], "width");
+    r.height = parse_length(match[4], "height");
+    itsClipRects[id] = r;
+  }
+
+  std::size_t pathIndex(const std::string& theHref)
+  {
+    if (theHref.empty() || theHref[0] != '#')
+      unsupported("unsupported reference '" + theHref + "'");
+    const auto iri = theHref.substr(1);
+
+    auto pos = itsPathIndex.find(iri);
+    if (pos != itsPathIndex.end())
+      return pos->second;
+
+    if (!itsHash.Exists("paths") || !itsHash["paths"].Exists(iri))
+      unsupported("reference to '" + theHref + "' is not a generated path");
+
+    itsList.paths.push_back(parse_path(get_string(itsHash["paths"][iri], "data")));
+    const auto index = itsList.paths.size() - 1;
+    itsPathIndex[iri] = index;
+    return index;
+  }
+
+  std::size_t addPath(PathData&& thePath)
+  {
+    itsList.paths.push_back(std::move(thePath));
+    return itsList.paths.size() - 1;
+  }
+
+  static double number(const AttributeMap& theGeometry, const std::string& theName)
+  {
+    auto pos = theGeometry.find(theName);
+    if (pos == theGeometry.end())
+      return 0;
+    return parse_length(pos->second, theName.c_str());
+  }
+
+  void leaf(const std::string& theName,
+            const AttributeMap& theAttributes,
+            const std::string& theCData)
+  {
+    static const std::map<std::string, std::set<std::string>> geometry_attributes{
+        {"use", {"x", "y", "width", "height", "xlink:href", "href"}},
+        {"path", {"d"}},
+        {"rect", {"x", "y", "width", "height", "rx", "ry"}},
+        {"circle", {"cx", "cy", "r"}},
+        {"ellipse", {"cx", "cy", "rx", "ry"}},
+        {"line", {"x1", "y1", "x2", "y2"}},
+        {"text", {"x", "y"}}};
+
+    auto geometry_pos = geometry_attributes.find(theName);
+    if (geometry_pos == geometry_attributes.end())
+      unsupported("unsupported element <" + theName + ">");
+
+    if (theName != "text" && !blank(theCData))
+      unsupported("<" + theName + "> with content");
+
+    Style style;
+    ElementProperties properties;
+    AttributeMap geometry;
+    std::optional<cairo_matrix_t> transform;
+    std::optional<Rect> clip;
+    resolve(theName,
+            theAttributes,
+            geometry_pos->second,
+            style,
+            properties,
+            geometry,
+            transform,
+            clip);
+
+    if (hidden() || !properties.display || !style.visible)
+      return;
+
+    Op op;
+    op.type = Op::Type::Shape;
+
+    if (theName == "use")
+    {
+      auto href = geometry["xlink:href"];
+      if (href.empty())
+        href = geometry["href"];
+      op.path = pathIndex(href);
+      op.x = number(geometry, "x");
+      op.y = number(geometry, "y");
+    }
+    else if (theName == "path")
+      op.path = addPath(parse_path(geometry["d"]));
+    else if (theName == "rect")
+    {
+      if (number(geometry, "rx") != 0 || number(geometry, "ry") != 0)
+        unsupported("rounded rectangles");
+      const double w = number(geometry, "width");
+      const double h = number(geometry, "height");
+      if (w <= 0 || h <= 0)
+        return;
+      op.path = addPath(rectangle_path(number(geometry, "x"), number(geometry, "y"), w, h));
+    }
+    else if (theName == "circle" || theName == "ellipse")
+    {
+      const double rx = number(geometry, theName == "circle" ? "r" : "rx");
+      const double ry = number(geometry, theName == "circle" ? "r" : "ry");
+      if (rx <= 0 || ry <= 0)
+        return;
+      op.path = addPath(ellipse_path(number(geometry, "cx"), number(geometry, "cy"), rx, ry));
+    }
+    else if (theName == "line")
+    {
+      PathData path;
+      path.ops = {'M', 'L'};
+      path.coords = {number(geometry, "x1"),
+                     number(geometry, "y1"),
+                     number(geometry, "x2"),
+                     number(geometry, "y2")};
+      op.path = addPath(std::move(path));
+    }
+    else  // text
+    {
+      op.type = Op::Type::Text;
+      op.text = decode_text(theCData);
+      if (op.text.empty())
+        return;
+      op.x = number(geometry, "x");
+      op.y = number(geometry, "y");
+    }
+
+    if (style.fill.none && style.stroke.none)
+      return;
+
+    itsList.styles.push_back(style);
+    op.style = itsList.styles.size() - 1;
+
+    const bool wrap = (transform || clip || properties.opacity < 1);
+    if (wrap)
+      push(transform, clip, properties.opacity);
+    itsList.ops.push_back(std::move(op));
+    if (wrap)
+      pop(properties.opacity);
+  }
+
+  CTPP::CDT& itsHash;
+  DisplayList& itsList;
+  StyleRules itsRules;
+  std::vector<Frame> itsFrames;
+  std::map<std::string, std::size_t> itsPathIndex;
+  std::map<std::string, Rect> itsClipRects;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Draw the display list
+ */
+// ----------------------------------------------------------------------
+
+void append_path(cairo_t* cr, const PathData& thePath, double dx, double dy)
+{
+  const double* c = thePath.coords.data();
+  for (char op : thePath.ops)
+  {
+    switch (op)
+    {
+      case 'M':
+        cairo_move_to(cr, c[0] + dx, c[1] + dy);
+        c += 2;
+        break;
+      case 'L':
+        cairo_line_to(cr, c[0] + dx, c[1] + dy);
+        c += 2;
+        break;
+      case 'C':
+        cairo_curve_to(cr, c[0] + dx, c[1] + dy, c[2] + dx, c[3] + dy, c[4] + dx, c[5] + dy);
+        c += 6;
+        break;
+      default:
+        cairo_close_path(cr);
+    }
+  }
+}
+
+void paint(cairo_t* cr, const Style& theStyle)
+{
+  const bool fill = !theStyle.fill.none;
+  const bool stroke = !theStyle.stroke.none && theStyle.stroke_width > 0;
+
+  cairo_set_antialias(cr, theStyle.antialias);
+
+  auto do_fill = [&](bool preserve)
+  {
+    const auto& c = theStyle.fill;
+    cairo_set_source_rgba(cr, c.r, c.g, c.b, c.a * theStyle.fill_opacity);
+    cairo_set_fill_rule(cr, theStyle.fill_rule);
+    if (preserve)
+      cairo_fill_preserve(cr);
+    else
+      cairo_fill(cr);
+  };
+
+  auto do_stroke = [&](bool preserve)
+  {
+    const auto& c = theStyle.stroke;
+    cairo_set_source_rgba(cr, c.r, c.g, c.b, c.a * theStyle.stroke_opacity);
+    cairo_set_line_width(cr, theStyle.stroke_width);
+    cairo_set_line_join(cr, theStyle.stroke_linejoin);
+    cairo_set_line_cap(cr, theStyle.stroke_linecap);
+    cairo_set_miter_limit(cr, theStyle.stroke_miterlimit);
+    cairo_set_dash(cr,
+                   theStyle.stroke_dasharray.data(),
+                   static_cast<int>(theStyle.stroke_dasharray.size()),
+                   theStyle.stroke_dashoffset);
+    if (preserve)
+      cairo_stroke_preserve(cr);
+    else
+      cairo_stroke(cr);
+  };
+
+  if (theStyle.stroke_first)
+  {
+    if (stroke)
+      do_stroke(fill);
+    if (fill)
+      do_fill(false);
+  }
+  else
+  {
+    if (fill)
+      do_fill(stroke);
+    if (stroke)
+      do_stroke(false);
+  }
+  cairo_new_path(cr);
+}
+
+void draw(cairo_t* cr, const DisplayList& theList)
+{
+  for (const auto& op : theList.ops)
+  {
+    switch (op.type)
+    {
+      case Op::Type::Push:
+        cairo_save(cr);
+        cairo_transform(cr, &op.matrix);
+        if (op.clip)
+        {
+          cairo_rectangle(cr, op.clip->x, op.clip->y, op.clip->width, op.clip->height);
+          cairo_clip(cr);
+        }
+        if (op.opacity < 1)
+          cairo_push_group(cr);
+        break;
+      case Op::Type::Pop:
+        if (op.opacity < 1)
+        {
+          cairo_pop_group_to_source(cr);
+          cairo_paint_with_alpha(cr, op.opacity);
+        }
+        cairo_restore(cr);
+        break;
+      case Op::Type::Shape:
+        append_path(cr, theList.paths[op.path], op.x, op.y);
+        paint(cr, theList.styles[op.style]);
+        break;
+      case Op::Type::Text:
+      {
+        const auto& style = theList.styles[op.style];
+        cairo_select_font_face(cr, style.font_family.c_str(), style.font_slant, style.font_weight);
+        cairo_set_font_size(cr, style.font_size);
+        double x = op.x;
+        if (style.text_anchor > 0)
+        {
+          cairo_text_extents_t extents;
+          cairo_text_extents(cr, op.text.c_str(), &extents);
+          x -= style.text_anchor * extents.x_advance;
+        }
+        cairo_move_to(cr, x, op.y);
+        cairo_text_path(cr, op.text.c_str());
+        paint(cr, style);
+        break;
+      }
+    }
+  }
+
+  if (cairo_status(cr) != CAIRO_STATUS_SUCCESS)
+    throw Fmi::Exception(BCP, "Cairo rendering failed")
+        .addParameter("Status", cairo_status_to_string(cairo_status(cr)));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Output encoding
+ */
+// ----------------------------------------------------------------------
+
+cairo_status_t write_to_string(void* theClosure,
+                               const unsigned char* theData,
+                               unsigned int theLength)
+{
+  static_cast<std::string*>(theClosure)->append(reinterpret_cast<const char*>(theData), theLength);
+  return CAIRO_STATUS_SUCCESS;
+}
+
+using SurfacePtr = std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)>;
+using ContextPtr = std::unique_ptr<cairo_t, decltype(&cairo_destroy)>;
+
+SurfacePtr draw_image(const DisplayList& theList)
+{
+  SurfacePtr surface(
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, theList.width, theList.height),
+      cairo_surface_destroy);
+  ContextPtr cr(cairo_create(surface.get()), cairo_destroy);
+  draw(cr.get(), theList);
+  cairo_surface_flush(surface.get());
+  return surface;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the fixed palette requested by the PNG options
+ *
+ * The automatic palette consists of the fill and stroke colours of the
+ * display list. Returns an empty palette if no palette is requested or the
+ * automatic palette would not fit into 256 colours.
+ */
+// ----------------------------------------------------------------------
+
+Palette::Colour palette_colour(const Paint& thePaint, double theOpacity)
+{
+  auto byte = [](double value) { return static_cast<std::uint8_t>(std::lround(255 * value)); };
+  return {byte(thePaint.r), byte(thePaint.g), byte(thePaint.b), byte(thePaint.a * theOpacity)};
+}
+
+Palette build_palette(const DisplayList& theList, const Png& thePng)
+{
+  Palette palette;
+  if (!thePng.auto_palette && thePng.palette.empty())
+    return palette;
+
+  // Transparent first keeps the tRNS chunk short
+  palette.add({0, 0, 0, 0});
+
+  if (thePng.auto_palette)
+  {
+    for (const auto& style : theList.styles)
+    {
+      if (!style.fill.none && !palette.add(palette_colour(style.fill, style.fill_opacity)))
+        return {};
+      if (!style.stroke.none && !palette.add(palette_colour(style.stroke, style.stroke_opacity)))
+        return {};
+    }
+  }
+  else
+  {
+    for (const auto& colour : thePng.palette)
+    {
+      try
+      {
+        const auto paint = parse_paint(colour);
+        palette.add(paint.none ? Palette::Colour{0, 0, 0, 0} : palette_colour(paint, 1.0));
+      }
+      catch (const Unsupported&)
+      {
+        throw Fmi::Exception(BCP, "Invalid colour '" + colour + "' in PNG palette");
+      }
+    }
+  }
+
+  palette.addEdgeBlends();
+  return palette;
+}
+
+std::string encode_png(const DisplayList& theList, const Png& thePng)
+{
+  auto surface = draw_image(theList);
+
+  const auto palette = build_palette(theList, thePng);
+  if (!palette.empty())
+  {
+    const auto indices = palette.map(cairo_image_surface_get_data(surface.get()),
+                                     theList.width,
+                                     theList.height,
+                                     cairo_image_surface_get_stride(surface.get()));
+    return palette.encodePng(indices, theList.width, theList.height);
+  }
+
+  std::string output;
+  auto status = cairo_surface_write_to_png_stream(surface.get(), write_to_string, &output);
+  if (status != CAIRO_STATUS_SUCCESS)
+    throw Fmi::Exception(BCP, "PNG encoding failed")
+        .addParameter("Status", cairo_status_to_string(status));
+  return output;
+}
+
+// Cairo uses premultiplied native endian ARGB, libwebp wants plain RGBA
+std::vector<std::uint8_t> unpremultiply(cairo_surface_t* theSurface, int theWidth, int theHeight)
+{
+  const int stride = cairo_image_surface_get_stride(theSurface);
+  const unsigned char* data = cairo_image_surface_get_data(theSurface);
+
+  std::vector<std::uint8_t> rgba(4UL * theWidth * theHeight);
+  for (int j = 0; j < theHeight; j++)
+  {
+    const auto* row = reinterpret_cast<const std::uint32_t*>(data + static_cast<long>(j) * stride);
+    std::uint8_t* out = rgba.data() + 4L * j * theWidth;
+    for (int i = 0; i < theWidth; i++, out += 4)
+    {
+      const std::uint32_t argb = row[i];
+      const unsigned int a = argb >> 24;
+      if (a == 0)
+      {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        continue;
+      }
+      out[0] = static_cast<std::uint8_t>((((argb >> 16) & 0xff) * 255 + a / 2) / a);
+      out[1] = static_cast<std::uint8_t>((((argb >> 8) & 0xff) * 255 + a / 2) / a);
+      out[2] = static_cast<std::uint8_t>(((argb & 0xff) * 255 + a / 2) / a);
+      out[3] = static_cast<std::uint8_t>(a);
+    }
+  }
+  return rgba;
+}
+
+std::string encode_webp(const DisplayList& theList, const Png& thePng, const Webp& theWebp)
+{
+  auto surface = draw_image(theList);
+  const int width = theList.width;
+  const int height = theList.height;
+
+  // With a palette the lossless encoder switches to its own palette mode
+  // instead of searching for one
+  std::vector<std::uint8_t> rgba;
+  const auto palette = build_palette(theList, thePng);
+  if (!palette.empty())
+    rgba = palette.expand(palette.map(cairo_image_surface_get_data(surface.get()),
+                                      width,
+                                      height,
+                                      cairo_image_surface_get_stride(surface.get())));
+  else
+    rgba = unpremultiply(surface.get(), width, height);
+
+  // Same lossless preset as the SVG path uses for the product
+  WebPConfig config;
+  if (WebPConfigInit(&config) == 0 ||
+      WebPConfigLosslessPreset(&config, theWebp.options.level) == 0)
+    throw Fmi::Exception(BCP, "WebP configuration failed");
+
+  WebPPicture picture;
+  if (WebPPictureInit(&picture) == 0)
+    throw Fmi::Exception(BCP, "WebP initialization failed");
+  picture.use_argb = 1;
+  picture.width = width;
+  picture.height = height;
+
+  WebPMemoryWriter writer;
+  WebPMemoryWriterInit(&writer);
+  picture.writer = WebPMemoryWrite;
+  picture.custom_ptr = &writer;
+
+  const bool ok = (WebPPictureImportRGBA(&picture, rgba.data(), 4 * width) != 0 &&
+                   WebPEncode(&config, &picture) != 0);
+  WebPPictureFree(&picture);
+
+  if (!ok)
+  {
+    WebPMemoryWriterClear(&writer);
+    throw Fmi::Exception(BCP, "WebP encoding failed");
+  }
+
+  std::string output(reinterpret_cast<const char*>(writer.mem), writer.size);
+  WebPMemoryWriterClear(&writer);
+  return output;
+}
+
+std::string encode_pdf(const DisplayList& theList)
+{
+  std::string output;
+  {
+    SurfacePtr surface(cairo_pdf_surface_create_for_stream(
+                           write_to_string, &output, theList.width, theList.height),
+                       cairo_surface_destroy);
+    ContextPtr cr(cairo_create(surface.get()), cairo_destroy);
+    draw(cr.get(), theList);
+    cairo_show_page(cr.get());
+    cairo_surface_finish(surface.get());
+  }
+  return output;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief True if the output format can be rendered directly
+ */
+// ----------------------------------------------------------------------
+
+bool supports(const std::string& theType)
+{
+  return (theType == "png" || theType == "webp" || theType == "pdf");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render the generated template hash
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::string> render(CTPP::CDT& theHash,
+                                  const std::string& theType,
+                                  const Png& thePng,
+                                  const Webp& theWebp,
+                                  std::string& theReason)
+{
+  try
+  {
+    if (!supports(theType))
+    {
+      theReason = "unsupported output format " + theType;
+      return {};
+    }
+
+    DisplayList list;
+    try
+    {
+      Compiler(theHash, list).compile();
+    }
+    catch (const Unsupported& e)
+    {
+      theReason = e.reason;
+      return {};
+    }
+
+    if (theType == "png")
+      return encode_png(list, thePng);
+    if (theType == "webp")
+      return encode_webp(list, thePng, theWebp);
+    return encode_pdf(list);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace CairoRenderer
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
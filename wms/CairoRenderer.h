@@ -0,0 +1,66 @@
+// ======================================================================
+/*!
+ * \brief Direct Cairo rendering of generated products
+ *
+ * Raster output is normally produced by expanding the product template
+ * into SVG text and handing it to librsvg, which parses the text back
+ * into a document before drawing it with Cairo. For large isoband maps
+ * a large part of that time goes into the template expansion and the
+ * XML parse of the document.
+ *
+ * This renderer compiles the template hash produced by Product::generate
+ * into a display list of groups, shapes and texts and draws it directly
+ * with Cairo. Only the template expansion and the XML document parse are
+ * avoided: the layers still format their path data as text, which is
+ * parsed back here. Path data referenced by several elements is parsed
+ * only once.
+ * The supported subset covers what the layers themselves generate:
+ *
+ *  - g, use (referring to generated paths), path, rect, circle, ellipse,
+ *    line and text elements
+ *  - rectangular clip paths as generated by Layer::addClipRect
+ *  - the usual fill, stroke, opacity, font and text-anchor properties as
+ *    presentation attributes, style attributes and class, element or id
+ *    selectors in the style sheets
+ *
+ * Anything else (symbols, patterns, markers, filters, nested SVG in
+ * cdata sections, complex selectors...) makes the renderer decline the
+ * product, in which case the caller falls back to the template and
+ * librsvg. The decision is made before anything is drawn.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Png.h"
+#include "Webp.h"
+#include <ctpp2/CDT.hpp>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace CairoRenderer
+{
+// True if the output format can be rendered directly
+bool supports(const std::string& theType);
+
+// Render png, webp or pdf output from the generated template hash. A fixed
+// palette in the PNG options produces indexed PNG output and is applied
+// before WebP encoding at the lossless level of the WebP options. Returns nullopt
+// and the reason in theReason if the product uses features the renderer
+// does not support.
+std::optional<std::string> render(CTPP::CDT& theHash,
+                                  const std::string& theType,
+                                  const Png& thePng,
+                                  const Webp& theWebp,
+                                  std::string& theReason);
+
+}  // namespace CairoRenderer
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -484,7 +484,7 @@ void CircleLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State
         std::string arcCoordinates;
 
         auto coords = Geometry::toString(*geom,
-                                         theState.getType(),
+                                         theState,
                                          box,
                                          crs,
                                          precision,
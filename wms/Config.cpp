@@ -115,6 +115,8 @@ Config::Config(const string& configfile)
     itsConfig.lookupValue("customer", itsDefaultCustomer);
 
     itsConfig.lookupValue("css_cache_size", itsStyleSheetCacheSize);
+    itsConfig.lookupValue("streamline_cache_size", itsStreamlineCacheSize);
+    itsConfig.lookupValue("windrose_cache_size", itsWindRoseCacheSize);
 
     itsConfig.lookupValue("cache.directory", itsFilesystemCacheDirectory);
 
@@ -123,6 +125,21 @@ Config::Config(const string& configfile)
     itsMaxFilesystemCacheSize =
         Spine::lookupSizeSetting(itsConfig, "cache.filesystem_bytes", itsMaxFilesystemCacheSize);
 
+    itsSampleCacheSize =
+        Spine::lookupSizeSetting(itsConfig, "sample_cache.memory_bytes", itsSampleCacheSize);
+    itsConfig.lookupValue("sample_cache.expand", itsSampleCacheExpand);
+
+    itsLocationIndexSize =
+        Spine::lookupSizeSetting(itsConfig, "location_index.memory_bytes", itsLocationIndexSize);
+
+    itsPostGISCacheSize =
+        Spine::lookupSizeSetting(itsConfig, "postgis_cache.memory_bytes", itsPostGISCacheSize);
+    itsConfig.lookupValue("postgis_cache.max_age", itsPostGISCacheMaxAge);
+
+    itsConfig.lookupValue("compression.enabled", itsCompressionEnabled);
+    itsCompressionMinSize =
+        Spine::lookupSizeSetting(itsConfig, "compression.min_bytes", itsCompressionMinSize);
+
     itsConfig.lookupValue("max_image_size", itsMaxImageSize);
     itsConfig.lookupValue("wms.max_layers", itsMaxWMSLayers);
     itsConfig.lookupValue("wmts.tile_width", itsWmtsTileWidth);
@@ -130,6 +147,39 @@ Config::Config(const string& configfile)
 
     itsConfig.lookupValue("heatmap.max_points", itsMaxHeatmapPoints);
 
+    itsConfig.lookupValue("timing.server_timing", itsServerTiming);
+
+    itsConfig.lookupValue("admission.fast_limit", itsCostModelSettings.fast_limit);
+    itsConfig.lookupValue("admission.smoothing", itsCostModelSettings.smoothing);
+    itsConfig.lookupValue("admission.max_expensive", itsCostModelSettings.max_expensive);
+
+    itsConfig.lookupValue("prerender.enabled", itsPrerenderSettings.enabled);
+    itsConfig.lookupValue("prerender.max_requests", itsPrerenderSettings.max_requests);
+    itsConfig.lookupValue("prerender.max_renders", itsPrerenderSettings.max_renders);
+    itsConfig.lookupValue("prerender.interval", itsPrerenderSettings.interval);
+    itsPrerenderSettings.interval = std::max(1U, itsPrerenderSettings.interval);
+
+    itsConfig.lookupValue("bake.directory", itsBakeDirectory);
+    {
+      std::string apikeys;
+      itsConfig.lookupValue("bake.apikeys", apikeys);
+      boost::algorithm::split(itsBakeApiKeys, apikeys, boost::is_any_of(","));
+      itsBakeApiKeys.erase("");
+    }
+    itsConfig.lookupValue("bake.max_tiles", itsBakeMaxTiles);
+    itsConfig.lookupValue("bake.metatile", itsBakeMetaTileSize);
+    itsBakeMetaTileSize = std::max(1U, itsBakeMetaTileSize);
+    if (itsConfig.exists("bake.threads"))
+      itsBakeThreads = std::max(1U, parse_threads(itsConfig, "bake.threads"));
+
+    itsConfig.lookupValue("observation_cache.enabled", itsObservationCacheEnabled);
+    itsConfig.lookupValue("observation_cache.max_age", itsObservationCacheMaxAge);
+
+    itsConfig.lookupValue("resource_index.enabled", itsResourceIndexEnabled);
+    itsConfig.lookupValue("resource_index.update_interval", itsResourceIndexUpdateInterval);
+    itsResourceIndexMemoryBytes = Spine::lookupSizeSetting(
+        itsConfig, "resource_index.memory_bytes", itsResourceIndexMemoryBytes);
+
     // Trax contouring worker pool size: absolute count or "NN%" of cores, capped to cores.
     itsContourWorkerThreads = parse_threads(itsConfig, "contour.worker_threads");
 
@@ -387,6 +437,11 @@ unsigned int Config::styleSheetCacheSize() const
   return itsStyleSheetCacheSize;
 }
 
+unsigned int Config::streamlineCacheSize() const
+{
+  return itsStreamlineCacheSize;
+}
+
 bool Config::quiet() const
 {
   return itsQuiet;
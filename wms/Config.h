@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "CostModel.h"
+#include "Prerenderer.h"
 #include <libconfig.h++>
 #include <map>
 #include <set>
@@ -58,6 +60,23 @@ class Config
   unsigned long long maxMemoryCacheSize() const;
   unsigned long long maxFilesystemCacheSize() const;
   unsigned int styleSheetCacheSize() const;
+  unsigned int streamlineCacheSize() const;
+  unsigned int windRoseCacheSize() const { return itsWindRoseCacheSize; }
+
+  // Memory limit for resampled querydata shared by requests (0 = disabled)
+  unsigned long long sampleCacheSize() const { return itsSampleCacheSize; }
+  bool sampleCacheExpand() const { return itsSampleCacheExpand; }
+
+  // Memory limit for projected keyword locations shared by requests (0 = disabled)
+  unsigned long long locationIndexSize() const { return itsLocationIndexSize; }
+
+  // Memory and age limits for PostGIS features shared by requests (0 = disabled)
+  unsigned long long postgisCacheSize() const { return itsPostGISCacheSize; }
+  unsigned int postgisCacheMaxAge() const { return itsPostGISCacheMaxAge; }
+
+  // Text products are cached and served also in gzip format if at least this large
+  bool compressionEnabled() const { return itsCompressionEnabled; }
+  unsigned long long compressionMinSize() const { return itsCompressionMinSize; }
 
   unsigned int maxImageSize() const;
   unsigned int maxWMSLayers() const;
@@ -74,6 +93,32 @@ class Config
   // of cores. Configured via "contour.worker_threads" (absolute count or "NN%" of cores).
   unsigned int contourWorkerThreads() const { return itsContourWorkerThreads; }
 
+  // In-memory index of the customer and resource directories, rescanned every N seconds
+  bool resourceIndexEnabled() const { return itsResourceIndexEnabled; }
+  unsigned int resourceIndexUpdateInterval() const { return itsResourceIndexUpdateInterval; }
+  unsigned long long resourceIndexMemoryBytes() const { return itsResourceIndexMemoryBytes; }
+
+  // Observation layers are cached until the producer reports new data, or for at most
+  // max_age seconds if it does not report data versions (0 = no caching then)
+  bool observationCacheEnabled() const { return itsObservationCacheEnabled; }
+  unsigned int observationCacheMaxAge() const { return itsObservationCacheMaxAge; }
+
+  // Request classification and admission control
+  const CostModel::Settings& costModelSettings() const { return itsCostModelSettings; }
+
+  // Background re-rendering of popular products on new model data
+  const Prerenderer::Settings& prerenderSettings() const { return itsPrerenderSettings; }
+
+  // Tile pyramids baked into PMTiles archives (empty directory = disabled)
+  const std::string& bakeDirectory() const { return itsBakeDirectory; }
+  const std::set<std::string>& bakeApiKeys() const { return itsBakeApiKeys; }
+  unsigned int bakeMaxTiles() const { return itsBakeMaxTiles; }
+  unsigned int bakeMetaTileSize() const { return itsBakeMetaTileSize; }
+  unsigned int bakeThreads() const { return itsBakeThreads; }
+
+  // Return per-stage durations in a Server-Timing header for all requests, not just timer=1
+  bool serverTiming() const { return itsServerTiming; }
+
   const libconfig::Config& getConfig() const { return itsConfig; }
   bool quiet() const;
 
@@ -110,6 +155,15 @@ class Config
   unsigned long long itsMaxMemoryCacheSize = 104857600;      // 100 MB
   unsigned long long itsMaxFilesystemCacheSize = 209715200;  // 200 MB
   unsigned int itsStyleSheetCacheSize = 1000;                // 1000 objects
+  unsigned int itsStreamlineCacheSize = 100;                 // 100 streamline sets
+  unsigned int itsWindRoseCacheSize = 1000;                  // 1000 stations
+  unsigned long long itsSampleCacheSize = 209715200;         // 200 MB
+  bool itsSampleCacheExpand = false;
+  unsigned long long itsLocationIndexSize = 104857600;       // 100 MB
+  unsigned long long itsPostGISCacheSize = 104857600;        // 100 MB
+  unsigned int itsPostGISCacheMaxAge = 60;                   // seconds
+  bool itsCompressionEnabled = true;
+  unsigned long long itsCompressionMinSize = 1024;           // bytes
 
   unsigned int itsMaxImageSize = 20 * 1024 * 1024;  // 20M pixels
   unsigned int itsMaxWMSLayers = 10;                // no more than 10 layers, ddos protection
@@ -119,6 +173,25 @@ class Config
 
   unsigned int itsContourWorkerThreads = 0;  // Trax worker pool size (0 = disabled)
 
+  bool itsServerTiming = false;
+
+  CostModel::Settings itsCostModelSettings;
+
+  Prerenderer::Settings itsPrerenderSettings;
+
+  std::string itsBakeDirectory;
+  std::set<std::string> itsBakeApiKeys;  // apikeys allowed to bake
+  unsigned int itsBakeMaxTiles = 5000;
+  unsigned int itsBakeMetaTileSize = 4;  // metatile width in tiles
+  unsigned int itsBakeThreads = 2;       // threads rendering the tiles of a bake
+
+  bool itsObservationCacheEnabled = true;
+  unsigned int itsObservationCacheMaxAge = 60;  // seconds
+
+  bool itsResourceIndexEnabled = false;
+  unsigned int itsResourceIndexUpdateInterval = 10;  // seconds
+  unsigned long long itsResourceIndexMemoryBytes = 10485760;  // 10 MB
+
   std::string itsWmsUrl = "/wms";
   std::string itsWmtsUrl = "/wmts";
   std::string itsTilesUrl = "/tiles";
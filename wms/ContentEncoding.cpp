@@ -0,0 +1,104 @@
+#include "ContentEncoding.h"
+#include <boost/algorithm/string.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <macgyver/Exception.h>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace ContentEncoding
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether gzip is an acceptable content coding
+ *
+ * The value is a list of codings with optional quality values, for
+ * example "gzip, deflate, br" or "br;q=1.0, gzip;q=0.8, *;q=0.1".
+ * A quality of zero refuses the coding, and "*" covers the codings
+ * not listed explicitly.
+ */
+// ----------------------------------------------------------------------
+
+bool acceptsGzip(const std::string& theAcceptEncoding)
+{
+  try
+  {
+    std::vector<std::string> codings;
+    boost::algorithm::split(codings, theAcceptEncoding, boost::is_any_of(","));
+
+    int gzip = -1;      // -1 = not listed, 0 = refused, 1 = accepted
+    int wildcard = -1;
+
+    for (auto& coding : codings)
+    {
+      std::string quality;
+      auto pos = coding.find(';');
+      if (pos != std::string::npos)
+      {
+        quality = coding.substr(pos + 1);
+        coding.resize(pos);
+        boost::algorithm::trim(quality);
+      }
+      boost::algorithm::trim(coding);
+      boost::algorithm::to_lower(coding);
+
+      // q=0, q=0.0 and so on refuse the coding
+      bool accepted = true;
+      if (boost::algorithm::istarts_with(quality, "q="))
+        accepted = (quality.find_first_not_of("0.", 2) != std::string::npos);
+
+      if (coding == "gzip" || coding == "x-gzip")
+        gzip = accepted;
+      else if (coding == "*")
+        wildcard = accepted;
+    }
+
+    if (gzip >= 0)
+      return gzip == 1;
+    return wildcard == 1;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress the data in gzip format
+ *
+ * The best compression level is used, since the result is cached and
+ * served many times.
+ */
+// ----------------------------------------------------------------------
+
+std::string gzip(const std::string& theData)
+{
+  try
+  {
+    std::string ret;
+    {
+      boost::iostreams::filtering_ostream out;
+      out.push(boost::iostreams::gzip_compressor(
+          boost::iostreams::gzip_params(boost::iostreams::gzip::best_compression)));
+      out.push(boost::iostreams::back_inserter(ret));
+      out.write(theData.data(), static_cast<std::streamsize>(theData.size()));
+    }
+    return ret;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace ContentEncoding
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
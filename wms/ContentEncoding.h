@@ -0,0 +1,32 @@
+// ======================================================================
+/*!
+ * \brief HTTP content encoding of text responses
+ *
+ * Large SVG and JSON products are compressed once when they are
+ * generated, and the compressed form is cached next to the plain one so
+ * that it can be served directly to clients accepting it.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace ContentEncoding
+{
+// True if the Accept-Encoding header value allows gzip
+bool acceptsGzip(const std::string& theAcceptEncoding);
+
+// Compress the data in gzip format
+std::string gzip(const std::string& theData);
+
+}  // namespace ContentEncoding
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,131 @@
+#include "CostModel.h"
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// The request being measured in the current thread
+thread_local CostModel::RenderScope* current_scope = nullptr;
+}  // namespace
+
+CostModel::RenderScope::RenderScope(CostModel* theAdmission)
+    : itsPrevious(current_scope), itsAdmission(theAdmission)
+{
+  current_scope = this;
+}
+
+CostModel::RenderScope::~RenderScope()
+{
+  current_scope = itsPrevious;
+}
+
+void CostModel::markRendered()
+{
+  if (current_scope == nullptr)
+    return;
+
+  current_scope->itsRendered = true;
+
+  if (current_scope->itsAdmission == nullptr || current_scope->itsTicket)
+    return;
+
+  if (!current_scope->itsRejected)
+    current_scope->itsTicket = current_scope->itsAdmission->admit();
+
+  if (!current_scope->itsTicket)
+  {
+    current_scope->itsRejected = true;
+    throw Fmi::Exception(BCP, "Too many expensive requests in progress").disableLogging();
+  }
+}
+
+bool CostModel::renderRejected()
+{
+  return (current_scope != nullptr && current_scope->itsRejected);
+}
+
+void CostModel::init(const Settings& theSettings)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  itsSettings = theSettings;
+}
+
+std::optional<double> CostModel::predict(std::size_t theProductKey,
+                                         std::size_t theRequestKey) const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+
+  // An identical request which rendered fast will most likely do so again
+  auto req = itsRequests.find(theRequestKey);
+  if (req != itsRequests.end() && req->second < itsSettings.fast_limit)
+    return req->second;
+
+  auto prod = itsProducts.find(theProductKey);
+  if (prod != itsProducts.end())
+    return prod->second;
+
+  return {};
+}
+
+bool CostModel::isFast(std::size_t theProductKey,
+                       std::size_t theRequestKey,
+                       bool theDefault) const
+{
+  auto cost = predict(theProductKey, theRequestKey);
+  if (!cost)
+    return theDefault;
+  return (*cost < itsSettings.fast_limit);
+}
+
+void CostModel::record(std::size_t theProductKey, std::size_t theRequestKey, double theDuration)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+
+  // The tables are only hints, start over if they grow too large
+  if (itsRequests.size() >= itsSettings.max_entries)
+    itsRequests.clear();
+  if (itsProducts.size() >= itsSettings.max_entries)
+    itsProducts.clear();
+
+  itsRequests[theRequestKey] = theDuration;
+
+  auto prod = itsProducts.find(theProductKey);
+  if (prod == itsProducts.end())
+    itsProducts.emplace(theProductKey, theDuration);
+  else
+    prod->second += itsSettings.smoothing * (theDuration - prod->second);
+}
+
+void CostModel::recordHit(std::size_t theRequestKey, double theDuration)
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+
+  if (itsRequests.size() >= itsSettings.max_entries)
+    itsRequests.clear();
+
+  itsRequests[theRequestKey] = theDuration;
+}
+
+std::optional<CostModel::Ticket> CostModel::admit()
+{
+  if (itsSettings.max_expensive == 0)
+    return Ticket();
+
+  auto n = itsExpensive.load();
+  do
+  {
+    if (n >= itsSettings.max_expensive)
+      return {};
+  } while (!itsExpensive.compare_exchange_weak(n, n + 1));
+
+  return Ticket(&itsExpensive);
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,158 @@
+// ======================================================================
+/*!
+ * \brief Render cost model for request classification and admission
+ *
+ * The server runs fast and slow requests in separate thread pools. A
+ * classification by URL alone puts a cached WMTS tile and a 4000x4000
+ * animated WMS GetMap in the same lane, so a few heavy renders can
+ * starve the tiles.
+ *
+ * The model keeps an exponentially weighted moving average of the
+ * measured render durations of each product, identified by the request
+ * with the bounding box, time and tile coordinates removed. It also
+ * remembers the duration of the latest identical requests. A request is
+ * fast if the same request rendered fast recently, or if the product is
+ * predicted to be fast.
+ *
+ * Only requests which actually rendered something are measured. Image
+ * cache hits, ETag probes and 304 responses take no time at all, and
+ * would make every popular product look fast until its next expensive
+ * render.
+ *
+ * Expensive requests can also be limited to a maximum number running at
+ * a time, in which case the rest are rejected while the cheap requests
+ * keep flowing. The admission slot is taken only when the request starts
+ * to render, so cache hits and conditional requests of expensive
+ * products are never rejected. Such requests are recorded as the latest
+ * duration of the identical request, so that they are classified fast
+ * until the request renders again.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class CostModel
+{
+ public:
+  struct Settings
+  {
+    double fast_limit = 0.2;         // seconds, requests predicted to be faster are fast
+    double smoothing = 0.2;          // weight of the latest measurement in the average
+    unsigned int max_expensive = 0;  // concurrent expensive requests, 0 = unlimited
+    std::size_t max_entries = 100000;
+  };
+
+  // Holds an admission slot for an expensive request
+  class Ticket
+  {
+   public:
+    Ticket() = default;
+    explicit Ticket(std::atomic<unsigned int>* theCounter) : itsCounter(theCounter) {}
+    ~Ticket()
+    {
+      if (itsCounter)
+        --(*itsCounter);
+    }
+
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+    Ticket(Ticket&& theOther) noexcept : itsCounter(theOther.itsCounter)
+    {
+      theOther.itsCounter = nullptr;
+    }
+    Ticket& operator=(Ticket&& theOther) noexcept
+    {
+      if (this != &theOther)
+      {
+        if (itsCounter)
+          --(*itsCounter);
+        itsCounter = theOther.itsCounter;
+        theOther.itsCounter = nullptr;
+      }
+      return *this;
+    }
+
+   private:
+    std::atomic<unsigned int>* itsCounter = nullptr;
+  };
+
+  // Tracks whether the request handled in the current thread renders a product.
+  // With an admission model the render must also get an admission slot.
+  class RenderScope
+  {
+   public:
+    explicit RenderScope(CostModel* theAdmission = nullptr);
+    ~RenderScope();
+
+    RenderScope(const RenderScope&) = delete;
+    RenderScope& operator=(const RenderScope&) = delete;
+    RenderScope(RenderScope&&) = delete;
+    RenderScope& operator=(RenderScope&&) = delete;
+
+    bool rendered() const { return itsRendered; }
+    bool rejected() const { return itsRejected; }
+
+   private:
+    friend class CostModel;
+    RenderScope* itsPrevious = nullptr;
+    CostModel* itsAdmission = nullptr;
+    std::optional<Ticket> itsTicket;
+    bool itsRendered = false;
+    bool itsRejected = false;
+  };
+
+  // Mark the current request as rendered, a no-op outside a RenderScope. Throws
+  // if the scope requires admission and expensive requests are at their limit.
+  static void markRendered();
+
+  // Test whether the render of the current request was rejected
+  static bool renderRejected();
+
+  CostModel() = default;
+  CostModel(const CostModel&) = delete;
+  CostModel& operator=(const CostModel&) = delete;
+
+  void init(const Settings& theSettings);
+
+  // Predicted duration in seconds, nullopt if the product has not been seen
+  std::optional<double> predict(std::size_t theProductKey, std::size_t theRequestKey) const;
+
+  // Classify the request, using theDefault for unknown products
+  bool isFast(std::size_t theProductKey, std::size_t theRequestKey, bool theDefault) const;
+
+  // Record a measured render duration in seconds
+  void record(std::size_t theProductKey, std::size_t theRequestKey, double theDuration);
+
+  // Record the duration of a request which did not render, such as a cache hit
+  void recordHit(std::size_t theRequestKey, double theDuration);
+
+  // Reserve a slot for an expensive request. Returns nullopt if the limit has been reached.
+  std::optional<Ticket> admit();
+
+  unsigned int expensiveRequests() const { return itsExpensive; }
+
+ private:
+  Settings itsSettings;
+
+  mutable std::mutex itsMutex;
+  std::unordered_map<std::size_t, double> itsProducts;  // moving average duration
+  std::unordered_map<std::size_t, double> itsRequests;  // latest duration
+
+  std::atomic<unsigned int> itsExpensive{0};
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,301 @@
+// ======================================================================
+/*!
+ * \brief PNG encoding of datatiles
+ *
+ * Kept apart from the grid engine query in DataTile.cpp so that the
+ * encoders can be linked without the engines, e.g. by the benchmarks.
+ */
+// ======================================================================
+
+#include "DataTile.h"
+#include <cmath>
+#include <cstdint>
+#include <fmt/format.h>
+#include <grid-files/grid/Typedefs.h>
+#include <macgyver/Exception.h>
+#include <png.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// ------------------------------------------------------------------
+// libpng in-memory write callback
+// ------------------------------------------------------------------
+
+struct PngBuffer
+{
+  std::string data;
+};
+
+void pngWriteCallback(png_structp png, png_bytep buf, png_size_t len)
+{
+  auto* out = static_cast<PngBuffer*>(png_get_io_ptr(png));
+  out->data.append(reinterpret_cast<const char*>(buf), len);
+}
+
+void pngFlushCallback(png_structp /*png*/) {}
+
+// ------------------------------------------------------------------
+// Write an RGBA pixel buffer as PNG with optional tEXt metadata
+// ------------------------------------------------------------------
+
+struct TextEntry
+{
+  std::string key;
+  std::string value;
+};
+
+std::string writePng(int width,
+                     int height,
+                     const std::vector<uint8_t>& pixels,
+                     const std::vector<TextEntry>& text)
+{
+  PngBuffer buf;
+
+  auto* png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  if (!png)
+    throw Fmi::Exception(BCP, "png_create_write_struct failed");
+
+  auto* info = png_create_info_struct(png);
+  if (!info)
+  {
+    png_destroy_write_struct(&png, nullptr);
+    throw Fmi::Exception(BCP, "png_create_info_struct failed");
+  }
+
+  if (setjmp(png_jmpbuf(png)))
+  {
+    png_destroy_write_struct(&png, &info);
+    throw Fmi::Exception(BCP, "libpng error during write");
+  }
+
+  png_set_write_fn(png, &buf, pngWriteCallback, pngFlushCallback);
+
+  png_set_IHDR(png,
+               info,
+               width,
+               height,
+               8,
+               PNG_COLOR_TYPE_RGBA,
+               PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+
+  png_set_compression_level(png, 6);
+
+  // Add tEXt metadata chunks
+  if (!text.empty())
+  {
+    std::vector<png_text> chunks(text.size());
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+      std::memset(&chunks[i], 0, sizeof(png_text));
+      chunks[i].compression = PNG_TEXT_COMPRESSION_NONE;
+      chunks[i].key = const_cast<char*>(text[i].key.c_str());
+      chunks[i].text = const_cast<char*>(text[i].value.c_str());
+      chunks[i].text_length = text[i].value.size();
+    }
+    png_set_text(png, info, chunks.data(), static_cast<int>(chunks.size()));
+  }
+
+  png_write_info(png, info);
+
+  // Write row by row
+  for (int y = 0; y < height; ++y)
+  {
+    auto* row = const_cast<uint8_t*>(pixels.data() + y * width * 4);
+    png_write_row(png, row);
+  }
+
+  png_write_end(png, info);
+  png_destroy_write_struct(&png, &info);
+
+  return std::move(buf.data);
+}
+
+// Missing-value sentinel from grid-files
+const float nodata = static_cast<float>(ParamValueMissing);
+
+bool isMissing(float v)
+{
+  return v == nodata || std::isnan(v);
+}
+
+}  // anonymous namespace
+
+// ======================================================================
+// Single-band datatile
+// ======================================================================
+
+std::string writeSingleBandDataTile(int width,
+                                     int height,
+                                     const std::vector<float>& values)
+{
+  try
+  {
+    const int sz = width * height;
+
+    // Find min/max of valid values
+    float vmin = std::numeric_limits<float>::max();
+    float vmax = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < sz; ++i)
+    {
+      if (!isMissing(values[i]))
+      {
+        vmin = std::min(vmin, values[i]);
+        vmax = std::max(vmax, values[i]);
+      }
+    }
+
+    // Handle edge case: all missing or constant field
+    if (vmin > vmax)
+    {
+      vmin = 0;
+      vmax = 1;
+    }
+    else if (vmin == vmax)
+    {
+      vmax = vmin + 1;
+    }
+
+    const double range = vmax - vmin;
+
+    // Encode pixels: R=high, G=low, B=0, A=255 (valid) or A=0 (missing)
+    std::vector<uint8_t> pixels(sz * 4);
+    for (int i = 0; i < sz; ++i)
+    {
+      const int p = i * 4;
+      if (isMissing(values[i]))
+      {
+        pixels[p + 0] = 0;
+        pixels[p + 1] = 0;
+        pixels[p + 2] = 0;
+        pixels[p + 3] = 0;
+      }
+      else
+      {
+        double norm = (values[i] - vmin) / range;
+        norm = std::max(0.0, std::min(1.0, norm));
+        auto q = static_cast<unsigned int>(std::round(norm * 65535.0));
+        pixels[p + 0] = static_cast<uint8_t>(q >> 8);
+        pixels[p + 1] = static_cast<uint8_t>(q & 0xFF);
+        pixels[p + 2] = 0;
+        pixels[p + 3] = 255;
+      }
+    }
+
+    std::vector<TextEntry> text = {{"datatile:bands", "1"},
+                                   {"datatile:min", fmt::format("{:.8g}", vmin)},
+                                   {"datatile:max", fmt::format("{:.8g}", vmax)},
+                                   {"datatile:encoding", "uint16"}};
+
+    return writePng(width, height, pixels, text);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "writeSingleBandDataTile failed!");
+  }
+}
+
+// ======================================================================
+// Dual-band datatile
+// ======================================================================
+
+std::string writeDualBandDataTile(int width,
+                                   int height,
+                                   const std::vector<float>& values1,
+                                   const std::vector<float>& values2)
+{
+  try
+  {
+    const int sz = width * height;
+
+    // Find min/max for each band independently
+    float min1 = std::numeric_limits<float>::max();
+    float max1 = std::numeric_limits<float>::lowest();
+    float min2 = std::numeric_limits<float>::max();
+    float max2 = std::numeric_limits<float>::lowest();
+
+    for (int i = 0; i < sz; ++i)
+    {
+      if (!isMissing(values1[i]) && !isMissing(values2[i]))
+      {
+        min1 = std::min(min1, values1[i]);
+        max1 = std::max(max1, values1[i]);
+        min2 = std::min(min2, values2[i]);
+        max2 = std::max(max2, values2[i]);
+      }
+    }
+
+    if (min1 > max1)
+    {
+      min1 = 0;
+      max1 = 1;
+    }
+    else if (min1 == max1)
+      max1 = min1 + 1;
+
+    if (min2 > max2)
+    {
+      min2 = 0;
+      max2 = 1;
+    }
+    else if (min2 == max2)
+      max2 = min2 + 1;
+
+    const double range1 = max1 - min1;
+    const double range2 = max2 - min2;
+
+    // Encode: R=high(band1), G=low(band1), B=high(band2), A=low(band2)
+    // [1..65535] for valid, 0 = missing sentinel
+    std::vector<uint8_t> pixels(sz * 4);
+    for (int i = 0; i < sz; ++i)
+    {
+      const int p = i * 4;
+      if (isMissing(values1[i]) || isMissing(values2[i]))
+      {
+        pixels[p + 0] = 0;
+        pixels[p + 1] = 0;
+        pixels[p + 2] = 0;
+        pixels[p + 3] = 0;
+      }
+      else
+      {
+        double n1 = (values1[i] - min1) / range1;
+        n1 = std::max(0.0, std::min(1.0, n1));
+        auto q1 = static_cast<unsigned int>(1 + std::round(n1 * 65534.0));
+
+        double n2 = (values2[i] - min2) / range2;
+        n2 = std::max(0.0, std::min(1.0, n2));
+        auto q2 = static_cast<unsigned int>(1 + std::round(n2 * 65534.0));
+
+        pixels[p + 0] = static_cast<uint8_t>(q1 >> 8);
+        pixels[p + 1] = static_cast<uint8_t>(q1 & 0xFF);
+        pixels[p + 2] = static_cast<uint8_t>(q2 >> 8);
+        pixels[p + 3] = static_cast<uint8_t>(q2 & 0xFF);
+      }
+    }
+
+    std::vector<TextEntry> text = {{"datatile:bands", "2"},
+                                   {"datatile:min1", fmt::format("{:.8g}", min1)},
+                                   {"datatile:max1", fmt::format("{:.8g}", max1)},
+                                   {"datatile:min2", fmt::format("{:.8g}", min2)},
+                                   {"datatile:max2", fmt::format("{:.8g}", max2)},
+                                   {"datatile:encoding", "uint16"}};
+
+    return writePng(width, height, pixels, text);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "writeDualBandDataTile failed!");
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
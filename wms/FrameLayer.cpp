@@ -199,7 +199,7 @@ void FrameLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State&
     frame_cdt["type"] = Geometry::name(*itsGeom, theState.getType());
 
     frame_cdt["layertype"] = "frame";
-    frame_cdt["data"] = Geometry::toString(*itsGeom, theState.getType(), box, crs, itsPrecision);
+    frame_cdt["data"] = Geometry::toString(*itsGeom, theState, box, crs, itsPrecision);
     //    theState.addPresentationAttributes(frame_cdt, css, attributes);
     theGlobals["paths"][iri] = frame_cdt;
 
@@ -1,6 +1,8 @@
 #include "Geometry.h"
 #include "Hash.h"
 #include "State.h"
+#include "SvgPath.h"
+#include "TopologyEncoder.h"
 #include <engines/gis/Engine.h>
 #include <fmt/format.h>
 #include <gis/CoordinateTransformation.h>
@@ -21,21 +23,6 @@ namespace Geometry
 namespace
 {
 
-using CoordinateCounter = std::map<unsigned long long, unsigned long long>;
-
-struct GInfo
-{
-  int precision = 0;
-  double mp = 0;
-  int arcCounter = 0;
-  int coordinateCounter = 0;
-  int globalArcCounter = 0;
-  std::map<std::size_t, uint>* arcHashMap{};
-  std::ostringstream arcNumbers;
-  std::ostringstream arcCoordinates;
-  std::ostringstream pointCoordinates;
-};
-
 // ----------------------------------------------------------------------
 /*!
  * \brief Get the GeoJSON specific geometry name
@@ -84,320 +71,12 @@ std::string name_geojson(const OGRGeometry& theGeom)
   }
 }
 
-extern void extractGeometry(const OGRGeometry* theGeom, uint mode, GInfo& info);
-
-void extractGeometry_point(const OGRPoint* theGeom, uint /* mode */, GInfo& info)
-{
-  try
-  {
-    double xx = theGeom->getX();
-    double yy = theGeom->getY();
-
-    long long xxi = (unsigned long long)(xx * info.mp);
-    long long yyi = (unsigned long long)(yy * info.mp);
-
-    info.pointCoordinates << "[" << xxi << "," << yyi << "]";
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_lineString(const OGRLineString* lineString, uint /* mode */, GInfo& info)
-{
-  try
-  {
-    std::ostringstream arcCoordinates;
-    std::ostringstream reverseArcsCoordinates;
-
-    int len = lineString->getNumPoints();
-    if (len < 2)
-      return;
-
-    double xx = lineString->getX(0);
-    double yy = lineString->getY(0);
-
-    long long xxi = static_cast<unsigned long long>(xx * info.mp);
-    long long yyi = static_cast<unsigned long long>(yy * info.mp);
-
-    arcCoordinates << "[";
-    arcCoordinates << "[" << xxi << "," << yyi << "]";
-    // arcCoordinates << "[" << xx << "," << yy << "]";
-
-    for (int t = 1; t < len; t++)
-    {
-      double x = lineString->getX(t);
-      double y = lineString->getY(t);
-
-      long long xi = static_cast<unsigned long long>(x * info.mp);
-      long long yi = static_cast<unsigned long long>(y * info.mp);
-
-      long long nx = (xi - xxi);
-      long long ny = (yi - yyi);
-
-      if (nx || ny)
-      {
-        arcCoordinates << ",[" << (xi - xxi) << "," << (yi - yyi) << "]";
-        // arcCoordinates << ",[" << (x-xx) << "," << (y-yy) << "]";
-
-        xxi = xi;
-        yyi = yi;
-      }
-    }
-    arcCoordinates << "]";
-
-    xx = lineString->getX(len - 1);
-    yy = lineString->getY(len - 1);
-
-    xxi = static_cast<long long>(xx * info.mp);
-    yyi = static_cast<long long>(yy * info.mp);
-
-    reverseArcsCoordinates << "[";
-    reverseArcsCoordinates << "[" << xxi << "," << yyi << "]";
-    // reverseArcsCoordinates << "[" << xx << "," << yy << "]";
-
-    for (int t = len - 2; t >= 0; t--)
-    {
-      double x = lineString->getX(t);
-      double y = lineString->getY(t);
-
-      long long xi = static_cast<unsigned long long>(x * info.mp);
-      long long yi = static_cast<unsigned long long>(y * info.mp);
-
-      long long nx = (xi - xxi);
-      long long ny = (yi - yyi);
-
-      if (nx || ny)
-      {
-        reverseArcsCoordinates << ",[" << (xi - xxi) << "," << (yi - yyi) << "]";
-        // reverseArcsCoordinates << ",[" << (x-xx) << "," << (y-yy) << "]";
-
-        xxi = xi;
-        yyi = yi;
-      }
-    }
-    reverseArcsCoordinates << "]";
-
-    int archNumber = info.globalArcCounter;
-
-    std::string str = arcCoordinates.str();
-    auto hash = Fmi::hash_value(str);
-
-    std::string reverseStr = reverseArcsCoordinates.str();
-    auto reverseHash = Fmi::hash_value(reverseStr);
-
-    auto it = info.arcHashMap->find(hash);
-    if (it != info.arcHashMap->end())
-    {
-      // printf("HASH FOUND %u\n",it->second);
-      archNumber = it->second;
-    }
-    else
-    {
-      it = info.arcHashMap->find(reverseHash);
-      if (it != info.arcHashMap->end())
-      {
-        // printf("REVERSE HASH FOUND %u\n",it->second);
-        archNumber = -(it->second + 1);
-      }
-      else
-      {
-        info.arcHashMap->insert(std::pair<std::size_t, int>(hash, info.globalArcCounter));
-        // arcCoordinateCache.insert(std::pair<std::string,int>(str,info.globalArcCounter));
-
-        if (info.coordinateCounter > 0)
-          info.arcCoordinates << ",\n";
-
-        info.arcCoordinates << str;
-        info.coordinateCounter++;
-        info.globalArcCounter++;
-      }
-    }
-
-    if (info.arcCounter > 0)
-      info.arcNumbers << ",";
-
-    info.arcNumbers << "[" << archNumber << "]";
-
-    info.arcCounter++;
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_linearRing(const OGRLinearRing* linearRing, uint mode, GInfo& info)
-{
-  try
-  {
-    extractGeometry_lineString(linearRing, mode, info);
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_polygon(const OGRPolygon* polygon, uint mode, GInfo& info)
-{
-  try
-  {
-    if (!polygon)
-      return;
-
-    const OGRLinearRing* ring = polygon->getExteriorRing();
-
-    extractGeometry_linearRing(ring, mode, info);
-
-    int len = polygon->getNumInteriorRings();
-    for (int t = 0; t < len; t++)
-    {
-      ring = polygon->getInteriorRing(t);
-      extractGeometry_linearRing(ring, mode, info);
-    }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_multiPoint(const OGRMultiPoint* multiPoint, uint mode, GInfo& info)
-{
-  try
-  {
-    int len = multiPoint->getNumGeometries();
-    for (int t = 0; t < len; t++)
-    {
-      const OGRGeometry* geom = multiPoint->getGeometryRef(t);
-      const OGRPoint* point = geom->toPoint();
-      extractGeometry_point(point, mode, info);
-    }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_multiLineString(const OGRMultiLineString* multiLineString,
-                                     uint mode,
-                                     GInfo& info)
-{
-  try
-  {
-    int len = multiLineString->getNumGeometries();
-    for (int t = 0; t < len; t++)
-    {
-      const OGRGeometry* geom = multiLineString->getGeometryRef(t);
-      const OGRLineString* lineString = geom->toLineString();
-      extractGeometry_lineString(lineString, mode, info);
-    }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_multiPolygon(const OGRMultiPolygon* multiPolygon, uint mode, GInfo& info)
-{
-  try
-  {
-    if (info.arcCounter > 0)
-      info.arcNumbers << ",";
-
-    info.arcNumbers << "[";
-    int len = multiPolygon->getNumGeometries();
-    for (int t = 0; t < len; t++)
-    {
-      const OGRGeometry* geom = multiPolygon->getGeometryRef(t);
-      const OGRPolygon* polygon = geom->toPolygon();
-      extractGeometry_polygon(polygon, mode, info);
-    }
-    info.arcNumbers << "]";
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry_geometryCollection(const OGRGeometryCollection* geometryCollection,
-                                        uint mode,
-                                        GInfo& info)
-{
-  try
-  {
-    int len = geometryCollection->getNumGeometries();
-    for (int t = 0; t < len; t++)
-    {
-      const OGRGeometry* geom = geometryCollection->getGeometryRef(t);
-      extractGeometry(geom, mode, info);
-    }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
-void extractGeometry(const OGRGeometry* geometry, uint mode, GInfo& info)
-{
-  try
-  {
-    auto id = geometry->getGeometryType();
-    switch (id)
-    {
-      case wkbPoint:
-        extractGeometry_point(dynamic_cast<const OGRPoint*>(geometry), mode, info);
-        break;
-
-      case wkbLineString:
-        extractGeometry_lineString(dynamic_cast<const OGRLineString*>(geometry), mode, info);
-        break;
-
-      case wkbLinearRing:
-        extractGeometry_linearRing(dynamic_cast<const OGRLinearRing*>(geometry), mode, info);
-        break;
-
-      case wkbPolygon:
-        extractGeometry_polygon(dynamic_cast<const OGRPolygon*>(geometry), mode, info);
-        break;
-
-      case wkbMultiPoint:
-        extractGeometry_multiPoint(dynamic_cast<const OGRMultiPoint*>(geometry), mode, info);
-        break;
-
-      case wkbMultiLineString:
-        extractGeometry_multiLineString(
-            dynamic_cast<const OGRMultiLineString*>(geometry), mode, info);
-        break;
-
-      case wkbMultiPolygon:
-        extractGeometry_multiPolygon(dynamic_cast<const OGRMultiPolygon*>(geometry), mode, info);
-        break;
-
-      case wkbGeometryCollection:
-        extractGeometry_geometryCollection(
-            dynamic_cast<const OGRGeometryCollection*>(geometry), mode, info);
-        break;
-
-      default:
-        throw Fmi::Exception(BCP, "Encountered an unknown geometry component!");
-    }
-  }
-  catch (...)
-  {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!");
-  }
-}
-
 // ----------------------------------------------------------------------
 /*!
  * \brief Export the coordinates to TopoJSON format
+ *
+ * Junctions are found within the geometry only. Layers with adjacent
+ * geometries should encode them together with a TopologyEncoder.
  */
 // ----------------------------------------------------------------------
 
@@ -405,29 +84,19 @@ std::string toTopoJSON(const OGRGeometry& theGeom,
                        const Fmi::Box& /* theBox */,
                        const Fmi::SpatialReference& /* theSRS */,
                        double thePrecision,
-                       std::map<std::size_t, uint>& arcHashMap,
+                       std::unordered_map<std::size_t, uint>& arcHashMap,
                        uint& arcCounter,
                        std::string& arcNumbers,
                        std::string& arcCoordinates)
 {
   try
   {
-    GInfo info;
-    info.arcHashMap = &arcHashMap;
-    info.precision = (int)(thePrecision);
-    if (thePrecision >= 1.0)
-      info.mp = pow(10.0, info.precision);
-
-    info.arcCounter = 0;
-    info.coordinateCounter = 0;
-    info.globalArcCounter = arcCounter;
-    info.arcNumbers << "[";
-    extractGeometry(&theGeom, 0, info);
-    arcCounter = info.globalArcCounter;
-    info.arcNumbers << "]";
-    arcCoordinates = info.arcCoordinates.str();
-    arcNumbers = info.arcNumbers.str();
-    return info.pointCoordinates.str();
+    TopologyEncoder encoder(thePrecision);
+    auto index = encoder.add(theGeom);
+    encoder.encode(arcHashMap, arcCounter);
+    arcNumbers = encoder.arcs(index);
+    arcCoordinates = encoder.newArcs();
+    return encoder.coordinates(index);
   }
   catch (...)
   {
@@ -529,6 +198,23 @@ std::string toKML(const OGRGeometry& theGeom,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Export the coordinates to SVG path data
+ */
+// ----------------------------------------------------------------------
+
+std::string toSvg(const OGRGeometry& theGeom,
+                  const State& theState,
+                  const Fmi::Box& theBox,
+                  double thePrecision)
+{
+  if (theState.compact_svg_paths)
+    return SvgPath::compact(theGeom, theBox, thePrecision);
+
+  return Fmi::OGR::exportToSvg(theGeom, theBox, thePrecision);
+}
+
 }  // namespace
 
 // ----------------------------------------------------------------------
@@ -538,20 +224,22 @@ std::string toKML(const OGRGeometry& theGeom,
 // ----------------------------------------------------------------------
 
 std::string toString(const OGRGeometry& theGeom,
-                     const std::string& theType,
+                     const State& theState,
                      const Fmi::Box& theBox,
                      const Fmi::SpatialReference& theSRS,
                      double thePrecision)
 {
   try
   {
-    if (theType == "geojson")
+    const auto& type = theState.getType();
+
+    if (type == "geojson")
       return toGeoJSON(theGeom, theBox, theSRS, thePrecision);
 
-    if (theType == "kml")
+    if (type == "kml")
       return toKML(theGeom, theBox, theSRS);
 
-    return Fmi::OGR::exportToSvg(theGeom, theBox, thePrecision);
+    return toSvg(theGeom, theState, theBox, thePrecision);
   }
   catch (...)
   {
@@ -566,18 +254,20 @@ std::string toString(const OGRGeometry& theGeom,
 // ----------------------------------------------------------------------
 
 std::string toString(const OGRGeometry& theGeom,
-                     const std::string& theType,
+                     const State& theState,
                      const Fmi::Box& theBox,
                      const Fmi::SpatialReference& theSRS,
                      double thePrecision,
-                     std::map<std::size_t, uint>& arcHashMap,
+                     std::unordered_map<std::size_t, uint>& arcHashMap,
                      uint& arcCounter,
                      std::string& arcNumbers,
                      std::string& arcCoordinates)
 {
   try
   {
-    if (theType == "topojson")
+    const auto& type = theState.getType();
+
+    if (type == "topojson")
       return toTopoJSON(theGeom,
                         theBox,
                         theSRS,
@@ -587,13 +277,13 @@ std::string toString(const OGRGeometry& theGeom,
                         arcNumbers,
                         arcCoordinates);
 
-    if (theType == "geojson")
+    if (type == "geojson")
       return toGeoJSON(theGeom, theBox, theSRS, thePrecision);
 
-    if (theType == "kml")
+    if (type == "kml")
       return toKML(theGeom, theBox, theSRS);
 
-    return Fmi::OGR::exportToSvg(theGeom, theBox, thePrecision);
+    return toSvg(theGeom, theState, theBox, thePrecision);
   }
   catch (...)
   {
@@ -9,6 +9,7 @@
 #include <gis/OGR.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace Fmi
 {
@@ -28,17 +29,17 @@ namespace Geometry
 std::string name(const OGRGeometry& theGeom, const std::string& theType);
 
 std::string toString(const OGRGeometry& theGeom,
-                     const std::string& theType,
+                     const State& theState,
                      const Fmi::Box& theBox,
                      const Fmi::SpatialReference& theSRS,
                      double thePrecision);
 
 std::string toString(const OGRGeometry& theGeom,
-                     const std::string& theType,
+                     const State& theState,
                      const Fmi::Box& theBox,
                      const Fmi::SpatialReference& theSRS,
                      double thePrecision,
-                     std::map<std::size_t, uint>& arcHashMap,
+                     std::unordered_map<std::size_t, uint>& arcHashMap,
                      uint& arcCounter,
                      std::string& arcNumbers,
                      std::string& arcCoordinates);
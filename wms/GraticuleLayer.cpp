@@ -1322,7 +1322,7 @@ void GraticuleLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, St
       std::string arcNumbers;
       std::string arcCoordinates;
       std::string pointCoordinates = Geometry::toString(*geom,
-                                                        theState.getType(),
+                                                        theState,
                                                         box,
                                                         crs,
                                                         precision,
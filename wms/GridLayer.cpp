@@ -124,7 +124,7 @@ void GridLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State&
     const double precision = 0.1;  // about 1 pixel accuracy should be sufficient
     CTPP::CDT grid_cdt(CTPP::CDT::HASH_VAL);
     grid_cdt["iri"] = iri;
-    grid_cdt["data"] = Geometry::toString(*geom2, theState.getType(), box, crs, precision);
+    grid_cdt["data"] = Geometry::toString(*geom2, theState, box, crs, precision);
     grid_cdt["type"] = Geometry::name(*geom2, theState.getType());
     grid_cdt["layertype"] = "grid";
 
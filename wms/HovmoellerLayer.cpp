@@ -17,11 +17,16 @@
 #include <fmt/format.h>
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
+#include <newbase/NFmiFastQueryInfo.h>
 #include <newbase/NFmiGlobals.h>
+#include <newbase/NFmiGrid.h>
+#include <newbase/NFmiInterpolation.h>
 #include <newbase/NFmiPoint.h>
 #include <spine/Json.h>
 #include <timeseries/ParameterFactory.h>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 
 namespace SmartMet
 {
@@ -33,18 +38,19 @@ namespace Dali
 namespace
 {
 
-// Return the CSS class for a data value given ordered isoband definitions.
+// Return the index of the isoband whose class a data value belongs to, or -1.
 // The first band whose [lolimit, hilimit) interval contains the value wins.
 // A band with neither limit is the missing-value catch-all.
-std::string isoband_class(float value, const std::vector<Isoband>& isobands)
+int isoband_index(float value, const std::vector<Isoband>& isobands)
 {
   const bool missing = (value == kFloatMissing);
-  for (const auto& band : isobands)
+  for (std::size_t i = 0; i < isobands.size(); ++i)
   {
+    const auto& band = isobands[i];
     if (!band.lolimit && !band.hilimit)
     {
       if (missing)
-        return band.attributes.value("class");
+        return static_cast<int>(i);
       continue;
     }
     if (missing)
@@ -52,22 +58,98 @@ std::string isoband_class(float value, const std::vector<Isoband>& isobands)
     bool lo_ok = !band.lolimit || (value >= static_cast<float>(*band.lolimit));
     bool hi_ok = !band.hilimit || (value < static_cast<float>(*band.hilimit));
     if (lo_ok && hi_ok)
-      return band.attributes.value("class");
+      return static_cast<int>(i);
   }
-  return {};
+  return -1;
 }
 
-// Emit one SVG rect; width/height are inflated by 0.5px to close sub-pixel gaps.
-void emit_rect(std::ostringstream& out,
-               double x,
-               double y,
-               double cell_w,
-               double cell_h,
-               const std::string& css_class)
+// Bilinear interpolation stencil for one sample point of the transect. The
+// grid cell and the weights depend only on the location, so they are computed
+// once and reused for every time step and level.
+struct Stencil
 {
-  out << fmt::format(
-      "<rect x=\"{:.2f}\" y=\"{:.2f}\" width=\"{:.2f}\" height=\"{:.2f}\" class=\"{}\"/>",
-      x, y, cell_w + 0.5, cell_h + 0.5, css_class);
+  unsigned long bl = 0;  // bottom left location index
+  unsigned long br = 0;  // bottom right
+  unsigned long tl = 0;  // top left
+  unsigned long tr = 0;  // top right
+  double dx = 0;
+  double dy = 0;
+  bool inside = false;
+};
+
+Stencil make_stencil(const NFmiFastQueryInfo& info, const NFmiPoint& latlon)
+{
+  Stencil s;
+  const auto nx = static_cast<long>(info.GridXNumber());
+  const auto ny = static_cast<long>(info.GridYNumber());
+  if (nx < 2 || ny < 2)
+    return s;
+
+  const NFmiPoint gp = info.Grid()->LatLonToGrid(latlon);
+  if (gp.X() < 0 || gp.Y() < 0 || gp.X() > nx - 1 || gp.Y() > ny - 1)
+    return s;
+
+  // Clamp to the last full cell so that points on the far edges are valid
+  const long i = std::min(static_cast<long>(std::floor(gp.X())), nx - 2);
+  const long j = std::min(static_cast<long>(std::floor(gp.Y())), ny - 2);
+
+  s.dx = gp.X() - i;
+  s.dy = gp.Y() - j;
+  s.bl = static_cast<unsigned long>(j * nx + i);
+  s.br = s.bl + 1;
+  s.tl = s.bl + static_cast<unsigned long>(nx);
+  s.tr = s.tl + 1;
+  s.inside = true;
+  return s;
+}
+
+float location_value(NFmiFastQueryInfo& info, unsigned long index)
+{
+  info.LocationIndex(index);
+  return info.FloatValue();
+}
+
+// Value at the stencil for the currently selected parameter, level and time
+float stencil_value(NFmiFastQueryInfo& info, const Stencil& s)
+{
+  if (!s.inside)
+    return kFloatMissing;
+  return static_cast<float>(NFmiInterpolation::BiLinear(s.dx,
+                                                        s.dy,
+                                                        location_value(info, s.tl),
+                                                        location_value(info, s.tr),
+                                                        location_value(info, s.bl),
+                                                        location_value(info, s.br)));
+}
+
+// Emit one row of cells, merging horizontal runs of the same class into a
+// single rect. Width/height are inflated by 0.5px to close sub-pixel gaps.
+void emit_row(std::string& out,
+              const std::vector<int>& row,
+              double y,
+              double cell_w,
+              double cell_h,
+              const std::vector<std::string>& classes)
+{
+  const std::size_t n = row.size();
+  std::size_t start = 0;
+  while (start < n)
+  {
+    std::size_t end = start + 1;
+    while (end < n && row[end] == row[start])
+      ++end;
+
+    if (row[start] >= 0 && !classes[row[start]].empty())
+      fmt::format_to(
+          std::back_inserter(out),
+          "<rect x=\"{:.2f}\" y=\"{:.2f}\" width=\"{:.2f}\" height=\"{:.2f}\" class=\"{}\"/>",
+          start * cell_w,
+          y,
+          (end - start) * cell_w + 0.5,
+          cell_h + 0.5,
+          classes[row[start]]);
+    start = end;
+  }
 }
 
 }  // anonymous namespace
@@ -191,7 +273,21 @@ void HovmoellerLayer::generate(CTPP::CDT& theGlobals,
 
     // ---- render ----
 
-    std::ostringstream svg;
+    // Class names are looked up once instead of once per cell
+    std::vector<std::string> classes;
+    classes.reserve(isobands.size());
+    for (const auto& band : isobands)
+      classes.push_back(band.attributes.value("class"));
+
+    // Work on a private copy of the iterator so that the shared model is not
+    // repositioned while we walk the locations and times directly.
+    NFmiFastQueryInfo info(*q->info());
+
+    // Non-linear parameters such as wind direction need the special handling
+    // in Q::interpolate, the rest use precomputed stencils.
+    const bool linear = (info.Param().GetParam()->InterpolationMethod() == kLinearly);
+
+    std::string svg;
 
     if (direction == "time_lon" || direction == "time_lat")
     {
@@ -203,20 +299,32 @@ void HovmoellerLayer::generate(CTPP::CDT& theGlobals,
       const double cell_w = static_cast<double>(canvas_w) / nx;
       const double cell_h = static_cast<double>(canvas_h) / n_times;
 
+      std::vector<NFmiPoint> points;
+      std::vector<Stencil> stencils;
+      points.reserve(nx);
+      stencils.reserve(nx);
+      for (int si = 0; si < nx; ++si)
+      {
+        const double space = space_min + (space_max - space_min) * si / (nx - 1);
+        points.emplace_back(time_lon ? space : fixed, time_lon ? fixed : space);
+        stencils.push_back(make_stencil(info, points.back()));
+      }
+
+      std::vector<int> row(nx);
       int ti = 0;
       for (const auto& t : valid_times)
       {
-        for (int si = 0; si < nx; ++si)
+        if (linear && info.TimeIndex(ti))
         {
-          const double space = space_min + (space_max - space_min) * si / (nx - 1);
-          const double lon   = time_lon ? space : fixed;
-          const double lat   = time_lon ? fixed : space;
-
-          const float value = q->interpolate(NFmiPoint(lon, lat), t, 180);
-          const std::string cls = isoband_class(value, isobands);
-          if (!cls.empty())
-            emit_rect(svg, si * cell_w, ti * cell_h, cell_w, cell_h, cls);
+          for (int si = 0; si < nx; ++si)
+            row[si] = isoband_index(stencil_value(info, stencils[si]), isobands);
         }
+        else
+        {
+          for (int si = 0; si < nx; ++si)
+            row[si] = isoband_index(q->interpolate(points[si], t, 180), isobands);
+        }
+        emit_row(svg, row, ti * cell_h, cell_w, cell_h, classes);
         ++ti;
       }
     }
@@ -224,8 +332,12 @@ void HovmoellerLayer::generate(CTPP::CDT& theGlobals,
     {
       // Collect all available pressure levels in data order
       std::vector<double> levels;
-      for (q->resetLevel(); q->nextLevel();)
-        levels.push_back(q->levelValue());
+      std::vector<unsigned long> level_indices;
+      for (info.ResetLevel(); info.NextLevel();)
+      {
+        levels.push_back(info.Level()->LevelValue());
+        level_indices.push_back(info.LevelIndex());
+      }
       const int n_levels = static_cast<int>(levels.size());
       if (n_levels == 0)
         throw Fmi::Exception(BCP, "HovmoellerLayer: no levels in data");
@@ -233,18 +345,31 @@ void HovmoellerLayer::generate(CTPP::CDT& theGlobals,
       const double cell_w = static_cast<double>(canvas_w) / n_levels;
       const double cell_h = static_cast<double>(canvas_h) / n_times;
 
+      const NFmiPoint point(longitude, latitude);
+      const Stencil stencil = make_stencil(info, point);
+
+      std::vector<int> row(n_levels);
       int ti = 0;
       for (const auto& t : valid_times)
       {
+        const bool fast = (linear && info.TimeIndex(ti));
         for (int li = 0; li < n_levels; ++li)
         {
-          q->selectLevel(levels[li]);
-          q->param(param.number());
-          const float value = q->interpolate(NFmiPoint(longitude, latitude), t, 180);
-          const std::string cls = isoband_class(value, isobands);
-          if (!cls.empty())
-            emit_rect(svg, li * cell_w, ti * cell_h, cell_w, cell_h, cls);
+          float value = kFloatMissing;
+          if (fast)
+          {
+            info.LevelIndex(level_indices[li]);
+            value = stencil_value(info, stencil);
+          }
+          else
+          {
+            q->selectLevel(levels[li]);
+            q->param(param.number());
+            value = q->interpolate(point, t, 180);
+          }
+          row[li] = isoband_index(value, isobands);
         }
+        emit_row(svg, row, ti * cell_h, cell_w, cell_h, classes);
         ++ti;
       }
     }
@@ -263,7 +388,7 @@ void HovmoellerLayer::generate(CTPP::CDT& theGlobals,
     group_cdt["start"] = "<g";
     group_cdt["end"] = "</g>";
     theState.addAttributes(theGlobals, group_cdt, attributes);
-    group_cdt["cdata"] = svg.str();
+    group_cdt["cdata"] = svg;
 
     theLayersCdt.PushBack(group_cdt);
   }
@@ -1203,7 +1203,7 @@ void IceMapLayer::handleGeometry(const Fmi::Feature& theResultItem,
     map_cdt["iri"] = iri;
     map_cdt["type"] = Geometry::name(*theResultItem.geom, theState.getType());
     map_cdt["layertype"] = "icemap";
-    map_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
+    map_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
     theState.addPresentationAttributes(map_cdt, css, attributes, theFilter.attributes);  // NEW
     theGlobals["paths"][iri] = map_cdt;
 
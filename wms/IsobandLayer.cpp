@@ -14,6 +14,8 @@
 #include "State.h"
 #include "StyleSheet.h"
 #include "SubdivideGate.h"
+#include "Timing.h"
+#include "TopologyEncoder.h"
 #include "ValueTools.h"
 #include <boost/timer/timer.hpp>
 #include <ctpp2/CDT.hpp>
@@ -42,6 +44,7 @@
 #include <timeseries/ParameterTools.h>
 #include <trax/InterpolationType.h>
 #include <limits>
+#include <optional>
 
 namespace SmartMet
 {
@@ -680,7 +683,11 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
     // query.print(std::cout,0,0);
 
     // Executing the query.
-    std::shared_ptr<QueryServer::Query> query = gridEngine->executeQuery(originalGridQuery);
+    std::shared_ptr<QueryServer::Query> query;
+    {
+      Timing::ScopedSpan span("contour", "isoband:grid");
+      query = gridEngine->executeQuery(originalGridQuery);
+    }
 
     // The Query object after the query execution.
     // query.print(std::cout,0,0);
@@ -763,7 +770,10 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
     filter.bbox(box);
 
     // Smoothen the isobands
-    filter.apply(geoms, true);
+    {
+      Timing::ScopedSpan span("smoothing", "isoband:grid");
+      filter.apply(geoms, true);
+    }
 
     // Extracting the projection information from the query result.
 
@@ -854,6 +864,12 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
     // Add attributes to the group, not the isobands
     theState.addAttributes(theGlobals, group_cdt, attributes);
 
+    // TopoJSON isobands are encoded together so that their common boundaries are shared
+    std::optional<TopologyEncoder> topology;
+    std::vector<std::pair<std::string, std::size_t>> topology_paths;  // iri, geometry
+    if (theState.getType() == "topojson")
+      topology.emplace(precision);
+
     for (unsigned int i = 0; i < geoms.size(); i++)
     {
       const OGRGeometryPtr& geom = geoms[i];
@@ -887,8 +903,6 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
 
           CTPP::CDT isoband_cdt(CTPP::CDT::HASH_VAL);
 
-          std::string arcNumbers;
-          std::string arcCoordinates;
           std::string pointCoordinates;
 
           isoband_cdt["iri"] = iri;
@@ -903,18 +917,10 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
                 filter.toBezierSvg(*geom2, box, precision, &theState.getBezierCache());
           }
 
-          if (pointCoordinates.empty())
-          {
-            pointCoordinates = Geometry::toString(*geom2,
-                                                  theState.getType(),
-                                                  box,
-                                                  crs,
-                                                  precision,
-                                                  theState.arcHashMap,
-                                                  theState.arcCounter,
-                                                  arcNumbers,
-                                                  arcCoordinates);
-          }
+          if (topology)
+            topology_paths.emplace_back(iri, topology->add(*geom2));
+          else if (pointCoordinates.empty())
+            pointCoordinates = Geometry::toString(*geom2, theState, box, crs, precision);
 
           if (!pointCoordinates.empty())
             isoband_cdt["data"] = pointCoordinates;
@@ -935,24 +941,10 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
 
           theState.addPresentationAttributes(isoband_cdt, css, attributes, isoband.attributes);
 
-          if (theState.getType() == "topojson")
-          {
-            if (!arcNumbers.empty())
-              isoband_cdt["arcs"] = arcNumbers;
-
-            if (!arcCoordinates.empty())
-            {
-              CTPP::CDT arc_cdt(CTPP::CDT::HASH_VAL);
-              arc_cdt["data"] = arcCoordinates;
-              theGlobals["arcs"][theState.insertCounter] = arc_cdt;
-              theState.insertCounter++;
-            }
+          if (topology)
             object_cdt["paths"][iri] = isoband_cdt;
-          }
           else
-          {
             theGlobals["paths"][iri] = isoband_cdt;
-          }
 
           // Add the SVG use element
           CTPP::CDT tag_cdt(CTPP::CDT::HASH_VAL);
@@ -965,6 +957,25 @@ void IsobandLayer::generate_gridEngine(CTPP::CDT& theGlobals,
       }
     }
 
+    if (topology)
+    {
+      topology->encode(theState.arcHashMap, theState.arcCounter);
+      for (const auto& iri_geometry : topology_paths)
+      {
+        const auto& arcs = topology->arcs(iri_geometry.second);
+        if (!arcs.empty())
+          object_cdt["paths"][iri_geometry.first]["arcs"] = arcs;
+      }
+
+      if (!topology->newArcs().empty())
+      {
+        CTPP::CDT arc_cdt(CTPP::CDT::HASH_VAL);
+        arc_cdt["data"] = topology->newArcs();
+        theGlobals["arcs"][theState.insertCounter] = arc_cdt;
+        theState.insertCounter++;
+      }
+    }
+
     theGlobals["bbox"] = Fmi::to_string(box.xmin()) + "," + Fmi::to_string(box.ymin()) + "," +
                          Fmi::to_string(box.xmax()) + "," + Fmi::to_string(box.ymax());
     if (precision >= 1.0)
@@ -1061,14 +1072,8 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
         timer2 = std::make_unique<boost::timer::auto_cpu_timer>(2, report2);
       }
 
-      q = q->sample(param,
-                    valid_time,
-                    crs,
-                    box.xmin(),
-                    box.ymin(),
-                    box.xmax(),
-                    box.ymax(),
-                    *sampleresolution);
+      q = theState.getSampleCache().sample(
+          q, param, valid_time, paraminfo.level, crs, box, *sampleresolution);
     }
     else if (heatmap.resolution)
     {
@@ -1166,53 +1171,104 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
       options.parameter = TS::ParameterFactory::instance().parse("1");
     }
 
-    const auto& qEngine = theState.getQEngine();
-    auto matrix = qEngine.getValues(q, options.parameter, valueshash, options.time);
+    // Other isoband layers of the product often contour the same field with the same limits.
+    // Heatmaps are built separately for each layer and are not shared.
 
-    // Avoid reprojecting data when sampling has been used for better speed (and accuracy)
-    CoordinatesPtr coords;
-    if (sampleresolution)
-      coords = qEngine.getWorldCoordinates(q);
-    else
-      coords = qEngine.getWorldCoordinates(q, crs);
+    auto contourhash = valueshash;
+    Fmi::hash_combine(contourhash, Fmi::hash_value(std::string("isobands")));
+    Fmi::hash_combine(contourhash, crs.hashValue());
+    Fmi::hash_combine(contourhash, box.hashValue());
+    Fmi::hash_combine(contourhash, clipbox.hashValue());
+    for (const auto& isoband : isobands)
+    {
+      Fmi::hash_combine(contourhash, Fmi::hash_value(isoband.lolimit));
+      Fmi::hash_combine(contourhash, Fmi::hash_value(isoband.hilimit));
+    }
+    Fmi::hash_combine(contourhash, Fmi::hash_value(paraminfo.level));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(multiplier));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(offset));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(sampleresolution));
+    Fmi::hash_combine(contourhash, Dali::hash_value(smoother, theState));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(interpolation));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(extrapolation));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(options.minarea));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(closed_range));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(strict));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(validate));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(desliver));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(subdivide));
+    Fmi::hash_combine(contourhash, Fmi::hash_value(subdivide_min_cell_pixels));
+    if (tfp_mode)
+      ComputedFields::hashTfpOptions(contourhash, *tfp);
+
+    std::optional<std::vector<OGRGeometryPtr>> cached;
+    if (!heatmap.resolution)
+      cached = theState.findContours(contourhash);
 
-    // When TFP mode is active, replace the fetched underlying field with
-    // its Thermal Front Parameter derivative before contouring. The
-    // contour cache key gets salted with the TFP options so different
-    // TFP configs don't share cache entries.
-    if (tfp_mode && matrix)
+    std::vector<OGRGeometryPtr> geoms;
+    if (cached)
+      geoms = *cached;
+    else
     {
-      static const Fmi::SpatialReference wgs84("WGS84");
-      auto coords_wgs84 = qEngine.getWorldCoordinates(q, wgs84);
-      if (coords_wgs84)
+      const auto& qEngine = theState.getQEngine();
+      std::optional<Timing::ScopedSpan> data_span(std::in_place, "data", "isoband");
+      auto matrix = qEngine.getValues(q, options.parameter, valueshash, options.time);
+
+      // Avoid reprojecting data when sampling has been used for better speed (and accuracy)
+      CoordinatesPtr coords;
+      if (sampleresolution)
+        coords = qEngine.getWorldCoordinates(q);
+      else
+        coords = qEngine.getWorldCoordinates(q, crs);
+
+      // When TFP mode is active, replace the fetched underlying field with
+      // its Thermal Front Parameter derivative before contouring. The
+      // contour cache key gets salted with the TFP options so different
+      // TFP configs don't share cache entries.
+      if (tfp_mode && matrix)
       {
-        auto smoothed = ComputedFields::smoothScalar(*matrix, tfp->smoothing_passes);
-        auto tfp_field = ComputedFields::computeTFP(smoothed, *coords_wgs84, tfp->min_gradient);
-        if (tfp->scale != 1.0)
+        static const Fmi::SpatialReference wgs84("WGS84");
+        auto coords_wgs84 = qEngine.getWorldCoordinates(q, wgs84);
+        if (coords_wgs84)
         {
-          const float s = static_cast<float>(tfp->scale);
-          for (std::size_t j = 0; j < tfp_field.NY(); ++j)
-            for (std::size_t i = 0; i < tfp_field.NX(); ++i)
-              if (tfp_field[i][j] != kFloatMissing)
-                tfp_field[i][j] *= s;
+          auto smoothed = ComputedFields::smoothScalar(*matrix, tfp->smoothing_passes);
+          auto tfp_field = ComputedFields::computeTFP(smoothed, *coords_wgs84, tfp->min_gradient);
+          if (tfp->scale != 1.0)
+          {
+            const float s = static_cast<float>(tfp->scale);
+            for (std::size_t j = 0; j < tfp_field.NY(); ++j)
+              for (std::size_t i = 0; i < tfp_field.NX(); ++i)
+                if (tfp_field[i][j] != kFloatMissing)
+                  tfp_field[i][j] *= s;
+          }
+          matrix = std::make_shared<NFmiDataMatrix<float>>(std::move(tfp_field));
+          Fmi::hash_combine(qhash, Fmi::hash_value(std::string("TFP")));
+          ComputedFields::hashTfpOptions(qhash, *tfp);
         }
-        matrix = std::make_shared<NFmiDataMatrix<float>>(std::move(tfp_field));
-        Fmi::hash_combine(qhash, Fmi::hash_value(std::string("TFP")));
-        ComputedFields::hashTfpOptions(qhash, *tfp);
       }
-    }
 
-    // Gate bilinear subdivision on output pixel density: if the projected data
-    // cells are sub-pixel the interior samples cannot possibly be visible, so
-    // skip them. See SubdivideGate.h for details.
-    if (coords)
-      options.subdivide = effective_subdivide(subdivide, subdivide_min_cell_pixels, *coords, box);
+      // Gate bilinear subdivision on output pixel density: if the projected data
+      // cells are sub-pixel the interior samples cannot possibly be visible, so
+      // skip them. See SubdivideGate.h for details.
+      if (coords)
+        options.subdivide = effective_subdivide(subdivide, subdivide_min_cell_pixels, *coords, box);
 
-    std::vector<OGRGeometryPtr> geoms =
-        contourer.contour(qhash, crs, *matrix, *coords, clipbox, options);
+      data_span.reset();
+
+      {
+        Timing::ScopedSpan span("contour", "isoband");
+        geoms = contourer.contour(qhash, crs, *matrix, *coords, clipbox, options);
+      }
+
+      if (!heatmap.resolution)
+        theState.insertContours(contourhash, geoms);
+    }
 
     filter.bbox(box);
-    filter.apply(geoms, true);
+    {
+      Timing::ScopedSpan span("smoothing", "isoband");
+      filter.apply(geoms, true);
+    }
 
     CTPP::CDT object_cdt;
     std::string objectKey = "isoband:" + paraminfo.parameter + ":" + qid;
@@ -1238,6 +1294,12 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
     // Add attributes to the group, not the isobands
     theState.addAttributes(theGlobals, group_cdt, attributes);
 
+    // TopoJSON isobands are encoded together so that their common boundaries are shared
+    std::optional<TopologyEncoder> topology;
+    std::vector<std::pair<std::string, std::size_t>> topology_paths;  // iri, geometry
+    if (theState.getType() == "topojson")
+      topology.emplace(precision);
+
     for (unsigned int i = 0; i < geoms.size(); i++)
     {
       OGRGeometryPtr& geom = geoms[i];
@@ -1271,8 +1333,6 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
           if (!theState.addId(iri))
             throw Fmi::Exception(BCP, "Non-unique ID assigned to isoband").addParameter("ID", iri);
 
-          std::string arcNumbers;
-          std::string arcCoordinates;
           std::string pointCoordinates;
 
           CTPP::CDT isoband_cdt(CTPP::CDT::HASH_VAL);
@@ -1288,18 +1348,10 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
                 filter.toBezierSvg(*geom2, box, precision, &theState.getBezierCache());
           }
 
-          if (pointCoordinates.empty())
-          {
-            pointCoordinates = Geometry::toString(*geom2,
-                                                  theState.getType(),
-                                                  box,
-                                                  crs,
-                                                  precision,
-                                                  theState.arcHashMap,
-                                                  theState.arcCounter,
-                                                  arcNumbers,
-                                                  arcCoordinates);
-          }
+          if (topology)
+            topology_paths.emplace_back(iri, topology->add(*geom2));
+          else if (pointCoordinates.empty())
+            pointCoordinates = Geometry::toString(*geom2, theState, box, crs, precision);
 
           if (!pointCoordinates.empty())
             isoband_cdt["data"] = pointCoordinates;
@@ -1320,24 +1372,10 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
 
           theState.addPresentationAttributes(isoband_cdt, css, attributes, isoband.attributes);
 
-          if (theState.getType() == "topojson")
-          {
-            if (!arcNumbers.empty())
-              isoband_cdt["arcs"] = arcNumbers;
-
-            if (!arcCoordinates.empty())
-            {
-              CTPP::CDT arc_cdt(CTPP::CDT::HASH_VAL);
-              arc_cdt["data"] = arcCoordinates;
-              theGlobals["arcs"][theState.insertCounter] = arc_cdt;
-              theState.insertCounter++;
-            }
+          if (topology)
             object_cdt["paths"][iri] = isoband_cdt;
-          }
           else
-          {
             theGlobals["paths"][iri] = isoband_cdt;
-          }
 
           // theGlobals["paths"][iri] = isoband_cdt;
 
@@ -1352,6 +1390,25 @@ void IsobandLayer::generate_qEngine(CTPP::CDT& theGlobals, CTPP::CDT& theLayersC
       }
     }
     theGlobals["objects"][objectKey] = object_cdt;
+    if (topology)
+    {
+      topology->encode(theState.arcHashMap, theState.arcCounter);
+      for (const auto& iri_geometry : topology_paths)
+      {
+        const auto& arcs = topology->arcs(iri_geometry.second);
+        if (!arcs.empty())
+          object_cdt["paths"][iri_geometry.first]["arcs"] = arcs;
+      }
+
+      if (!topology->newArcs().empty())
+      {
+        CTPP::CDT arc_cdt(CTPP::CDT::HASH_VAL);
+        arc_cdt["data"] = topology->newArcs();
+        theGlobals["arcs"][theState.insertCounter] = arc_cdt;
+        theState.insertCounter++;
+      }
+    }
+
     theGlobals["bbox"] = Fmi::to_string(box.xmin()) + "," + Fmi::to_string(box.ymin()) + "," +
                          Fmi::to_string(box.xmax()) + "," + Fmi::to_string(box.ymax());
     if (precision >= 1.0)
@@ -1533,14 +1590,8 @@ void IsobandLayer::addMVTLayer(MVTTileBuilder& theBuilder, State& theState)
     {
       if (!q)
         throw Fmi::Exception(BCP, "Cannot resample without gridded data");
-      q = q->sample(param,
-                    valid_time,
-                    crs,
-                    box.xmin(),
-                    box.ymin(),
-                    box.xmax(),
-                    box.ymax(),
-                    *sampleresolution);
+      q = theState.getSampleCache().sample(
+          q, param, valid_time, paraminfo.level, crs, box, *sampleresolution);
     }
     else if (heatmap.resolution)
     {
@@ -10,11 +10,15 @@
 #include <macgyver/Hash.h>
 #include <spine/Convenience.h>
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <future>
 #include <iostream>
+#include <numeric>
 #include <ogr_geometry.h>
 #include <fmt/format.h>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace SmartMet
@@ -52,20 +56,259 @@ Fmi::GeometrySmoother::Type parse_filter_name(const std::string& name)
   }
 }
 
-// Are all (non-empty) geometries OGC-valid? Used by the adaptive validity
-// backoff. For isobands this catches self-intersections introduced by
-// smoothing; for isolines IsValid is essentially always true (a line may be
-// non-simple yet valid), so the backoff never triggers for them.
-bool all_valid(const std::vector<OGRGeometryPtr>& geoms)
+// Helper threads available to all requests, see IsolineFilter::setWorkerThreads
+std::atomic<unsigned int> available_workers{0};
+
+// Helpers run their share serially instead of starting more threads
+thread_local bool in_worker = false;
+
+// Returns the reserved helpers to the shared budget
+struct WorkerReservation
+{
+  std::size_t count = 0;
+  ~WorkerReservation() { available_workers += static_cast<unsigned int>(count); }
+};
+
+// Run f(0)...f(n-1) on up to max_tasks threads including the calling one.
+// Indices are handed out dynamically since the work items vary in size.
+// The helper threads are taken from a budget shared by all requests, and
+// the calling thread does the work alone if none are free.
+template <typename F>
+void parallel_for(std::size_t n, std::size_t max_tasks, F&& f)
+{
+  WorkerReservation reservation;
+  if (!in_worker && n > 1 && max_tasks > 1)
+  {
+    const auto wanted = static_cast<unsigned int>(std::min(n, max_tasks) - 1);
+    auto available = available_workers.load();
+    do
+    {
+      reservation.count = std::min(wanted, available);
+    } while (reservation.count > 0 &&
+             !available_workers.compare_exchange_weak(
+                 available, available - static_cast<unsigned int>(reservation.count)));
+  }
+
+  if (reservation.count == 0)
+  {
+    for (std::size_t i = 0; i < n; i++)
+      f(i);
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  auto work = [&]()
+  {
+    for (std::size_t i = next++; i < n; i = next++)
+      f(i);
+  };
+
+  auto helper = [&]()
+  {
+    in_worker = true;
+    work();
+  };
+
+  // Declared after the reservation so that the helpers finish before it is returned
+  std::vector<std::future<void>> tasks;
+  for (std::size_t t = 0; t < reservation.count; ++t)
+    tasks.push_back(std::async(std::launch::async, helper));
+  work();
+  for (auto& task : tasks)
+    task.get();
+}
+
+// Upper limit for threads used by a single request
+const std::size_t max_parallel_tasks = 8;
+
+// Indices of the (non-empty) geometries which are not OGC-valid. Used by the
+// adaptive validity backoff. For isobands this catches self-intersections
+// introduced by smoothing; for isolines IsValid is essentially always true (a
+// line may be non-simple yet valid), so the backoff never triggers for them.
+// The geometries are independent, so they are checked in parallel.
+std::vector<std::size_t> invalid_geometries(const std::vector<OGRGeometryPtr>& geoms,
+                                            const std::vector<std::size_t>& indices)
+{
+  std::vector<char> invalid(indices.size(), 0);
+
+  parallel_for(indices.size(),
+               max_parallel_tasks,
+               [&](std::size_t i)
+               {
+                 const auto& geom_ptr = geoms[indices[i]];
+                 invalid[i] = (geom_ptr && !geom_ptr->IsEmpty() && !geom_ptr->IsValid());
+               });
+
+  std::vector<std::size_t> ret;
+  for (std::size_t i = 0; i < indices.size(); ++i)
+    if (invalid[i])
+      ret.push_back(indices[i]);
+  return ret;
+}
+
+std::vector<std::size_t> all_indices(std::size_t n)
+{
+  std::vector<std::size_t> ret(n);
+  std::iota(ret.begin(), ret.end(), 0);
+  return ret;
+}
+
+// Vertices are identified by their exact coordinates, since adjacent isobands
+// share bit-identical vertices along their common edges (as in VertexCounter).
+struct Vertex
+{
+  double x;
+  double y;
+  bool operator==(const Vertex& other) const { return x == other.x && y == other.y; }
+};
+
+struct VertexHash
+{
+  std::size_t operator()(const Vertex& v) const
+  {
+    auto hash = std::hash<double>{}(v.x);
+    Fmi::hash_combine(hash, std::hash<double>{}(v.y));
+    return hash;
+  }
+};
+
+using VertexSet = std::unordered_set<Vertex, VertexHash>;
+
+// Collect the rings and linestrings of a geometry in traversal order
+void collect_curves(const OGRGeometry* geom, std::vector<const OGRSimpleCurve*>& curves)
+{
+  if (geom == nullptr || geom->IsEmpty())
+    return;
+
+  switch (wkbFlatten(geom->getGeometryType()))
+  {
+    case wkbLineString:
+    case wkbLinearRing:
+      curves.push_back(dynamic_cast<const OGRSimpleCurve*>(geom));
+      break;
+    case wkbPolygon:
+    {
+      const auto* poly = dynamic_cast<const OGRPolygon*>(geom);
+      curves.push_back(poly->getExteriorRing());
+      for (int i = 0, n = poly->getNumInteriorRings(); i < n; i++)
+        curves.push_back(poly->getInteriorRing(i));
+      break;
+    }
+    case wkbMultiLineString:
+    case wkbMultiPolygon:
+    case wkbGeometryCollection:
+    {
+      const auto* coll = dynamic_cast<const OGRGeometryCollection*>(geom);
+      for (int i = 0, n = coll->getNumGeometries(); i < n; i++)
+        collect_curves(coll->getGeometryRef(i), curves);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void add_vertices(const OGRGeometry* geom, VertexSet& vertices)
+{
+  std::vector<const OGRSimpleCurve*> curves;
+  collect_curves(geom, curves);
+  for (const auto* curve : curves)
+    for (int i = 0, n = curve->getNumPoints(); i < n; i++)
+      vertices.insert({curve->getX(i), curve->getY(i)});
+}
+
+bool has_vertex(const OGRGeometry* geom, const VertexSet& vertices)
+{
+  std::vector<const OGRSimpleCurve*> curves;
+  collect_curves(geom, curves);
+  for (const auto* curve : curves)
+    for (int i = 0, n = curve->getNumPoints(); i < n; i++)
+      if (vertices.count({curve->getX(i), curve->getY(i)}) > 0)
+        return true;
+  return false;
+}
+
+// Add the original vertices of the invalid polygons of a smoothed isoband. If
+// no single polygon is invalid (overlapping parts) the whole isoband is added.
+void add_offending_vertices(const OGRGeometry& smoothed,
+                            const OGRGeometry& original,
+                            VertexSet& vertices)
+{
+  const auto* smulti = dynamic_cast<const OGRMultiPolygon*>(&smoothed);
+  const auto* omulti = dynamic_cast<const OGRMultiPolygon*>(&original);
+
+  bool found = false;
+  if (smulti != nullptr && omulti != nullptr &&
+      smulti->getNumGeometries() == omulti->getNumGeometries())
+  {
+    for (int i = 0, n = smulti->getNumGeometries(); i < n; i++)
+    {
+      if (!smulti->getGeometryRef(i)->IsValid())
+      {
+        add_vertices(omulti->getGeometryRef(i), vertices);
+        found = true;
+      }
+    }
+  }
+
+  if (!found)
+    add_vertices(&original, vertices);
+}
+
+// Copy the listed original vertices from the re-smoothed geometry into the
+// target, which is a copy of the fully smoothed geometry. Shared vertices are
+// selected identically in every isoband, which keeps common edges coherent.
+// Returns false if the smoother changed the structure of the geometry.
+bool splice(OGRGeometry& target,
+            const OGRGeometry& original,
+            const OGRGeometry& reduced,
+            const VertexSet& vertices)
 {
-  for (const auto& geom_ptr : geoms)
-    if (geom_ptr && !geom_ptr->IsEmpty() && !geom_ptr->IsValid())
+  std::vector<const OGRSimpleCurve*> tcurves;
+  std::vector<const OGRSimpleCurve*> ocurves;
+  std::vector<const OGRSimpleCurve*> rcurves;
+  collect_curves(&target, tcurves);
+  collect_curves(&original, ocurves);
+  collect_curves(&reduced, rcurves);
+
+  if (tcurves.size() != ocurves.size() || rcurves.size() != ocurves.size())
+    return false;
+
+  for (std::size_t c = 0; c < ocurves.size(); c++)
+  {
+    const int n = ocurves[c]->getNumPoints();
+    if (tcurves[c]->getNumPoints() != n || rcurves[c]->getNumPoints() != n)
       return false;
+  }
+
+  for (std::size_t c = 0; c < ocurves.size(); c++)
+  {
+    auto* curve = const_cast<OGRSimpleCurve*>(tcurves[c]);  // owned by target
+    for (int i = 0, n = ocurves[c]->getNumPoints(); i < n; i++)
+      if (vertices.count({ocurves[c]->getX(i), ocurves[c]->getY(i)}) > 0)
+        curve->setPoint(i, rcurves[c]->getX(i), rcurves[c]->getY(i));
+  }
   return true;
 }
 
 }  // namespace
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the number of helper threads shared by all requests
+ *
+ * Validity checks and Bezier fits of large isolines are run in parallel
+ * only with helpers from this budget, so concurrent requests cannot
+ * start more threads than configured. The plugin uses the size of the
+ * contouring worker pool, zero makes the filters single threaded.
+ */
+// ----------------------------------------------------------------------
+
+void IsolineFilter::setWorkerThreads(unsigned int theThreads)
+{
+  available_workers = theThreads;
+}
+
 // Initialize from JSON config
 void IsolineFilter::init(Json::Value& theJson)
 {
@@ -165,6 +408,7 @@ void IsolineFilter::init(Json::Value& theJson)
         m_validate = enabled;
         JsonTools::remove_int(m_validateTries, validateJson, "tries");
         JsonTools::remove_bool(m_validateBisect, validateJson, "bisect");
+        JsonTools::remove_bool(m_validateLocal, validateJson, "local");
         JsonTools::remove_bool(m_validateDebug, validateJson, "debug");
       }
       else
@@ -196,50 +440,221 @@ void IsolineFilter::apply(std::vector<OGRGeometryPtr>& geoms, bool preserve_topo
   else
   {
     // Adaptive validity backoff. Smoothing can move vertices enough to make an
-    // isoband self-intersect, which makes it invalid for clipping. Re-smooth the
-    // whole set at a halved radius until every geometry is valid. Re-smoothing
-    // the whole set (rather than repairing one band) keeps the shared edges
-    // between adjacent isobands coherent and gap-free. If no valid radius is
-    // found within the budget, fall back to the unsmoothed (simple) input.
+    // isoband self-intersect, which makes it invalid for clipping.
     //
     // A shallow copy is enough to preserve the originals: the smoother replaces
     // each shared_ptr (geom.reset(newgeom)) rather than mutating in place, so the
     // copied pointers keep the originals alive across retries.
     const std::vector<OGRGeometryPtr> original = geoms;
 
-    Fmi::GeometrySmoother trial;
-    trial.type(m_type);
-    trial.iterations(m_iterations);
-    trial.lambda(m_lambda);
-    trial.mu(m_mu);
+    trialSmoother(m_radiusMetric).apply(geoms, preserve_topology);
+    auto bad = invalid_geometries(geoms, all_indices(geoms.size()));
 
+    if (!bad.empty())
+    {
+      if (!m_validateLocal || !backoffLocally(geoms, original, bad, preserve_topology))
+        backoffGlobally(geoms, original, preserve_topology);
+    }
+  }
+
+  // When Bezier fitting is enabled, always count vertices across all geometries.
+  // The VertexCounter identifies shared edges (count=2) and grid corners (count=4)
+  // so that Bezier fitting places break points correctly and fits shared edges in
+  // a canonical direction. This prevents gaps unconditionally — for isobands the
+  // shared edges get identical curves, and for isolines the counts are simply zero
+  // (unshared) so every vertex is freely fittable.
+  if (m_bezierAccuracy > 0)
+  {
+    m_vertexCounter = Fmi::VertexCounter();  // reset
+    for (const auto& geom_ptr : geoms)
+      if (geom_ptr && !geom_ptr->IsEmpty())
+        m_vertexCounter.add(geom_ptr.get());
+  }
+}
+
+// Smoother for the validity backoff at the given metric radius
+Fmi::GeometrySmoother IsolineFilter::trialSmoother(double radius) const
+{
+  Fmi::GeometrySmoother trial;
+  trial.type(m_type);
+  trial.iterations(m_iterations);
+  trial.lambda(m_lambda);
+  trial.mu(m_mu);
+  trial.radius(radius);
+  return trial;
+}
+
+// Localised validity backoff. Only the offending polygons are re-smoothed at a
+// reduced radius: their original vertices are collected, the isobands sharing
+// any of them are re-smoothed, and exactly those vertices are spliced into the
+// full-radius result. Since a shared vertex is selected in every isoband that
+// contains it, common edges stay coherent while the rest of the map keeps full
+// smoothing. The offending set grows if the splice itself produces an invalid
+// polygon. Returns false if the smoother does not preserve the structure of
+// the geometries, in which case the caller falls back to the global backoff.
+bool IsolineFilter::backoffLocally(std::vector<OGRGeometryPtr>& geoms,
+                                   const std::vector<OGRGeometryPtr>& original,
+                                   const std::vector<std::size_t>& bad,
+                                   bool preserve_topology) const
+{
+  try
+  {
+    const std::vector<OGRGeometryPtr> full = geoms;
+
+    VertexSet vertices;
+    for (auto i : bad)
+      add_offending_vertices(*full[i], *original[i], vertices);
+
+    // Isobands containing offending vertices, updated by resmooth
+    std::vector<std::size_t> touched;
+
+    // Re-smooth the touched isobands at the given radius (0 = unsmoothed) and
+    // splice the offending vertices into a copy of the full-radius result
+    auto resmooth = [&](double radius, std::vector<OGRGeometryPtr>& result)
+    {
+      touched.clear();
+      for (std::size_t i = 0; i < original.size(); i++)
+        if (has_vertex(original[i].get(), vertices))
+          touched.push_back(i);
+
+      // With preserve_topology the smoother freezes unshared vertices, hence the
+      // neighbours must be included for shared vertices to be classified as in
+      // the full set. Their re-smoothed versions are not used.
+      std::vector<std::size_t> subset = touched;
+      if (preserve_topology)
+      {
+        VertexSet touched_vertices;
+        for (auto i : touched)
+          add_vertices(original[i].get(), touched_vertices);
+        subset.clear();
+        for (std::size_t i = 0; i < original.size(); i++)
+          if (has_vertex(original[i].get(), touched_vertices))
+            subset.push_back(i);
+      }
+
+      std::vector<OGRGeometryPtr> reduced;
+      reduced.reserve(subset.size());
+      for (auto i : subset)
+        reduced.push_back(original[i]);
+      if (radius > 0)
+        trialSmoother(radius).apply(reduced, preserve_topology);
+
+      result = full;
+      std::size_t pos = 0;
+      for (auto i : touched)
+      {
+        while (subset[pos] != i)
+          ++pos;
+        if (!full[i] || !reduced[pos])
+          return false;
+        OGRGeometryPtr geom(full[i]->clone());
+        if (!splice(*geom, *original[i], *reduced[pos], vertices))
+          return false;
+        result[i] = geom;
+      }
+      return true;
+    };
+
+    std::vector<OGRGeometryPtr> result;
     double r = m_radiusMetric;
-    double last_bad = -1;
+    double last_bad = r;
     bool ok = false;
 
-    for (int t = 0; t < m_validateTries && r > 0; ++t)
+    for (int t = 1; t < m_validateTries; ++t)
     {
-      geoms = original;
-      trial.radius(r);
-      trial.apply(geoms, preserve_topology);
-      if (all_valid(geoms))
+      r *= 0.5;
+      if (!resmooth(r, result))
+        return false;
+
+      auto still_bad = invalid_geometries(result, touched);
+      if (still_bad.empty())
       {
         ok = true;
         break;
       }
+      for (auto i : still_bad)
+        add_offending_vertices(*result[i], *original[i], vertices);
       last_bad = r;
+    }
+
+    // One bisection step back towards a larger radius for the same vertices to
+    // retain as much smoothing as possible while staying valid.
+    if (ok && m_validateBisect && last_bad > r)
+    {
+      const double rmid = 0.5 * (r + last_bad);
+      std::vector<OGRGeometryPtr> trial_result;
+      if (resmooth(rmid, trial_result) && invalid_geometries(trial_result, touched).empty())
+      {
+        result = std::move(trial_result);
+        r = rmid;
+      }
+    }
+
+    // Leave the offending vertices unsmoothed, or the whole set if even that fails
+    if (!ok)
+    {
+      ok = resmooth(0, result) && invalid_geometries(result, touched).empty();
+      r = 0;
+    }
+
+    geoms = (ok ? std::move(result) : original);
+
+    if (m_validateDebug)
+      std::cerr << Spine::log_time_str()
+                << fmt::format(
+                       " WMS IsolineFilter validity backoff: smoothing radius {} -> {} in {}/{} "
+                       "geometries ({})",
+                       m_radiusMetric,
+                       r,
+                       touched.size(),
+                       geoms.size(),
+                       (ok ? "valid" : "unsmoothed fallback"))
+                << '\n';
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// Global validity backoff. Re-smooth the whole set at a halved radius until
+// every geometry is valid. Re-smoothing the whole set keeps the shared edges
+// between adjacent isobands coherent without any assumptions on the smoother.
+// If no valid radius is found within the budget, fall back to the unsmoothed
+// (simple) input.
+void IsolineFilter::backoffGlobally(std::vector<OGRGeometryPtr>& geoms,
+                                    const std::vector<OGRGeometryPtr>& original,
+                                    bool preserve_topology) const
+{
+  try
+  {
+    double r = m_radiusMetric;
+    double last_bad = r;
+    bool ok = false;
+
+    for (int t = 1; t < m_validateTries; ++t)
+    {
       r *= 0.5;
+      geoms = original;
+      trialSmoother(r).apply(geoms, preserve_topology);
+      if (invalid_geometries(geoms, all_indices(geoms.size())).empty())
+      {
+        ok = true;
+        break;
+      }
+      last_bad = r;
     }
 
     // One bisection step back towards a larger (less aggressively reduced) radius
     // to retain as much smoothing as possible while staying valid.
-    if (ok && m_validateBisect && last_bad > 0)
+    if (ok && m_validateBisect)
     {
       const double rmid = 0.5 * (r + last_bad);
       std::vector<OGRGeometryPtr> trial_geoms = original;
-      trial.radius(rmid);
-      trial.apply(trial_geoms, preserve_topology);
-      if (all_valid(trial_geoms))
+      trialSmoother(rmid).apply(trial_geoms, preserve_topology);
+      if (invalid_geometries(trial_geoms, all_indices(trial_geoms.size())).empty())
       {
         geoms = std::move(trial_geoms);
         r = rmid;
@@ -249,7 +664,7 @@ void IsolineFilter::apply(std::vector<OGRGeometryPtr>& geoms, bool preserve_topo
     if (!ok)
       geoms = original;  // emit unsmoothed geometry rather than an invalid one
 
-    if (m_validateDebug && r != m_radiusMetric)
+    if (m_validateDebug)
       std::cerr << Spine::log_time_str()
                 << fmt::format(
                        " WMS IsolineFilter validity backoff: smoothing radius {} -> {} ({})",
@@ -258,19 +673,9 @@ void IsolineFilter::apply(std::vector<OGRGeometryPtr>& geoms, bool preserve_topo
                        (ok ? "valid" : "unsmoothed fallback"))
                 << '\n';
   }
-
-  // When Bezier fitting is enabled, always count vertices across all geometries.
-  // The VertexCounter identifies shared edges (count=2) and grid corners (count=4)
-  // so that Bezier fitting places break points correctly and fits shared edges in
-  // a canonical direction. This prevents gaps unconditionally — for isobands the
-  // shared edges get identical curves, and for isolines the counts are simply zero
-  // (unshared) so every vertex is freely fittable.
-  if (m_bezierAccuracy > 0)
+  catch (...)
   {
-    m_vertexCounter = Fmi::VertexCounter();  // reset
-    for (const auto& geom_ptr : geoms)
-      if (geom_ptr && !geom_ptr->IsEmpty())
-        m_vertexCounter.add(geom_ptr.get());
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
 
@@ -423,12 +828,10 @@ std::vector<Fmi::BezierFit::CubicBez> IsolineFilter::fitWithCache(
   return canonical ? std::move(cubics) : Fmi::BezierFit::reverseCubics(cubics);
 }
 
-void IsolineFilter::writeBezierLineStringSvg(std::string& out,
-                                             const OGRLineString* geom,
-                                             const Fmi::Box& box,
-                                             double rfactor,
-                                             int decimals,
-                                             BezierCache* cache) const
+void IsolineFilter::planBezierLineString(std::vector<BezierPiece>& plan,
+                                         const OGRLineString* geom,
+                                         const Fmi::Box& box,
+                                         double rfactor) const
 {
   try
   {
@@ -456,12 +859,10 @@ void IsolineFilter::writeBezierLineStringSvg(std::string& out,
     const auto& last = data.points.back();
     const bool closed = (first.x == last.x && first.y == last.y);
 
-    auto cubics = fitWithCache(data.points, cache, closed);
-
-    if (cubics.empty())
-      return;
-
-    Fmi::BezierFit::appendBezierSvg(out, cubics, true, false, decimals);
+    BezierPiece piece;
+    piece.points = std::move(data.points);
+    piece.closed = closed;
+    plan.push_back(std::move(piece));
   }
   catch (...)
   {
@@ -469,12 +870,10 @@ void IsolineFilter::writeBezierLineStringSvg(std::string& out,
   }
 }
 
-void IsolineFilter::writeBezierLinearRingSvg(std::string& out,
-                                             const OGRLinearRing* geom,
-                                             const Fmi::Box& box,
-                                             double rfactor,
-                                             int decimals,
-                                             BezierCache* cache) const
+void IsolineFilter::planBezierLinearRing(std::vector<BezierPiece>& plan,
+                                         const OGRLinearRing* geom,
+                                         const Fmi::Box& box,
+                                         double rfactor) const
 {
   try
   {
@@ -526,15 +925,18 @@ void IsolineFilter::writeBezierLinearRingSvg(std::string& out,
       // No break points - the entire ring is smooth. Fit as a closed ring
       // so the curve is C1-continuous across the closure (otherwise a
       // straight-line 'Z' close leaves a visible corner).
-      auto cubics = fitWithCache(data.points, cache, /*closed=*/true);
-      Fmi::BezierFit::appendBezierSvg(out, cubics, true, false, decimals);
-      out += 'Z';
+      BezierPiece piece;
+      piece.points = std::move(data.points);
+      piece.closed = true;
+      piece.close = true;
+      plan.push_back(std::move(piece));
       return;
     }
 
     // We have break points. Split the ring into segments and fit each one.
-    // For direction normalization: compare first and last point of each segment.
-    // Always fit in canonical direction, reverse output if actual direction differs.
+    // fitWithCache handles direction normalization and shared-edge reuse:
+    // each sub-segment's canonical-direction fit is cached and replayed
+    // (reversed if needed) for the neighbouring isoband's matching edge.
 
     bool firstSegment = true;
     int numBreaks = static_cast<int>(breaks.size());
@@ -545,7 +947,8 @@ void IsolineFilter::writeBezierLinearRingSvg(std::string& out,
       int endIdx = breaks[(b + 1) % numBreaks];
 
       // Build sub-segment points (may wrap around ring)
-      std::vector<Fmi::BezierFit::Point> segPoints;
+      BezierPiece piece;
+      auto& segPoints = piece.points;
       if (endIdx > startIdx)
       {
         segPoints.assign(data.points.begin() + startIdx, data.points.begin() + endIdx + 1);
@@ -560,16 +963,14 @@ void IsolineFilter::writeBezierLinearRingSvg(std::string& out,
       if (segPoints.size() < 2)
         continue;
 
-      // fitWithCache handles direction normalization and shared-edge reuse:
-      // each sub-segment's canonical-direction fit is cached and replayed
-      // (reversed if needed) for the neighbouring isoband's matching edge.
-      auto cubics = fitWithCache(segPoints, cache);
-
-      Fmi::BezierFit::appendBezierSvg(out, cubics, firstSegment, false, decimals);
+      piece.moveTo = firstSegment;
+      plan.push_back(std::move(piece));
       firstSegment = false;
     }
 
-    out += 'Z';
+    BezierPiece closing;
+    closing.close = true;
+    plan.push_back(std::move(closing));
   }
   catch (...)
   {
@@ -577,12 +978,10 @@ void IsolineFilter::writeBezierLinearRingSvg(std::string& out,
   }
 }
 
-void IsolineFilter::writeBezierSvg(std::string& out,
-                                   const OGRGeometry* geom,
-                                   const Fmi::Box& box,
-                                   double rfactor,
-                                   int decimals,
-                                   BezierCache* cache) const
+void IsolineFilter::planBezierSvg(std::vector<BezierPiece>& plan,
+                                  const OGRGeometry* geom,
+                                  const Fmi::Box& box,
+                                  double rfactor) const
 {
   try
   {
@@ -593,40 +992,38 @@ void IsolineFilter::writeBezierSvg(std::string& out,
     switch (wkbFlatten(id))
     {
       case wkbLineString:
-        writeBezierLineStringSvg(
-            out, dynamic_cast<const OGRLineString*>(geom), box, rfactor, decimals, cache);
+        planBezierLineString(plan, dynamic_cast<const OGRLineString*>(geom), box, rfactor);
         break;
       case wkbLinearRing:
-        writeBezierLinearRingSvg(
-            out, dynamic_cast<const OGRLinearRing*>(geom), box, rfactor, decimals, cache);
+        planBezierLinearRing(plan, dynamic_cast<const OGRLinearRing*>(geom), box, rfactor);
         break;
       case wkbPolygon:
       {
         const auto* poly = dynamic_cast<const OGRPolygon*>(geom);
-        writeBezierLinearRingSvg(out, poly->getExteriorRing(), box, rfactor, decimals, cache);
+        planBezierLinearRing(plan, poly->getExteriorRing(), box, rfactor);
         for (int i = 0, nHoles = poly->getNumInteriorRings(); i < nHoles; i++)
-          writeBezierLinearRingSvg(out, poly->getInteriorRing(i), box, rfactor, decimals, cache);
+          planBezierLinearRing(plan, poly->getInteriorRing(i), box, rfactor);
         break;
       }
       case wkbMultiLineString:
       {
         const auto* multi = dynamic_cast<const OGRMultiLineString*>(geom);
         for (int i = 0, ng = multi->getNumGeometries(); i < ng; i++)
-          writeBezierLineStringSvg(out, multi->getGeometryRef(i), box, rfactor, decimals, cache);
+          planBezierLineString(plan, multi->getGeometryRef(i), box, rfactor);
         break;
       }
       case wkbMultiPolygon:
       {
         const auto* multi = dynamic_cast<const OGRMultiPolygon*>(geom);
         for (int i = 0, ng = multi->getNumGeometries(); i < ng; i++)
-          writeBezierSvg(out, multi->getGeometryRef(i), box, rfactor, decimals, cache);
+          planBezierSvg(plan, multi->getGeometryRef(i), box, rfactor);
         break;
       }
       case wkbGeometryCollection:
       {
         const auto* coll = dynamic_cast<const OGRGeometryCollection*>(geom);
         for (int i = 0, ng = coll->getNumGeometries(); i < ng; i++)
-          writeBezierSvg(out, coll->getGeometryRef(i), box, rfactor, decimals, cache);
+          planBezierSvg(plan, coll->getGeometryRef(i), box, rfactor);
         break;
       }
       default:
@@ -640,6 +1037,10 @@ void IsolineFilter::writeBezierSvg(std::string& out,
   }
 }
 
+// The polylines are first collected in output order, then fitted in parallel
+// (the pieces are independent apart from the thread safe cache), and finally
+// written in the original order so the output does not depend on scheduling.
+// Small geometries are fitted serially, since thread startup would dominate.
 std::string IsolineFilter::toBezierSvg(const OGRGeometry& geom,
                                        const Fmi::Box& box,
                                        double precision,
@@ -651,8 +1052,32 @@ std::string IsolineFilter::toBezierSvg(const OGRGeometry& geom,
     const int decimals = std::min(16.0, std::ceil(prec));
     const double rfactor = std::pow(10.0, prec);
 
+    std::vector<BezierPiece> plan;
+    planBezierSvg(plan, &geom, box, rfactor);
+
+    std::size_t npoints = 0;
+    for (const auto& piece : plan)
+      npoints += piece.points.size();
+
+    const std::size_t min_parallel_points = 2000;
+    const std::size_t ntasks = (npoints >= min_parallel_points ? max_parallel_tasks : 1);
+
+    parallel_for(plan.size(),
+                 ntasks,
+                 [&](std::size_t i)
+                 {
+                   auto& piece = plan[i];
+                   if (piece.points.size() >= 2)
+                     piece.cubics = fitWithCache(piece.points, cache, piece.closed);
+                 });
+
     std::string out;
-    writeBezierSvg(out, &geom, box, rfactor, decimals, cache);
+    for (const auto& piece : plan)
+    {
+      Fmi::BezierFit::appendBezierSvg(out, piece.cubics, piece.moveTo, false, decimals);
+      if (piece.close)
+        out += 'Z';
+    }
     return out;
   }
   catch (...)
@@ -676,6 +1101,7 @@ std::size_t IsolineFilter::hash_value() const
     {
       Fmi::hash_combine(hash, Fmi::hash_value(m_validateTries));
       Fmi::hash_combine(hash, Fmi::hash_value(static_cast<int>(m_validateBisect)));
+      Fmi::hash_combine(hash, Fmi::hash_value(static_cast<int>(m_validateLocal)));
     }
     return hash;
   }
@@ -35,6 +35,9 @@ class IsolineFilter
   void init(Json::Value& theJson);
   std::size_t hash_value() const;
 
+  // Size the helper thread budget shared by all filters (0 = single threaded)
+  static void setWorkerThreads(unsigned int theThreads);
+
   void bbox(const Fmi::Box& box);
   void apply(std::vector<OGRGeometryPtr>& geoms, bool preserve_topology);
 
@@ -46,7 +49,8 @@ class IsolineFilter
   // The box transforms from projection to pixel coordinates.
   // The cache shares fitted cubics between adjacent isobands (and any
   // isolines that overlay them) so shared edges are bit-identical and
-  // gap-free. Pass nullptr to fit without caching.
+  // gap-free. Pass nullptr to fit without caching. Large geometries are
+  // fitted in parallel, the output does not depend on the scheduling.
   std::string toBezierSvg(const OGRGeometry& geom,
                           const Fmi::Box& box,
                           double precision,
@@ -56,17 +60,20 @@ class IsolineFilter
   Fmi::GeometrySmoother smoother;
 
   // Adaptive validity backoff settings (enabled by default; set "validate":false
-  // to turn off). When enabled, after smoothing we test geometry validity and,
-  // if any isoband self-intersects (which makes it invalid for clipping),
-  // re-smooth the whole set at a halved radius until every geometry is valid.
-  // Re-smoothing the whole set keeps the shared edges between adjacent isobands
-  // coherent (gap-free), unlike a per-band repair such as MakeValid. Falls back
-  // to the unsmoothed (and thus simple) input if no valid radius is found within
-  // the budget. Only active when a smoothing filter is configured, so no
-  // validity check is done on unsmoothed geometry.
+  // to turn off). When enabled, after smoothing we test geometry validity in
+  // parallel and, if any isoband self-intersects (which makes it invalid for
+  // clipping), re-smooth the offending polygons and the edges they share with
+  // their neighbours at a halved radius until every geometry is valid. The
+  // vertices are selected identically on both sides of a shared edge, so the
+  // edges stay coherent (gap-free), unlike a per-band repair such as MakeValid.
+  // With "local":false the whole set is re-smoothed instead. Falls back to the
+  // unsmoothed (and thus simple) input if no valid radius is found within the
+  // budget. Only active when a smoothing filter is configured, so no validity
+  // check is done on unsmoothed geometry.
   bool m_validate = true;
   int m_validateTries = 4;       // max halvings before giving up
   bool m_validateBisect = true;  // one step back towards a larger valid radius
+  bool m_validateLocal = true;   // re-smooth only the offending polygons
   bool m_validateDebug = false;  // log when a backoff fires
 
   // Smoother parameters retained so the adaptive path can drive a private trial
@@ -81,6 +88,15 @@ class IsolineFilter
   double m_lambda = 0.5;
   double m_mu = -0.53;
 
+  Fmi::GeometrySmoother trialSmoother(double radius) const;
+  bool backoffLocally(std::vector<OGRGeometryPtr>& geoms,
+                      const std::vector<OGRGeometryPtr>& original,
+                      const std::vector<std::size_t>& bad,
+                      bool preserve_topology) const;
+  void backoffGlobally(std::vector<OGRGeometryPtr>& geoms,
+                       const std::vector<OGRGeometryPtr>& original,
+                       bool preserve_topology) const;
+
   // Bezier fitting settings
   double m_bezierAccuracy = 0;  // 0 = disabled; accuracy in pixels
   int m_bezierMaxDepth = 10;
@@ -99,27 +115,32 @@ class IsolineFilter
       BezierCache* cache,
       bool closed = false) const;
 
+  // A polyline to be fitted during Bezier SVG export and how to write it.
+  // Pieces without points only append the closing 'Z' of a ring.
+  struct BezierPiece
+  {
+    std::vector<Fmi::BezierFit::Point> points;
+    std::vector<Fmi::BezierFit::CubicBez> cubics;
+    bool closed = false;  // fit as a closed ring
+    bool moveTo = true;   // start a new subpath
+    bool close = false;   // close the subpath after this piece
+  };
+
   // Internal helpers for Bezier SVG export
-  void writeBezierLineStringSvg(std::string& out,
-                                const OGRLineString* geom,
-                                const Fmi::Box& box,
-                                double rfactor,
-                                int decimals,
-                                BezierCache* cache) const;
-
-  void writeBezierLinearRingSvg(std::string& out,
-                                const OGRLinearRing* geom,
-                                const Fmi::Box& box,
-                                double rfactor,
-                                int decimals,
-                                BezierCache* cache) const;
-
-  void writeBezierSvg(std::string& out,
-                      const OGRGeometry* geom,
-                      const Fmi::Box& box,
-                      double rfactor,
-                      int decimals,
-                      BezierCache* cache) const;
+  void planBezierLineString(std::vector<BezierPiece>& plan,
+                            const OGRLineString* geom,
+                            const Fmi::Box& box,
+                            double rfactor) const;
+
+  void planBezierLinearRing(std::vector<BezierPiece>& plan,
+                            const OGRLinearRing* geom,
+                            const Fmi::Box& box,
+                            double rfactor) const;
+
+  void planBezierSvg(std::vector<BezierPiece>& plan,
+                     const OGRGeometry* geom,
+                     const Fmi::Box& box,
+                     double rfactor) const;
 };
 
 }  // namespace Dali
@@ -712,8 +712,8 @@ std::vector<OGRGeometryPtr> IsolineLayer::getIsolinesQuerydata(const std::vector
     if (!q)
       throw Fmi::Exception(BCP, "Cannot resample without gridded data");
 
-    q = q->sample(
-        param, valid_time, crs, box.xmin(), box.ymin(), box.xmax(), box.ymax(), *sampleresolution);
+    q = theState.getSampleCache().sample(
+        q, param, valid_time, paraminfo.level, crs, box, *sampleresolution);
   }
 
   if (!q)
@@ -804,6 +804,34 @@ std::vector<OGRGeometryPtr> IsolineLayer::getIsolinesQuerydata(const std::vector
   auto valueshash = qhash;
   Fmi::hash_combine(valueshash, options.data_hash_value());
 
+  // Isolabel layers and other isoline layers of the product often contour the same field
+
+  auto contourhash = valueshash;
+  Fmi::hash_combine(contourhash, Fmi::hash_value(std::string("isolines")));
+  Fmi::hash_combine(contourhash, crs.hashValue());
+  Fmi::hash_combine(contourhash, box.hashValue());
+  Fmi::hash_combine(contourhash, clipbox.hashValue());
+  for (auto value : isovalues)
+    Fmi::hash_combine(contourhash, Fmi::hash_value(value));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(paraminfo.level));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(multiplier));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(offset));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(sampleresolution));
+  Fmi::hash_combine(contourhash, Dali::hash_value(smoother, theState));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(interpolation));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(extrapolation));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(options.minarea));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(strict));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(validate));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(desliver));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(subdivide));
+  Fmi::hash_combine(contourhash, Fmi::hash_value(subdivide_min_cell_pixels));
+  if (tfp_mode)
+    ComputedFields::hashTfpOptions(contourhash, *tfp);
+
+  if (auto cached = theState.findContours(contourhash))
+    return *cached;
+
   const auto& qEngine = theState.getQEngine();
   auto matrix = qEngine.getValues(q, options.parameter, valueshash, options.time);
 
@@ -847,6 +875,7 @@ std::vector<OGRGeometryPtr> IsolineLayer::getIsolinesQuerydata(const std::vector
     options.subdivide = effective_subdivide(subdivide, subdivide_min_cell_pixels, *coords, box);
 
   auto geoms = contourer.contour(qhash, crs, *matrix, *coords, clipbox, options);
+  theState.insertContours(contourhash, geoms);
 
   return geoms;
 }
@@ -952,7 +981,7 @@ void IsolineLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Stat
         if (pointCoordinates.empty())
         {
           pointCoordinates = Geometry::toString(*geom,
-                                                theState.getType(),
+                                                theState,
                                                 box,
                                                 crs,
                                                 precision,
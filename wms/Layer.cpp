@@ -807,34 +807,49 @@ void Layer::getQuerydataValue(CTPP::CDT& theInfo, const State& theState)
       return;
     auto [lon, lat] = *lonlat;
 
-    std::shared_ptr<Fmi::TimeFormatter> timeformatter(Fmi::TimeFormatter::create("iso"));
-    Fmi::LocalDateTime localdatetime(valid_time, Fmi::TimeZonePtr::utc);
-    auto mylocale = std::locale::classic();
-    NFmiPoint dummy;
-
-    Spine::Location loc(lon, lat);
-    Engine::Querydata::ParameterOptions options(param_funcs.parameter,
-                                                "",
-                                                loc,
-                                                "",
-                                                "",
-                                                *timeformatter,
-                                                "",
-                                                "",
-                                                mylocale,
-                                                "",
-                                                false,
-                                                0,
-                                                dummy);
-
-    TS::Value result =
-        AggregationUtility::get_qengine_value(q, options, localdatetime, param_funcs);
+    // Other layers may already have probed the same field at this point and time
+    auto probe_hash = Engine::Querydata::hash_value(q);
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.parameter));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.level));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(lon));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(lat));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(valid_time));
 
     double value = std::numeric_limits<double>::quiet_NaN();
-    if (const double* tmp = std::get_if<double>(&result))
-      value = *tmp;
-    else if (const int* ptr = std::get_if<int>(&result))
-      value = *ptr;
+    if (auto probed = theState.findPointValue(probe_hash))
+      value = *probed;
+    else
+    {
+      std::shared_ptr<Fmi::TimeFormatter> timeformatter(Fmi::TimeFormatter::create("iso"));
+      Fmi::LocalDateTime localdatetime(valid_time, Fmi::TimeZonePtr::utc);
+      auto mylocale = std::locale::classic();
+      NFmiPoint dummy;
+
+      Spine::Location loc(lon, lat);
+      Engine::Querydata::ParameterOptions options(param_funcs.parameter,
+                                                  "",
+                                                  loc,
+                                                  "",
+                                                  "",
+                                                  *timeformatter,
+                                                  "",
+                                                  "",
+                                                  mylocale,
+                                                  "",
+                                                  false,
+                                                  0,
+                                                  dummy);
+
+      TS::Value result =
+          AggregationUtility::get_qengine_value(q, options, localdatetime, param_funcs);
+
+      if (const double* tmp = std::get_if<double>(&result))
+        value = *tmp;
+      else if (const int* ptr = std::get_if<int>(&result))
+        value = *ptr;
+
+      theState.insertPointValue(probe_hash, value);
+    }
 
     value = multiplier.value_or(1.0) * value + offset.value_or(0.0);
 
@@ -934,6 +949,47 @@ void Layer::getGridValue(CTPP::CDT& theInfo, const State& theState)
       return;
     auto [lon, lat] = *lonlat;
 
+    auto set_feature_info = [&](double value)
+    {
+      if (value == kFloatMissing)
+        value = std::numeric_limits<double>::quiet_NaN();
+      value = multiplier.value_or(1.0) * value + offset.value_or(0.0);
+
+      theInfo["time"] = Fmi::to_iso_string(valid_time);
+      theInfo["features"][paraminfo.parameter] = value;
+      const auto label = getLegendLabelText(value, theState);
+      if (!label.empty())
+        theInfo["features"][paraminfo.parameter + "_label"] = "\"" + label + "\"";
+      theInfo["longitude"] = std::round(lon * 1e5) / 1e5;
+      theInfo["latitude"] = std::round(lat * 1e5) / 1e5;
+    };
+
+    // Other layers may already have probed the same field at this point and time
+    auto probe_hash = Fmi::hash_value(producerName);
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.parameter));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.level));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.levelId));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.pressure));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.elevation_unit));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.geometryId));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.forecastType));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(paraminfo.forecastNumber));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(origintime));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(valid_time));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(wkt));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(box.xmin()));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(box.ymin()));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(box.xmax()));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(box.ymax()));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(theInfo["x"].GetFloat()));
+    Fmi::hash_combine(probe_hash, Fmi::hash_value(theInfo["y"].GetFloat()));
+
+    if (auto probed = theState.findPointValue(probe_hash))
+    {
+      set_feature_info(*probed);
+      return;
+    }
+
     T::Coordinate_vec coordinates;
     coordinates.emplace_back(lon, lat);
     originalGridQuery->mAreaCoordinates.push_back(coordinates);
@@ -1010,18 +1066,9 @@ void Layer::getGridValue(CTPP::CDT& theInfo, const State& theState)
     if (pointvalues.empty())
       return;
 
-    double value = pointvalues.front()[0];
-    if (value == kFloatMissing)
-      value = std::numeric_limits<double>::quiet_NaN();
-    value = multiplier.value_or(1.0) * value + offset.value_or(0.0);
-
-    theInfo["time"] = Fmi::to_iso_string(valid_time);
-    theInfo["features"][paraminfo.parameter] = value;
-    const auto label = getLegendLabelText(value, theState);
-    if (!label.empty())
-      theInfo["features"][paraminfo.parameter + "_label"] = "\"" + label + "\"";
-    theInfo["longitude"] = std::round(lon * 1e5) / 1e5;
-    theInfo["latitude"] = std::round(lat * 1e5) / 1e5;
+    const double value = pointvalues.front()[0];
+    theState.insertPointValue(probe_hash, value);
+    set_feature_info(value);
   }
   catch (...)
   {
@@ -1119,6 +1166,29 @@ std::size_t Layer::hash_value(const State& theState) const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hash the observations used by the layer
+ *
+ * Combined with the rest of the layer hash this allows caching the layer
+ * until new observations arrive for the valid time period.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t Layer::observationHash(const State& theState) const
+{
+  try
+  {
+    const auto producer =
+        (paraminfo.producer ? *paraminfo.producer : theState.getConfig().defaultModel());
+    return theState.getObservationHash(producer, getValidTimePeriod());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 bool Layer::isFlashOrMobileProducer(const std::string& producer)
 {
   return (producer == "flash" || producer == "roadcloud" || producer == "netatmo");
@@ -172,6 +172,9 @@ class Layer : public Properties
  protected:
   void getFeatureValue(CTPP::CDT& theInfo, const State& theState);
 
+  // Hash of the observations used by the layer, bad_hash if they cannot be cached
+  std::size_t observationHash(const State& theState) const;
+
   // Convert a pixel coordinate in theInfo["x"]/["y"] to WGS84 lon/lat.
   // Returns nullopt if the transformation fails.
   std::optional<std::pair<double, double>> pixel_to_lonlat(const CTPP::CDT& theInfo,
@@ -2,6 +2,7 @@
 #include "Hash.h"
 #include "Layer.h"
 #include "LayerFactory.h"
+#include "Timing.h"
 #include <ctpp2/CDT.hpp>
 #include <fmt/format.h>
 #include <macgyver/Exception.h>
@@ -16,6 +17,15 @@ namespace Dali
 namespace
 {
 
+// Layer spans are tagged by layer type and producer
+std::string timing_tag(const Layer& theLayer)
+{
+  std::string tag = (theLayer.type ? *theLayer.type : std::string("layer"));
+  if (theLayer.paraminfo.producer)
+    tag += ":" + *theLayer.paraminfo.producer;
+  return tag;
+}
+
 // GetLegendGraphic requests may create null elements which are meaningless for validation
 
 void remove_null_members(Json::Value& json)
@@ -257,7 +267,10 @@ void Layers::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State& the
           // if (layer->projection.projectionParameter)
           //  std::cout << "  PARAM : " << *layer->projection.projectionParameter << "\n";
 
-          layer->generate(theGlobals, theLayersCdt, theState);
+          {
+            Timing::ScopedSpan span("layer", timing_tag(*layer));
+            layer->generate(theGlobals, theLayersCdt, theState);
+          }
 
           if (layer->projection.projectionParameter && !projection.projectionParameter)
             projection.projectionParameter = *layer->projection.projectionParameter;
@@ -295,6 +308,21 @@ void Layers::getFeatureInfo(CTPP::CDT& theInfo, const State& theState)
     layer->getFeatureInfo(theInfo, theState);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move the valid times of the layers and their sublayers
+ */
+// ----------------------------------------------------------------------
+
+void Layers::shiftValidTime(const Fmi::TimeDuration& theOffset)
+{
+  for (const auto& layer : layers)
+  {
+    layer->shiftValidTime(theOffset);
+    layer->layers.shiftValidTime(theOffset);
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Hash value = combined hash from all layers
@@ -10,6 +10,7 @@
 #include "Projection.h"
 #include "Warnings.h"
 #include <json/json.h>
+#include <macgyver/DateTime.h>
 #include <list>
 #include <memory>
 
@@ -41,6 +42,7 @@ class Layers
 
   void generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State& theState);
   void getFeatureInfo(CTPP::CDT& theInfo, const State& theState);
+  void shiftValidTime(const Fmi::TimeDuration& theOffset);
 
   bool getProjection(CTPP::CDT& theGlobals,
                      CTPP::CDT& theLayersCdt,
@@ -0,0 +1,132 @@
+#include "LocationIndex.h"
+#include <engines/geonames/Engine.h>
+#include <gis/CoordinateTransformation.h>
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+std::vector<PointIndex::Point> project(const std::vector<Spine::LocationPtr>& theLocations,
+                                       const Fmi::SpatialReference& theCRS)
+{
+  std::vector<double> x;
+  std::vector<double> y;
+  x.reserve(theLocations.size());
+  y.reserve(theLocations.size());
+  for (const auto& location : theLocations)
+  {
+    x.push_back(location->longitude);
+    y.push_back(location->latitude);
+  }
+
+  // Points which cannot be projected become non-finite and are left out of the index
+  Fmi::CoordinateTransformation transformation("WGS84", theCRS);
+  transformation.transform(x, y);
+
+  std::vector<PointIndex::Point> points;
+  points.reserve(x.size());
+  for (std::size_t i = 0; i < x.size(); i++)
+    points.push_back({x[i], y[i]});
+  return points;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Project sorted locations and index them
+ */
+// ----------------------------------------------------------------------
+
+LocationIndex::LocationIndex(const Spine::LocationList& theLocations,
+                             const Fmi::SpatialReference& theCRS)
+    : itsLocations(theLocations.begin(), theLocations.end())
+{
+  try
+  {
+    itsIndex = PointIndex(project(itsLocations, theCRS));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Approximate memory used by the index and the locations
+ */
+// ----------------------------------------------------------------------
+
+std::size_t LocationIndex::memory() const
+{
+  std::size_t bytes = itsIndex.memory();
+  for (const auto& location : itsLocations)
+    bytes += sizeof(Spine::LocationPtr) + sizeof(Spine::Location) + location->name.size() +
+             location->area.size() + location->feature.size();
+  return bytes;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the memory limit
+ */
+// ----------------------------------------------------------------------
+
+void LocationIndexCache::init(std::size_t theMaxBytes)
+{
+  itsMaxBytes = theMaxBytes;
+  itsCache.resize(theMaxBytes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the sorted locations of a keyword projected to the CRS
+ */
+// ----------------------------------------------------------------------
+
+LocationIndexPtr LocationIndexCache::get(const Engine::Geonames::Engine& theEngine,
+                                         const std::string& theKeyword,
+                                         const Fmi::SpatialReference& theCRS)
+{
+  try
+  {
+    // The autocomplete sort gives a good priority order for the locations
+    auto build = [&]()
+    {
+      Locus::QueryOptions options;
+      auto locations = theEngine.keywordSearch(options, theKeyword);
+      theEngine.sort(locations);
+      return std::make_shared<const LocationIndex>(locations, theCRS);
+    };
+
+    if (itsMaxBytes == 0)
+      return build();
+
+    auto hash = theEngine.hash_value();
+    Fmi::hash_combine(hash, Fmi::hash_value(theKeyword));
+    Fmi::hash_combine(hash, theCRS.hashValue());
+
+    // Concurrent requests for the same keyword wait for the first one to build the index
+    return itsCache.getOrCompute(hash,
+                                 [&]()
+                                 {
+                                   auto index = build();
+                                   return std::make_pair(index, index->memory());
+                                 });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("keyword", theKeyword);
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,104 @@
+// ======================================================================
+/*!
+ * \brief Process-wide cache of projected keyword location sets
+ *
+ * Location layers search all the locations of a keyword from geonames,
+ * sort them by priority and project them to the map for every request.
+ * For keywords covering the whole world this takes most of the time
+ * spent rendering a tile, even though only a few locations end up on it.
+ *
+ * Here the sorted locations of a keyword are projected once per
+ * spatial reference and indexed with a quadtree, so that a request only
+ * looks at the locations inside its own bounding box. The hash of the
+ * geonames data is part of the key, so the sets are rebuilt after the
+ * engine reloads its data and the old ones are evicted as they age.
+ *
+ * Concurrent requests for the same set wait for the first one instead
+ * of building the set again.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "MemoryLimitedCache.h"
+#include "PointIndex.h"
+#include <gis/SpatialReference.h>
+#include <spine/Location.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Geonames
+{
+class Engine;
+}
+}  // namespace Engine
+
+namespace Plugin
+{
+namespace Dali
+{
+// Locations of a keyword in priority order and their projected coordinates
+class LocationIndex
+{
+ public:
+  LocationIndex(const Spine::LocationList& theLocations, const Fmi::SpatialReference& theCRS);
+
+  bool empty() const { return itsLocations.empty(); }
+  std::size_t size() const { return itsLocations.size(); }
+
+  const Spine::LocationPtr& location(std::size_t theIndex) const
+  {
+    return itsLocations[theIndex];
+  }
+
+  // Coordinates in the spatial reference of the index
+  const PointIndex::Point& point(std::size_t theIndex) const { return itsIndex.point(theIndex); }
+
+  // Indices of the locations inside the rectangle in priority order
+  std::vector<uint32_t> query(double theX1, double theY1, double theX2, double theY2) const
+  {
+    return itsIndex.query(theX1, theY1, theX2, theY2);
+  }
+
+  std::size_t memory() const;
+
+ private:
+  std::vector<Spine::LocationPtr> itsLocations;
+  PointIndex itsIndex;
+};
+
+using LocationIndexPtr = std::shared_ptr<const LocationIndex>;
+
+class LocationIndexCache
+{
+ public:
+  using Statistics = MemoryLimitedCache<LocationIndexPtr>::Statistics;
+
+  LocationIndexCache() = default;
+  LocationIndexCache(const LocationIndexCache&) = delete;
+  LocationIndexCache& operator=(const LocationIndexCache&) = delete;
+
+  // 0 bytes disables caching
+  void init(std::size_t theMaxBytes);
+
+  // Sorted and projected locations of the keyword
+  LocationIndexPtr get(const Engine::Geonames::Engine& theEngine,
+                       const std::string& theKeyword,
+                       const Fmi::SpatialReference& theCRS);
+
+  Statistics statistics() const { return itsCache.statistics(); }
+
+ private:
+  std::size_t itsMaxBytes = 0;
+
+  MemoryLimitedCache<LocationIndexPtr> itsCache;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -386,9 +386,6 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
     const auto& crs = projection.getCRS();
     const auto& box = projection.getBox();
 
-    // Create the coordinate transformation from geonames coordinates to image coordinates
-    Fmi::CoordinateTransformation transformation("WGS84", crs);
-
     // Update the globals
     if (css)
     {
@@ -396,14 +393,11 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
       theGlobals["css"][name] = theState.getStyle(*css);
     }
 
-    // Read the data from geonames. We use autocomplete mode to get a good
-    // prioritized sort for the locations.
-    const auto& engine = theState.getGeoEngine();
-    Locus::QueryOptions options;
-    auto locations = engine.keywordSearch(options, keyword);
-    engine.sort(locations);
+    // The sorted locations of the keyword projected to the map CRS, shared by all requests
+    const auto index =
+        theState.getLocationIndexCache().get(theState.getGeoEngine(), keyword, crs);
 
-    if (locations.empty())
+    if (index->empty())
       throw Fmi::Exception(BCP, "No locations found for keyword '" + keyword + "'");
 
     // Clip if necessary
@@ -415,6 +409,12 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
     //         filtering from symbol/label emission so label placement
     //         can see the full set before any SVG is written.
     //
+    // The candidates come from a range query on the projected location
+    // index, so large keyword sets (e.g. 200k world locations) cost
+    // only as much as the locations near the image.  The query returns
+    // the locations in priority order, which the mindistance filter
+    // and the placement algorithms rely on.
+    //
     // pan_invariant mode:
     //   The strict-bbox filter is replaced with a *margin-extended*
     //   bbox.  Cities whose anchors lie outside the visible bbox but
@@ -422,9 +422,6 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
     //   that visible cities see the same neighbours regardless of how
     //   the request bbox is shifted (panning).  At render time we
     //   skip elements whose anchor is outside the original bbox.
-    //   For large keyword sets (e.g. 200k world locations) we add a
-    //   WGS84 prefilter so we don't pay for projecting points that
-    //   are obviously outside the buffered region.
     // ----------------------------------------------------------------
 
     // Buffered image bbox (in image pixel coords).  When pan_invariant
@@ -448,51 +445,13 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
     const double bx2 = static_cast<double>(box.width()) + margin;
     const double by2 = static_cast<double>(box.height()) + margin;
 
-    // WGS84 prefilter: inverse-project a few sample points along the
-    // buffered image bbox edge to estimate a (possibly loose) WGS84
-    // rectangle.  Then a cheap lon/lat box check can drop most of a
-    // 200k-entry keyword list before we pay for the full projection.
-    // Disabled when pan_invariant is off (the existing strict-bbox
-    // filter happens after projection like before).
-    bool wgs84_prefilter_active = false;
-    double lon_min = 0, lon_max = 0, lat_min = 0, lat_max = 0;
-    bool lon_wraps = false;
-    if (pan_invariant)
-    {
-      Fmi::CoordinateTransformation invtransformation(crs, "WGS84");
-      // Sample 12 points around the buffered bbox boundary.  Four
-      // corners plus midpoints of each edge handles the bow-shaped
-      // distortion of most projections; doesn't cover poles correctly
-      // but does cover everything else with a slight overestimate
-      // that is fine for a prefilter.
-      std::vector<double> sx{bx1, bx2, bx1, bx2,
-                             (bx1 + bx2) / 2, (bx1 + bx2) / 2,
-                             bx1, bx2,
-                             (bx1 + 3 * bx2) / 4, (3 * bx1 + bx2) / 4,
-                             (bx1 + 3 * bx2) / 4, (3 * bx1 + bx2) / 4};
-      std::vector<double> sy{by1, by1, by2, by2,
-                             by1, by2,
-                             (by1 + by2) / 2, (by1 + by2) / 2,
-                             by1, by1, by2, by2};
-      for (size_t i = 0; i < sx.size(); i++)
-        box.itransform(sx[i], sy[i]);  // image px → CRS
-      invtransformation.transform(sx, sy);  // CRS → WGS84
-      lon_min = lon_max = sx[0];
-      lat_min = lat_max = sy[0];
-      for (size_t i = 1; i < sx.size(); i++)
-      {
-        if (sx[i] < lon_min) lon_min = sx[i];
-        if (sx[i] > lon_max) lon_max = sx[i];
-        if (sy[i] < lat_min) lat_min = sy[i];
-        if (sy[i] > lat_max) lat_max = sy[i];
-      }
-      // If the buffered region spans more than ~180° of longitude we
-      // are most likely viewing a hemispheric / world projection where
-      // the four-corner inverse projects to a wrap-crossing rectangle.
-      // Disable longitude prefilter in that case.
-      lon_wraps = (lon_max - lon_min) > 180.0;
-      wgs84_prefilter_active = true;
-    }
+    // The same bbox in map CRS coordinates for the index query
+    double qx1 = bx1;
+    double qy1 = by1;
+    double qx2 = bx2;
+    double qy2 = by2;
+    box.itransform(qx1, qy1);
+    box.itransform(qx2, qy2);
 
     // Store only the fields needed for symbol selection and label placement;
     // this avoids taking a type dependency on the internal location list type.
@@ -510,21 +469,11 @@ void LocationLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Sta
 
     Fmi::NearTree<XY> selected_coordinates;
 
-    for (const auto& location : locations)
+    for (auto i : index->query(qx1, qy1, qx2, qy2))
     {
-      // WGS84 prefilter (cheap O(1) box check; runs once per location).
-      if (wgs84_prefilter_active)
-      {
-        if (location->latitude < lat_min || location->latitude > lat_max)
-          continue;
-        if (!lon_wraps &&
-            (location->longitude < lon_min || location->longitude > lon_max))
-          continue;
-      }
-
-      double x = location->longitude;
-      double y = location->latitude;
-      transformation.transform(x, y);
+      const auto& location = index->location(i);
+      double x = index->point(i).x;
+      double y = index->point(i).y;
       box.transform(x, y);
 
       // Buffered image bbox check.  When pan_invariant is off the
@@ -9,6 +9,7 @@
 #include "Select.h"
 #include "State.h"
 #include "StyleSheet.h"
+#include "Timing.h"
 #include <boost/timer/timer.hpp>
 #include <ctpp2/CDT.hpp>
 #include <engines/gis/Engine.h>
@@ -146,6 +147,7 @@ void MapLayer::generate_full_map(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt,
         std::string report = "getShape finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Timing::ScopedSpan span("data", "map");
       geom = gis.getShape(&crs, map.options);
 
       if (!geom)
@@ -162,6 +164,7 @@ void MapLayer::generate_full_map(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt,
         std::string report = "polyclip finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Timing::ScopedSpan span("clip", "map");
       geom.reset(geom->clone());
       Fmi::OGR::normalizeWindingOrder(geom.get());
 
@@ -211,7 +214,7 @@ void MapLayer::generate_full_map(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt,
       map_cdt["layertype"] = "map";
 
       pointCoordinates = Geometry::toString(*geom,
-                                            theState.getType(),
+                                            theState,
                                             box,
                                             crs,
                                             precision,
@@ -409,7 +412,7 @@ void MapLayer::generate_styled_map(CTPP::CDT& theGlobals,
       map_cdt["iri"] = iri;
       map_cdt["type"] = Geometry::name(*geom, theState.getType());
       map_cdt["layertype"] = "map";
-      map_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
+      map_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
 
       theGlobals["paths"][iri] = map_cdt;
 
@@ -0,0 +1,205 @@
+// ======================================================================
+/*!
+ * \brief LRU cache limited by the memory used by the values
+ *
+ * Fmi::Cache limits the number of objects, which does not work for
+ * values whose sizes vary by orders of magnitude. Here the caller
+ * gives the approximate size of each value on insertion, and the least
+ * recently used values are evicted until the total fits the limit.
+ * Values larger than the limit are not stored at all.
+ *
+ * The cache is thread safe. Values are returned by copy, so they should
+ * be cheap to copy (shared pointers or similar). Expensive values can be
+ * computed with getOrCompute, which makes concurrent requests for the
+ * same key wait for the first one instead of computing the value again.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+template <typename Value>
+class MemoryLimitedCache
+{
+ public:
+  struct Statistics
+  {
+    std::size_t maxsize = 0;  // bytes
+    std::size_t size = 0;     // bytes
+    std::size_t count = 0;    // values
+    std::size_t inserts = 0;
+    std::size_t evictions = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+  };
+
+  explicit MemoryLimitedCache(std::size_t theMaxBytes = 0) : itsMaxBytes(theMaxBytes) {}
+
+  MemoryLimitedCache(const MemoryLimitedCache&) = delete;
+  MemoryLimitedCache& operator=(const MemoryLimitedCache&) = delete;
+
+  void resize(std::size_t theMaxBytes)
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsMaxBytes = theMaxBytes;
+    evict();
+  }
+
+  std::optional<Value> find(std::size_t theKey)
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    auto pos = itsIndex.find(theKey);
+    if (pos == itsIndex.end())
+    {
+      ++itsMisses;
+      return {};
+    }
+    ++itsHits;
+    itsEntries.splice(itsEntries.begin(), itsEntries, pos->second);
+    return pos->second->value;
+  }
+
+  // Replaces any previous value with the same key
+  void insert(std::size_t theKey, Value theValue, std::size_t theBytes)
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto pos = itsIndex.find(theKey);
+    if (pos != itsIndex.end())
+    {
+      itsBytes -= pos->second->bytes;
+      itsEntries.erase(pos->second);
+      itsIndex.erase(pos);
+    }
+
+    if (theBytes > itsMaxBytes)
+      return;
+
+    itsEntries.push_front(Entry{theKey, std::move(theValue), theBytes});
+    itsIndex[theKey] = itsEntries.begin();
+    itsBytes += theBytes;
+    ++itsInserts;
+    evict();
+  }
+
+  // Return the cached value, or compute it once for all concurrent callers. The
+  // function returns the value and its size in bytes, values of zero bytes are
+  // not stored. Cached values rejected by the validator are computed again.
+  template <typename Compute, typename Validate>
+  Value getOrCompute(std::size_t theKey, Compute theCompute, Validate theValidate)
+  {
+    if (auto cached = find(theKey))
+    {
+      if (theValidate(*cached))
+        return *cached;
+    }
+
+    std::promise<Value> promise;
+    std::shared_future<Value> pending;
+    {
+      std::lock_guard<std::mutex> lock(itsPendingMutex);
+      auto pos = itsPending.find(theKey);
+      if (pos != itsPending.end())
+        pending = pos->second;
+      else
+        itsPending.emplace(theKey, promise.get_future().share());
+    }
+
+    if (pending.valid())
+      return pending.get();
+
+    try
+    {
+      auto result = theCompute();
+      if (result.second > 0)
+        insert(theKey, result.first, result.second);
+      promise.set_value(result.first);
+
+      std::lock_guard<std::mutex> lock(itsPendingMutex);
+      itsPending.erase(theKey);
+      return result.first;
+    }
+    catch (...)
+    {
+      promise.set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(itsPendingMutex);
+      itsPending.erase(theKey);
+      throw;
+    }
+  }
+
+  template <typename Compute>
+  Value getOrCompute(std::size_t theKey, Compute theCompute)
+  {
+    return getOrCompute(theKey, theCompute, [](const Value&) { return true; });
+  }
+
+  Statistics statistics() const
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    Statistics stats;
+    stats.maxsize = itsMaxBytes;
+    stats.size = itsBytes;
+    stats.count = itsEntries.size();
+    stats.inserts = itsInserts;
+    stats.evictions = itsEvictions;
+    stats.hits = itsHits;
+    stats.misses = itsMisses;
+    return stats;
+  }
+
+ private:
+  struct Entry
+  {
+    std::size_t key;
+    Value value;
+    std::size_t bytes;
+  };
+
+  // Caller must hold the lock
+  void evict()
+  {
+    while (itsBytes > itsMaxBytes && !itsEntries.empty())
+    {
+      const auto& last = itsEntries.back();
+      itsBytes -= last.bytes;
+      itsIndex.erase(last.key);
+      itsEntries.pop_back();
+      ++itsEvictions;
+    }
+  }
+
+  mutable std::mutex itsMutex;
+  std::size_t itsMaxBytes = 0;
+  std::size_t itsBytes = 0;
+  std::list<Entry> itsEntries;  // most recently used first
+  std::unordered_map<std::size_t, typename std::list<Entry>::iterator> itsIndex;
+
+  // Values being computed by getOrCompute
+  std::mutex itsPendingMutex;
+  std::map<std::size_t, std::shared_future<Value>> itsPending;
+
+  std::size_t itsInserts = 0;
+  std::size_t itsEvictions = 0;
+  std::size_t itsHits = 0;
+  std::size_t itsMisses = 0;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
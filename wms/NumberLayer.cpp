@@ -1055,12 +1055,17 @@ std::size_t NumberLayer::hash_value(const State& theState) const
 {
   try
   {
-    // Disable caching of observation layers
-    if (theState.isObservation(paraminfo.producer))
-      return Fmi::bad_hash;
-
     auto hash = Layer::hash_value(theState);
 
+    // Observation layers are cached only until new observations arrive
+    if (theState.isObservation(paraminfo.producer))
+    {
+      auto obshash = observationHash(theState);
+      if (obshash == Fmi::bad_hash)
+        return Fmi::bad_hash;
+      Fmi::hash_combine(hash, obshash);
+    }
+
     if (paraminfo.source != std::string("grid"))
     {
       auto q = getModel(theState);
@@ -425,7 +425,7 @@ void OSMLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State& t
         map_cdt["iri"] = iri;
         map_cdt["type"] = Geometry::name(*geom, theState.getType());
         map_cdt["layertype"] = "osm";
-        map_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
+        map_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
         theState.addPresentationAttributes(map_cdt, fs.css, fs.attributes);
         theGlobals["paths"][iri] = map_cdt;
 
@@ -464,7 +464,7 @@ void OSMLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State& t
           map_cdt["iri"] = iri;
           map_cdt["type"] = Geometry::name(*geom, theState.getType());
           map_cdt["layertype"] = "osm";
-          map_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
+          map_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
           theState.addPresentationAttributes(map_cdt, fs.css, fs.attributes);
           theGlobals["paths"][iri] = map_cdt;
 
@@ -0,0 +1,550 @@
+#include "PMTiles.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace PMTiles
+{
+namespace
+{
+// The root directory must fit with the header into the first 16 kB
+const std::size_t max_root_size = 16384 - header_size;
+
+// Number of entries in a leaf directory, doubled until the root fits
+const std::size_t initial_leaf_size = 4096;
+
+// Directories nest at most this deep
+const int max_depth = 4;
+
+void rotate(int64_t n, int64_t& x, int64_t& y, int64_t rx, int64_t ry)
+{
+  if (ry == 0)
+  {
+    if (rx == 1)
+    {
+      x = n - 1 - x;
+      y = n - 1 - y;
+    }
+    std::swap(x, y);
+  }
+}
+
+void write_varint(std::string& theOutput, uint64_t theValue)
+{
+  while (theValue >= 0x80)
+  {
+    theOutput.push_back(static_cast<char>((theValue & 0x7F) | 0x80));
+    theValue >>= 7;
+  }
+  theOutput.push_back(static_cast<char>(theValue));
+}
+
+uint64_t read_varint(std::string_view theData, std::size_t& thePos)
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (thePos >= theData.size())
+      throw Fmi::Exception(BCP, "Truncated PMTiles directory");
+    const auto byte = static_cast<uint8_t>(theData[thePos++]);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  throw Fmi::Exception(BCP, "Invalid varint in PMTiles directory");
+}
+
+template <typename T>
+void write_le(std::string& theOutput, T theValue)
+{
+  auto value = static_cast<uint64_t>(theValue);
+  for (std::size_t i = 0; i < sizeof(T); i++)
+  {
+    theOutput.push_back(static_cast<char>(value & 0xFF));
+    value >>= 8;
+  }
+}
+
+template <typename T>
+T read_le(std::string_view theData, std::size_t thePos)
+{
+  uint64_t value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(theData[thePos + i])) << (8 * i);
+  return static_cast<T>(value);
+}
+
+// Last entry whose tile id is <= theTileId
+const Entry* find_entry(const std::vector<Entry>& theEntries, uint64_t theTileId)
+{
+  auto pos = std::upper_bound(theEntries.begin(),
+                              theEntries.end(),
+                              theTileId,
+                              [](uint64_t id, const Entry& entry) { return id < entry.tile_id; });
+  if (pos == theEntries.begin())
+    return nullptr;
+  return &*(pos - 1);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Tile id of a tile: the tiles of lower zoom levels followed by the
+ *        Hilbert curve index within the zoom level
+ */
+// ----------------------------------------------------------------------
+
+uint64_t zxy_to_tileid(uint8_t z, uint32_t x, uint32_t y)
+{
+  if (z > 31)
+    throw Fmi::Exception(BCP, "PMTiles zoom level must be at most 31");
+
+  const int64_t n = 1LL << z;
+  if (x >= n || y >= n)
+    throw Fmi::Exception(BCP, "Tile coordinates out of range for the zoom level")
+        .addParameter("z", std::to_string(z))
+        .addParameter("x", std::to_string(x))
+        .addParameter("y", std::to_string(y));
+
+  uint64_t acc = ((1ULL << (2 * z)) - 1) / 3;
+  int64_t tx = x;
+  int64_t ty = y;
+  for (int64_t s = n / 2; s > 0; s /= 2)
+  {
+    const int64_t rx = (tx & s) > 0 ? 1 : 0;
+    const int64_t ry = (ty & s) > 0 ? 1 : 0;
+    acc += static_cast<uint64_t>(s * s * ((3 * rx) ^ ry));
+    rotate(n, tx, ty, rx, ry);
+  }
+  return acc;
+}
+
+void tileid_to_zxy(uint64_t theTileId, uint8_t& z, uint32_t& x, uint32_t& y)
+{
+  uint64_t acc = 0;
+  for (uint8_t zoom = 0; zoom < 32; zoom++)
+  {
+    const uint64_t count = 1ULL << (2 * zoom);
+    if (acc + count > theTileId)
+    {
+      const int64_t n = 1LL << zoom;
+      auto t = static_cast<int64_t>(theTileId - acc);
+      int64_t tx = 0;
+      int64_t ty = 0;
+      for (int64_t s = 1; s < n; s *= 2)
+      {
+        const int64_t rx = 1 & (t / 2);
+        const int64_t ry = 1 & (t ^ rx);
+        rotate(s, tx, ty, rx, ry);
+        tx += s * rx;
+        ty += s * ry;
+        t /= 4;
+      }
+      z = zoom;
+      x = static_cast<uint32_t>(tx);
+      y = static_cast<uint32_t>(ty);
+      return;
+    }
+    acc += count;
+  }
+  throw Fmi::Exception(BCP, "PMTiles tile id out of range");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Directory encoding: entry count followed by columns of varints
+ *
+ * Tile ids are delta encoded, and an offset equal to the end of the
+ * previous entry is written as zero, other offsets as offset + 1.
+ */
+// ----------------------------------------------------------------------
+
+std::string serialize_directory(const std::vector<Entry>& theEntries)
+{
+  std::string out;
+  write_varint(out, theEntries.size());
+
+  uint64_t last_id = 0;
+  for (const auto& entry : theEntries)
+  {
+    write_varint(out, entry.tile_id - last_id);
+    last_id = entry.tile_id;
+  }
+  for (const auto& entry : theEntries)
+    write_varint(out, entry.run_length);
+  for (const auto& entry : theEntries)
+    write_varint(out, entry.length);
+  for (std::size_t i = 0; i < theEntries.size(); i++)
+  {
+    const auto& entry = theEntries[i];
+    if (i > 0 && entry.offset == theEntries[i - 1].offset + theEntries[i - 1].length)
+      write_varint(out, 0);
+    else
+      write_varint(out, entry.offset + 1);
+  }
+  return out;
+}
+
+std::vector<Entry> deserialize_directory(std::string_view theData)
+{
+  try
+  {
+    std::size_t pos = 0;
+    const auto n = read_varint(theData, pos);
+    if (n > theData.size())
+      throw Fmi::Exception(BCP, "Invalid PMTiles directory size");
+
+    std::vector<Entry> entries(n);
+
+    uint64_t last_id = 0;
+    for (auto& entry : entries)
+    {
+      last_id += read_varint(theData, pos);
+      entry.tile_id = last_id;
+    }
+    for (auto& entry : entries)
+      entry.run_length = static_cast<uint32_t>(read_varint(theData, pos));
+    for (auto& entry : entries)
+      entry.length = static_cast<uint32_t>(read_varint(theData, pos));
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const auto value = read_varint(theData, pos);
+      if (value == 0 && i > 0)
+        entries[i].offset = entries[i - 1].offset + entries[i - 1].length;
+      else if (value == 0)
+        throw Fmi::Exception(BCP, "Invalid first PMTiles directory offset");
+      else
+        entries[i].offset = value - 1;
+    }
+    return entries;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+
+std::string serialize_header(const Header& theHeader)
+{
+  std::string out = "PMTiles";
+  out.push_back(3);
+  write_le(out, theHeader.root_dir_offset);
+  write_le(out, theHeader.root_dir_length);
+  write_le(out, theHeader.metadata_offset);
+  write_le(out, theHeader.metadata_length);
+  write_le(out, theHeader.leaf_dirs_offset);
+  write_le(out, theHeader.leaf_dirs_length);
+  write_le(out, theHeader.tile_data_offset);
+  write_le(out, theHeader.tile_data_length);
+  write_le(out, theHeader.addressed_tiles_count);
+  write_le(out, theHeader.tile_entries_count);
+  write_le(out, theHeader.tile_contents_count);
+  write_le(out, static_cast<uint8_t>(theHeader.clustered ? 1 : 0));
+  write_le(out, static_cast<uint8_t>(theHeader.internal_compression));
+  write_le(out, static_cast<uint8_t>(theHeader.tile_compression));
+  write_le(out, static_cast<uint8_t>(theHeader.tile_type));
+  write_le(out, theHeader.min_zoom);
+  write_le(out, theHeader.max_zoom);
+  write_le(out, theHeader.min_lon_e7);
+  write_le(out, theHeader.min_lat_e7);
+  write_le(out, theHeader.max_lon_e7);
+  write_le(out, theHeader.max_lat_e7);
+  write_le(out, theHeader.center_zoom);
+  write_le(out, theHeader.center_lon_e7);
+  write_le(out, theHeader.center_lat_e7);
+  return out;
+}
+
+Header deserialize_header(std::string_view theData)
+{
+  if (theData.size() < header_size || theData.substr(0, 7) != "PMTiles")
+    throw Fmi::Exception(BCP, "Not a PMTiles archive");
+  if (theData[7] != 3)
+    throw Fmi::Exception(BCP, "Unsupported PMTiles version")
+        .addParameter("version", std::to_string(static_cast<int>(theData[7])));
+
+  Header h;
+  h.root_dir_offset = read_le<uint64_t>(theData, 8);
+  h.root_dir_length = read_le<uint64_t>(theData, 16);
+  h.metadata_offset = read_le<uint64_t>(theData, 24);
+  h.metadata_length = read_le<uint64_t>(theData, 32);
+  h.leaf_dirs_offset = read_le<uint64_t>(theData, 40);
+  h.leaf_dirs_length = read_le<uint64_t>(theData, 48);
+  h.tile_data_offset = read_le<uint64_t>(theData, 56);
+  h.tile_data_length = read_le<uint64_t>(theData, 64);
+  h.addressed_tiles_count = read_le<uint64_t>(theData, 72);
+  h.tile_entries_count = read_le<uint64_t>(theData, 80);
+  h.tile_contents_count = read_le<uint64_t>(theData, 88);
+  h.clustered = (theData[96] == 1);
+  h.internal_compression = static_cast<Compression>(theData[97]);
+  h.tile_compression = static_cast<Compression>(theData[98]);
+  h.tile_type = static_cast<TileType>(theData[99]);
+  h.min_zoom = read_le<uint8_t>(theData, 100);
+  h.max_zoom = read_le<uint8_t>(theData, 101);
+  h.min_lon_e7 = read_le<int32_t>(theData, 102);
+  h.min_lat_e7 = read_le<int32_t>(theData, 106);
+  h.max_lon_e7 = read_le<int32_t>(theData, 110);
+  h.max_lat_e7 = read_le<int32_t>(theData, 114);
+  h.center_zoom = read_le<uint8_t>(theData, 118);
+  h.center_lon_e7 = read_le<int32_t>(theData, 119);
+  h.center_lat_e7 = read_le<int32_t>(theData, 123);
+  return h;
+}
+
+// ----------------------------------------------------------------------
+
+Writer::Writer(TileType theType, Compression theCompression)
+    : itsType(theType), itsCompression(theCompression)
+{
+}
+
+void Writer::add(uint8_t z, uint32_t x, uint32_t y, const std::string& theData)
+{
+  try
+  {
+    const auto tile_id = zxy_to_tileid(z, x, y);
+    const auto hash = std::hash<std::string>{}(theData);
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    // Empty sea and land tiles are typically identical, store them once
+    auto range = itsContentHashes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (itsContents[it->second] == theData)
+      {
+        itsTiles[tile_id] = it->second;
+        return;
+      }
+    }
+
+    itsContents.push_back(theData);
+    itsContentHashes.emplace(hash, itsContents.size() - 1);
+    itsTiles[tile_id] = itsContents.size() - 1;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::size_t Writer::tiles() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  return itsTiles.size();
+}
+
+std::size_t Writer::write(const std::string& thePath, const std::string& theMetadata) const
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    // Lay out the contents in tile id order and merge runs of identical
+    // consecutive tiles into one entry
+
+    std::vector<uint64_t> offsets(itsContents.size(), UINT64_MAX);
+    std::vector<std::size_t> order;
+    uint64_t data_length = 0;
+
+    std::vector<Entry> entries;
+    for (const auto& [tile_id, index] : itsTiles)
+    {
+      if (offsets[index] == UINT64_MAX)
+      {
+        offsets[index] = data_length;
+        data_length += itsContents[index].size();
+        order.push_back(index);
+      }
+
+      if (!entries.empty())
+      {
+        auto& last = entries.back();
+        if (last.offset == offsets[index] && last.tile_id + last.run_length == tile_id)
+        {
+          ++last.run_length;
+          continue;
+        }
+      }
+
+      Entry entry;
+      entry.tile_id = tile_id;
+      entry.offset = offsets[index];
+      entry.length = static_cast<uint32_t>(itsContents[index].size());
+      entry.run_length = 1;
+      entries.push_back(entry);
+    }
+
+    // Split the directory into leaves until the root fits into the first 16 kB
+
+    std::string root = serialize_directory(entries);
+    std::string leaves;
+    for (std::size_t leaf_size = initial_leaf_size; root.size() > max_root_size; leaf_size *= 2)
+    {
+      leaves.clear();
+      std::vector<Entry> root_entries;
+      for (std::size_t i = 0; i < entries.size(); i += leaf_size)
+      {
+        const auto n = std::min(leaf_size, entries.size() - i);
+        std::vector<Entry> chunk(entries.begin() + i, entries.begin() + i + n);
+        auto leaf = serialize_directory(chunk);
+
+        Entry entry;
+        entry.tile_id = chunk.front().tile_id;
+        entry.offset = leaves.size();
+        entry.length = static_cast<uint32_t>(leaf.size());
+        entry.run_length = 0;
+        root_entries.push_back(entry);
+
+        leaves += leaf;
+      }
+      root = serialize_directory(root_entries);
+    }
+
+    Header header;
+    header.root_dir_offset = header_size;
+    header.root_dir_length = root.size();
+    header.metadata_offset = header.root_dir_offset + header.root_dir_length;
+    header.metadata_length = theMetadata.size();
+    header.leaf_dirs_offset = header.metadata_offset + header.metadata_length;
+    header.leaf_dirs_length = leaves.size();
+    header.tile_data_offset = header.leaf_dirs_offset + header.leaf_dirs_length;
+    header.tile_data_length = data_length;
+    header.addressed_tiles_count = itsTiles.size();
+    header.tile_entries_count = entries.size();
+    header.tile_contents_count = itsContents.size();
+    header.clustered = true;
+    header.internal_compression = Compression::None;
+    header.tile_compression = itsCompression;
+    header.tile_type = itsType;
+
+    if (!itsTiles.empty())
+    {
+      uint8_t z = 0;
+      uint32_t x = 0;
+      uint32_t y = 0;
+      tileid_to_zxy(itsTiles.begin()->first, z, x, y);
+      header.min_zoom = z;
+      header.center_zoom = z;
+      tileid_to_zxy(itsTiles.rbegin()->first, z, x, y);
+      header.max_zoom = z;
+    }
+
+    // Write to a temporary file first so that readers never see a partial archive
+
+    const auto tmp = thePath + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw Fmi::Exception(BCP, "Failed to open PMTiles archive for writing")
+            .addParameter("path", tmp);
+
+      out << serialize_header(header) << root << theMetadata << leaves;
+      for (auto index : order)
+        out << itsContents[index];
+
+      if (!out)
+        throw Fmi::Exception(BCP, "Failed to write PMTiles archive").addParameter("path", tmp);
+    }
+    std::filesystem::rename(tmp, thePath);
+
+    return header.tile_data_offset + header.tile_data_length;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("path", thePath);
+  }
+}
+
+// ----------------------------------------------------------------------
+
+Archive::Archive(const std::string& thePath) : itsPath(thePath)
+{
+  try
+  {
+    itsFile.open(thePath);
+    if (!itsFile.is_open())
+      throw Fmi::Exception(BCP, "Failed to open PMTiles archive");
+
+    itsHeader = deserialize_header(view(0, header_size));
+    if (itsHeader.internal_compression != Compression::None &&
+        itsHeader.internal_compression != Compression::Unknown)
+      throw Fmi::Exception(BCP, "Compressed PMTiles directories are not supported");
+
+    itsRoot =
+        deserialize_directory(view(itsHeader.root_dir_offset, itsHeader.root_dir_length));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("path", thePath);
+  }
+}
+
+std::string_view Archive::view(uint64_t theOffset, uint64_t theLength) const
+{
+  if (theOffset > itsFile.size() || theLength > itsFile.size() - theOffset)
+    throw Fmi::Exception(BCP, "PMTiles archive section is out of bounds");
+  return {itsFile.data() + theOffset, theLength};
+}
+
+std::string_view Archive::metadata() const
+{
+  return view(itsHeader.metadata_offset, itsHeader.metadata_length);
+}
+
+const std::vector<Entry>& Archive::leaf(uint64_t theOffset, uint64_t theLength) const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  auto pos = itsLeaves.find(theOffset);
+  if (pos == itsLeaves.end())
+  {
+    auto data = view(itsHeader.leaf_dirs_offset + theOffset, theLength);
+    pos = itsLeaves.emplace(theOffset, deserialize_directory(data)).first;
+  }
+  return pos->second;
+}
+
+std::optional<std::string_view> Archive::tile(uint64_t theTileId) const
+{
+  try
+  {
+    const auto* entries = &itsRoot;
+    for (int depth = 0; depth < max_depth; depth++)
+    {
+      const auto* entry = find_entry(*entries, theTileId);
+      if (entry == nullptr)
+        return {};
+
+      if (entry->run_length > 0)
+      {
+        if (theTileId >= entry->tile_id + entry->run_length)
+          return {};
+        return view(itsHeader.tile_data_offset + entry->offset, entry->length);
+      }
+
+      entries = &leaf(entry->offset, entry->length);
+    }
+    return {};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("path", itsPath);
+  }
+}
+
+}  // namespace PMTiles
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
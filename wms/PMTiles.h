@@ -0,0 +1,179 @@
+// ======================================================================
+/*!
+ * \brief PMTiles version 3 archive writer and reader
+ *
+ * A PMTiles archive is a single file holding a tile pyramid: a fixed
+ * header, a root directory, JSON metadata, optional leaf directories and
+ * the tile contents. Tiles are addressed by a tile id which enumerates
+ * the zoom levels in order and the tiles within a zoom level along a
+ * Hilbert curve, so that nearby tiles are also near each other in the
+ * file.
+ *
+ * The writer collects the tiles in memory, stores identical tile
+ * contents only once and writes the archive without internal
+ * compression. The reader memory maps the archive and returns views to
+ * the tile contents without copying them.
+ *
+ * Specification: https://github.com/protomaps/PMTiles/blob/main/spec/v3/spec.md
+ */
+// ======================================================================
+
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace PMTiles
+{
+// Tile content types and compressions used in the header
+enum class TileType : uint8_t
+{
+  Unknown = 0,
+  MVT = 1,
+  PNG = 2,
+  JPEG = 3,
+  WEBP = 4,
+  AVIF = 5
+};
+
+enum class Compression : uint8_t
+{
+  Unknown = 0,
+  None = 1,
+  Gzip = 2,
+  Brotli = 3,
+  Zstd = 4
+};
+
+uint64_t zxy_to_tileid(uint8_t z, uint32_t x, uint32_t y);
+void tileid_to_zxy(uint64_t theTileId, uint8_t& z, uint32_t& x, uint32_t& y);
+
+// Directory entry. A zero run length marks a leaf directory.
+struct Entry
+{
+  uint64_t tile_id = 0;
+  uint64_t offset = 0;
+  uint32_t length = 0;
+  uint32_t run_length = 0;
+};
+
+std::string serialize_directory(const std::vector<Entry>& theEntries);
+std::vector<Entry> deserialize_directory(std::string_view theData);
+
+struct Header
+{
+  uint64_t root_dir_offset = 0;
+  uint64_t root_dir_length = 0;
+  uint64_t metadata_offset = 0;
+  uint64_t metadata_length = 0;
+  uint64_t leaf_dirs_offset = 0;
+  uint64_t leaf_dirs_length = 0;
+  uint64_t tile_data_offset = 0;
+  uint64_t tile_data_length = 0;
+  uint64_t addressed_tiles_count = 0;
+  uint64_t tile_entries_count = 0;
+  uint64_t tile_contents_count = 0;
+  bool clustered = true;
+  Compression internal_compression = Compression::None;
+  Compression tile_compression = Compression::None;
+  TileType tile_type = TileType::Unknown;
+  uint8_t min_zoom = 0;
+  uint8_t max_zoom = 0;
+  int32_t min_lon_e7 = -1800000000;
+  int32_t min_lat_e7 = -850511287;
+  int32_t max_lon_e7 = 1800000000;
+  int32_t max_lat_e7 = 850511287;
+  uint8_t center_zoom = 0;
+  int32_t center_lon_e7 = 0;
+  int32_t center_lat_e7 = 0;
+};
+
+constexpr std::size_t header_size = 127;
+
+std::string serialize_header(const Header& theHeader);
+Header deserialize_header(std::string_view theData);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect tiles and write them into an archive
+ */
+// ----------------------------------------------------------------------
+
+class Writer
+{
+ public:
+  Writer(TileType theType, Compression theCompression);
+
+  // Thread safe, tiles may be added in any order
+  void add(uint8_t z, uint32_t x, uint32_t y, const std::string& theData);
+
+  std::size_t tiles() const;
+
+  // Write the archive atomically via a temporary file, returns the file size
+  std::size_t write(const std::string& thePath, const std::string& theMetadata) const;
+
+ private:
+  TileType itsType;
+  Compression itsCompression;
+
+  mutable std::mutex itsMutex;
+  std::map<uint64_t, std::size_t> itsTiles;  // tile id -> content index
+  std::vector<std::string> itsContents;
+  std::unordered_multimap<std::size_t, std::size_t> itsContentHashes;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Memory mapped read only archive
+ */
+// ----------------------------------------------------------------------
+
+class Archive
+{
+ public:
+  explicit Archive(const std::string& thePath);
+
+  Archive(const Archive&) = delete;
+  Archive& operator=(const Archive&) = delete;
+
+  const std::string& path() const { return itsPath; }
+  const Header& header() const { return itsHeader; }
+  std::string_view metadata() const;
+
+  // Thread safe. The view is valid as long as the archive exists.
+  std::optional<std::string_view> tile(uint64_t theTileId) const;
+  std::optional<std::string_view> tile(uint8_t z, uint32_t x, uint32_t y) const
+  {
+    return tile(zxy_to_tileid(z, x, y));
+  }
+
+ private:
+  std::string_view view(uint64_t theOffset, uint64_t theLength) const;
+  const std::vector<Entry>& leaf(uint64_t theOffset, uint64_t theLength) const;
+
+  std::string itsPath;
+  boost::iostreams::mapped_file_source itsFile;
+  Header itsHeader;
+  std::vector<Entry> itsRoot;
+
+  mutable std::mutex itsMutex;
+  mutable std::map<uint64_t, std::vector<Entry>> itsLeaves;
+};
+
+}  // namespace PMTiles
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
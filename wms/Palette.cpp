@@ -0,0 +1,292 @@
+#include "Palette.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <limits>
+#include <png.h>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// Premultiplied components of a palette colour for distance comparisons
+struct Premultiplied
+{
+  int r;
+  int g;
+  int b;
+  int a;
+};
+
+Premultiplied premultiply(const Palette::Colour& theColour)
+{
+  const int a = theColour[3];
+  return {(theColour[0] * a + 127) / 255, (theColour[1] * a + 127) / 255,
+          (theColour[2] * a + 127) / 255, a};
+}
+
+std::uint32_t argb32(const Premultiplied& theColour)
+{
+  return (static_cast<std::uint32_t>(theColour.a) << 24) |
+         (static_cast<std::uint32_t>(theColour.r) << 16) |
+         (static_cast<std::uint32_t>(theColour.g) << 8) | static_cast<std::uint32_t>(theColour.b);
+}
+
+void pngWriteCallback(png_structp png, png_bytep buf, png_size_t len)
+{
+  auto* out = static_cast<std::string*>(png_get_io_ptr(png));
+  out->append(reinterpret_cast<const char*>(buf), len);
+}
+
+void pngFlushCallback(png_structp /*png*/) {}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a colour
+ */
+// ----------------------------------------------------------------------
+
+bool Palette::add(const Colour& theColour)
+{
+  // All fully transparent colours are equivalent
+  Colour colour = theColour;
+  if (colour[3] == 0)
+    colour = {0, 0, 0, 0};
+
+  if (std::find(itsColours.begin(), itsColours.end(), colour) != itsColours.end())
+    return true;
+  if (itsColours.size() >= max_size)
+    return false;
+  itsColours.push_back(colour);
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add quarter, half and three quarter alpha versions of opaque colours
+ */
+// ----------------------------------------------------------------------
+
+void Palette::addEdgeBlends()
+{
+  std::vector<Colour> opaque;
+  for (const auto& colour : itsColours)
+    if (colour[3] == 255)
+      opaque.push_back(colour);
+
+  if (itsColours.size() + 3 * opaque.size() > max_size)
+    return;
+
+  for (std::uint8_t alpha : {64, 128, 192})
+    for (const auto& colour : opaque)
+      add({colour[0], colour[1], colour[2], alpha});
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map a Cairo image to palette indices
+ *
+ * Exact palette colours are found from a precomputed table, other pixel
+ * values are mapped to the nearest colour in premultiplied RGBA space and
+ * memoized, since anti-aliased edges repeat the same few values.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::uint8_t> Palette::map(const unsigned char* theData,
+                                       int theWidth,
+                                       int theHeight,
+                                       int theStride) const
+{
+  try
+  {
+    if (itsColours.empty())
+      throw Fmi::Exception(BCP, "Cannot map an image to an empty palette");
+
+    std::vector<Premultiplied> targets;
+    targets.reserve(itsColours.size());
+    std::unordered_map<std::uint32_t, std::uint8_t> lookup;
+    for (std::size_t i = 0; i < itsColours.size(); i++)
+    {
+      targets.push_back(premultiply(itsColours[i]));
+      lookup.emplace(argb32(targets.back()), static_cast<std::uint8_t>(i));
+    }
+
+    auto nearest = [&targets](std::uint32_t pixel)
+    {
+      const int a = static_cast<int>(pixel >> 24);
+      const int r = static_cast<int>((pixel >> 16) & 0xff);
+      const int g = static_cast<int>((pixel >> 8) & 0xff);
+      const int b = static_cast<int>(pixel & 0xff);
+      std::size_t best = 0;
+      int best_distance = std::numeric_limits<int>::max();
+      for (std::size_t i = 0; i < targets.size(); i++)
+      {
+        const auto& t = targets[i];
+        const int distance = (r - t.r) * (r - t.r) + (g - t.g) * (g - t.g) +
+                             (b - t.b) * (b - t.b) + (a - t.a) * (a - t.a);
+        if (distance < best_distance)
+        {
+          best = i;
+          best_distance = distance;
+        }
+      }
+      return static_cast<std::uint8_t>(best);
+    };
+
+    std::vector<std::uint8_t> indices(static_cast<std::size_t>(theWidth) * theHeight);
+    auto* out = indices.data();
+
+    std::uint32_t previous_pixel = 0;
+    std::uint8_t previous_index = 0;
+    bool have_previous = false;
+
+    for (int j = 0; j < theHeight; j++)
+    {
+      const auto* row =
+          reinterpret_cast<const std::uint32_t*>(theData + static_cast<long>(j) * theStride);
+      for (int i = 0; i < theWidth; i++)
+      {
+        const std::uint32_t pixel = row[i];
+        if (!have_previous || pixel != previous_pixel)
+        {
+          auto pos = lookup.find(pixel);
+          if (pos == lookup.end())
+            pos = lookup.emplace(pixel, nearest(pixel)).first;
+          previous_pixel = pixel;
+          previous_index = pos->second;
+          have_previous = true;
+        }
+        *out++ = previous_index;
+      }
+    }
+    return indices;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Expand indices to RGBA
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::uint8_t> Palette::expand(const std::vector<std::uint8_t>& theIndices) const
+{
+  std::vector<std::uint8_t> rgba;
+  rgba.reserve(4 * theIndices.size());
+  for (auto index : theIndices)
+  {
+    const auto& colour = itsColours.at(index);
+    rgba.insert(rgba.end(), colour.begin(), colour.end());
+  }
+  return rgba;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Encode an indexed PNG
+ *
+ * Transparency is written as a tRNS chunk, which is truncated after the
+ * last non-opaque entry.
+ */
+// ----------------------------------------------------------------------
+
+std::string Palette::encodePng(const std::vector<std::uint8_t>& theIndices,
+                               int theWidth,
+                               int theHeight) const
+{
+  try
+  {
+    if (theIndices.size() != static_cast<std::size_t>(theWidth) * theHeight)
+      throw Fmi::Exception(BCP, "Palette index buffer size does not match the image size");
+
+    // Objects with destructors must exist before setjmp, a longjmp past
+    // their construction would skip the destructors
+    std::string output;
+    std::vector<png_color> plte;
+    std::vector<png_byte> trns;
+    for (const auto& colour : itsColours)
+    {
+      plte.push_back({colour[0], colour[1], colour[2]});
+      trns.push_back(colour[3]);
+    }
+    while (!trns.empty() && trns.back() == 255)
+      trns.pop_back();
+
+    auto* png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png)
+      throw Fmi::Exception(BCP, "png_create_write_struct failed");
+
+    auto* info = png_create_info_struct(png);
+    if (!info)
+    {
+      png_destroy_write_struct(&png, nullptr);
+      throw Fmi::Exception(BCP, "png_create_info_struct failed");
+    }
+
+    if (setjmp(png_jmpbuf(png)))
+    {
+      png_destroy_write_struct(&png, &info);
+      throw Fmi::Exception(BCP, "libpng error during write");
+    }
+
+    png_set_write_fn(png, &output, pngWriteCallback, pngFlushCallback);
+
+    const int bit_depth = (itsColours.size() <= 2    ? 1
+                           : itsColours.size() <= 4  ? 2
+                           : itsColours.size() <= 16 ? 4
+                                                     : 8);
+
+    png_set_IHDR(png,
+                 info,
+                 theWidth,
+                 theHeight,
+                 bit_depth,
+                 PNG_COLOR_TYPE_PALETTE,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+
+    // Filters rarely help indexed images
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+    png_set_compression_level(png, 6);
+
+    png_set_PLTE(png, info, plte.data(), static_cast<int>(plte.size()));
+
+    if (!trns.empty())
+      png_set_tRNS(png, info, trns.data(), static_cast<int>(trns.size()), nullptr);
+
+    png_write_info(png, info);
+
+    // libpng packs sub-byte depths from one index per byte
+    if (bit_depth < 8)
+      png_set_packing(png);
+
+    for (int y = 0; y < theHeight; ++y)
+    {
+      auto* row = const_cast<png_bytep>(theIndices.data() + static_cast<std::size_t>(y) * theWidth);
+      png_write_row(png, row);
+    }
+
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    return output;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
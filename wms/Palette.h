@@ -0,0 +1,66 @@
+// ======================================================================
+/*!
+ * \brief Fixed colour palettes for indexed image output
+ *
+ * Products drawn from a small known set of colours (isoband fills, land
+ * and sea colours...) do not need a colour quantisation search. The image
+ * is mapped directly to the palette: exact colours via a lookup table,
+ * anti-aliased edge pixels to the nearest palette entry. The result is
+ * deterministic for a given image and palette.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class Palette
+{
+ public:
+  // Non-premultiplied RGBA
+  using Colour = std::array<std::uint8_t, 4>;
+
+  static constexpr std::size_t max_size = 256;
+
+  // Add a colour unless it is already present. Returns false if the palette is full.
+  bool add(const Colour& theColour);
+
+  // Add partially transparent versions of the opaque colours for edges
+  // drawn on a transparent background, if there is room for them.
+  void addEdgeBlends();
+
+  std::size_t size() const { return itsColours.size(); }
+  bool empty() const { return itsColours.empty(); }
+  const std::vector<Colour>& colours() const { return itsColours; }
+
+  // Map a premultiplied native endian ARGB32 image (the Cairo image format)
+  // to palette indices
+  std::vector<std::uint8_t> map(const unsigned char* theData,
+                                int theWidth,
+                                int theHeight,
+                                int theStride) const;
+
+  // Expand palette indices back to non-premultiplied RGBA
+  std::vector<std::uint8_t> expand(const std::vector<std::uint8_t>& theIndices) const;
+
+  // Encode palette indices as an indexed PNG
+  std::string encodePng(const std::vector<std::uint8_t>& theIndices,
+                        int theWidth,
+                        int theHeight) const;
+
+ private:
+  std::vector<Colour> itsColours;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
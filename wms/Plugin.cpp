@@ -5,15 +5,19 @@
 // ======================================================================
 
 #include "Plugin.h"
+#include "CairoRenderer.h"
 #include "CaseInsensitiveComparator.h"
+#include "ContentEncoding.h"
 #include "DaliCapabilities.h"
 #include "Hash.h"
+#include "IsolineFilter.h"
 #include "JsonTools.h"
 #include "Mime.h"
 #include "ParameterInfo.h"
 #include "Product.h"
 #include "State.h"
 #include "TextUtility.h"
+#include "Timing.h"
 #include "ogc/QueryStatus.h"
 #include "tiles/Config.h"
 #include "wms/Config.h"
@@ -33,13 +37,18 @@
 #include <json/writer.h>
 #include <macgyver/AnsiEscapeCodes.h>
 #include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
 #include <spine/Convenience.h>
 #include <spine/FmiApiKey.h>
 #include <spine/HostInfo.h>
 #include <spine/Json.h>
 #include <spine/SmartMet.h>
 #include <trax/Contour.h>
+#include <cctype>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <set>
 #include <stdexcept>
 
 using namespace boost::placeholders;
@@ -142,6 +151,136 @@ std::string injectFrameStyle(const std::string &theSvg, int theFrame, bool theAc
   return out;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Identify the product of a request for the cost model
+ *
+ * The bounding box, times, feature info pixel and tile coordinates are
+ * ignored, since they do not change the cost of the product much.
+ * Numeric path components are tile coordinates or zoom levels in WMTS
+ * and OGC Tiles paths.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t cost_product_key(const Spine::HTTP::Request &theRequest)
+{
+  static const std::set<std::string> ignored{"bbox",
+                                             "time",
+                                             "starttime",
+                                             "endtime",
+                                             "origintime",
+                                             "i",
+                                             "j",
+                                             "x",
+                                             "y",
+                                             "tilerow",
+                                             "tilecol"};
+
+  const auto &resource = theRequest.getResource();
+
+  std::string path;
+  std::size_t pos = 0;
+  while (pos < resource.size())
+  {
+    auto next = resource.find('/', pos + 1);
+    if (next == std::string::npos)
+      next = resource.size();
+    if (next > pos + 1 && std::isdigit(static_cast<unsigned char>(resource[pos + 1])) != 0)
+      path += "/*";
+    else
+      path.append(resource, pos, next - pos);
+    pos = next;
+  }
+
+  auto hash = Fmi::hash_value(path);
+  for (const auto &name_value : theRequest.getParameterMap())
+  {
+    if (ignored.count(Fmi::ascii_tolower_copy(name_value.first)) > 0)
+      continue;
+    Fmi::hash_combine(hash, Fmi::hash_value(name_value.first));
+    Fmi::hash_combine(hash, Fmi::hash_value(name_value.second));
+  }
+  return hash;
+}
+
+std::size_t cost_request_key(const Spine::HTTP::Request &theRequest)
+{
+  return Fmi::hash_value(theRequest.getURI());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cost classification of requests for products not measured yet
+ *
+ * WMS/WMTS/Tiles requests should be handled ASAP, others, not so much.
+ * Baking a tile pyramid renders thousands of tiles.
+ */
+// ----------------------------------------------------------------------
+
+bool is_bake_request(const Spine::HTTP::Request &theRequest)
+{
+  const std::string &res = theRequest.getResource();
+  return (res.size() >= 5 && res.substr(res.size() - 5) == "/bake");
+}
+
+bool fast_by_default(const Spine::HTTP::Request &theRequest)
+{
+  if (is_bake_request(theRequest))
+    return false;
+  const std::string &res = theRequest.getResource();
+  return (res == "/wms" || (res.size() >= 5 && res.substr(0, 5) == "/wmts") ||
+          (res.size() >= 6 && res.substr(0, 6) == "/tiles"));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Respond to an expensive request rejected by the admission limit
+ */
+// ----------------------------------------------------------------------
+
+void reject_expensive(Spine::HTTP::Response &theResponse)
+{
+  theResponse.setContent(std::string());
+  theResponse.setStatus(Spine::HTTP::Status::service_unavailable);
+  theResponse.setHeader("Retry-After", "5");
+  theResponse.setHeader("X-Dali-Error", "Too many expensive requests in progress");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the product format is text which is output as is
+ */
+// ----------------------------------------------------------------------
+
+bool is_text_format(const std::string &theType)
+{
+  static const std::set<std::string> text_formats{"xml",
+                                                  "svg",
+                                                  "image/svg+xml",
+                                                  "geojson",
+                                                  "topojson",
+                                                  "kml",
+                                                  "json",
+                                                  "html",
+                                                  "application/json",
+                                                  "cnf"};
+  return text_formats.find(theType) != text_formats.end();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Image cache key of the gzip compressed form of a text product
+ */
+// ----------------------------------------------------------------------
+
+std::size_t gzip_hash(std::size_t theHash)
+{
+  if (theHash == Fmi::bad_hash)
+    return theHash;
+  Fmi::hash_combine(theHash, Fmi::hash_value(std::string("gzip")));
+  return theHash;
+}
+
 }  // namespace
 
 // Keep only acceptable querystring replacements (allowed keys or names with dots)
@@ -212,6 +351,14 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
       return;
     }
 
+    // Latency histograms of the request stages
+    if (request_param && boost::iequals(*request_param, "GetTimingStatistics"))
+    {
+      theResponse.setHeader("Content-Type", "application/json");
+      theResponse.setContent(Timing::statistics());
+      return;
+    }
+
     int width = Spine::optional_int(theRequest.getParameter("width"), 1000);
     int height = Spine::optional_int(theRequest.getParameter("height"), 1000);
 
@@ -254,6 +401,8 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
 
     theState.setName(theState.getCustomer() + "/" + product_name);
 
+    std::optional<Timing::ScopedSpan> json_span(std::in_place, "json");
+
     auto json = getProductJson(theRequest, theState, product_name, json_stage);
 
     // Debugging
@@ -303,9 +452,15 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
 
     product.check_errors(theRequest.getURI(), itsWarnedURLs);
 
+    json_span.reset();
+
     // Calculate hash for the product
 
-    auto product_hash = product.hash_value(theState);
+    std::size_t product_hash = Fmi::bad_hash;
+    {
+      Timing::ScopedSpan span("hash");
+      product_hash = product.hash_value(theState);
+    }
 
     if (product_hash != Fmi::bad_hash)
     {
@@ -313,7 +468,8 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
       if (theRequest.getHeader("X-Request-ETag"))
       {
         theResponse.setHeader("Content-Type", mimeType(product.type));
-        theResponse.setHeader("ETag", fmt::sprintf("\"%x\"", product_hash));
+        theResponse.setHeader(
+            "ETag", fmt::sprintf("\"%x\"", responseHash(product_hash, product.type, theRequest)));
         theResponse.setStatus(Spine::HTTP::Status::no_content);
 
         // Add updated expiration time if available
@@ -334,7 +490,7 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
     // or returning any body.
     if (product_hash != Fmi::bad_hash)
     {
-      auto etag = fmt::sprintf("\"%x\"", product_hash);
+      auto etag = fmt::sprintf("\"%x\"", responseHash(product_hash, product.type, theRequest));
       theResponse.setHeader("ETag", etag);
       if (auto status = Spine::HTTP::conditionalResponseStatus(theRequest, etag))
       {
@@ -343,7 +499,7 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
       }
     }
 
-    auto obj = itsImageCache->find(product_hash);
+    auto obj = findInImageCache(product_hash, product.type, theRequest, theResponse);
 
     if (obj)
     {
@@ -402,6 +558,7 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
         std::string report = "Product::generate finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Timing::ScopedSpan span("generate", product.type);
       product.generate(hash, theState);
     }
 
@@ -413,6 +570,13 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
                                hash.RecursiveDump());
     }
 
+    if (renderDirect(hash, product, theResponse, usetimer, product_hash))
+    {
+      if (usetimer)
+        std::cout << "Timed query finished\n";
+      return;
+    }
+
     std::string output;
     std::string log;
     try
@@ -423,6 +587,7 @@ void Dali::Plugin::daliQuery(Spine::Reactor & /* theReactor */,
         std::string report = "Template processing finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Timing::ScopedSpan span("template", *product.svg_tmpl);
       tmpl->process(hash, output, log);
     }
     catch (const CTPP::CTPPException &)
@@ -468,20 +633,9 @@ void Plugin::formatResponse(const std::string &theSvg,
 {
   try
   {
-    std::set<std::string> text_formats{"xml",
-                                       "svg",
-                                       "image/svg+xml",
-                                       "geojson",
-                                       "topojson",
-                                       "kml",
-                                       "json",
-                                       "html",
-                                       "application/json",
-                                       "cnf"};
-
     theResponse.setHeader("Content-Type", mimeType(theType));
 
-    if (text_formats.find(theType) != text_formats.end())
+    if (is_text_format(theType))
     {
       // Set string content as-is
       if (theSvg.empty())
@@ -490,12 +644,38 @@ void Plugin::formatResponse(const std::string &theSvg,
                                  theRequest.getQueryString(),
                                  theRequest.getClientIP());
       }
-      else
+      else if (theType != theProduct.type || theHash == 0 || theHash == Fmi::bad_hash)
       {
+        // Capabilities, exceptions and feature info responses are not cached
         theResponse.setContent(theSvg);
         auto etag = (theHash != Fmi::bad_hash) ? theHash : Fmi::hash_value(theSvg);
         theResponse.setHeader("ETag", fmt::sprintf("\"%x\"", etag));
       }
+      else
+      {
+        // Cache the product as is and large ones also gzip compressed, and
+        // serve the form negotiated by responseHash
+        auto buffer = std::make_shared<std::string>(theSvg);
+        insertInImageCache(theHash, buffer);
+
+        const auto etag = responseHash(theHash, theType, theRequest);
+        theResponse.setHeader("ETag", fmt::sprintf("\"%x\"", etag));
+        theResponse.setHeader("Vary", "Accept-Encoding");
+
+        if (itsConfig.compressionEnabled() && theSvg.size() >= itsConfig.compressionMinSize())
+        {
+          Timing::ScopedSpan span("compress", "gzip");
+          auto compressed = std::make_shared<std::string>(ContentEncoding::gzip(theSvg));
+          insertInImageCache(gzip_hash(theHash), compressed);
+          if (etag != theHash)
+          {
+            theResponse.setHeader("Content-Encoding", "gzip");
+            buffer = compressed;
+          }
+        }
+
+        theResponse.setContent(buffer);
+      }
     }
     else
     {
@@ -506,6 +686,7 @@ void Plugin::formatResponse(const std::string &theSvg,
         std::string report = "svg_to_" + theType + " finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Timing::ScopedSpan span("rasterise", theType);
 
       std::shared_ptr<std::string> buffer;
       if (theType == "png")
@@ -555,142 +736,286 @@ void Plugin::formatResponse(const std::string &theSvg,
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Main content handler
+ * \brief Render raster output directly from the generated hash
+ *
+ * Used instead of template processing and formatResponse when the product
+ * selects the Cairo renderer. Returns false if the caller must take the
+ * template path, either because the product does not use the renderer,
+ * uses a custom template or animation, or contains elements the renderer
+ * does not support.
  */
 // ----------------------------------------------------------------------
 
-void Plugin::requestHandler(Spine::Reactor &theReactor,
-                            const Spine::HTTP::Request &theRequest,
-                            Spine::HTTP::Response &theResponse)
+bool Plugin::renderDirect(CTPP::CDT &theHash,
+                          const Product &theProduct,
+                          Spine::HTTP::Response &theResponse,
+                          bool usetimer,
+                          std::size_t theProductHash)
 {
   try
   {
-    const bool isdebug = Spine::optional_bool(theRequest.getParameter("debug"), false);
+    if (theProduct.renderer != "cairo" || !CairoRenderer::supports(theProduct.type))
+      return false;
 
-    theResponse.setHeader("Access-Control-Allow-Origin", "*");
+    // A custom template may add content the generated hash does not describe
+    if (theProduct.svg_tmpl && *theProduct.svg_tmpl != itsConfig.defaultTemplate(theProduct.type))
+      return false;
 
-    // WMS: if WMS exception is thrown or capabilities requested, the format must be xml in response
-    // no matter what format-option was given in request
-    try
+    if (theProduct.type == "webp" && theProduct.webp.frames)
+      return false;
+
+    std::unique_ptr<boost::timer::auto_cpu_timer> mytimer;
+    if (usetimer)
     {
-      State state(*this, theRequest);
-      state.useTimer(Spine::optional_bool(theRequest.getParameter("timer"), false));
+      std::string report =
+          "cairo_to_" + theProduct.type + " finished in %t sec CPU, %w sec real\n";
+      mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
+    }
+    Timing::ScopedSpan span("rasterise", "cairo-" + theProduct.type);
 
-      using Fmi::DateTime;
+    std::string reason;
+    auto output = CairoRenderer::render(
+        theHash, theProduct.type, theProduct.png, theProduct.webp, reason);
+    if (!output)
+    {
+      if (usetimer)
+        std::cout << "Cairo renderer declined the product: " << reason << '\n';
+      return false;
+    }
 
-      const std::string &resource = theRequest.getResource();
+    auto buffer = std::make_shared<std::string>(std::move(*output));
+    auto etag = (theProductHash != Fmi::bad_hash) ? theProductHash : Fmi::hash_value(*buffer);
+    itsImageCache->insert(etag, buffer);
 
-      if (resource == "/wms")
-      {
-        state.useWms(true);
+    theResponse.setHeader("Content-Type", mimeType(theProduct.type));
+    theResponse.setHeader("ETag", fmt::sprintf("\"%x\"", etag));
+    theResponse.setContent(buffer);
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Direct rendering failed!");
+  }
+}
 
-        theResponse.setStatus(Spine::HTTP::Status::ok);
+// ----------------------------------------------------------------------
+/*!
+ * \brief Route the request to the WMS, WMTS, Tiles or Dali handler
+ *
+ * Returns the producers whose latest data was used.
+ */
+// ----------------------------------------------------------------------
 
-        // may modify HTTP status set above
-        try
-        {
-          OGC::QueryStatus status =
-              itsWMSHandler->query(theReactor, state, theRequest, theResponse);
+std::set<std::string> Plugin::dispatch(Spine::Reactor &theReactor,
+                                       const Spine::HTTP::Request &theRequest,
+                                       Spine::HTTP::Response &theResponse)
+{
+  State state(*this, theRequest);
+  state.useTimer(Spine::optional_bool(theRequest.getParameter("timer"), false));
 
-          switch (status)
-          {
-            case OGC::QueryStatus::FORBIDDEN:
-            {
-              theResponse.setStatus(Spine::HTTP::Status::forbidden, true);
-              break;
-            }
-            case OGC::QueryStatus::OK:
-            default:
-              break;
-          }
-        }
+  using Fmi::DateTime;
 
-        catch (const Fmi::Exception &wmsException)
-        {
-          wmsException.printError();
+  const std::string &resource = theRequest.getResource();
 
-          // The default for most responses:
-          theResponse.setStatus(Spine::HTTP::Status::bad_request);
+  if (resource == "/wms")
+  {
+    state.useWms(true);
 
-          const Fmi::Exception *e = wmsException.getExceptionByParameterName(WMS_EXCEPTION_CODE);
+    theResponse.setStatus(Spine::HTTP::Status::ok);
 
-          if (e != nullptr)
-          {
-            // Status codes used by OGC and their HTTP response codes:
-            // OperationNotSupported 501 Not Implemented
-            // MissingParameterValue 400 Bad request
-            // InvalidParameterValue 400 Bad request
-            // VersionNegotiationFailed 400 Bad request
-            // InvalidUpdateSequence 400 Bad request
-            // OptionNotSupported 501 Not Implemented
-            // NoApplicableCode 3xx, 4xx, 5xx Internal Server Error
-
-            std::string exceptionCode = e->getParameterValue(WMS_EXCEPTION_CODE);
-
-            theResponse.setHeader("X-WMS-Exception", exceptionCode);
-
-            std::string firstMessage = wmsException.what();
-            boost::algorithm::replace_all(firstMessage, "\n", " ");
-            if (firstMessage.size() > 300)
-              firstMessage.resize(300);
-            theResponse.setHeader("X-WMS-Error", firstMessage);
-
-            if (exceptionCode == WMS_LAYER_NOT_QUERYABLE ||
-                exceptionCode == WMS_OPERATION_NOT_SUPPORTED)
-            {
-              theResponse.setStatus(Spine::HTTP::Status::not_implemented);
-            }
-          }
-        }
-      }
-      else if (resource.size() >= 5 && resource.substr(0, 5) == "/wmts")
+    // may modify HTTP status set above
+    try
+    {
+      OGC::QueryStatus status = itsWMSHandler->query(theReactor, state, theRequest, theResponse);
+
+      switch (status)
       {
-        // WMTS REST interface — uses same product file tree as WMS
-        state.useWms(true);
-        theResponse.setStatus(Spine::HTTP::Status::ok);
-        itsWMTSHandler->query(theReactor, state, theRequest, theResponse);
+        case OGC::QueryStatus::FORBIDDEN:
+        {
+          theResponse.setStatus(Spine::HTTP::Status::forbidden, true);
+          break;
+        }
+        case OGC::QueryStatus::OK:
+        default:
+          break;
       }
-      else if (resource.size() >= 6 && resource.substr(0, 6) == "/tiles")
+    }
+
+    catch (const Fmi::Exception &wmsException)
+    {
+      wmsException.printError();
+
+      // The default for most responses:
+      theResponse.setStatus(Spine::HTTP::Status::bad_request);
+
+      const Fmi::Exception *e = wmsException.getExceptionByParameterName(WMS_EXCEPTION_CODE);
+
+      if (e != nullptr)
       {
-        // OGC API - Tiles interface — uses same product file tree as WMS
-        state.useWms(true);
-        theResponse.setStatus(Spine::HTTP::Status::ok);
-        itsTilesHandler->query(theReactor, state, theRequest, theResponse);
+        // Status codes used by OGC and their HTTP response codes:
+        // OperationNotSupported 501 Not Implemented
+        // MissingParameterValue 400 Bad request
+        // InvalidParameterValue 400 Bad request
+        // VersionNegotiationFailed 400 Bad request
+        // InvalidUpdateSequence 400 Bad request
+        // OptionNotSupported 501 Not Implemented
+        // NoApplicableCode 3xx, 4xx, 5xx Internal Server Error
+
+        std::string exceptionCode = e->getParameterValue(WMS_EXCEPTION_CODE);
+
+        theResponse.setHeader("X-WMS-Exception", exceptionCode);
+
+        std::string firstMessage = wmsException.what();
+        boost::algorithm::replace_all(firstMessage, "\n", " ");
+        if (firstMessage.size() > 300)
+          firstMessage.resize(300);
+        theResponse.setHeader("X-WMS-Error", firstMessage);
+
+        if (exceptionCode == WMS_LAYER_NOT_QUERYABLE ||
+            exceptionCode == WMS_OPERATION_NOT_SUPPORTED)
+        {
+          theResponse.setStatus(Spine::HTTP::Status::not_implemented);
+        }
       }
-      else
-      {
-        state.useWms(false);
+    }
+  }
+  else if (resource.size() >= 5 && resource.substr(0, 5) == "/wmts")
+  {
+    // WMTS REST interface — uses same product file tree as WMS
+    state.useWms(true);
+    theResponse.setStatus(Spine::HTTP::Status::ok);
+    itsWMTSHandler->query(theReactor, state, theRequest, theResponse);
+  }
+  else if (resource.size() >= 6 && resource.substr(0, 6) == "/tiles")
+  {
+    // OGC API - Tiles interface — uses same product file tree as WMS
+    state.useWms(true);
+    theResponse.setStatus(Spine::HTTP::Status::ok);
+    itsTilesHandler->query(theReactor, state, theRequest, theResponse);
+  }
+  else
+  {
+    state.useWms(false);
 
-        theResponse.setStatus(Spine::HTTP::Status::ok);
-        daliQuery(theReactor, state, theRequest, theResponse);
-      }
+    theResponse.setStatus(Spine::HTTP::Status::ok);
+    daliQuery(theReactor, state, theRequest, theResponse);
+  }
 
-      // Adding headers
+  if (state.useTimer())
+    std::cout << state.getArenaReport() << std::endl;
 
-      std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+  // Adding headers
 
-      const Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
-      const auto &modification_time = state.getModificationTime();
-      if (!modification_time)
-        theResponse.setHeader("Last-Modified", tformat->format(t_now));
-      else
-        theResponse.setHeader("Last-Modified", tformat->format(*modification_time));
+  std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+
+  const Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
+  const auto &modification_time = state.getModificationTime();
+  if (!modification_time)
+    theResponse.setHeader("Last-Modified", tformat->format(t_now));
+  else
+    theResponse.setHeader("Last-Modified", tformat->format(*modification_time));
+
+  // Send expiration header only if there was no error. Note: 304 Not Modified must pass!
+
+  bool is_error = (static_cast<int>(theResponse.getStatus()) >= 400);
+
+  if (!is_error)
+  {
+    const auto &expires = state.getExpirationTime();
+    if (!expires)
+      theResponse.setHeader("Expires", tformat->format(t_now + Fmi::Hours(1)));
+    else
+      theResponse.setHeader("Expires", tformat->format(*expires));
+  }
+
+  return state.getLatestProducers();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Render a popular request again in the background
+ *
+ * The result lands in the image cache. The request is not counted in the
+ * cost model or the popularity sketch, since it is not a client request.
+ * Returns false without rendering if expensive requests are at their limit.
+ */
+// ----------------------------------------------------------------------
+
+bool Plugin::prerender(const Spine::HTTP::Request &theRequest)
+{
+  try
+  {
+    auto ticket = itsCostModel.admit();
+    if (!ticket)
+      return false;
+
+    Spine::HTTP::Response response;
+    dispatch(*itsReactor, theRequest, response);
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Main content handler
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::requestHandler(Spine::Reactor &theReactor,
+                            const Spine::HTTP::Request &theRequest,
+                            Spine::HTTP::Response &theResponse)
+{
+  try
+  {
+    const bool isdebug = Spine::optional_bool(theRequest.getParameter("debug"), false);
 
-      // Send expiration header only if there was no error. Note: 304 Not Modified must pass!
+    theResponse.setHeader("Access-Control-Allow-Origin", "*");
+
+    // Reject expensive renders if too many of them are already running. Bakes
+    // are rejected immediately, other requests predicted to be slow only once
+    // they start to render, so that cached products keep flowing.
 
-      bool is_error = (static_cast<int>(theResponse.getStatus()) >= 400);
+    const auto started = std::chrono::steady_clock::now();
+    const auto product_key = cost_product_key(theRequest);
+    const auto request_key = cost_request_key(theRequest);
 
-      if (!is_error)
+    std::optional<CostModel::Ticket> ticket;
+    if (is_bake_request(theRequest))
+    {
+      ticket = itsCostModel.admit();
+      if (!ticket)
       {
-        const auto &expires = state.getExpirationTime();
-        if (!expires)
-          theResponse.setHeader("Expires", tformat->format(t_now + Fmi::Hours(1)));
-        else
-          theResponse.setHeader("Expires", tformat->format(*expires));
+        reject_expensive(theResponse);
+        return;
       }
     }
+    const bool admit_render =
+        (!ticket && !itsCostModel.isFast(product_key, request_key, fast_by_default(theRequest)));
+
+    // Collect per-stage durations for the histograms and the Server-Timing header
+    Timing::RequestTiming timing;
+    Timing::RequestScope timing_scope(timing);
+
+    // WMS: if WMS exception is thrown or capabilities requested, the format must be xml in response
+    // no matter what format-option was given in request
+    std::set<std::string> producers;
+    CostModel::RenderScope render_scope(admit_render ? &itsCostModel : nullptr);
+    try
+    {
+      producers = dispatch(theReactor, theRequest, theResponse);
+    }
     catch (...)
     {
+      if (render_scope.rejected())
+      {
+        reject_expensive(theResponse);
+        return;
+      }
+
       // Catching all exceptions
 
       Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
@@ -726,6 +1051,31 @@ void Plugin::requestHandler(Spine::Reactor &theReactor,
         firstMessage.resize(300);
       theResponse.setHeader("X-Dali-Error", firstMessage);
     }
+
+    // The WMS handler reports errors as service exceptions instead of throwing
+    if (render_scope.rejected())
+    {
+      reject_expensive(theResponse);
+      return;
+    }
+
+    Timing::record(timing);
+
+    if (static_cast<int>(theResponse.getStatus()) < 400)
+    {
+      // Cache hits, ETag probes and 304 responses would make the product look
+      // fast, they only make the identical request fast
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+      if (render_scope.rendered())
+        itsCostModel.record(product_key, request_key, elapsed.count());
+      else
+        itsCostModel.recordHit(request_key, elapsed.count());
+      itsPrerenderer.record(request_key, theRequest, producers);
+    }
+    if (!timing.spans().empty() &&
+        (itsConfig.serverTiming() ||
+         Spine::optional_bool(theRequest.getParameter("timer"), false)))
+      theResponse.setHeader("Server-Timing", timing.serverTiming());
   }
   catch (...)
   {
@@ -771,6 +1121,8 @@ Plugin::Plugin(Spine::Reactor *theReactor, const char *theConfig)
     // Size the process-wide Trax contouring worker pool once at startup. Without this the
     // band-parallel engine stays dormant; n == 0 (the default) keeps contouring single-threaded.
     Trax::Contour::set_worker_threads(itsConfig.contourWorkerThreads());
+    // The isoline filters borrow their helper threads from a budget of the same size
+    IsolineFilter::setWorkerThreads(itsConfig.contourWorkerThreads());
   }
   catch (...)
   {
@@ -797,6 +1149,39 @@ void Plugin::init()
     // StyleSheet cache
     itsStyleSheetCache.resize(itsConfig.styleSheetCacheSize());
 
+    // Streamline cache
+    itsStreamlineCache.resize(itsConfig.streamlineCacheSize());
+
+#ifndef WITHOUT_OBSERVATION
+    // Wind rose statistics cache
+    itsWindRoseCache.resize(itsConfig.windRoseCacheSize());
+#endif
+
+    // Sampled querydata cache
+    itsSampleCache.init(itsConfig.sampleCacheSize(), itsConfig.sampleCacheExpand());
+
+    // Projected keyword location cache
+    itsLocationIndexCache.init(itsConfig.locationIndexSize());
+
+    // PostGIS feature cache
+    itsPostGISFeatureCache.init(itsConfig.postgisCacheSize(), itsConfig.postgisCacheMaxAge());
+
+    // Request classification
+    itsCostModel.init(itsConfig.costModelSettings());
+
+    // Baked tile archives
+    itsTileBakery.init(itsConfig.bakeDirectory(), itsConfig.bakeApiKeys());
+
+    // Resource index
+
+    if (itsConfig.resourceIndexEnabled())
+    {
+      itsResourceIndex = std::make_unique<ResourceIndex>(
+          std::vector<std::string>{itsConfig.rootDirectory(false), itsConfig.rootDirectory(true)});
+      itsResourceIndex->init(itsConfig.resourceIndexUpdateInterval(),
+                             itsConfig.resourceIndexMemoryBytes());
+    }
+
     // CONTOUR
 
     if (Spine::Reactor::isShuttingDown())
@@ -941,6 +1326,14 @@ void Plugin::init()
     itsTilesHandler = std::make_unique<Tiles::Handler>(itsConfig);
     itsTilesHandler->init(std::move(tilesConfig));
 
+    // Background re-rendering of popular products when their model data changes
+
+    itsPrerenderer.init(
+        itsConfig.prerenderSettings(),
+        [this](const std::string &theProducer)
+        { return Engine::Querydata::hash_value(itsQEngine->get(theProducer)); },
+        [this](const Spine::HTTP::Request &theRequest) { return prerender(theRequest); });
+
     // Register dali content handler
 
     if (!itsReactor->addContentHandler(
@@ -1008,9 +1401,14 @@ void Plugin::shutdown()
   {
     std::cout << "  -- Shutdown requested (dali)\n" << std::flush;
 
+    itsPrerenderer.shutdown();
+
     if (itsImageCache != nullptr)
       itsImageCache->shutdown();
 
+    if (itsResourceIndex != nullptr)
+      itsResourceIndex->shutdown();
+
     // Shut down WMTS and Tiles before WMS since they hold raw pointers into WMS::Config
     if (itsTilesHandler != nullptr)
       itsTilesHandler->shutdown();
@@ -1037,10 +1435,12 @@ bool Plugin::queryIsFast(const Spine::HTTP::Request &theRequest) const
 {
   try
   {
-    // WMS/WMTS/Tiles requests should be handled ASAP, others, not so much
-    const std::string &res = theRequest.getResource();
-    return (res == "/wms" || (res.size() >= 5 && res.substr(0, 5) == "/wmts") ||
-            (res.size() >= 6 && res.substr(0, 6) == "/tiles"));
+    if (is_bake_request(theRequest))
+      return false;
+
+    // Once a product has been rendered its measured cost decides instead of the resource
+    return itsCostModel.isFast(
+        cost_product_key(theRequest), cost_request_key(theRequest), fast_by_default(theRequest));
   }
   catch (...)
   {
@@ -1056,6 +1456,8 @@ bool Plugin::queryIsFast(const Spine::HTTP::Request &theRequest) const
 
 Plugin::~Plugin()
 {
+  itsPrerenderer.shutdown();
+
   if (itsImageCache != nullptr)
     itsImageCache->shutdown();
 
@@ -1066,14 +1468,33 @@ Plugin::~Plugin()
 // ----------------------------------------------------------------------
 /*!
  * \brief Cache lookup for binary image formats
+ *
+ * Tiles baked into PMTiles archives are found by the same product hash.
+ * A baked tile is copied out of the archive only once, later requests
+ * share the copy placed in the image cache.
  */
 // ----------------------------------------------------------------------
 
 std::shared_ptr<std::string> Plugin::findInImageCache(std::size_t hash) const
 {
-  if (!itsImageCache)
+  if (hash == Fmi::bad_hash)
+    return {};
+
+  if (itsImageCache)
+  {
+    auto obj = itsImageCache->find(hash);
+    if (obj)
+      return obj;
+  }
+
+  auto tile = itsTileBakery.find(hash);
+  if (!tile)
     return {};
-  return itsImageCache->find(hash);
+
+  auto obj = std::make_shared<std::string>(tile->data);
+  if (itsImageCache)
+    itsImageCache->insert(hash, obj);
+  return obj;
 }
 
 void Plugin::insertInImageCache(std::size_t hash, std::shared_ptr<std::string> data)
@@ -1082,6 +1503,129 @@ void Plugin::insertInImageCache(std::size_t hash, std::shared_ptr<std::string> d
     itsImageCache->insert(hash, std::move(data));
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a cached product in the form negotiated for the request
+ *
+ * Text products are cached as is and, if large enough, also gzip
+ * compressed. The compressed form is returned with the matching headers
+ * to clients accepting it. If only the plain form is still cached, it is
+ * compressed again, since the response already has the ETag of the
+ * compressed form.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<std::string> Plugin::findInImageCache(std::size_t hash,
+                                                      const std::string &theType,
+                                                      const Spine::HTTP::Request &theRequest,
+                                                      Spine::HTTP::Response &theResponse) const
+{
+  try
+  {
+    if (!is_text_format(theType))
+      return findInImageCache(hash);
+
+    theResponse.setHeader("Vary", "Accept-Encoding");
+
+    if (responseHash(hash, theType, theRequest) == hash)
+      return findInImageCache(hash);
+
+    if (auto obj = findInImageCache(gzip_hash(hash)))
+    {
+      theResponse.setHeader("Content-Encoding", "gzip");
+      return obj;
+    }
+
+    // Products too small to be compressed are served as is also to gzip clients
+    auto obj = findInImageCache(hash);
+    if (!obj || obj->size() < itsConfig.compressionMinSize())
+      return obj;
+
+    Timing::ScopedSpan span("compress", "gzip");
+    auto compressed = std::make_shared<std::string>(ContentEncoding::gzip(*obj));
+    if (itsImageCache)
+      itsImageCache->insert(gzip_hash(hash), compressed);
+    theResponse.setHeader("Content-Encoding", "gzip");
+    return compressed;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The hash of the response for the request, used as the ETag
+ *
+ * Clients accepting gzip may receive a compressed text product, which
+ * is a different entity than the plain one and needs a different ETag.
+ * The choice depends only on the request, so ETag probes and the actual
+ * responses agree even before the size of the product is known.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t Plugin::responseHash(std::size_t theHash,
+                                 const std::string &theType,
+                                 const Spine::HTTP::Request &theRequest) const
+{
+  try
+  {
+    if (theHash == 0 || theHash == Fmi::bad_hash || !itsConfig.compressionEnabled() ||
+        !is_text_format(theType))
+      return theHash;
+
+    if (!ContentEncoding::acceptsGzip(theRequest.getHeader("Accept-Encoding").value_or("")))
+      return theHash;
+
+    return gzip_hash(theHash);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache lookup for traced streamlines
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::vector<OGRGeometryPtr>> Plugin::findStreamlines(std::size_t hash) const
+{
+  if (hash == Fmi::bad_hash)
+    return {};
+  return itsStreamlineCache.find(hash);
+}
+
+void Plugin::insertStreamlines(std::size_t hash, const std::vector<OGRGeometryPtr>& streamlines)
+{
+  if (hash != Fmi::bad_hash)
+    itsStreamlineCache.insert(hash, streamlines);
+}
+
+#ifndef WITHOUT_OBSERVATION
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache lookup for wind rose statistics of a station
+ */
+// ----------------------------------------------------------------------
+
+std::optional<WindRoseData> Plugin::findWindRose(std::size_t hash) const
+{
+  if (hash == Fmi::bad_hash)
+    return {};
+  return itsWindRoseCache.find(hash);
+}
+
+void Plugin::insertWindRose(std::size_t hash, const WindRoseData& data)
+{
+  if (hash != Fmi::bad_hash)
+    itsWindRoseCache.insert(hash, data);
+}
+#endif
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Return the plugin name
@@ -1123,14 +1667,14 @@ Json::Value Plugin::getProductJson(const Spine::HTTP::Request &theRequest,
 
     std::string product_path = customer_root + "/products/" + theName + ".json";
 
-    if (!std::filesystem::exists(product_path))
+    if (!resourceExists(product_path))
     {
       throw Fmi::Exception(BCP, "Product file not found!").addParameter("File", product_path);
     }
 
     // Read the JSON
 
-    std::string json_text = itsFileCache.get(product_path);
+    std::string json_text = readResource(product_path);
 
     Json::Value json;
     std::unique_ptr<Json::CharReader> reader(charreaderbuilder.newCharReader());
@@ -1212,14 +1756,14 @@ std::string Plugin::resolveFilePath(const std::string &theCustomer,
       file_path = (itsConfig.rootDirectory(theWmsFlag) + "/customers/" + check_attack(theCustomer) +
                    theSubDir + check_attack(theFileName));
       theTestedPaths.push_back(file_path);
-      if (!std::filesystem::exists(file_path))
+      if (!resourceExists(file_path))
         filename.insert(filename.begin(), '/');
     }
     if (filename[0] == '/')
     {
       file_path = itsConfig.rootDirectory(theWmsFlag) + check_attack(filename);
       theTestedPaths.push_back(file_path);
-      if (!std::filesystem::exists(file_path))
+      if (!resourceExists(file_path))
       {
         if (theSubDir == "/filters/")
         {
@@ -1232,11 +1776,11 @@ std::string Plugin::resolveFilePath(const std::string &theCustomer,
           file_path = itsConfig.rootDirectory(theWmsFlag) + "/resources/layers" + theSubDir +
                       check_attack(filename);
           theTestedPaths.push_back(file_path);
-          if (!std::filesystem::exists(file_path))
+          if (!resourceExists(file_path))
             file_path = itsConfig.rootDirectory(theWmsFlag) + "/resources" + theSubDir +
                         check_attack(filename);
           theTestedPaths.push_back(file_path);
-          if (!std::filesystem::exists(file_path))
+          if (!resourceExists(file_path))
             file_path = itsConfig.rootDirectory(theWmsFlag) + "/resources" + check_attack(filename);
           theTestedPaths.push_back(file_path);
         }
@@ -1263,11 +1807,11 @@ std::string Plugin::resolveSvgPath(const std::string &theCustomer,
 
   auto file =
       resolveFilePath(theCustomer, theSubDir, theFileName + ".svg", theWmsFlag, tested_paths);
-  if (std::filesystem::exists(file))
+  if (resourceExists(file))
     return file;
 
   file = resolveFilePath(theCustomer, theSubDir, theFileName, theWmsFlag, tested_paths);
-  if (std::filesystem::exists(file))
+  if (resourceExists(file))
     return file;
 
   return file;
@@ -1284,6 +1828,44 @@ std::string Plugin::resolveSvgPath(const std::string &theCustomer,
 #endif
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Resource file access
+ *
+ * Files in the customer and resource directories are checked from the
+ * in-memory resource index, other paths from the filesystem.
+ */
+// ----------------------------------------------------------------------
+
+bool Plugin::resourceExists(const std::string &thePath) const
+{
+  if (itsResourceIndex)
+    return itsResourceIndex->exists(thePath);
+  return std::filesystem::exists(thePath);
+}
+
+std::string Plugin::readResource(const std::string &thePath) const
+{
+  if (itsResourceIndex)
+  {
+    auto contents = itsResourceIndex->contents(thePath);
+    if (contents)
+      return *contents;
+  }
+  return itsFileCache.get(thePath);
+}
+
+std::size_t Plugin::resourceHash(const std::string &thePath) const
+{
+  if (itsResourceIndex)
+  {
+    auto modified = itsResourceIndex->modified(thePath);
+    if (modified)
+      return *modified;
+  }
+  return itsFileCache.last_modified(thePath);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Get CSS contents from the internal cache
@@ -1303,8 +1885,8 @@ std::string Plugin::getStyle(const std::string &theCustomer,
     std::string css_path =
         resolveFilePath(theCustomer, "/layers/", theCSS, theWmsFlag, tested_files);
 
-    if (std::filesystem::exists(css_path))
-      return itsFileCache.get(css_path);
+    if (resourceExists(css_path))
+      return readResource(css_path);
 
     throw Fmi::Exception(BCP, "Failed to find CSS file").addDetails(tested_files);
   }
@@ -1386,7 +1968,7 @@ std::string Plugin::getFilter(const std::string &theCustomer,
 
     std::string filter_path = resolveSvgPath(theCustomer, "/filters/", theName, theWmsFlag);
 
-    return itsFileCache.get(filter_path);
+    return readResource(filter_path);
   }
   catch (...)
   {
@@ -1413,7 +1995,7 @@ std::size_t Plugin::getFilterHash(const std::string &theCustomer,
 
     std::string filter_path = resolveSvgPath(theCustomer, "/filters/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(filter_path);
+    return resourceHash(filter_path);
   }
   catch (...)
   {
@@ -1438,7 +2020,7 @@ std::string Plugin::getMarker(const std::string &theCustomer,
 
     std::string marker_path = resolveSvgPath(theCustomer, "/markers/", theName, theWmsFlag);
 
-    return itsFileCache.get(marker_path);
+    return readResource(marker_path);
   }
   catch (...)
   {
@@ -1465,7 +2047,7 @@ std::size_t Plugin::getMarkerHash(const std::string &theCustomer,
 
     std::string marker_path = resolveSvgPath(theCustomer, "/markers/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(marker_path);
+    return resourceHash(marker_path);
   }
   catch (...)
   {
@@ -1492,7 +2074,7 @@ std::string Plugin::getSymbol(const std::string &theCustomer,
 
     std::string symbol_path = resolveSvgPath(theCustomer, "/symbols/", theName, theWmsFlag);
 
-    return itsFileCache.get(symbol_path);
+    return readResource(symbol_path);
   }
   catch (...)
   {
@@ -1519,7 +2101,7 @@ std::size_t Plugin::getSymbolHash(const std::string &theCustomer,
 
     std::string symbol_path = resolveSvgPath(theCustomer, "/symbols/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(symbol_path);
+    return resourceHash(symbol_path);
   }
   catch (...)
   {
@@ -1544,7 +2126,7 @@ std::string Plugin::getPattern(const std::string &theCustomer,
 
     std::string pattern_path = resolveSvgPath(theCustomer, "/patterns/", theName, theWmsFlag);
 
-    return itsFileCache.get(pattern_path);
+    return readResource(pattern_path);
   }
   catch (...)
   {
@@ -1571,7 +2153,7 @@ std::size_t Plugin::getPatternHash(const std::string &theCustomer,
 
     std::string pattern_path = resolveSvgPath(theCustomer, "/patterns/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(pattern_path);
+    return resourceHash(pattern_path);
   }
   catch (...)
   {
@@ -1596,7 +2178,7 @@ std::string Plugin::getGradient(const std::string &theCustomer,
 
     std::string gradient_path = resolveSvgPath(theCustomer, "/gradients/", theName, theWmsFlag);
 
-    return itsFileCache.get(gradient_path);
+    return readResource(gradient_path);
   }
   catch (...)
   {
@@ -1623,7 +2205,7 @@ std::size_t Plugin::getGradientHash(const std::string &theCustomer,
 
     std::string gradient_path = resolveSvgPath(theCustomer, "/gradients/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(gradient_path);
+    return resourceHash(gradient_path);
   }
   catch (...)
   {
@@ -1650,8 +2232,8 @@ std::string Plugin::getColorMap(const std::string &theCustomer,
     std::string colormap_path =
         resolveFilePath(theCustomer, "/colormaps/", theName + ".csv", theWmsFlag, tested_files);
 
-    if (std::filesystem::exists(colormap_path))
-      return itsFileCache.get(colormap_path);
+    if (resourceExists(colormap_path))
+      return readResource(colormap_path);
 
     throw Fmi::Exception(BCP, "Failed to find ColorMap file").addDetails(tested_files);
   }
@@ -1680,7 +2262,7 @@ std::size_t Plugin::getColorMapHash(const std::string &theCustomer,
 
     std::string colormap_path = resolveSvgPath(theCustomer, "/colormaps/", theName, theWmsFlag);
 
-    return itsFileCache.last_modified(colormap_path);
+    return resourceHash(colormap_path);
   }
   catch (...)
   {
@@ -1706,8 +2288,42 @@ Fmi::Cache::CacheStatistics Plugin::getCacheStats() const
   ret["Wms::image_cache::memory_cache [B]"] = itsImageCache->getMemoryCacheStats();
   ret["Wms::image_cache::file_cache [B]"] = itsImageCache->getFileCacheStats();
   ret["Wms::css_cache"] = itsStyleSheetCache.statistics();
+  ret["Wms::streamline_cache"] = itsStreamlineCache.statistics();
+#ifndef WITHOUT_OBSERVATION
+  ret["Wms::windrose_cache"] = itsWindRoseCache.statistics();
+#endif
+
+  const auto sample_stats = itsSampleCache.statistics();
+  Fmi::Cache::CacheStats stats;
+  stats.maxsize = sample_stats.maxsize;
+  stats.size = sample_stats.size;
+  stats.inserts = sample_stats.inserts;
+  stats.hits = sample_stats.hits;
+  stats.misses = sample_stats.misses;
+  ret["Wms::sample_cache [B]"] = stats;
+
+  const auto location_stats = itsLocationIndexCache.statistics();
+  stats.maxsize = location_stats.maxsize;
+  stats.size = location_stats.size;
+  stats.inserts = location_stats.inserts;
+  stats.hits = location_stats.hits;
+  stats.misses = location_stats.misses;
+  ret["Wms::location_index [B]"] = stats;
+
+  const auto postgis_stats = itsPostGISFeatureCache.statistics();
+  stats.maxsize = postgis_stats.maxsize;
+  stats.size = postgis_stats.size;
+  stats.inserts = postgis_stats.inserts;
+  stats.hits = postgis_stats.hits;
+  stats.misses = postgis_stats.misses;
+  ret["Wms::postgis_cache [B]"] = stats;
+
   if (itsWMSHandler)
     ret["Wms::capabilities_cache"] = itsWMSHandler->getCapabilitiesCacheStats();
+  if (itsWMTSHandler)
+    ret["Wms::wmts_capabilities_cache"] = itsWMTSHandler->getCapabilitiesCacheStats();
+  if (itsTilesHandler)
+    ret["Wms::tiles_metadata_cache"] = itsTilesHandler->getMetadataCacheStats();
   // TextUtility.cpp uses LRUCache which is not yet comparible
   // ret["Wms::text_extent_cache"] = getTextCacheStats();
 
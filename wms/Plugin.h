@@ -7,8 +7,16 @@
 #pragma once
 
 #include "Config.h"
+#include "CostModel.h"
+#include "LocationIndex.h"
+#include "PostGISFeatureCache.h"
+#include "Prerenderer.h"
 #include "Product.h"
+#include "ResourceIndex.h"
+#include "SampleCache.h"
 #include "StyleSheet.h"
+#include "TileBakery.h"
+#include "WindRoseData.h"
 #include "wms/Handler.h"
 #include "wmts/Handler.h"
 #include "tiles/Handler.h"
@@ -21,6 +29,7 @@
 #include <engines/osm/Engine.h>
 #endif
 #include <engines/querydata/Engine.h>
+#include <gis/Types.h>
 #ifndef WITHOUT_OBSERVATION
 #include <engines/observation/Engine.h>
 #endif
@@ -51,6 +60,10 @@ namespace Dali
 class Filter;
 
 using ImageCache = Spine::SmartMetCache;
+using StreamlineCache = Fmi::Cache::Cache<std::size_t, std::vector<OGRGeometryPtr>>;
+#ifndef WITHOUT_OBSERVATION
+using WindRoseCache = Fmi::Cache::Cache<std::size_t, WindRoseData>;
+#endif
 
 class Plugin : public SmartMetPlugin
 {
@@ -144,8 +157,37 @@ class Plugin : public SmartMetPlugin
                       const Product& theProduct = Product(),
                       std::size_t theHash = 0);
 
+  bool renderDirect(CTPP::CDT& theHash,
+                    const Product& theProduct,
+                    Spine::HTTP::Response& theResponse,
+                    bool usetimer,
+                    std::size_t theProductHash);
+
   std::shared_ptr<std::string> findInImageCache(std::size_t hash) const;
   void insertInImageCache(std::size_t hash, std::shared_ptr<std::string> data);
+  std::shared_ptr<std::string> findInImageCache(std::size_t hash,
+                                                const std::string& theType,
+                                                const Spine::HTTP::Request& theRequest,
+                                                Spine::HTTP::Response& theResponse) const;
+  std::size_t responseHash(std::size_t theHash,
+                           const std::string& theType,
+                           const Spine::HTTP::Request& theRequest) const;
+
+  std::optional<std::vector<OGRGeometryPtr>> findStreamlines(std::size_t hash) const;
+  void insertStreamlines(std::size_t hash, const std::vector<OGRGeometryPtr>& streamlines);
+
+#ifndef WITHOUT_OBSERVATION
+  std::optional<WindRoseData> findWindRose(std::size_t hash) const;
+  void insertWindRose(std::size_t hash, const WindRoseData& data);
+#endif
+
+  SampleCache& getSampleCache() const { return itsSampleCache; }
+
+  LocationIndexCache& getLocationIndexCache() const { return itsLocationIndexCache; }
+
+  PostGISFeatureCache& getPostGISFeatureCache() const { return itsPostGISFeatureCache; }
+
+  TileBakery& getTileBakery() const { return itsTileBakery; }
 
   static Spine::HTTP::ParamMap extractValidParameters(const Spine::HTTP::ParamMap& theParams);
 
@@ -159,6 +201,12 @@ class Plugin : public SmartMetPlugin
                       const Spine::HTTP::Request& theRequest,
                       Spine::HTTP::Response& theResponse) override;
 
+  std::set<std::string> dispatch(Spine::Reactor& theReactor,
+                                 const Spine::HTTP::Request& theRequest,
+                                 Spine::HTTP::Response& theResponse);
+
+  bool prerender(const Spine::HTTP::Request& theRequest);
+
   void daliQuery(Spine::Reactor& theReactor,
                  State& theState,
                  const Spine::HTTP::Request& theRequest,
@@ -175,6 +223,11 @@ class Plugin : public SmartMetPlugin
                              const std::string& theFileName,
                              bool theWmsFlag) const;
 
+  // Resource file access via the resource index when possible
+  bool resourceExists(const std::string& thePath) const;
+  std::string readResource(const std::string& thePath) const;
+  std::size_t resourceHash(const std::string& thePath) const;
+
   static void print(const ParameterInfos& infos);
 
   // Plugin configuration
@@ -206,12 +259,38 @@ class Plugin : public SmartMetPlugin
   mutable Spine::FileCache itsFileCache;
   mutable Spine::JsonCache itsJsonCache;
 
+  // Index of customer and resource files, null if disabled
+  std::unique_ptr<ResourceIndex> itsResourceIndex;
+
   // Style sheet cache
   Fmi::Cache::Cache<std::size_t, StyleSheet> itsStyleSheetCache;
 
+  // Traced streamlines memoized for requests with the identical field and domain
+  mutable StreamlineCache itsStreamlineCache;
+
+#ifndef WITHOUT_OBSERVATION
+  // Wind rose statistics shared by requests for the same station and observations
+  mutable WindRoseCache itsWindRoseCache;
+#endif
+
+  // Resampled querydata shared by requests for the same area and resolution
+  mutable SampleCache itsSampleCache;
+
+  // Projected keyword locations shared by location layers
+  mutable LocationIndexCache itsLocationIndexCache;
+
+  // PostGIS features shared by layers fetching all their classes at once
+  mutable PostGISFeatureCache itsPostGISFeatureCache;
+
+  // Measured render costs for request classification and admission control
+  mutable CostModel itsCostModel;
+
   // Cache results
   mutable std::unique_ptr<ImageCache> itsImageCache;
 
+  // Tiles baked into PMTiles archives, used when the image cache misses
+  mutable TileBakery itsTileBakery;
+
   // WMS handler (owns WMS configuration and state)
   std::unique_ptr<WMS::Handler> itsWMSHandler;
   WMS::Config* itsWMSConfig = nullptr;  // non-owning pointer into itsWMSHandler
@@ -222,6 +301,9 @@ class Plugin : public SmartMetPlugin
   // OGC API - Tiles handler (shares WMS layer registry via itsWMSConfig)
   std::unique_ptr<Tiles::Handler> itsTilesHandler;
 
+  // Re-renders popular requests in the background when their model data changes
+  Prerenderer itsPrerenderer;
+
   // URLs which have already generated a warning or qid duplicates or on some other problem. We do
   // not wish to fill the logs with the same warnings again and again.
   std::set<std::string> itsWarnedURLs;
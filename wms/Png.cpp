@@ -39,6 +39,18 @@ void Png::init(Json::Value& theJson, const Config& /* theConfig */)
         options.maxcolors = json.asInt();
       else if (name == "truecolor")
         options.truecolor = json.asBool();
+      else if (name == "palette")
+      {
+        if (json.isString() && json.asString() == "auto")
+          auto_palette = true;
+        else if (json.isArray() && !json.empty() && json.size() < 256)
+        {
+          for (const auto& colour : json)
+            palette.push_back(colour.asString());
+        }
+        else
+          throw Fmi::Exception(BCP, "Png palette must be 'auto' or an array of 1-255 colours");
+      }
       else
         throw Fmi::Exception(BCP, "Png does not have a setting named '" + name + "'");
     }
@@ -64,6 +76,9 @@ std::size_t Png::hash_value(const State& /* theState */) const
     Fmi::hash_combine(hash, Fmi::hash_value(options.errorfactor));
     Fmi::hash_combine(hash, Fmi::hash_value(options.maxcolors));
     Fmi::hash_combine(hash, Fmi::hash_value(options.truecolor));
+    Fmi::hash_combine(hash, Fmi::hash_value(auto_palette));
+    for (const auto& colour : palette)
+      Fmi::hash_combine(hash, Fmi::hash_value(colour));
     return hash;
   }
   catch (...)
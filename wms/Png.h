@@ -9,6 +9,7 @@
 #include <giza/ColorMapOptions.h>
 #include <json/json.h>
 #include <string>
+#include <vector>
 
 namespace SmartMet
 {
@@ -27,6 +28,11 @@ class Png
 
   Giza::ColorMapOptions options;
 
+  // Fixed palette for indexed output with the Cairo renderer. "auto" derives
+  // it from the colours the layers use, otherwise the colours are listed.
+  bool auto_palette = false;
+  std::vector<std::string> palette;
+
  private:
 };  // class Png
 
@@ -0,0 +1,198 @@
+#include "PointIndex.h"
+#include <macgyver/Exception.h>
+#include <algorithm>
+#include <cmath>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// Identical points cannot be separated, stop splitting at this depth
+const unsigned int max_depth = 24;
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build the quadtree for points given in priority order
+ */
+// ----------------------------------------------------------------------
+
+PointIndex::PointIndex(std::vector<Point> thePoints, std::size_t theLeafSize)
+    : itsLeafSize(std::max<std::size_t>(theLeafSize, 1)), itsPoints(std::move(thePoints))
+{
+  try
+  {
+    itsOrder.reserve(itsPoints.size());
+    for (uint32_t i = 0; i < itsPoints.size(); i++)
+    {
+      const auto& p = itsPoints[i];
+      if (std::isfinite(p.x) && std::isfinite(p.y))
+        itsOrder.push_back(i);
+    }
+
+    if (!itsOrder.empty())
+      build(0, static_cast<uint32_t>(itsOrder.size()), 0);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a node for a range of points, returns the node index
+ */
+// ----------------------------------------------------------------------
+
+int32_t PointIndex::build(uint32_t theBegin, uint32_t theEnd, unsigned int theDepth)
+{
+  Node node;
+  node.begin = theBegin;
+  node.end = theEnd;
+
+  const auto& first = itsPoints[itsOrder[theBegin]];
+  node.xmin = node.xmax = first.x;
+  node.ymin = node.ymax = first.y;
+  for (auto i = theBegin + 1; i < theEnd; i++)
+  {
+    const auto& p = itsPoints[itsOrder[i]];
+    node.xmin = std::min(node.xmin, p.x);
+    node.xmax = std::max(node.xmax, p.x);
+    node.ymin = std::min(node.ymin, p.y);
+    node.ymax = std::max(node.ymax, p.y);
+  }
+
+  const auto index = static_cast<int32_t>(itsNodes.size());
+  itsNodes.push_back(node);
+
+  const bool leaf = (theEnd - theBegin <= itsLeafSize || theDepth >= max_depth ||
+                     (node.xmin == node.xmax && node.ymin == node.ymax));
+  if (leaf)
+  {
+    // Leaves keep the priority order so that small queries need no sorting
+    std::sort(itsOrder.begin() + theBegin, itsOrder.begin() + theEnd);
+    return index;
+  }
+
+  // Split into quadrants around the centre of the points
+
+  const double xmid = 0.5 * (node.xmin + node.xmax);
+  const double ymid = 0.5 * (node.ymin + node.ymax);
+
+  auto below = [this, ymid](uint32_t i) { return itsPoints[i].y < ymid; };
+  auto left = [this, xmid](uint32_t i) { return itsPoints[i].x < xmid; };
+
+  const auto begin = itsOrder.begin() + theBegin;
+  const auto end = itsOrder.begin() + theEnd;
+  const auto ysplit = std::partition(begin, end, below);
+  const auto xsplit1 = std::partition(begin, ysplit, left);
+  const auto xsplit2 = std::partition(ysplit, end, left);
+
+  const uint32_t bounds[5] = {theBegin,
+                              static_cast<uint32_t>(xsplit1 - itsOrder.begin()),
+                              static_cast<uint32_t>(ysplit - itsOrder.begin()),
+                              static_cast<uint32_t>(xsplit2 - itsOrder.begin()),
+                              theEnd};
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (bounds[i] < bounds[i + 1])
+    {
+      const auto child = build(bounds[i], bounds[i + 1], theDepth + 1);
+      itsNodes[index].children[i] = child;
+    }
+  }
+
+  return index;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find the points inside a rectangle
+ */
+// ----------------------------------------------------------------------
+
+std::vector<uint32_t> PointIndex::query(double theX1,
+                                        double theY1,
+                                        double theX2,
+                                        double theY2) const
+{
+  try
+  {
+    std::vector<uint32_t> result;
+    if (itsNodes.empty())
+      return result;
+
+    query(itsNodes.front(),
+          std::min(theX1, theX2),
+          std::min(theY1, theY2),
+          std::max(theX1, theX2),
+          std::max(theY1, theY2),
+          result);
+
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void PointIndex::query(const Node& theNode,
+                       double theX1,
+                       double theY1,
+                       double theX2,
+                       double theY2,
+                       std::vector<uint32_t>& theResult) const
+{
+  if (theNode.xmax < theX1 || theNode.xmin > theX2 || theNode.ymax < theY1 ||
+      theNode.ymin > theY2)
+    return;
+
+  const bool contained = (theNode.xmin >= theX1 && theNode.xmax <= theX2 &&
+                          theNode.ymin >= theY1 && theNode.ymax <= theY2);
+  if (contained)
+  {
+    theResult.insert(
+        theResult.end(), itsOrder.begin() + theNode.begin, itsOrder.begin() + theNode.end);
+    return;
+  }
+
+  bool leaf = true;
+  for (auto child : theNode.children)
+  {
+    if (child >= 0)
+    {
+      leaf = false;
+      query(itsNodes[child], theX1, theY1, theX2, theY2, theResult);
+    }
+  }
+
+  if (!leaf)
+    return;
+
+  for (auto i = theNode.begin; i < theNode.end; i++)
+  {
+    const auto& p = itsPoints[itsOrder[i]];
+    if (p.x >= theX1 && p.x <= theX2 && p.y >= theY1 && p.y <= theY2)
+      theResult.push_back(itsOrder[i]);
+  }
+}
+
+// ----------------------------------------------------------------------
+
+std::size_t PointIndex::memory() const
+{
+  return sizeof(Point) * itsPoints.capacity() + sizeof(uint32_t) * itsOrder.capacity() +
+         sizeof(Node) * itsNodes.capacity();
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,76 @@
+// ======================================================================
+/*!
+ * \brief Static quadtree of points
+ *
+ * The points are given in priority order, and range queries return the
+ * indices of the points inside a rectangle in the same order. This lets
+ * layers which process locations by priority look at only the points
+ * near the rendered area instead of all of them.
+ *
+ * Points with non-finite coordinates, such as locations which cannot be
+ * projected, keep their index but are never returned.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class PointIndex
+{
+ public:
+  struct Point
+  {
+    double x = 0;
+    double y = 0;
+  };
+
+  PointIndex() = default;
+  explicit PointIndex(std::vector<Point> thePoints, std::size_t theLeafSize = 32);
+
+  std::size_t size() const { return itsPoints.size(); }
+  const Point& point(std::size_t theIndex) const { return itsPoints[theIndex]; }
+
+  // Indices of the points inside the closed rectangle in ascending order
+  std::vector<uint32_t> query(double theX1, double theY1, double theX2, double theY2) const;
+
+  // Approximate memory used by the index
+  std::size_t memory() const;
+
+ private:
+  struct Node
+  {
+    double xmin = 0;
+    double ymin = 0;
+    double xmax = 0;
+    double ymax = 0;
+    uint32_t begin = 0;  // range in itsOrder
+    uint32_t end = 0;
+    int32_t children[4] = {-1, -1, -1, -1};
+  };
+
+  int32_t build(uint32_t theBegin, uint32_t theEnd, unsigned int theDepth);
+  void query(const Node& theNode,
+             double theX1,
+             double theY1,
+             double theX2,
+             double theY2,
+             std::vector<uint32_t>& theResult) const;
+
+  std::size_t itsLeafSize = 32;
+  std::vector<Point> itsPoints;
+  std::vector<uint32_t> itsOrder;  // point indices grouped by node
+  std::vector<Node> itsNodes;      // root first
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
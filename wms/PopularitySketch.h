@@ -0,0 +1,155 @@
+// ======================================================================
+/*!
+ * \brief Bounded top-K counter of the most frequent requests
+ *
+ * Implements the Space-Saving algorithm: at most the given number of
+ * keys are counted, and when a new key arrives at a full table it
+ * replaces the key with the smallest count, inheriting that count.
+ * Every key occurring more often than total/capacity is guaranteed to
+ * be in the table, and counts are overestimated by at most the count
+ * inherited on entry.
+ *
+ * Each key carries a value and the set of groups it belongs to, so that
+ * the most frequent values of a group can be listed. Counts can be
+ * halved to let old popularity fade.
+ *
+ * The sketch is thread safe.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+template <typename Value>
+class PopularitySketch
+{
+ public:
+  using Groups = std::set<std::string>;
+
+  explicit PopularitySketch(std::size_t theCapacity = 0) : itsCapacity(theCapacity) {}
+
+  PopularitySketch(const PopularitySketch&) = delete;
+  PopularitySketch& operator=(const PopularitySketch&) = delete;
+
+  void resize(std::size_t theCapacity)
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsCapacity = theCapacity;
+    while (itsEntries.size() > itsCapacity)
+      erase(itsOrder.begin()->second);
+  }
+
+  // Count an occurrence of the key, the value and groups are replaced by the latest ones
+  void record(std::size_t theKey, const Value& theValue, const Groups& theGroups)
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    if (itsCapacity == 0)
+      return;
+
+    std::size_t count = 1;
+
+    auto pos = itsEntries.find(theKey);
+    if (pos != itsEntries.end())
+    {
+      count = pos->second.count + 1;
+      erase(theKey);
+    }
+    else if (itsEntries.size() >= itsCapacity)
+    {
+      // Replace the least frequent key
+      auto least = itsOrder.begin();
+      count = least->first + 1;
+      erase(least->second);
+    }
+
+    itsEntries.emplace(theKey, Entry{theValue, theGroups, count});
+    itsOrder.emplace(count, theKey);
+  }
+
+  // Most frequent values of the group, most frequent first
+  std::vector<Value> top(const std::string& theGroup, std::size_t theCount) const
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    std::vector<Value> ret;
+    for (auto it = itsOrder.rbegin(); it != itsOrder.rend() && ret.size() < theCount; ++it)
+    {
+      const auto& entry = itsEntries.at(it->second);
+      if (entry.groups.count(theGroup) > 0)
+        ret.push_back(entry.value);
+    }
+    return ret;
+  }
+
+  // All groups of the counted keys
+  Groups groups() const
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    Groups ret;
+    for (const auto& key_entry : itsEntries)
+      ret.insert(key_entry.second.groups.begin(), key_entry.second.groups.end());
+    return ret;
+  }
+
+  // Halve all counts, keys whose count drops to zero are removed
+  void decay()
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    std::set<std::pair<std::size_t, std::size_t>> order;
+    for (const auto& count_key : itsOrder)
+    {
+      const auto count = count_key.first / 2;
+      if (count == 0)
+        itsEntries.erase(count_key.second);
+      else
+      {
+        itsEntries.at(count_key.second).count = count;
+        order.emplace(count, count_key.second);
+      }
+    }
+    itsOrder = std::move(order);
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    return itsEntries.size();
+  }
+
+ private:
+  struct Entry
+  {
+    Value value;
+    Groups groups;
+    std::size_t count = 0;
+  };
+
+  void erase(std::size_t theKey)
+  {
+    auto pos = itsEntries.find(theKey);
+    itsOrder.erase(itsOrder.find({pos->second.count, theKey}));
+    itsEntries.erase(pos);
+  }
+
+  std::size_t itsCapacity = 0;
+
+  mutable std::mutex itsMutex;
+  std::unordered_map<std::size_t, Entry> itsEntries;
+  std::set<std::pair<std::size_t, std::size_t>> itsOrder;  // count, key
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,105 @@
+#include "PostGISFeatureCache.h"
+#include <engines/gis/Engine.h>
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+#include <ogr_geometry.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+std::size_t query_hash(const Fmi::SpatialReference& theSR,
+                       const Engine::Gis::MapOptions& theOptions)
+{
+  auto hash = Fmi::hash_value(theOptions.pgname);
+  Fmi::hash_combine(hash, Fmi::hash_value(theOptions.schema));
+  Fmi::hash_combine(hash, Fmi::hash_value(theOptions.table));
+  Fmi::hash_combine(hash, Fmi::hash_value(theOptions.where));
+  for (const auto& name : theOptions.fieldnames)
+    Fmi::hash_combine(hash, Fmi::hash_value(name));
+  Fmi::hash_combine(hash, Fmi::hash_value(theOptions.minarea));
+  Fmi::hash_combine(hash, Fmi::hash_value(theOptions.mindistance));
+  Fmi::hash_combine(hash, theOptions.simplifier.hash_value());
+  Fmi::hash_combine(hash, theSR.hashValue());
+  return hash;
+}
+
+std::size_t memory(const Fmi::Features& theFeatures)
+{
+  std::size_t bytes = sizeof(Fmi::Features);
+  for (const auto& feature : theFeatures)
+  {
+    bytes += sizeof(Fmi::Feature);
+    if (feature->geom)
+      bytes += feature->geom->WkbSize();
+    for (const auto& name_value : feature->attributes)
+      bytes += name_value.first.size() + sizeof(name_value);
+  }
+  return bytes;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the memory and age limits
+ */
+// ----------------------------------------------------------------------
+
+void PostGISFeatureCache::init(std::size_t theMaxBytes, unsigned int theMaxAge)
+{
+  itsMaxBytes = theMaxBytes;
+  itsMaxAge = std::chrono::seconds(theMaxAge);
+  itsCache.resize(theMaxAge > 0 ? theMaxBytes : 0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the features of a query
+ */
+// ----------------------------------------------------------------------
+
+PostGISFeaturesPtr PostGISFeatureCache::get(const Engine::Gis::Engine& theEngine,
+                                            const Fmi::SpatialReference& theSR,
+                                            const Engine::Gis::MapOptions& theOptions)
+{
+  try
+  {
+    auto fetch = [&]()
+    {
+      auto options = theOptions;
+      return std::make_shared<const Fmi::Features>(theEngine.getFeatures(theSR, options));
+    };
+
+    if (itsMaxBytes == 0 || itsMaxAge.count() == 0)
+      return fetch();
+
+    const auto hash = query_hash(theSR, theOptions);
+    const auto now = std::chrono::steady_clock::now();
+
+    // Concurrent requests for the same query wait for the first one to run it
+    auto entry = itsCache.getOrCompute(
+        hash,
+        [&]()
+        {
+          auto features = fetch();
+          return std::make_pair(Entry{features, now}, memory(*features));
+        },
+        [&](const Entry& theEntry) { return now - theEntry.created < itsMaxAge; });
+    return entry.features;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!")
+        .addParameter("schema", theOptions.schema)
+        .addParameter("table", theOptions.table);
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,76 @@
+// ======================================================================
+/*!
+ * \brief Process-wide cache of PostGIS feature queries
+ *
+ * PostGIS layers fetching all their filter classes with one query share
+ * the results with the other requests for the same table, time and
+ * area. The queries cover the requested area aligned to a grid, so that
+ * neighbouring tiles usually issue the same query.
+ *
+ * The Gis engine does not report table versions, so the results are
+ * reused for a limited time only. Concurrent requests for the same
+ * query wait for the first one instead of querying the database again.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "MemoryLimitedCache.h"
+#include <engines/gis/MapOptions.h>
+#include <gis/SpatialReference.h>
+#include <gis/Types.h>
+#include <chrono>
+#include <memory>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Gis
+{
+class Engine;
+}
+}  // namespace Engine
+
+namespace Plugin
+{
+namespace Dali
+{
+using PostGISFeaturesPtr = std::shared_ptr<const Fmi::Features>;
+
+class PostGISFeatureCache
+{
+ public:
+  struct Entry
+  {
+    PostGISFeaturesPtr features;
+    std::chrono::steady_clock::time_point created;
+  };
+
+  using Statistics = MemoryLimitedCache<Entry>::Statistics;
+
+  PostGISFeatureCache() = default;
+  PostGISFeatureCache(const PostGISFeatureCache&) = delete;
+  PostGISFeatureCache& operator=(const PostGISFeatureCache&) = delete;
+
+  // 0 bytes or 0 seconds disables caching
+  void init(std::size_t theMaxBytes, unsigned int theMaxAge);
+
+  // Features of the query, possibly fetched recently by another request. The features
+  // are shared and must not be modified.
+  PostGISFeaturesPtr get(const Engine::Gis::Engine& theEngine,
+                         const Fmi::SpatialReference& theSR,
+                         const Engine::Gis::MapOptions& theOptions);
+
+  Statistics statistics() const { return itsCache.statistics(); }
+
+ private:
+  std::size_t itsMaxBytes = 0;
+  std::chrono::seconds itsMaxAge{0};
+
+  MemoryLimitedCache<Entry> itsCache;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
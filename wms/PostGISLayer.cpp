@@ -1,11 +1,21 @@
 #include "PostGISLayer.h"
 #include "Geometry.h"
+#include "JsonTools.h"
 #include "State.h"
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/replace.hpp>
 #include <ctpp2/CDT.hpp>
 #include <engines/gis/MapOptions.h>
+#include <fmt/format.h>
 #include <gis/OGR.h>
 #include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
 #include <ogr_geometry.h>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <variant>
 
 namespace SmartMet
 {
@@ -13,6 +23,106 @@ namespace Plugin
 {
 namespace Dali
 {
+namespace
+{
+// Smallest grid cell used for aligning the queried area, in degrees
+const double min_area_step = 1.0 / 64;
+
+// Quote a string as an SQL literal
+std::string sql_literal(const std::string& theValue)
+{
+  return "'" + boost::algorithm::replace_all_copy(theValue, "'", "''") + "'";
+}
+
+// The class of a row as text, empty if missing
+std::string class_value(const Fmi::Feature& theFeature, const std::string& theColumn)
+{
+  auto it = theFeature.attributes.find(theColumn);
+  if (it == theFeature.attributes.end())
+    return {};
+  return std::visit(
+      [](const auto& v) -> std::string
+      {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>)
+          return v;
+        else if constexpr (std::is_same_v<T, int>)
+          return Fmi::to_string(v);
+        else if constexpr (std::is_same_v<T, double>)
+          return Fmi::to_string(v);
+        else  // Fmi::DateTime
+          return Fmi::to_iso_string(v);
+      },
+      it->second);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief SQL condition selecting the rows near the map
+ *
+ * The WGS84 bounding box of the map is expanded to a grid whose cell is
+ * at least as large as the box, so that neighbouring tiles usually
+ * issue the same query and share the cached result. The box is
+ * segmentized before it is projected to the table coordinates so that
+ * its edges stay outside the map in curved projections.
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::string> area_condition(const std::map<std::string, double>& theBBox,
+                                          const std::string& theSchema,
+                                          const std::string& theTable,
+                                          const std::string& theColumn)
+{
+  if (theBBox.empty())
+    return {};
+
+  double x1 = theBBox.at("minx");
+  double y1 = theBBox.at("miny");
+  double x2 = theBBox.at("maxx");
+  double y2 = theBBox.at("maxy");
+
+  const double size = std::max(x2 - x1, y2 - y1);
+  double step = min_area_step;
+  while (step < size && step < 360)
+    step *= 2;
+
+  x1 = std::max(-180.0, std::floor(x1 / step) * step);
+  y1 = std::max(-90.0, std::floor(y1 / step) * step);
+  x2 = std::min(180.0, std::ceil(x2 / step) * step);
+  y2 = std::min(90.0, std::ceil(y2 / step) * step);
+
+  return fmt::format(
+      "{0} && ST_Transform(ST_Segmentize(ST_MakeEnvelope({1},{2},{3},{4},4326),1),"
+      "Find_SRID({5},{6},{7}))",
+      theColumn,
+      x1,
+      y1,
+      x2,
+      y2,
+      sql_literal(theSchema),
+      sql_literal(theTable),
+      sql_literal(theColumn));
+}
+
+// Add the polygons or lines of a geometry into a multi geometry of the same kind
+void add_parts(OGRGeometryCollection& theCollection, const OGRGeometry& theGeom)
+{
+  const auto type = wkbFlatten(theGeom.getGeometryType());
+  if (type == wkbMultiPolygon || type == wkbMultiLineString || type == wkbGeometryCollection)
+  {
+    const auto& parts = dynamic_cast<const OGRGeometryCollection&>(theGeom);
+    for (int i = 0; i < parts.getNumGeometries(); i++)
+      add_parts(theCollection, *parts.getGeometryRef(i));
+  }
+  else
+  {
+    // Parts of other kinds are rejected by the collection
+    static_cast<void>(theCollection.addGeometry(&theGeom));
+  }
+}
+
+}  // namespace
+
 void PostGISLayer::init(Json::Value& theJson,
                         const State& theState,
                         const Config& theConfig,
@@ -21,6 +131,17 @@ void PostGISLayer::init(Json::Value& theJson,
   try
   {
     PostGISLayerBase::init(theJson, theState, theConfig, theProperties);
+
+    JsonTools::remove_string(class_column, theJson, "class_column");
+
+    if (class_column)
+    {
+      for (const auto& filter : filters)
+        if (filter.where)
+          throw Fmi::Exception(BCP,
+                               "PostGIS layer filters must select classes with 'value' instead "
+                               "of 'where' when 'class_column' is set");
+    }
   }
   catch (...)
   {
@@ -63,13 +184,65 @@ void PostGISLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Stat
     // Add attributes to the group, not the areas
     theState.addAttributes(theGlobals, group_cdt, attributes);
 
+    const auto shapes = (class_column ? getClassShapes(theState, crs, box, clipbox)
+                                      : getFilterShapes(theState, crs, clipbox));
+
+    unsigned int mapid(1);  // id to concatenate to iri to make it unique
+                            // Store the polygons into the template engine
+    for (std::size_t i = 0; i < filters.size(); i++)
+    {
+      const auto& geom = shapes[i];
+      if (geom && geom->IsEmpty() == 0)
+      {
+        const PostGISLayerFilter& filter = filters[i];
+
+        // Store the path
+        std::string iri = (qid + Fmi::to_string(mapid++));
+
+        CTPP::CDT map_cdt(CTPP::CDT::HASH_VAL);
+        map_cdt["iri"] = iri;
+        map_cdt["type"] = Geometry::name(*geom, theState.getType());
+        map_cdt["layertype"] = "postgis";
+        map_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
+        theState.addPresentationAttributes(map_cdt, css, attributes);
+        theGlobals["paths"][iri] = map_cdt;
+
+        // Add the SVG use element
+        CTPP::CDT tag_cdt(CTPP::CDT::HASH_VAL);
+        tag_cdt["start"] = "<use";
+        tag_cdt["end"] = "/>";
+        theState.addAttributes(theGlobals, tag_cdt, filter.attributes);
+        tag_cdt["attributes"]["xlink:href"] = "#" + iri;
+        group_cdt["tags"].PushBack(tag_cdt);
+      }
+    }
+    // We created only this one layer
+    theLayersCdt.PushBack(group_cdt);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("qid", qid);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Fetch the shapes of the filters with one query each
+ */
+// ----------------------------------------------------------------------
+
+std::vector<OGRGeometryPtr> PostGISLayer::getFilterShapes(const State& theState,
+                                                          const Fmi::SpatialReference& theCRS,
+                                                          const Fmi::Box& theClipBox) const
+{
+  try
+  {
     Engine::Gis::MapOptions mapOptions;
     mapOptions.pgname = pgname;
     mapOptions.schema = schema;
     mapOptions.table = table;
 
-    unsigned int mapid(1);  // id to concatenate to iri to make it unique
-                            // Get the polygons and store them into the template engine
+    std::vector<OGRGeometryPtr> shapes;
     for (const PostGISLayerFilter& filter : filters)
     {
       if (time_condition && filter.where)
@@ -79,44 +252,134 @@ void PostGISLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, Stat
       else if (filter.where)
         mapOptions.where = filter.where;
 
-      OGRGeometryPtr geom = getShape(theState, crs, mapOptions);
+      OGRGeometryPtr geom = getShape(theState, theCRS, mapOptions);
 
       if (geom && geom->IsEmpty() == 0)
       {
         if (isLines())
-          geom.reset(Fmi::OGR::lineclip(*geom, clipbox));
+          geom.reset(Fmi::OGR::lineclip(*geom, theClipBox));
         else
-          geom.reset(Fmi::OGR::polyclip(*geom, clipbox));
+          geom.reset(Fmi::OGR::polyclip(*geom, theClipBox));
+      }
+      shapes.push_back(geom);
+    }
+    return shapes;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-        if (geom && geom->IsEmpty() == 0)
+// ----------------------------------------------------------------------
+/*!
+ * \brief Fetch the shapes of all filters with a single query
+ *
+ * The time condition, the classes of the filters and the map area are
+ * selected in the database, and the rows are assigned to the filters by
+ * the class column. The rows are shared with other requests through the
+ * PostGIS feature cache, and an empty result is not an error since the
+ * map may simply contain no features.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<OGRGeometryPtr> PostGISLayer::getClassShapes(const State& theState,
+                                                         const Fmi::SpatialReference& theCRS,
+                                                         const Fmi::Box& theBox,
+                                                         const Fmi::Box& theClipBox) const
+{
+  try
+  {
+    std::vector<OGRGeometryPtr> shapes(filters.size());
+    if (filters.empty())
+      return shapes;
+
+    Engine::Gis::MapOptions mapOptions;
+    mapOptions.pgname = pgname;
+    mapOptions.schema = schema;
+    mapOptions.table = table;
+    mapOptions.fieldnames.insert(*class_column);
+
+    std::vector<std::string> conditions;
+    if (time_condition)
+      conditions.push_back(*time_condition);
+
+    // Fetch only the classes in use unless some filter accepts all rows
+    std::string values;
+    for (const auto& filter : filters)
+    {
+      if (!filter.value)
+      {
+        values.clear();
+        break;
+      }
+      if (!values.empty())
+        values += ',';
+      values += sql_literal(*filter.value);
+    }
+    if (!values.empty())
+      conditions.push_back(fmt::format("{}::text IN ({})", *class_column, values));
+
+    if (geometry_column)
+    {
+      auto area =
+          area_condition(getClipBoundingBox(theBox, theCRS), schema, table, *geometry_column);
+      if (area)
+        conditions.push_back(*area);
+    }
+
+    if (!conditions.empty())
+      mapOptions.where = "(" + boost::algorithm::join(conditions, ") AND (") + ")";
+
+    auto features =
+        theState.getPostGISFeatureCache().get(theState.getGisEngine(), theCRS, mapOptions);
+
+    std::vector<std::unique_ptr<OGRGeometryCollection>> collections;
+    for (std::size_t i = 0; i < filters.size(); i++)
+    {
+      if (isLines())
+        collections.push_back(std::make_unique<OGRMultiLineString>());
+      else
+        collections.push_back(std::make_unique<OGRMultiPolygon>());
+    }
+
+    for (const auto& feature : *features)
+    {
+      if (!feature->geom || feature->geom->IsEmpty() != 0)
+        continue;
+
+      const auto value = class_value(*feature, *class_column);
+
+      // The cached geometry is shared, clip a copy only if some filter accepts the row
+      std::unique_ptr<OGRGeometry> clipped;
+      for (std::size_t i = 0; i < filters.size(); i++)
+      {
+        if (filters[i].value && *filters[i].value != value)
+          continue;
+
+        if (!clipped)
         {
-          // Store the path
-          std::string iri = (qid + Fmi::to_string(mapid++));
-
-          CTPP::CDT map_cdt(CTPP::CDT::HASH_VAL);
-          map_cdt["iri"] = iri;
-          map_cdt["type"] = Geometry::name(*geom, theState.getType());
-          map_cdt["layertype"] = "postgis";
-          map_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
-          theState.addPresentationAttributes(map_cdt, css, attributes);
-          theGlobals["paths"][iri] = map_cdt;
-
-          // Add the SVG use element
-          CTPP::CDT tag_cdt(CTPP::CDT::HASH_VAL);
-          tag_cdt["start"] = "<use";
-          tag_cdt["end"] = "/>";
-          theState.addAttributes(theGlobals, tag_cdt, filter.attributes);
-          tag_cdt["attributes"]["xlink:href"] = "#" + iri;
-          group_cdt["tags"].PushBack(tag_cdt);
+          if (isLines())
+            clipped.reset(Fmi::OGR::lineclip(*feature->geom, theClipBox));
+          else
+            clipped.reset(Fmi::OGR::polyclip(*feature->geom, theClipBox));
+          if (!clipped || clipped->IsEmpty() != 0)
+            break;
         }
+        add_parts(*collections[i], *clipped);
       }
     }
-    // We created only this one layer
-    theLayersCdt.PushBack(group_cdt);
+
+    for (std::size_t i = 0; i < filters.size(); i++)
+      if (collections[i]->IsEmpty() == 0)
+        shapes[i].reset(collections[i].release());
+
+    return shapes;
   }
   catch (...)
   {
-    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("qid", qid);
+    throw Fmi::Exception::Trace(BCP, "Operation failed!")
+        .addParameter("class_column", *class_column);
   }
 }
 
@@ -135,7 +398,11 @@ std::size_t PostGISLayer::hash_value(const State& theState) const
 {
   try
   {
-    return PostGISLayerBase::hash_value(theState);
+    auto hash = PostGISLayerBase::hash_value(theState);
+    Fmi::hash_combine(hash, Fmi::hash_value(class_column));
+    if (class_column)
+      Fmi::hash_combine(hash, Fmi::hash_value(geometry_column));
+    return hash;
   }
   catch (...)
   {
@@ -9,7 +9,11 @@
 #include "Attributes.h"
 #include "PostGISLayerBase.h"
 
+#include <gis/Box.h>
 #include <gis/Types.h>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace SmartMet
 {
@@ -33,6 +37,20 @@ class PostGISLayer : public PostGISLayerBase
   void getFeatureInfo(CTPP::CDT& theInfo, const State& theState) override;
 
   std::size_t hash_value(const State& theState) const override;
+
+ private:
+  // Column whose value selects the filter of each row. If set, all filters are
+  // fetched with a single query limited to the map area.
+  std::optional<std::string> class_column;
+
+  std::vector<OGRGeometryPtr> getFilterShapes(const State& theState,
+                                              const Fmi::SpatialReference& theCRS,
+                                              const Fmi::Box& theClipBox) const;
+
+  std::vector<OGRGeometryPtr> getClassShapes(const State& theState,
+                                             const Fmi::SpatialReference& theCRS,
+                                             const Fmi::Box& theBox,
+                                             const Fmi::Box& theClipBox) const;
 };
 
 }  // namespace Dali
@@ -81,8 +81,7 @@ void PostGISLayerBase::init(Json::Value& theJson,
     JsonTools::remove_string(pgname, theJson, "pgname");
     JsonTools::remove_string(schema, theJson, "schema");
     JsonTools::remove_string(table, theJson, "table");
-    // Needed only for GetCapabilities responses
-    static_cast<void>(JsonTools::remove(theJson, "geometry_column"));
+    JsonTools::remove_string(geometry_column, theJson, "geometry_column");
 
     if (pgname.empty())
       throw Fmi::Exception(BCP, "'pgname' must be defined for postgis layer");
@@ -52,6 +52,7 @@ class PostGISLayerBase : public Layer
   std::string pgname;
   std::string schema;
   std::string table;
+  std::optional<std::string> geometry_column;  // Needed for GetCapabilities and area selection
 
   double precision = 1.0;
   std::optional<std::string> time_column;     // Needed for GetCapabilities
@@ -34,6 +34,8 @@ void PostGISLayerFilter::init(Json::Value& theJson, const Config& theConfig)
 
       if (name == "where")
         where = json.asString();
+      else if (name == "value")
+        value = json.asString();
       else if (name == "attributes")
         attributes.init(json, theConfig);
       else if (name == "text_attributes")
@@ -59,6 +61,7 @@ std::size_t PostGISLayerFilter::hash_value(const State& theState) const
   try
   {
     auto hash = Fmi::hash_value(where);
+    Fmi::hash_combine(hash, Fmi::hash_value(value));
     Fmi::hash_combine(hash, Dali::hash_value(attributes, theState));
     return hash;
   }
@@ -24,6 +24,8 @@ class PostGISLayerFilter
   std::size_t hash_value(const State& theState) const;
 
   std::optional<std::string> where;
+  // Value of the class column selecting the rows when the layer fetches all classes at once
+  std::optional<std::string> value;
   // SVG attributes for geometry (id, class, style, ...)
   Attributes attributes;
   // SVG attributes for text
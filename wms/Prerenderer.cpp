@@ -0,0 +1,209 @@
+#include "Prerenderer.h"
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+#include <macgyver/Exception.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// Popularity is halved this often so that the sketch follows changes in the traffic
+const auto decay_period = std::chrono::hours(1);
+
+// Headers which let a request finish without rendering: ETag probes from the frontend
+// are answered with 204, and conditional requests may get a 304 or 412.
+const char* const conditional_headers[] = {"X-Request-ETag",
+                                           "If-None-Match",
+                                           "If-Match",
+                                           "If-Modified-Since",
+                                           "If-Unmodified-Since",
+                                           "If-Range"};
+}  // namespace
+
+Prerenderer::~Prerenderer()
+{
+  if (itsUpdateTask)
+  {
+    itsUpdateTask->cancel();
+    itsUpdateTask->wait();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start the update loop if enabled
+ */
+// ----------------------------------------------------------------------
+
+void Prerenderer::init(const Settings& theSettings, Version theVersion, Renderer theRenderer)
+{
+  try
+  {
+    itsSettings = theSettings;
+    if (!itsSettings.enabled || itsSettings.max_requests == 0 || itsSettings.max_renders == 0)
+      return;
+
+    itsVersion = std::move(theVersion);
+    itsRenderer = std::move(theRenderer);
+    itsSketch.resize(itsSettings.max_requests);
+    itsLastDecay = std::chrono::steady_clock::now();
+
+    itsUpdateTask.reset(new Fmi::AsyncTask("prerender", [this]() { updateLoop(); }));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Prerenderer::shutdown()
+{
+  try
+  {
+    if (itsUpdateTask)
+    {
+      itsUpdateTask->cancel();
+      itsUpdateTask->wait();
+      itsUpdateTask.reset();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Count a request
+ *
+ * The request is stored without the headers which would let its replay
+ * finish without rendering anything.
+ */
+// ----------------------------------------------------------------------
+
+void Prerenderer::record(std::size_t theKey,
+                         const Spine::HTTP::Request& theRequest,
+                         const std::set<std::string>& theProducers)
+{
+  try
+  {
+    if (!itsSettings.enabled || theProducers.empty())
+      return;
+
+    itsSketch.record(theKey, replayable(theRequest), theProducers);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The request without probe and conditional headers
+ */
+// ----------------------------------------------------------------------
+
+Spine::HTTP::Request Prerenderer::replayable(const Spine::HTTP::Request& theRequest)
+{
+  try
+  {
+    auto request = theRequest;
+    for (const auto* header : conditional_headers)
+      request.removeHeader(header);
+    return request;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void Prerenderer::updateLoop()
+{
+  while (true)
+  {
+    // Interruption point for cancel()
+    boost::this_thread::sleep_for(boost::chrono::seconds(itsSettings.interval));
+    try
+    {
+      update();
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Could not prerender products!", nullptr);
+      exception.printError();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replay the popular requests of producers with new data
+ *
+ * The first version seen of a producer is only remembered, since the
+ * requests counted so far were rendered with it.
+ */
+// ----------------------------------------------------------------------
+
+void Prerenderer::update()
+{
+  for (const auto& producer : itsSketch.groups())
+  {
+    boost::this_thread::interruption_point();
+
+    std::size_t version = 0;
+    try
+    {
+      version = itsVersion(producer);
+    }
+    catch (...)
+    {
+      // The producer may have been removed from the engine
+      continue;
+    }
+
+    auto pos = itsVersions.find(producer);
+    if (pos == itsVersions.end())
+    {
+      itsVersions.emplace(producer, version);
+      continue;
+    }
+
+    if (pos->second == version)
+      continue;
+    pos->second = version;
+
+    for (const auto& request : itsSketch.top(producer, itsSettings.max_renders))
+    {
+      boost::this_thread::interruption_point();
+      try
+      {
+        if (!itsRenderer(request))
+          break;
+      }
+      catch (...)
+      {
+        Fmi::Exception exception(BCP, "Prerendering failed!", nullptr);
+        exception.addParameter("URI", request.getURI());
+        exception.printError();
+      }
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  if (now - itsLastDecay >= decay_period)
+  {
+    itsSketch.decay();
+    itsLastDecay = now;
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
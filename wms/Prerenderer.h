@@ -0,0 +1,95 @@
+// ======================================================================
+/*!
+ * \brief Background re-rendering of popular products on new model data
+ *
+ * Product hashes include the version of the querydata used, so when a
+ * new model run arrives all cached images of the producer are orphaned
+ * and the next requests for them pay the full rendering cost at once.
+ *
+ * The prerenderer counts the requests which used the latest data of a
+ * producer in a bounded popularity sketch. A background task polls the
+ * data versions of the producers in the sketch, and when a version
+ * changes it replays the most popular requests of the producer so that
+ * the new images are in the image cache before the clients ask for
+ * them.
+ *
+ * The requests are replayed one at a time, and only while the admission
+ * control lets expensive requests through, so client requests always
+ * take precedence.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "PopularitySketch.h"
+#include <macgyver/AsyncTask.h>
+#include <spine/HTTP.h>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class Prerenderer
+{
+ public:
+  struct Settings
+  {
+    bool enabled = false;
+    unsigned int max_requests = 1000;  // size of the popularity sketch
+    unsigned int max_renders = 50;     // requests replayed per producer update
+    unsigned int interval = 10;        // seconds between data version checks
+  };
+
+  // Current data version of a producer
+  using Version = std::function<std::size_t(const std::string& theProducer)>;
+
+  // Render the request into the image cache. Returns false if the server is too busy.
+  using Renderer = std::function<bool(const Spine::HTTP::Request& theRequest)>;
+
+  Prerenderer() = default;
+  ~Prerenderer();
+
+  Prerenderer(const Prerenderer&) = delete;
+  Prerenderer& operator=(const Prerenderer&) = delete;
+
+  void init(const Settings& theSettings, Version theVersion, Renderer theRenderer);
+  void shutdown();
+
+  // Count a successful request which used the latest data of the producers
+  void record(std::size_t theKey,
+              const Spine::HTTP::Request& theRequest,
+              const std::set<std::string>& theProducers);
+
+  // The request without the ETag probe and conditional headers, which would
+  // let the replay end with a 204, 304 or 412 response without rendering
+  static Spine::HTTP::Request replayable(const Spine::HTTP::Request& theRequest);
+
+ private:
+  void updateLoop();
+  void update();
+
+  Settings itsSettings;
+  Version itsVersion;
+  Renderer itsRenderer;
+
+  PopularitySketch<Spine::HTTP::Request> itsSketch;
+
+  // Latest seen data versions, accessed only by the update task
+  std::map<std::string, std::size_t> itsVersions;
+  std::chrono::steady_clock::time_point itsLastDecay;
+
+  std::unique_ptr<Fmi::AsyncTask> itsUpdateTask;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
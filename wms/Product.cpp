@@ -1,5 +1,6 @@
 #include "Product.h"
 #include "Config.h"
+#include "CostModel.h"
 #include "Hash.h"
 #include "JsonTools.h"
 #include "Layer.h"
@@ -40,6 +41,16 @@ void Product::init(Json::Value& theJson, const State& theState, const Config& th
     JsonTools::remove_string(type, theJson, "type");
     JsonTools::remove_int(width, theJson, "width");
     JsonTools::remove_int(height, theJson, "height");
+    JsonTools::remove_string(renderer, theJson, "renderer");
+
+    if (renderer != "svg" && renderer != "cairo")
+      throw Fmi::Exception(BCP, "Unknown product renderer '" + renderer + "', use svg or cairo");
+
+    JsonTools::remove_string(svg_paths, theJson, "svg_paths");
+    if (svg_paths != "absolute" && svg_paths != "compact")
+      throw Fmi::Exception(
+          BCP, "Unknown svg_paths setting '" + svg_paths + "', use absolute or compact");
+    theState.compact_svg_paths = (svg_paths == "compact");
 
     auto json = JsonTools::remove(theJson, "title");
     if (!json.isNull())
@@ -108,6 +119,9 @@ void Product::generate(CTPP::CDT& theGlobals, State& theState)
 {
   try
   {
+    // Only requests which render are measured by the cost model
+    CostModel::markRendered();
+
     // Initialize the structure
 
     theGlobals["styles"] = CTPP::CDT(CTPP::CDT::HASH_VAL);
@@ -223,6 +237,18 @@ void Product::getFeatureInfo(CTPP::CDT& theInfo, const State& theState)
   views.getFeatureInfo(theInfo, theState);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move the valid time of the product and all its layers
+ */
+// ----------------------------------------------------------------------
+
+void Product::shiftValidTime(const Fmi::TimeDuration& theOffset)
+{
+  Properties::shiftValidTime(theOffset);
+  views.shiftValidTime(theOffset);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Hash value
@@ -245,6 +271,8 @@ std::size_t Product::hash_value(const State& theState) const
     Fmi::hash_combine(hash, Dali::hash_value(views, theState));
     Fmi::hash_combine(hash, Dali::hash_value(png, theState));
     Fmi::hash_combine(hash, Dali::hash_value(webp, theState));
+    Fmi::hash_combine(hash, Fmi::hash_value(renderer));
+    Fmi::hash_combine(hash, Fmi::hash_value(svg_paths));
     Fmi::hash_combine(hash, animation.hash_value(theState));
     return hash;
   }
@@ -264,6 +292,8 @@ std::string Product::generateGeoTiff(State& theState)
 {
   try
   {
+    CostModel::markRendered();
+
     for (const auto& view : views.views)
     {
       for (const auto& layer : view->layers.layers)
@@ -291,6 +321,8 @@ std::string Product::generateMVT(State& theState)
 {
   try
   {
+    CostModel::markRendered();
+
     // Fast path: if any layer provides pre-encoded MVT bytes (e.g. PMTiles
     // backend), return them directly without going through the tile builder.
     // This is only used when the product consists of a single PMTiles layer
@@ -331,6 +363,8 @@ std::string Product::generateDataTile(State& theState)
 {
   try
   {
+    CostModel::markRendered();
+
     for (const auto& view : views.views)
     {
       for (const auto& layer : view->layers.layers)
@@ -42,6 +42,9 @@ class Product : public Properties
   std::size_t hash_value(const State& theState) const;
   void getFeatureInfo(CTPP::CDT& theInfo, const State& theState);
 
+  // Move the valid times of all layers, for example for the next step of a time series
+  void shiftValidTime(const Fmi::TimeDuration& theOffset);
+
   ParameterInfos getGridParameterInfo(const State& theState) const;
 
   // Returns GeoTiff bytes by finding the first geotiff layer in the product.
@@ -81,6 +84,13 @@ class Product : public Properties
   // WebP rendering options
   Webp webp;
 
+  // Raster backend: "svg" renders the template output with librsvg, "cairo"
+  // draws the generated layers directly when they are supported
+  std::string renderer = "svg";
+
+  // SVG path data: "absolute" coordinates as before, or "compact" relative quantised paths
+  std::string svg_paths = "absolute";
+
  private:
 };  // class Product
 
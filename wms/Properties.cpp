@@ -251,6 +251,18 @@ void Properties::setValidTime(const Fmi::DateTime& theTime)
   time = theTime;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move the valid time, if any, keeping the time offset
+ */
+// ----------------------------------------------------------------------
+
+void Properties::shiftValidTime(const Fmi::TimeDuration& theOffset)
+{
+  if (time)
+    *time += theOffset;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Establish valid time if not set already
@@ -47,6 +47,7 @@ class Properties
 
   bool hasValidTime() const;
   void setValidTime(const Fmi::DateTime& theTime);
+  void shiftValidTime(const Fmi::TimeDuration& theOffset);
   Fmi::DateTime getValidTime() const;
   Fmi::DateTime getValidTime(const Fmi::DateTime& theDefault) const;
   Fmi::TimePeriod getValidTimePeriod() const;
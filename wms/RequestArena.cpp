@@ -0,0 +1,65 @@
+#include "RequestArena.h"
+#include <fmt/format.h>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// Size of the first block, later blocks grow geometrically
+const std::size_t initial_size = 64 * 1024;
+}  // namespace
+
+RequestArena::RequestArena()
+    : itsHeap(std::pmr::new_delete_resource()),
+      itsArena(initial_size, &itsHeap),
+      itsCounter(&itsArena)
+{
+}
+
+void* RequestArena::Counter::do_allocate(std::size_t theBytes, std::size_t theAlignment)
+{
+  auto* ptr = itsUpstream->allocate(theBytes, theAlignment);
+  ++allocations;
+  bytes += theBytes;
+  return ptr;
+}
+
+void RequestArena::Counter::do_deallocate(void* thePtr,
+                                          std::size_t theBytes,
+                                          std::size_t theAlignment)
+{
+  itsUpstream->deallocate(thePtr, theBytes, theAlignment);
+}
+
+bool RequestArena::Counter::do_is_equal(const std::pmr::memory_resource& theOther) const noexcept
+{
+  return this == &theOther;
+}
+
+RequestArena::Statistics RequestArena::statistics() const
+{
+  Statistics stats;
+  stats.allocations = itsCounter.allocations;
+  stats.bytes = itsCounter.bytes;
+  stats.heap_allocations = itsHeap.allocations;
+  stats.heap_bytes = itsHeap.bytes;
+  return stats;
+}
+
+std::string RequestArena::report() const
+{
+  const auto stats = statistics();
+  return fmt::format("Request arena: {} allocations, {} bytes, {} heap blocks, {} heap bytes",
+                     stats.allocations,
+                     stats.bytes,
+                     stats.heap_allocations,
+                     stats.heap_bytes);
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,297 @@
+#include "ResourceIndex.h"
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/FileSystem.h>
+#include <macgyver/Hash.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+// Guard against symbolic link loops
+const int max_depth = 32;
+
+// Paths with empty, . or .. components are left for the filesystem to resolve
+bool is_canonical(const std::string& thePath)
+{
+  return (thePath.find("//") == std::string::npos && thePath.find("/./") == std::string::npos &&
+          thePath.find("/../") == std::string::npos);
+}
+
+std::string read_file(const std::string& thePath)
+{
+  std::ifstream in(thePath, std::ios::in | std::ios::binary);
+  if (!in)
+    throw Fmi::Exception(BCP, "Failed to open file for reading").addParameter("File", thePath);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Construct the index for the given root directories
+ *
+ * Empty and duplicate roots are ignored. Nothing is scanned until init().
+ */
+// ----------------------------------------------------------------------
+
+ResourceIndex::ResourceIndex(const std::vector<std::string>& theRoots)
+    : itsFiles(std::make_shared<const Files>())
+{
+  for (auto root : theRoots)
+  {
+    while (!root.empty() && root.back() == '/')
+      root.pop_back();
+    if (root.empty())
+      continue;
+
+    for (const auto* dir : {"/customers/", "/resources/"})
+    {
+      auto prefix = root + dir;
+      if (std::find(itsPrefixes.begin(), itsPrefixes.end(), prefix) == itsPrefixes.end())
+        itsPrefixes.push_back(prefix);
+    }
+  }
+}
+
+ResourceIndex::~ResourceIndex()
+{
+  if (itsUpdateTask)
+  {
+    itsUpdateTask->cancel();
+    itsUpdateTask->wait();
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Do the first scan and start the update loop
+ */
+// ----------------------------------------------------------------------
+
+void ResourceIndex::init(unsigned int theInterval, std::size_t theMaxBytes)
+{
+  try
+  {
+    itsContents.resize(theMaxBytes);
+    update();
+
+    if (theInterval > 0)
+      itsUpdateTask.reset(new Fmi::AsyncTask("upd-resources",
+                                             [this, theInterval]() { updateLoop(theInterval); }));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void ResourceIndex::shutdown()
+{
+  try
+  {
+    if (itsUpdateTask)
+    {
+      itsUpdateTask->cancel();
+      itsUpdateTask->wait();
+      itsUpdateTask.reset();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+void ResourceIndex::updateLoop(unsigned int theInterval)
+{
+  while (true)
+  {
+    // Interruption point for cancel()
+    boost::this_thread::sleep_for(boost::chrono::seconds(theInterval));
+    try
+    {
+      update();
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Could not update the resource index!", nullptr);
+      exception.printError();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Rescan the indexed directories
+ *
+ * Cached contents are keyed by the modification time and size too, so
+ * the contents of changed files are no longer found and age out of the
+ * cache.
+ */
+// ----------------------------------------------------------------------
+
+void ResourceIndex::update()
+{
+  try
+  {
+    auto files = std::make_shared<Files>();
+
+    for (const auto& prefix : itsPrefixes)
+    {
+      const std::string dir = prefix.substr(0, prefix.size() - 1);
+
+      std::error_code ec;
+      if (std::filesystem::is_directory(dir, ec))
+        scan(dir, 0, *files);
+    }
+
+    std::atomic_store(&itsFiles, std::shared_ptr<const Files>(files));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index the regular files in a directory and its subdirectories
+ *
+ * Unlike std::filesystem::recursive_directory_iterator, which ends the
+ * whole iteration when it fails to enter a directory, an entry which
+ * cannot be examined is skipped and the scan continues with the next
+ * one.
+ */
+// ----------------------------------------------------------------------
+
+void ResourceIndex::scan(const std::string& theDirectory, int theDepth, Files& theFiles) const
+{
+  std::error_code ec;
+  std::filesystem::directory_iterator it(
+      theDirectory, std::filesystem::directory_options::skip_permission_denied, ec);
+  const std::filesystem::directory_iterator end;
+  for (; !ec && it != end; it.increment(ec))
+  {
+    const auto& path = it->path();
+
+    // Directory symlinks are followed
+    std::error_code fec;
+    if (it->is_directory(fec))
+    {
+      if (!fec && theDepth + 1 < max_depth)
+        scan(path.string(), theDepth + 1, theFiles);
+      continue;
+    }
+
+    if (fec)
+      continue;
+    if (!it->is_regular_file(fec) || fec)
+      continue;
+
+    Entry entry;
+    entry.modified = Fmi::last_write_time(path, fec);
+    if (fec)
+      continue;
+    entry.size = std::filesystem::file_size(path, fec);
+    if (fec)
+      continue;
+
+    theFiles.emplace(path.string(), entry);
+  }
+}
+
+std::shared_ptr<const ResourceIndex::Files> ResourceIndex::snapshot() const
+{
+  return std::atomic_load(&itsFiles);
+}
+
+bool ResourceIndex::covers(const std::string& thePath) const
+{
+  for (const auto& prefix : itsPrefixes)
+    if (thePath.compare(0, prefix.size(), prefix) == 0)
+      return is_canonical(thePath);
+  return false;
+}
+
+bool ResourceIndex::exists(const std::string& thePath) const
+{
+  try
+  {
+    if (!covers(thePath))
+      return std::filesystem::exists(thePath);
+
+    return snapshot()->count(thePath) > 0;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("File", thePath);
+  }
+}
+
+std::optional<std::time_t> ResourceIndex::modified(const std::string& thePath) const
+{
+  if (!covers(thePath))
+    return {};
+
+  auto files = snapshot();
+  auto pos = files->find(thePath);
+  if (pos == files->end())
+    return {};
+  return pos->second.modified;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get file contents, reading the file if it has not been cached
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const std::string> ResourceIndex::contents(const std::string& thePath) const
+{
+  try
+  {
+    if (!covers(thePath))
+      return nullptr;
+
+    auto files = snapshot();
+    auto pos = files->find(thePath);
+    if (pos == files->end())
+      return nullptr;
+
+    auto key = Fmi::hash_value(thePath);
+    Fmi::hash_combine(key, Fmi::hash_value(static_cast<int64_t>(pos->second.modified)));
+    Fmi::hash_combine(key, Fmi::hash_value(static_cast<uint64_t>(pos->second.size)));
+
+    if (auto cached = itsContents.find(key))
+      return *cached;
+
+    // Concurrent readers of the same file may race harmlessly
+    auto data = std::make_shared<const std::string>(read_file(thePath));
+    itsContents.insert(key, data, data->size());
+    return data;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+std::size_t ResourceIndex::size() const
+{
+  return snapshot()->size();
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
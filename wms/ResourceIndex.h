@@ -0,0 +1,104 @@
+// ======================================================================
+/*!
+ * \brief In-memory index of the customer and resource directories
+ *
+ * Every symbol, filter, marker, pattern, gradient and colour map used by
+ * a product is resolved by probing several candidate paths in the
+ * customers and resources directories. Doing that with stat() calls
+ * generates hundreds of system calls per request for symbol-heavy
+ * products.
+ *
+ * The index scans <root>/customers and <root>/resources once at startup
+ * and then periodically in a background task, publishing each scan as an
+ * immutable snapshot of path -> modification time. Existence checks and
+ * hashes are answered from the snapshot, and file contents are cached
+ * until the scan notices a change in the modification time or size. The
+ * cached contents are limited by their total size.
+ *
+ * Files added or modified after the last scan are not seen until the
+ * next one, which is why the index is opt-in. Entries which cannot be
+ * read during a scan are skipped.
+ *
+ * Paths outside the indexed directories are not covered and the caller
+ * must check them from the filesystem as before.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "MemoryLimitedCache.h"
+#include <macgyver/AsyncTask.h>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class ResourceIndex
+{
+ public:
+  explicit ResourceIndex(const std::vector<std::string>& theRoots);
+  ~ResourceIndex();
+
+  ResourceIndex() = delete;
+  ResourceIndex(const ResourceIndex&) = delete;
+  ResourceIndex& operator=(const ResourceIndex&) = delete;
+
+  // Do the first scan and start rescanning every theInterval seconds (0 = never).
+  // At most theMaxBytes of file contents are cached.
+  void init(unsigned int theInterval, std::size_t theMaxBytes = 10 * 1024 * 1024);
+  void shutdown();
+
+  // Rescan all roots and publish a new snapshot
+  void update();
+
+  // True if the path is under an indexed directory
+  bool covers(const std::string& thePath) const;
+
+  // Existence check, from the filesystem if the path is not covered
+  bool exists(const std::string& thePath) const;
+
+  // Modification time and contents of an indexed file. nullopt/nullptr if the
+  // path is not covered or the file does not exist.
+  std::optional<std::time_t> modified(const std::string& thePath) const;
+  std::shared_ptr<const std::string> contents(const std::string& thePath) const;
+
+  // Number of indexed files
+  std::size_t size() const;
+
+ private:
+  struct Entry
+  {
+    std::time_t modified = 0;
+    std::uintmax_t size = 0;
+  };
+
+  using Files = std::unordered_map<std::string, Entry>;
+
+  std::shared_ptr<const Files> snapshot() const;
+  void updateLoop(unsigned int theInterval);
+  void scan(const std::string& theDirectory, int theDepth, Files& theFiles) const;
+
+  // Indexed directories with a trailing slash
+  std::vector<std::string> itsPrefixes;
+
+  // Latest scan, accessed via atomic_load and atomic_store
+  std::shared_ptr<const Files> itsFiles;
+
+  // File contents by path, modification time and size
+  mutable MemoryLimitedCache<std::shared_ptr<const std::string>> itsContents;
+
+  std::unique_ptr<Fmi::AsyncTask> itsUpdateTask;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,140 @@
+#include "SampleCache.h"
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+#include <newbase/NFmiFastQueryInfo.h>
+#include <spine/Parameter.h>
+#include <algorithm>
+#include <cmath>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+struct Extent
+{
+  double xmin;
+  double ymin;
+  double xmax;
+  double ymax;
+};
+
+// Expand the box to blocks aligned to twice its size. Boxes of the same size,
+// such as tiles at one zoom level, then share the blocks.
+Extent expand(const Fmi::Box& theBox, const Fmi::SpatialReference& theCRS)
+{
+  Extent extent{theBox.xmin(), theBox.ymin(), theBox.xmax(), theBox.ymax()};
+
+  const double w = 2 * (extent.xmax - extent.xmin);
+  const double h = 2 * (extent.ymax - extent.ymin);
+  if (!(w > 0) || !(h > 0))
+    return extent;
+
+  Extent block{std::floor(extent.xmin / w) * w,
+               std::floor(extent.ymin / h) * h,
+               std::ceil(extent.xmax / w) * w,
+               std::ceil(extent.ymax / h) * h};
+
+  // Do not expand beyond the valid range unless the box itself is already outside it
+  if (theCRS.isGeographic())
+  {
+    block.xmin = std::max(block.xmin, std::min(extent.xmin, -180.0));
+    block.xmax = std::min(block.xmax, std::max(extent.xmax, 180.0));
+    block.ymin = std::max(block.ymin, std::min(extent.ymin, -90.0));
+    block.ymax = std::min(block.ymax, std::max(extent.ymax, 90.0));
+  }
+
+  return block;
+}
+
+// Approximate memory used by querydata values
+std::size_t data_size(const Engine::Querydata::Q& theQ)
+{
+  auto info = theQ->info();
+  return sizeof(float) * info->GridXNumber() * info->GridYNumber() * info->SizeLevels() *
+         info->SizeParams() * info->SizeTimes();
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the memory limit and whether to expand the sampled area
+ */
+// ----------------------------------------------------------------------
+
+void SampleCache::init(std::size_t theMaxBytes, bool theExpand)
+{
+  itsMaxBytes = theMaxBytes;
+  itsExpand = theExpand;
+  itsCache.resize(theMaxBytes);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sample querydata, or return a previous sample covering the box
+ */
+// ----------------------------------------------------------------------
+
+Engine::Querydata::Q SampleCache::sample(const Engine::Querydata::Q& theQ,
+                                         const Spine::Parameter& theParameter,
+                                         const Fmi::DateTime& theTime,
+                                         const std::optional<double>& theLevel,
+                                         const Fmi::SpatialReference& theCRS,
+                                         const Fmi::Box& theBox,
+                                         double theResolution)
+{
+  try
+  {
+    if (itsMaxBytes == 0)
+      return theQ->sample(theParameter,
+                          theTime,
+                          theCRS,
+                          theBox.xmin(),
+                          theBox.ymin(),
+                          theBox.xmax(),
+                          theBox.ymax(),
+                          theResolution);
+
+    Extent extent{theBox.xmin(), theBox.ymin(), theBox.xmax(), theBox.ymax()};
+    if (itsExpand)
+      extent = expand(theBox, theCRS);
+
+    auto hash = Engine::Querydata::hash_value(theQ);
+    Fmi::hash_combine(hash, Fmi::hash_value(theParameter.name()));
+    Fmi::hash_combine(hash, Fmi::hash_value(theTime));
+    Fmi::hash_combine(hash, Fmi::hash_value(theLevel));
+    Fmi::hash_combine(hash, theCRS.hashValue());
+    Fmi::hash_combine(hash, Fmi::hash_value(extent.xmin));
+    Fmi::hash_combine(hash, Fmi::hash_value(extent.ymin));
+    Fmi::hash_combine(hash, Fmi::hash_value(extent.xmax));
+    Fmi::hash_combine(hash, Fmi::hash_value(extent.ymax));
+    Fmi::hash_combine(hash, Fmi::hash_value(theResolution));
+
+    // Concurrent requests for the same block wait for the first one to sample it
+    return itsCache.getOrCompute(hash,
+                                 [&]()
+                                 {
+                                   auto q = theQ->sample(theParameter,
+                                                         theTime,
+                                                         theCRS,
+                                                         extent.xmin,
+                                                         extent.ymin,
+                                                         extent.xmax,
+                                                         extent.ymax,
+                                                         theResolution);
+                                   return std::make_pair(q, q ? data_size(q) : 0);
+                                 });
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,75 @@
+// ======================================================================
+/*!
+ * \brief Process-wide cache of resampled querydata
+ *
+ * Layers with a sampling resolution resample the model to a new high
+ * resolution querydata object on every request. Consecutive tiles and
+ * repeated requests at the same zoom level cover the same areas at the
+ * same resolution, so the results are shared here.
+ *
+ * Optionally neighbouring tiles may share one result by expanding the
+ * sampled area to a block aligned to twice the size of the requested box.
+ * Tiles of the same size then fall into the same blocks, and each block
+ * is sampled only once. The block covers up to 16 times the requested
+ * area and the contours are then computed from a different grid, so the
+ * expansion is off by default. Concurrent requests for the same area wait
+ * for the first one instead of sampling it again.
+ *
+ * The cache is limited by the approximate memory used by the sampled
+ * data.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "MemoryLimitedCache.h"
+#include <engines/querydata/Q.h>
+#include <gis/Box.h>
+#include <gis/SpatialReference.h>
+#include <macgyver/DateTime.h>
+#include <optional>
+
+namespace SmartMet
+{
+namespace Spine
+{
+class Parameter;
+}  // namespace Spine
+
+namespace Plugin
+{
+namespace Dali
+{
+class SampleCache
+{
+ public:
+  using Statistics = MemoryLimitedCache<Engine::Querydata::Q>::Statistics;
+
+  SampleCache() = default;
+  SampleCache(const SampleCache&) = delete;
+  SampleCache& operator=(const SampleCache&) = delete;
+
+  // 0 bytes disables caching
+  void init(std::size_t theMaxBytes, bool theExpand);
+
+  // Sample the currently selected level of the model for the given box
+  Engine::Querydata::Q sample(const Engine::Querydata::Q& theQ,
+                              const Spine::Parameter& theParameter,
+                              const Fmi::DateTime& theTime,
+                              const std::optional<double>& theLevel,
+                              const Fmi::SpatialReference& theCRS,
+                              const Fmi::Box& theBox,
+                              double theResolution);
+
+  Statistics statistics() const { return itsCache.statistics(); }
+
+ private:
+  std::size_t itsMaxBytes = 0;
+  bool itsExpand = false;
+
+  MemoryLimitedCache<Engine::Querydata::Q> itsCache;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
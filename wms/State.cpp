@@ -32,7 +32,16 @@ namespace Dali
 // ----------------------------------------------------------------------
 
 State::State(Plugin& thePlugin, const Spine::HTTP::Request& theRequest)
-    : itsPlugin(thePlugin), itsRequest(theRequest)
+    : itsPlugin(thePlugin),
+      itsUsedIds(itsArena.resource()),
+      itsSymbols(itsArena.resource()),
+      itsFilters(itsArena.resource()),
+      itsMarkers(itsArena.resource()),
+      itsPatterns(itsArena.resource()),
+      itsGradients(itsArena.resource()),
+      itsColorMaps(itsArena.resource()),
+      itsQids(itsArena.resource()),
+      itsRequest(theRequest)
 {
   auto prec = theRequest.getParameter("precision");
   if (prec)
@@ -194,6 +203,174 @@ const Config& State::getConfig() const
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find previously traced streamlines
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::vector<OGRGeometryPtr>> State::findStreamlines(std::size_t theHash) const
+{
+  try
+  {
+    return itsPlugin.findStreamlines(theHash);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store traced streamlines for other requests
+ */
+// ----------------------------------------------------------------------
+
+void State::insertStreamlines(std::size_t theHash,
+                              const std::vector<OGRGeometryPtr>& theStreams) const
+{
+  try
+  {
+    itsPlugin.insertStreamlines(theHash, theStreams);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+#ifndef WITHOUT_OBSERVATION
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find previously calculated wind rose statistics
+ */
+// ----------------------------------------------------------------------
+
+std::optional<WindRoseData> State::findWindRose(std::size_t theHash) const
+{
+  try
+  {
+    return itsPlugin.findWindRose(theHash);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store wind rose statistics for other requests
+ */
+// ----------------------------------------------------------------------
+
+void State::insertWindRose(std::size_t theHash, const WindRoseData& theData) const
+{
+  try
+  {
+    itsPlugin.insertWindRose(theHash, theData);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the cache of resampled querydata
+ */
+// ----------------------------------------------------------------------
+
+SampleCache& State::getSampleCache() const
+{
+  return itsPlugin.getSampleCache();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the cache of projected keyword locations
+ */
+// ----------------------------------------------------------------------
+
+LocationIndexCache& State::getLocationIndexCache() const
+{
+  return itsPlugin.getLocationIndexCache();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the cache of PostGIS features
+ */
+// ----------------------------------------------------------------------
+
+PostGISFeatureCache& State::getPostGISFeatureCache() const
+{
+  return itsPlugin.getPostGISFeatureCache();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find contours already generated for the product
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::vector<OGRGeometryPtr>> State::findContours(std::size_t theHash) const
+{
+  auto pos = itsContours.find(theHash);
+  if (pos == itsContours.end())
+    return {};
+  return pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store contours for the remaining layers of the product
+ */
+// ----------------------------------------------------------------------
+
+void State::insertContours(std::size_t theHash, const std::vector<OGRGeometryPtr>& theGeoms) const
+{
+  try
+  {
+    itsContours.emplace(theHash, theGeoms);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a point value already probed for the request
+ */
+// ----------------------------------------------------------------------
+
+std::optional<double> State::findPointValue(std::size_t theHash) const
+{
+  if (theHash == Fmi::bad_hash)
+    return {};
+  auto pos = itsPointValues.find(theHash);
+  if (pos == itsPointValues.end())
+    return {};
+  return pos->second;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store a probed point value for the remaining layers and times
+ */
+// ----------------------------------------------------------------------
+
+void State::insertPointValue(std::size_t theHash, double theValue) const
+{
+  if (theHash != Fmi::bad_hash)
+    itsPointValues.emplace(theHash, theValue);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Get cached Q
@@ -222,6 +399,7 @@ Engine::Querydata::Q State::getModel(const Engine::Querydata::Producer& theProdu
 
     // Get the data from the engine
     auto q = itsPlugin.getQEngine().get(theProducer);
+    itsLatestProducers.insert(theProducer);
 
     // Update estimated expiration time for the product
     updateExpirationTime(q->expirationTime());
@@ -339,11 +517,7 @@ bool State::addId(const std::string& theID) const
 {
   try
   {
-    if (itsUsedIds.find(theID) != itsUsedIds.end())
-      return false;
-
-    itsUsedIds.insert(theID);
-    return true;
+    return itsUsedIds.emplace(theID).second;
   }
   catch (...)
   {
@@ -593,7 +767,7 @@ bool State::setSymbol(const std::string& theName, const std::string& theValue) c
 {
   try
   {
-    auto ret = itsSymbols.insert({theName, theValue});
+    auto ret = itsSymbols.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -611,7 +785,7 @@ bool State::setFilter(const std::string& theName, const std::string& theValue) c
 {
   try
   {
-    auto ret = itsFilters.insert({theName, theValue});
+    auto ret = itsFilters.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -629,7 +803,7 @@ bool State::setMarker(const std::string& theName, const std::string& theValue) c
 {
   try
   {
-    auto ret = itsMarkers.insert({theName, theValue});
+    auto ret = itsMarkers.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -647,7 +821,7 @@ bool State::setPattern(const std::string& theName, const std::string& theValue)
 {
   try
   {
-    auto ret = itsPatterns.insert({theName, theValue});
+    auto ret = itsPatterns.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -665,7 +839,7 @@ bool State::setGradient(const std::string& theName, const std::string& theValue)
 {
   try
   {
-    auto ret = itsGradients.insert({theName, theValue});
+    auto ret = itsGradients.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -684,8 +858,9 @@ std::string State::getSymbol(const std::string& theName) const
 {
   try
   {
-    if (itsSymbols.count(theName) > 0)
-      return itsSymbols[theName];
+    auto pos = itsSymbols.find(std::string_view(theName));
+    if (pos != itsSymbols.end())
+      return std::string(pos->second);
     return itsPlugin.getSymbol(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -704,8 +879,9 @@ std::size_t State::getSymbolHash(const std::string& theName) const
 {
   try
   {
-    if (itsSymbols.count(theName) > 0)
-      return Fmi::hash_value(itsSymbols[theName]);
+    auto pos = itsSymbols.find(std::string_view(theName));
+    if (pos != itsSymbols.end())
+      return Fmi::hash_value(std::string(pos->second));
     return itsPlugin.getSymbolHash(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -724,8 +900,9 @@ std::string State::getFilter(const std::string& theName) const
 {
   try
   {
-    if (itsFilters.count(theName) > 0)
-      return itsFilters[theName];
+    auto pos = itsFilters.find(std::string_view(theName));
+    if (pos != itsFilters.end())
+      return std::string(pos->second);
     return itsPlugin.getFilter(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -744,8 +921,9 @@ std::size_t State::getFilterHash(const std::string& theName) const
 {
   try
   {
-    if (itsFilters.count(theName) > 0)
-      return Fmi::hash_value(itsFilters[theName]);
+    auto pos = itsFilters.find(std::string_view(theName));
+    if (pos != itsFilters.end())
+      return Fmi::hash_value(std::string(pos->second));
 
     return itsPlugin.getFilterHash(itsCustomer, theName, itUsesWms);
   }
@@ -765,8 +943,9 @@ std::string State::getPattern(const std::string& theName) const
 {
   try
   {
-    if (itsPatterns.count(theName) > 0)
-      return itsPatterns[theName];
+    auto pos = itsPatterns.find(std::string_view(theName));
+    if (pos != itsPatterns.end())
+      return std::string(pos->second);
     return itsPlugin.getPattern(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -785,8 +964,9 @@ std::size_t State::getPatternHash(const std::string& theName) const
 {
   try
   {
-    if (itsPatterns.count(theName) > 0)
-      return Fmi::hash_value(itsPatterns[theName]);
+    auto pos = itsPatterns.find(std::string_view(theName));
+    if (pos != itsPatterns.end())
+      return Fmi::hash_value(std::string(pos->second));
     return itsPlugin.getPatternHash(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -805,8 +985,9 @@ std::string State::getMarker(const std::string& theName) const
 {
   try
   {
-    if (itsMarkers.count(theName) > 0)
-      return itsMarkers[theName];
+    auto pos = itsMarkers.find(std::string_view(theName));
+    if (pos != itsMarkers.end())
+      return std::string(pos->second);
     return itsPlugin.getMarker(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -825,8 +1006,9 @@ std::size_t State::getMarkerHash(const std::string& theName) const
 {
   try
   {
-    if (itsMarkers.count(theName) > 0)
-      return Fmi::hash_value(itsMarkers[theName]);
+    auto pos = itsMarkers.find(std::string_view(theName));
+    if (pos != itsMarkers.end())
+      return Fmi::hash_value(std::string(pos->second));
     return itsPlugin.getMarkerHash(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -845,8 +1027,9 @@ std::string State::getGradient(const std::string& theName) const
 {
   try
   {
-    if (itsGradients.count(theName) > 0)
-      return itsGradients[theName];
+    auto pos = itsGradients.find(std::string_view(theName));
+    if (pos != itsGradients.end())
+      return std::string(pos->second);
     return itsPlugin.getGradient(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -865,8 +1048,9 @@ std::size_t State::getGradientHash(const std::string& theName) const
 {
   try
   {
-    if (itsGradients.count(theName) > 0)
-      return Fmi::hash_value(itsGradients[theName]);
+    auto pos = itsGradients.find(std::string_view(theName));
+    if (pos != itsGradients.end())
+      return Fmi::hash_value(std::string(pos->second));
     return itsPlugin.getGradientHash(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -885,8 +1069,9 @@ std::string State::getColorMap(const std::string& theName) const
 {
   try
   {
-    if (itsColorMaps.count(theName) > 0)
-      return itsColorMaps[theName];
+    auto pos = itsColorMaps.find(std::string_view(theName));
+    if (pos != itsColorMaps.end())
+      return std::string(pos->second);
     return itsPlugin.getColorMap(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -905,8 +1090,9 @@ std::size_t State::getColorMapHash(const std::string& theName) const
 {
   try
   {
-    if (itsColorMaps.count(theName) > 0)
-      return Fmi::hash_value(itsColorMaps[theName]);
+    auto pos = itsColorMaps.find(std::string_view(theName));
+    if (pos != itsColorMaps.end())
+      return Fmi::hash_value(std::string(pos->second));
     return itsPlugin.getColorMapHash(itsCustomer, theName, itUsesWms);
   }
   catch (...)
@@ -924,7 +1110,7 @@ bool State::setColorMap(const std::string& theName, const std::string& theValue)
 {
   try
   {
-    auto ret = itsColorMaps.insert({theName, theValue});
+    auto ret = itsColorMaps.emplace(theName, theValue);
     return ret.second;
   }
   catch (...)
@@ -1027,7 +1213,10 @@ void State::updateModificationTime(const Fmi::DateTime& theTime) const
 
 std::string State::makeQid(const std::string& thePrefix) const
 {
-  auto num = ++itsQids[thePrefix];
+  auto pos = itsQids.find(std::string_view(thePrefix));
+  if (pos == itsQids.end())
+    pos = itsQids.emplace(thePrefix, 0).first;
+  auto num = ++pos->second;
   return thePrefix + Fmi::to_string(num);
 }
 
@@ -1062,6 +1251,76 @@ bool State::isObservation(const std::string& theProducer) const
 #endif
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hash the version of the observations used by a layer
+ *
+ * The hash changes when the producer reports an update to data in the
+ * period. Backends which do not report updates get a hash which changes
+ * every max_age seconds instead. The expiration time of the product is
+ * limited accordingly so that clients revalidate it.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t State::getObservationHash(const std::string& theProducer,
+                                      const Fmi::TimePeriod& thePeriod) const
+{
+  try
+  {
+#ifdef WITHOUT_OBSERVATION
+    return Fmi::bad_hash;
+#else
+    const auto& config = getConfig();
+    if (!config.observationCacheEnabled() || config.obsEngineDisabled())
+      return Fmi::bad_hash;
+
+    auto key = Fmi::hash_value(theProducer);
+    Fmi::hash_combine(key, Fmi::hash_value(thePeriod.begin()));
+    Fmi::hash_combine(key, Fmi::hash_value(thePeriod.end()));
+
+    auto pos = itsObservationHashes.find(key);
+    if (pos != itsObservationHashes.end())
+      return pos->second;
+
+    const auto now = Fmi::SecondClock::universal_time();
+    const auto max_age = config.observationCacheMaxAge();
+
+    std::size_t hash = Fmi::bad_hash;
+    try
+    {
+      auto latest = getObsEngine().latestDataUpdateTime(theProducer, thePeriod.begin());
+      if (!latest.is_not_a_date_time())
+      {
+        hash = key;
+        Fmi::hash_combine(hash, Fmi::hash_value(latest));
+      }
+    }
+    catch (...)
+    {
+      // The backend does not report data versions
+    }
+
+    if (hash == Fmi::bad_hash && max_age > 0)
+    {
+      const long bucket = now.time_of_day().total_seconds() / max_age;
+      hash = key;
+      Fmi::hash_combine(hash, Fmi::hash_value(Fmi::DateTime(now.date())));
+      Fmi::hash_combine(hash, Fmi::hash_value(bucket));
+    }
+
+    if (hash != Fmi::bad_hash && max_age > 0)
+      updateExpirationTime(now + Fmi::Seconds(max_age));
+
+    itsObservationHashes[key] = hash;
+    return hash;
+#endif
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("Producer", theProducer);
+  }
+}
+
 }  // namespace Dali
 }  // namespace Plugin
 }  // namespace SmartMet
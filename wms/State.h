@@ -19,15 +19,24 @@
 
 #include "Attributes.h"
 #include "BezierCache.h"
+#include "LocationIndex.h"
+#include "PostGISFeatureCache.h"
+#include "RequestArena.h"
+#include "SampleCache.h"
+#include "WindRoseData.h"
 #include <engines/geonames/Engine.h>
 #include <engines/grid/Engine.h>
 #include <engines/querydata/Q.h>
+#include <gis/Types.h>
 #include <grid-files/common/ImageFunctions.h>
 #include <spine/HTTP.h>
 #include <timeseries/TimeSeriesInclude.h>
 #include <map>
+#include <memory_resource>
 #include <optional>
 #include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace CTPP
@@ -133,6 +142,12 @@ class State
   Engine::Querydata::Q getModel(const Engine::Querydata::Producer& theProducer,
                                 const Fmi::TimePeriod& theTimePeriod) const;
 
+  // Producers whose latest data was used without a fixed origin time or period
+  const std::set<Engine::Querydata::Producer>& getLatestProducers() const
+  {
+    return itsLatestProducers;
+  }
+
   // Require given ID to be free, and mark it used if it is free
   void requireId(const std::string& theID) const;
 
@@ -226,6 +241,11 @@ class State
   bool isObservation(const std::optional<std::string>& theProducer) const;
   bool isObservation(const std::string& theProducer) const;
 
+  // Hash of the observation data version for the producer and time period, bad_hash if the
+  // observations cannot be cached
+  std::size_t getObservationHash(const std::string& theProducer,
+                                 const Fmi::TimePeriod& thePeriod) const;
+
   // Set tile z/x/y when serving an OGC Tiles or WMTS request (for PMTiles passthrough)
   void setTileCoords(uint8_t z, uint32_t x, uint32_t y)
   {
@@ -246,9 +266,45 @@ class State
   // an isoband edge.
   BezierCache& getBezierCache() const { return itsBezierCache; }
 
+  // Process-wide cache of traced streamlines for identical field and domain
+  std::optional<std::vector<OGRGeometryPtr>> findStreamlines(std::size_t theHash) const;
+  void insertStreamlines(std::size_t theHash, const std::vector<OGRGeometryPtr>& theStreams) const;
+
+#ifndef WITHOUT_OBSERVATION
+  // Process-wide cache of wind rose statistics
+  std::optional<WindRoseData> findWindRose(std::size_t theHash) const;
+  void insertWindRose(std::size_t theHash, const WindRoseData& theData) const;
+#endif
+
+  // Process-wide cache of resampled querydata
+  SampleCache& getSampleCache() const;
+
+  // Process-wide cache of projected keyword locations
+  LocationIndexCache& getLocationIndexCache() const;
+
+  // Process-wide cache of PostGIS features
+  PostGISFeatureCache& getPostGISFeatureCache() const;
+
+  // Monotonic arena for data which lives until the end of the request. Only
+  // for the thread generating the product, not for parallel tasks.
+  std::pmr::memory_resource* getArena() const { return itsArena.resource(); }
+  RequestArena::Statistics getArenaStatistics() const { return itsArena.statistics(); }
+  std::string getArenaReport() const { return itsArena.report(); }
+
+  // Contours generated for this product. Isoline, isolabel and isoband layers
+  // drawing the same field share the results instead of contouring it again.
+  // The geometries must not be modified, layers clone them before clipping.
+  std::optional<std::vector<OGRGeometryPtr>> findContours(std::size_t theHash) const;
+  void insertContours(std::size_t theHash, const std::vector<OGRGeometryPtr>& theGeoms) const;
+
+  // Point values probed for GetFeatureInfo. Layers querying the same field at
+  // the same point and time share the value instead of querying it again.
+  std::optional<double> findPointValue(std::size_t theHash) const;
+  void insertPointValue(std::size_t theHash, double theValue) const;
+
   mutable uint arcCounter = 0;
   mutable uint insertCounter = 0;
-  mutable std::map<std::size_t, uint> arcHashMap;
+  mutable std::unordered_map<std::size_t, uint> arcHashMap;
   mutable bool animation_enabled = false;
   mutable int animation_timestep = 0;
   mutable int animation_loopstep = 0;
@@ -260,32 +316,46 @@ class State
   // layer time interval (Product webp 'frames' setting)
   mutable std::optional<int> time_animation_frames;
 
+  // Write SVG paths with relative quantised coordinates (Product svg_paths setting)
+  mutable bool compact_svg_paths = false;
+
  private:
   Plugin& itsPlugin;
   mutable std::map<Engine::Querydata::Producer, Engine::Querydata::Q> itsQCache;
+  mutable std::set<Engine::Querydata::Producer> itsLatestProducers;
   mutable BezierCache itsBezierCache;
+  mutable std::map<std::size_t, std::vector<OGRGeometryPtr>> itsContours;
+  mutable std::map<std::size_t, double> itsPointValues;
 
   // Names which have already been used for styling
   mutable std::map<std::string, std::string> itsUsedStyles;
 
+  // Memory for the containers below, must be declared before them
+  mutable RequestArena itsArena;
+
+  using ArenaStringMap = std::pmr::map<std::pmr::string, std::pmr::string, std::less<>>;
+
   // Names which have already been used as unique IDs in the SVG
-  mutable std::set<std::string> itsUsedIds;
+  mutable std::pmr::set<std::pmr::string, std::less<>> itsUsedIds;
 
   // Symbols we already know of
-  mutable std::map<std::string, std::string> itsSymbols;
+  mutable ArenaStringMap itsSymbols;
   // Filters we already know of
-  mutable std::map<std::string, std::string> itsFilters;
+  mutable ArenaStringMap itsFilters;
   // Markers we already know of
-  mutable std::map<std::string, std::string> itsMarkers;
+  mutable ArenaStringMap itsMarkers;
   // Patterns we already know of
-  mutable std::map<std::string, std::string> itsPatterns;
+  mutable ArenaStringMap itsPatterns;
   // Gradients we already know of
-  mutable std::map<std::string, std::string> itsGradients;
+  mutable ArenaStringMap itsGradients;
   // Colormaps we already know of
-  mutable std::map<std::string, std::string> itsColorMaps;
+  mutable ArenaStringMap itsColorMaps;
+
+  // Observation data versions resolved during the request
+  mutable std::map<std::size_t, std::size_t> itsObservationHashes;
 
   // Unique Qids created by us
-  mutable std::map<std::string, std::size_t> itsQids;
+  mutable std::pmr::map<std::pmr::string, std::size_t, std::less<>> itsQids;
 
   // Next ID to be used
   mutable std::size_t itsNextId = 0;
@@ -81,12 +81,37 @@ std::vector<OGRGeometryPtr> StreamLayer::getStreams(State& theState)
 {
   try
   {
+    const bool grid = (paraminfo.source == std::string("grid"));
+
+    // The streamlines depend only on the field, the domain and the tracing
+    // settings, not on styling or the output format. Hence they can be reused
+    // by requests for exactly the same domain, unless the domain is resolved
+    // only once the data has been fetched. Tiles differ in their domains and
+    // are each traced separately.
+
+    const bool cacheable = (projection.crs && *projection.crs != "data" && projection.xsize &&
+                            projection.ysize && !projection.size);
+
+    std::size_t key = Fmi::bad_hash;
+    if (cacheable)
+    {
+      if (!grid)
+        q = getModel(theState);
+      key = streams_hash_value(theState);
+      auto cached = theState.findStreamlines(key);
+      if (cached)
+        return *cached;
+    }
+
     std::vector<OGRGeometryPtr> geoms;
-    if (paraminfo.source == std::string("grid"))
+    if (grid)
       geoms = getStreamsGrid(theState);
     else
       geoms = getStreamsQuerydata(theState);
 
+    if (key != Fmi::bad_hash)
+      theState.insertStreamlines(key, geoms);
+
     return geoms;
   }
   catch (...)
@@ -729,7 +754,7 @@ void StreamLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State
         std::string arcNumbers;
         std::string arcCoordinates;
         std::string pointCoordinates = Geometry::toString(*geom,
-                                                          theState.getType(),
+                                                          theState,
                                                           box,
                                                           crs,
                                                           precision,
@@ -790,6 +815,40 @@ void StreamLayer::getFeatureInfo(CTPP::CDT& /* theInfo */, const State& /* theSt
   // TODO();
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Hash value for the streamlines themselves
+ *
+ * Unlike the layer hash this excludes attributes, CSS and precision,
+ * which affect only how the streamlines are drawn.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t StreamLayer::streams_hash_value(const State& theState) const
+{
+  try
+  {
+    auto hash = Properties::hash_value(theState);
+
+    if (paraminfo.source != std::string("grid"))
+      Fmi::hash_combine(hash, Engine::Querydata::hash_value(getModel(theState)));
+
+    Fmi::hash_combine(hash, countParameterHash(theState, paraminfo.parameter));
+    Fmi::hash_combine(hash, Fmi::hash_value(u_parameter));
+    Fmi::hash_combine(hash, Fmi::hash_value(v_parameter));
+    Fmi::hash_combine(hash, Fmi::hash_value(minStreamLen));
+    Fmi::hash_combine(hash, Fmi::hash_value(maxStreamLen));
+    Fmi::hash_combine(hash, Fmi::hash_value(lineLen));
+    Fmi::hash_combine(hash, Fmi::hash_value(xStep));
+    Fmi::hash_combine(hash, Fmi::hash_value(yStep));
+    return hash;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Hash value for the layer
@@ -53,6 +53,7 @@ class StreamLayer : public Layer
   T::MessageIndex messageIndex = 0;
 
  private:
+  std::size_t streams_hash_value(const State& theState) const;
   std::vector<OGRGeometryPtr> getStreamsGrid(State& theState);
   std::vector<OGRGeometryPtr> getStreamsQuerydata(const State& theState);
 
@@ -19,6 +19,9 @@ class StyleSheet
 
   const Declarations& declarations(const std::string& theSelector) const;
 
+  // All selectors and their declarations
+  const SelectorDeclarations& selectors() const { return itsStyleSheet; }
+
  private:
   SelectorDeclarations itsStyleSheet;
 
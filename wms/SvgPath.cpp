@@ -0,0 +1,254 @@
+#include "SvgPath.h"
+#include <macgyver/Exception.h>
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace SvgPath
+{
+namespace
+{
+struct Point
+{
+  long long x = 0;
+  long long y = 0;
+
+  bool operator==(const Point& theOther) const { return x == theOther.x && y == theOther.y; }
+};
+
+// True if b lies on the segment continuing from a towards c
+bool collinear(const Point& a, const Point& b, const Point& c)
+{
+  // Doubles are exact for all practical pixel coordinates and avoid overflows
+  const double dx1 = static_cast<double>(b.x - a.x);
+  const double dy1 = static_cast<double>(b.y - a.y);
+  const double dx2 = static_cast<double>(c.x - b.x);
+  const double dy2 = static_cast<double>(c.y - b.y);
+  return dx1 * dy2 == dy1 * dx2 && dx1 * dx2 + dy1 * dy2 > 0;
+}
+
+class Writer
+{
+ public:
+  Writer(const Fmi::Box& theBox, double thePrecision)
+      : itsBox(theBox), itsDecimals(static_cast<int>(thePrecision))
+  {
+    itsScale = std::pow(10.0, itsDecimals);
+    for (int i = 0; i < itsDecimals; i++)
+      itsDivisor *= 10;
+    for (int i = itsDecimals; i < 0; i++)
+      itsMultiplier *= 10;
+  }
+
+  void write(const OGRGeometry& theGeom);
+
+  std::string& result() { return itsPath; }
+
+ private:
+  Point quantise(double theX, double theY) const
+  {
+    itsBox.transform(theX, theY);
+    return Point{std::llround(theX * itsScale), std::llround(theY * itsScale)};
+  }
+
+  void writePath(const OGRLineString& theLine, bool theRing);
+  void writeNumber(long long theValue);
+  void writeDelta(const Point& thePoint);
+
+  const Fmi::Box& itsBox;
+  int itsDecimals = 0;
+  double itsScale = 1;
+  long long itsDivisor = 1;     // for positive decimals
+  long long itsMultiplier = 1;  // for negative decimals
+
+  std::string itsPath;
+  Point itsPosition;             // current point
+  std::vector<Point> itsPoints;  // buffer reused for all paths
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a fixed point number with the configured decimals
+ */
+// ----------------------------------------------------------------------
+
+void Writer::writeNumber(long long theValue)
+{
+  char buffer[24];
+
+  // Numbers are separated by a space unless the sign separates them
+  if (!itsPath.empty())
+  {
+    const char last = itsPath.back();
+    if (theValue >= 0 && (last == '.' || (last >= '0' && last <= '9')))
+      itsPath += ' ';
+  }
+
+  if (itsDecimals <= 0)
+  {
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), theValue * itsMultiplier);
+    itsPath.append(buffer, result.ptr);
+    return;
+  }
+
+  if (theValue < 0)
+  {
+    itsPath += '-';
+    theValue = -theValue;
+  }
+
+  const auto whole = theValue / itsDivisor;
+  auto fraction = theValue % itsDivisor;
+
+  if (whole != 0 || fraction == 0)
+  {
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), whole);
+    itsPath.append(buffer, result.ptr);
+  }
+
+  if (fraction != 0)
+  {
+    // Zero padded decimals without trailing zeros
+    int digits = itsDecimals;
+    while (fraction % 10 == 0)
+    {
+      fraction /= 10;
+      --digits;
+    }
+    itsPath += '.';
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), fraction);
+    itsPath.append(digits - (result.ptr - buffer), '0');
+    itsPath.append(buffer, result.ptr);
+  }
+}
+
+void Writer::writeDelta(const Point& thePoint)
+{
+  writeNumber(thePoint.x - itsPosition.x);
+  writeNumber(thePoint.y - itsPosition.y);
+  itsPosition = thePoint;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write a line or a ring as a subpath
+ */
+// ----------------------------------------------------------------------
+
+void Writer::writePath(const OGRLineString& theLine, bool theRing)
+{
+  // Quantise dropping sub-pixel steps
+  itsPoints.clear();
+  for (int i = 0, n = theLine.getNumPoints(); i < n; i++)
+  {
+    auto point = quantise(theLine.getX(i), theLine.getY(i));
+    if (itsPoints.empty() || !(point == itsPoints.back()))
+      itsPoints.push_back(point);
+  }
+
+  if (theRing && itsPoints.size() > 1 && itsPoints.back() == itsPoints.front())
+    itsPoints.pop_back();
+
+  if (itsPoints.empty())
+    return;
+
+  // Drop collinear vertices in place. The ring closing point is the successor
+  // of the last vertex of a ring.
+  const auto n = itsPoints.size();
+  std::size_t count = 1;
+  for (std::size_t i = 1; i < n; i++)
+  {
+    const auto& next = (i + 1 < n ? itsPoints[i + 1] : itsPoints.front());
+    if ((i + 1 < n || theRing) && collinear(itsPoints[count - 1], itsPoints[i], next))
+      continue;
+    itsPoints[count++] = itsPoints[i];
+  }
+  itsPoints.resize(count);
+
+  const auto start = itsPoints.front();
+
+  itsPath += 'm';
+  writeDelta(start);
+  for (std::size_t i = 1; i < count; i++)
+    writeDelta(itsPoints[i]);
+
+  if (theRing)
+  {
+    itsPath += 'z';
+    itsPosition = start;
+  }
+}
+
+void Writer::write(const OGRGeometry& theGeom)
+{
+  switch (wkbFlatten(theGeom.getGeometryType()))
+  {
+    case wkbPoint:
+    {
+      const auto* point = theGeom.toPoint();
+      itsPath += 'm';
+      writeDelta(quantise(point->getX(), point->getY()));
+      break;
+    }
+    case wkbLineString:
+      writePath(*theGeom.toLineString(), false);
+      break;
+    case wkbLinearRing:
+      writePath(*theGeom.toLineString(), true);
+      break;
+    case wkbPolygon:
+    {
+      const auto* polygon = theGeom.toPolygon();
+      if (const auto* exterior = polygon->getExteriorRing())
+        writePath(*exterior, true);
+      for (int i = 0, n = polygon->getNumInteriorRings(); i < n; i++)
+        writePath(*polygon->getInteriorRing(i), true);
+      break;
+    }
+    case wkbMultiPoint:
+    case wkbMultiLineString:
+    case wkbMultiPolygon:
+    case wkbGeometryCollection:
+    {
+      const auto* collection = theGeom.toGeometryCollection();
+      for (int i = 0, n = collection->getNumGeometries(); i < n; i++)
+        write(*collection->getGeometryRef(i));
+      break;
+    }
+    default:
+      throw Fmi::Exception(BCP, "Encountered an unknown geometry component!");
+  }
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Export the geometry to compact relative SVG path data
+ */
+// ----------------------------------------------------------------------
+
+std::string compact(const OGRGeometry& theGeom, const Fmi::Box& theBox, double thePrecision)
+{
+  try
+  {
+    Writer writer(theBox, thePrecision);
+    writer.write(theGeom);
+    return std::move(writer.result());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace SvgPath
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
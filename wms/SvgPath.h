@@ -0,0 +1,34 @@
+// ======================================================================
+/*!
+ * \brief Compact SVG path encoding
+ *
+ * An alternative to Fmi::OGR::exportToSvg for large paths. The pixel
+ * coordinates are quantised to the given number of decimals and written
+ * relative to the previous point, with implicit repeated commands,
+ * without leading zeros and without separators before negative numbers.
+ * Vertices which fall on the previous vertex or on the line between
+ * their neighbours after quantisation are dropped, so the path renders
+ * the same at the chosen precision.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <gis/Box.h>
+#include <ogr_geometry.h>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace SvgPath
+{
+std::string compact(const OGRGeometry& theGeom, const Fmi::Box& theBox, double thePrecision);
+
+}  // namespace SvgPath
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
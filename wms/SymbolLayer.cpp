@@ -1072,16 +1072,21 @@ std::size_t SymbolLayer::hash_value(const State& theState) const
 {
   try
   {
-    // Disable caching of very new observation layers
+    auto hash = Layer::hash_value(theState);
+
+    // Observation layers are cached only until new observations arrive. The
+    // old rule of not caching observations younger than five minutes applies
+    // only when no observation hash is available, i.e. when the cache is
+    // disabled or when neither data versions nor a time bucket can be used.
     if (theState.isObservation(paraminfo.producer))
     {
-      const auto age = Fmi::SecondClock::universal_time() - getValidTime();
-      if (age < Fmi::Minutes(5))
+      auto obshash = observationHash(theState);
+      if (obshash != Fmi::bad_hash)
+        Fmi::hash_combine(hash, obshash);
+      else if (Fmi::SecondClock::universal_time() - getValidTime() < Fmi::Minutes(5))
         return Fmi::bad_hash;
     }
 
-    auto hash = Layer::hash_value(theState);
-
     if (!(paraminfo.source == std::string("grid")))
     {
       auto q = getModel(theState);
@@ -0,0 +1,253 @@
+#include "TileBakery.h"
+#include <json/json.h>
+#include <macgyver/Exception.h>
+#include <filesystem>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+void TileBakery::init(const std::string& theDirectory, const std::set<std::string>& theApiKeys)
+{
+  try
+  {
+    itsDirectory = theDirectory;
+    itsApiKeys = theApiKeys;
+    if (itsDirectory.empty())
+      return;
+
+    std::filesystem::create_directories(itsDirectory);
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(itsDirectory))
+    {
+      if (!entry.is_regular_file() || entry.path().extension() != ".pmtiles")
+        continue;
+
+      // A broken archive must not prevent the server from starting
+      try
+      {
+        add(entry.path().string());
+      }
+      catch (...)
+      {
+        Fmi::Exception exception(BCP, "Failed to index baked tiles", nullptr);
+        exception.printError();
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("directory", theDirectory);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Test whether the apikey may start a bake
+ *
+ * Baking renders up to bake.max_tiles tiles per request and writes to the
+ * disk, hence it is reserved for the configured apikeys.
+ */
+// ----------------------------------------------------------------------
+
+bool TileBakery::authorized(const std::optional<std::string>& theApiKey) const
+{
+  return enabled() && theApiKey && itsApiKeys.count(*theApiKey) > 0;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index an archive by the product hashes in its metadata
+ */
+// ----------------------------------------------------------------------
+
+void TileBakery::add(const std::string& thePath)
+{
+  try
+  {
+    auto archive = std::make_shared<const PMTiles::Archive>(thePath);
+
+    const auto text = archive->metadata();
+    Json::CharReaderBuilder rb;
+    Json::Value json;
+    std::string errors;
+    std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+    if (!reader->parse(text.data(), text.data() + text.size(), &json, &errors))
+      throw Fmi::Exception(BCP, "Failed to parse PMTiles metadata").addParameter("error", errors);
+
+    const auto& dali = json["dali"];
+    const auto& hashes = dali["hashes"];
+    if (!hashes.isObject())
+      throw Fmi::Exception(BCP, "PMTiles archive has no Dali product hashes");
+
+    std::unordered_map<std::size_t, Location> tiles;
+    for (const auto& name : hashes.getMemberNames())
+    {
+      Location location;
+      location.archive = archive;
+      location.tile_id = std::stoull(name);
+      tiles[std::stoull(hashes[name].asString(), nullptr, 16)] = location;
+    }
+
+    Source source;
+    source.archive = archive;
+    source.collection = dali["collection"].asString();
+    source.tile_matrix_set = dali["tileMatrixSet"].asString();
+    source.format = json["format"].asString();
+    source.reference_time = dali["reference_time"].asString();
+    source.origin_time = dali["origin_time"].asString();
+    if (source.origin_time.empty())
+      source.origin_time = source.reference_time;
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    // Forget the tiles of a previous archive with the same name. The old
+    // archive stays mapped until the last response using it is gone.
+    forget(thePath);
+
+    itsArchives[thePath] = std::move(source);
+    for (auto& tile : tiles)
+      itsTiles[tile.first] = std::move(tile.second);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("path", thePath);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove the archives superseded by a new archive
+ *
+ * An archive supersedes the archives of the same collection, tile matrix
+ * set and format baked from an earlier model run, since their product
+ * hashes no longer match. Archives of the same run are kept whatever
+ * their valid times, so the valid times of a run can be baked one at a
+ * time. An archive of the same run and valid time has the same path and
+ * has already been replaced by add. Explicit reference times and the
+ * latest run are pruned separately, and archives whose model run is not
+ * known are never pruned.
+ *
+ * The files are deleted immediately. Responses still using the tiles keep
+ * the memory mapping alive until they are done.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t TileBakery::prune(const std::string& thePath)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto pos = itsArchives.find(thePath);
+    if (pos == itsArchives.end() || pos->second.origin_time.empty())
+      return 0;
+    const auto newest = pos->second;
+
+    std::vector<std::string> superseded;
+    for (const auto& archive : itsArchives)
+    {
+      const auto& source = archive.second;
+      if (archive.first == thePath || source.collection != newest.collection ||
+          source.tile_matrix_set != newest.tile_matrix_set || source.format != newest.format ||
+          source.reference_time.empty() != newest.reference_time.empty())
+        continue;
+
+      // The ISO times order alphabetically
+      if (!source.origin_time.empty() && !newest.origin_time.empty() &&
+          source.origin_time < newest.origin_time)
+        superseded.push_back(archive.first);
+    }
+
+    for (const auto& path : superseded)
+    {
+      forget(path);
+      itsArchives.erase(path);
+
+      std::error_code ec;
+      const std::filesystem::path file(path);
+      std::filesystem::remove(file, ec);
+      // Remove the directory of the run too once it is empty
+      if (!ec && file.parent_path() != std::filesystem::path(itsDirectory) &&
+          std::filesystem::is_empty(file.parent_path(), ec))
+        std::filesystem::remove(file.parent_path(), ec);
+    }
+
+    return superseded.size();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!").addParameter("path", thePath);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove the tiles of an archive from the index
+ *
+ * The caller must hold the mutex.
+ */
+// ----------------------------------------------------------------------
+
+void TileBakery::forget(const std::string& thePath)
+{
+  auto old = itsArchives.find(thePath);
+  if (old == itsArchives.end())
+    return;
+
+  for (auto it = itsTiles.begin(); it != itsTiles.end();)
+  {
+    if (it->second.archive == old->second.archive)
+      it = itsTiles.erase(it);
+    else
+      ++it;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find a baked tile without copying it out of the archive
+ */
+// ----------------------------------------------------------------------
+
+std::optional<TileBakery::Tile> TileBakery::find(std::size_t theHash) const
+{
+  try
+  {
+    Location location;
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      auto pos = itsTiles.find(theHash);
+      if (pos == itsTiles.end())
+        return {};
+      location = pos->second;
+      ++itsHits;
+    }
+
+    auto data = location.archive->tile(location.tile_id);
+    if (!data)
+      return {};
+    return Tile{location.archive, *data};
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+TileBakery::Statistics TileBakery::statistics() const
+{
+  std::lock_guard<std::mutex> lock(itsMutex);
+  Statistics stats;
+  stats.archives = itsArchives.size();
+  stats.tiles = itsTiles.size();
+  stats.hits = itsHits;
+  return stats;
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,123 @@
+// ======================================================================
+/*!
+ * \brief Index of tiles baked into PMTiles archives
+ *
+ * Static products such as model fields can be rendered ahead of time for
+ * a range of zoom levels and written into one PMTiles archive per model
+ * run and valid time. Each baked tile is stored in the archive metadata
+ * together with the product hash it was rendered with, and the index
+ * maps the hashes back to the tiles.
+ *
+ * The image cache lookups fall back to the index, so a request whose
+ * product hash matches a baked tile is answered from the memory mapped
+ * archive without rendering. A new model run or a changed product
+ * changes the hash, and the archive of the old run simply stops matching.
+ *
+ * Archives in the configured directory are indexed at startup. Once a
+ * bake completes, the archives of older model runs are removed from the
+ * index and the disk. Baking is allowed only for the configured apikeys.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "PMTiles.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class TileBakery
+{
+ public:
+  struct Statistics
+  {
+    std::size_t archives = 0;
+    std::size_t tiles = 0;
+    std::size_t hits = 0;
+  };
+
+  // A baked tile. The data points into the memory mapped archive, which
+  // stays mapped as long as the tile exists.
+  struct Tile
+  {
+    std::shared_ptr<const PMTiles::Archive> archive;
+    std::string_view data;
+  };
+
+  TileBakery() = default;
+  TileBakery(const TileBakery&) = delete;
+  TileBakery& operator=(const TileBakery&) = delete;
+
+  // Index the archives found under the directory. An empty directory disables baking.
+  void init(const std::string& theDirectory, const std::set<std::string>& theApiKeys = {});
+
+  bool enabled() const { return !itsDirectory.empty(); }
+  const std::string& directory() const { return itsDirectory; }
+
+  // True if the apikey may start a bake
+  bool authorized(const std::optional<std::string>& theApiKey) const;
+
+  // Reserve the bakery for one bake at a time. The lock does not own the mutex if
+  // another bake is in progress.
+  std::unique_lock<std::mutex> reserve()
+  {
+    return std::unique_lock<std::mutex>(itsBakeMutex, std::try_to_lock);
+  }
+
+  // Index a new archive, replacing an earlier archive with the same path
+  void add(const std::string& thePath);
+
+  // Remove the archives superseded by the given archive, returns their number
+  std::size_t prune(const std::string& thePath);
+
+  // Baked tile rendered with the given product hash, if any
+  std::optional<Tile> find(std::size_t theHash) const;
+
+  Statistics statistics() const;
+
+ private:
+  struct Location
+  {
+    std::shared_ptr<const PMTiles::Archive> archive;
+    uint64_t tile_id = 0;
+  };
+
+  // What the archive was baked from, as recorded in its metadata
+  struct Source
+  {
+    std::shared_ptr<const PMTiles::Archive> archive;
+    std::string collection;
+    std::string tile_matrix_set;
+    std::string format;
+    std::string reference_time;  // empty for the latest run
+    std::string origin_time;     // model run of the tiles, empty if unknown
+  };
+
+  // Remove the tiles of an archive from the index
+  void forget(const std::string& thePath);
+
+  std::string itsDirectory;
+  std::set<std::string> itsApiKeys;
+  std::mutex itsBakeMutex;
+
+  mutable std::mutex itsMutex;
+  std::map<std::string, Source> itsArchives;
+  std::unordered_map<std::size_t, Location> itsTiles;
+  mutable std::size_t itsHits = 0;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
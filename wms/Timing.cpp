@@ -0,0 +1,265 @@
+#include "Timing.h"
+#include <fmt/format.h>
+#include <json/json.h>
+#include <json/writer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace Timing
+{
+namespace
+{
+// Bucket 0 holds zero durations, bucket b >= 1 durations in [2^(b-1), 2^b) microseconds.
+// The last bucket is open ended, 2^38 us is over three days.
+constexpr std::size_t num_buckets = 40;
+
+std::size_t bucket_index(std::uint64_t us)
+{
+  std::size_t b = 0;
+  while (us > 0 && b < num_buckets - 1)
+  {
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+// Written only by the owning thread, hence relaxed atomics suffice for readers
+struct Histogram
+{
+  std::array<std::atomic<std::uint64_t>, num_buckets> buckets{};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> max{0};
+
+  void add(std::uint64_t us)
+  {
+    buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(us, std::memory_order_relaxed);
+    if (us > max.load(std::memory_order_relaxed))
+      max.store(us, std::memory_order_relaxed);
+  }
+};
+
+using Key = std::pair<std::string, std::string>;  // stage, tag
+
+// The owning thread looks up histograms without locking. The mutex is taken
+// only when the owner inserts a new stage, and by readers collecting statistics.
+struct ThreadHistograms
+{
+  std::mutex mutex;
+  std::map<Key, std::unique_ptr<Histogram>> histograms;
+};
+
+std::mutex& registry_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Histograms of all threads, kept alive after the thread exits
+std::vector<std::shared_ptr<ThreadHistograms>>& registry()
+{
+  static std::vector<std::shared_ptr<ThreadHistograms>> threads;
+  return threads;
+}
+
+ThreadHistograms& local_histograms()
+{
+  thread_local std::shared_ptr<ThreadHistograms> local = []()
+  {
+    auto histograms = std::make_shared<ThreadHistograms>();
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().push_back(histograms);
+    return histograms;
+  }();
+  return *local;
+}
+
+// The request being timed in the current thread
+thread_local RequestTiming* current_request = nullptr;
+
+// Server-Timing metric names must be HTTP tokens
+std::string token(const std::string& theName)
+{
+  std::string ret = theName;
+  for (auto& ch : ret)
+  {
+    const bool ok = ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                     (ch >= '0' && ch <= '9') || ch == '-' || ch == '.' || ch == '_');
+    if (!ok)
+      ch = '_';
+  }
+  return ret;
+}
+
+// Upper limit of the bucket containing the given quantile, in milliseconds
+double quantile(const std::array<std::uint64_t, num_buckets>& theBuckets,
+                std::uint64_t theCount,
+                double theQuantile)
+{
+  if (theCount == 0)
+    return 0;
+  const auto limit = static_cast<std::uint64_t>(theQuantile * static_cast<double>(theCount));
+  std::uint64_t n = 0;
+  for (std::size_t b = 0; b < num_buckets; ++b)
+  {
+    n += theBuckets[b];
+    if (n > limit)
+      return (b == 0 ? 0.0 : static_cast<double>(std::uint64_t{1} << b) / 1000.0);
+  }
+  return static_cast<double>(std::uint64_t{1} << (num_buckets - 1)) / 1000.0;
+}
+
+}  // namespace
+
+void RequestTiming::add(std::string theStage, std::string theTag, std::int64_t theMicroseconds)
+{
+  itsSpans.push_back(Span{std::move(theStage), std::move(theTag), theMicroseconds});
+}
+
+std::string RequestTiming::serverTiming() const
+{
+  // Sum up repeated stages such as one span per isoband layer
+  std::vector<std::pair<std::string, std::int64_t>> totals;
+  for (const auto& span : itsSpans)
+  {
+    auto name = token(span.tag.empty() ? span.stage : span.stage + "-" + span.tag);
+    auto pos = std::find_if(
+        totals.begin(), totals.end(), [&name](const auto& total) { return total.first == name; });
+    if (pos == totals.end())
+      totals.emplace_back(std::move(name), span.microseconds);
+    else
+      pos->second += span.microseconds;
+  }
+
+  std::string ret;
+  for (const auto& total : totals)
+  {
+    if (!ret.empty())
+      ret += ", ";
+    ret += fmt::format("{};dur={:.3f}", total.first, static_cast<double>(total.second) / 1000.0);
+  }
+  return ret;
+}
+
+RequestScope::RequestScope(RequestTiming& theTiming) : itsPrevious(current_request)
+{
+  current_request = &theTiming;
+}
+
+RequestScope::~RequestScope()
+{
+  current_request = itsPrevious;
+}
+
+ScopedSpan::ScopedSpan(std::string theStage, std::string theTag) : itsTiming(current_request)
+{
+  if (itsTiming == nullptr)
+    return;
+  itsStage = std::move(theStage);
+  itsTag = std::move(theTag);
+  itsStart = std::chrono::steady_clock::now();
+}
+
+ScopedSpan::~ScopedSpan()
+{
+  if (itsTiming == nullptr)
+    return;
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - itsStart)
+                .count();
+  try
+  {
+    itsTiming->add(std::move(itsStage), std::move(itsTag), us);
+  }
+  catch (...)
+  {
+    // Timing must never break the request
+  }
+}
+
+void record(const RequestTiming& theTiming)
+{
+  auto& local = local_histograms();
+  for (const auto& span : theTiming.spans())
+  {
+    Key key(span.stage, span.tag);
+    auto pos = local.histograms.find(key);
+    if (pos == local.histograms.end())
+    {
+      std::lock_guard<std::mutex> lock(local.mutex);
+      pos = local.histograms.emplace(std::move(key), std::make_unique<Histogram>()).first;
+    }
+    pos->second->add(static_cast<std::uint64_t>(std::max<std::int64_t>(0, span.microseconds)));
+  }
+}
+
+std::string statistics()
+{
+  struct Totals
+  {
+    std::array<std::uint64_t, num_buckets> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+  };
+
+  std::map<Key, Totals> totals;
+  {
+    std::lock_guard<std::mutex> registry_lock(registry_mutex());
+    for (const auto& thread : registry())
+    {
+      std::lock_guard<std::mutex> lock(thread->mutex);
+      for (const auto& key_histogram : thread->histograms)
+      {
+        const auto& h = *key_histogram.second;
+        auto& t = totals[key_histogram.first];
+        for (std::size_t b = 0; b < num_buckets; ++b)
+          t.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+        t.count += h.count.load(std::memory_order_relaxed);
+        t.sum += h.sum.load(std::memory_order_relaxed);
+        t.max = std::max(t.max, h.max.load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  Json::Value stages(Json::arrayValue);
+  for (const auto& key_totals : totals)
+  {
+    const auto& t = key_totals.second;
+    Json::Value stage(Json::objectValue);
+    stage["stage"] = key_totals.first.first;
+    stage["tag"] = key_totals.first.second;
+    stage["count"] = Json::UInt64(t.count);
+    stage["mean_ms"] =
+        (t.count > 0 ? static_cast<double>(t.sum) / static_cast<double>(t.count) / 1000.0 : 0.0);
+    stage["p50_ms"] = quantile(t.buckets, t.count, 0.5);
+    stage["p90_ms"] = quantile(t.buckets, t.count, 0.9);
+    stage["p99_ms"] = quantile(t.buckets, t.count, 0.99);
+    stage["max_ms"] = static_cast<double>(t.max) / 1000.0;
+    stages.append(stage);
+  }
+
+  Json::Value result(Json::objectValue);
+  result["stages"] = stages;
+
+  Json::StyledWriter writer;
+  return writer.write(result);
+}
+
+}  // namespace Timing
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
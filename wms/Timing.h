@@ -0,0 +1,100 @@
+// ======================================================================
+/*!
+ * \brief Per-stage request timing
+ *
+ * A request handler installs a RequestTiming object for the duration of
+ * the request, after which any code running in the same thread may time
+ * a stage with a ScopedSpan:
+ *
+ *   Timing::ScopedSpan span("contour", "isoband");
+ *
+ * Spans are a no-op when no request is being timed. Once the request is
+ * done its spans are folded into process-wide latency histograms, which
+ * are kept per thread so that recording does not contend with other
+ * requests. The spans of a single request can also be returned to the
+ * client as a Server-Timing header.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace Timing
+{
+struct Span
+{
+  std::string stage;  // json, hash, generate, layer, contour, template, rasterise, ...
+  std::string tag;    // layer type, producer, output format or empty
+  std::int64_t microseconds = 0;
+};
+
+class RequestTiming
+{
+ public:
+  void add(std::string theStage, std::string theTag, std::int64_t theMicroseconds);
+  const std::vector<Span>& spans() const { return itsSpans; }
+
+  // Value for a Server-Timing response header, durations of equal names summed
+  std::string serverTiming() const;
+
+ private:
+  std::vector<Span> itsSpans;
+};
+
+// Installs a RequestTiming as the target of spans in the current thread
+class RequestScope
+{
+ public:
+  explicit RequestScope(RequestTiming& theTiming);
+  ~RequestScope();
+
+  RequestScope() = delete;
+  RequestScope(const RequestScope& other) = delete;
+  RequestScope& operator=(const RequestScope& other) = delete;
+  RequestScope(RequestScope&& other) = delete;
+  RequestScope& operator=(RequestScope&& other) = delete;
+
+ private:
+  RequestTiming* itsPrevious = nullptr;
+};
+
+// Times the enclosing scope into the current request, if any
+class ScopedSpan
+{
+ public:
+  explicit ScopedSpan(std::string theStage, std::string theTag = {});
+  ~ScopedSpan();
+
+  ScopedSpan() = delete;
+  ScopedSpan(const ScopedSpan& other) = delete;
+  ScopedSpan& operator=(const ScopedSpan& other) = delete;
+  ScopedSpan(ScopedSpan&& other) = delete;
+  ScopedSpan& operator=(ScopedSpan&& other) = delete;
+
+ private:
+  RequestTiming* itsTiming = nullptr;
+  std::string itsStage;
+  std::string itsTag;
+  std::chrono::steady_clock::time_point itsStart;
+};
+
+// Fold the spans of a finished request into the histograms
+void record(const RequestTiming& theTiming);
+
+// Histogram summaries of all stages as a JSON document
+std::string statistics();
+
+}  // namespace Timing
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,414 @@
+#include "TopologyEncoder.h"
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+namespace
+{
+void append(std::string& theBuffer, long long theValue)
+{
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), theValue);
+  theBuffer.append(buffer, result.ptr);
+}
+
+}  // namespace
+
+TopologyEncoder::TopologyEncoder(double thePrecision)
+{
+  if (thePrecision >= 1.0)
+    itsScale = std::pow(10.0, static_cast<int>(thePrecision));
+}
+
+// Truncated towards zero like the earlier TopoJSON output
+TopologyEncoder::Point TopologyEncoder::quantise(double theX, double theY) const
+{
+  return Point{static_cast<long long>(theX * itsScale), static_cast<long long>(theY * itsScale)};
+}
+
+void TopologyEncoder::appendPoint(std::string& theBuffer, const Point& thePoint) const
+{
+  theBuffer += '[';
+  append(theBuffer, thePoint.x);
+  theBuffer += ',';
+  append(theBuffer, thePoint.y);
+  theBuffer += ']';
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Add a geometry to the topology
+ */
+// ----------------------------------------------------------------------
+
+std::size_t TopologyEncoder::add(const OGRGeometry& theGeom)
+{
+  try
+  {
+    std::string coordinates;
+    itsShapes.push_back(shape(theGeom, coordinates));
+    itsCoordinates.push_back(std::move(coordinates));
+    return itsShapes.size() - 1;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Quantise a line or a ring into a path of the shape
+ *
+ * Consecutive duplicate points are removed. Returns false if nothing
+ * is left of the path.
+ */
+// ----------------------------------------------------------------------
+
+bool TopologyEncoder::addPath(const OGRLineString& theLine, bool theRing, Shape& theShape)
+{
+  Path path;
+  path.ring = theRing;
+
+  const int n = theLine.getNumPoints();
+  path.points.reserve(n + 1);
+  for (int i = 0; i < n; i++)
+  {
+    auto point = quantise(theLine.getX(i), theLine.getY(i));
+    if (path.points.empty() || point != path.points.back())
+      path.points.push_back(point);
+  }
+
+  if (theRing)
+  {
+    if (!path.points.empty() && path.points.back() != path.points.front())
+      path.points.push_back(path.points.front());
+    if (path.points.size() < 4)
+      return false;
+  }
+  else if (path.points.size() < 2)
+    return false;
+
+  theShape.paths.push_back(itsPaths.size());
+  itsPaths.push_back(std::move(path));
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Collect the paths of a geometry, and the coordinates of its points
+ */
+// ----------------------------------------------------------------------
+
+TopologyEncoder::Shape TopologyEncoder::shape(const OGRGeometry& theGeom,
+                                               std::string& theCoordinates)
+{
+  Shape ret;
+
+  switch (wkbFlatten(theGeom.getGeometryType()))
+  {
+    case wkbPoint:
+    {
+      const auto* point = theGeom.toPoint();
+      if (!theCoordinates.empty())
+        theCoordinates += ',';
+      appendPoint(theCoordinates, quantise(point->getX(), point->getY()));
+      break;
+    }
+    case wkbMultiPoint:
+    {
+      const auto* points = theGeom.toMultiPoint();
+      if (!theCoordinates.empty())
+        theCoordinates += ',';
+      theCoordinates += '[';
+      for (int i = 0, n = points->getNumGeometries(); i < n; i++)
+      {
+        const auto* point = points->getGeometryRef(i);
+        if (i > 0)
+          theCoordinates += ',';
+        appendPoint(theCoordinates, quantise(point->getX(), point->getY()));
+      }
+      theCoordinates += ']';
+      break;
+    }
+    case wkbLineString:
+    case wkbLinearRing:
+    {
+      ret.kind = Shape::Kind::Line;
+      addPath(*theGeom.toLineString(), theGeom.getGeometryType() == wkbLinearRing, ret);
+      break;
+    }
+    case wkbMultiLineString:
+    {
+      ret.kind = Shape::Kind::Lines;
+      const auto* lines = theGeom.toMultiLineString();
+      for (int i = 0, n = lines->getNumGeometries(); i < n; i++)
+        addPath(*lines->getGeometryRef(i), false, ret);
+      break;
+    }
+    case wkbPolygon:
+    {
+      ret.kind = Shape::Kind::Lines;
+      const auto* polygon = theGeom.toPolygon();
+      const auto* exterior = polygon->getExteriorRing();
+      if (exterior == nullptr || !addPath(*exterior, true, ret))
+        break;
+      for (int i = 0, n = polygon->getNumInteriorRings(); i < n; i++)
+        addPath(*polygon->getInteriorRing(i), true, ret);
+      break;
+    }
+    case wkbMultiPolygon:
+    case wkbGeometryCollection:
+    {
+      ret.kind = Shape::Kind::Collection;
+      const auto* collection = theGeom.toGeometryCollection();
+      for (int i = 0, n = collection->getNumGeometries(); i < n; i++)
+        ret.members.push_back(shape(*collection->getGeometryRef(i), theCoordinates));
+      break;
+    }
+    default:
+      throw Fmi::Exception(BCP, "Encountered an unknown geometry component!");
+  }
+
+  return ret;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Reference to an arc, writing it out if it is new
+ */
+// ----------------------------------------------------------------------
+
+long long TopologyEncoder::arc(const Point* theBegin,
+                               const Point* theEnd,
+                               std::unordered_map<std::size_t, uint>& theArcHashMap,
+                               uint& theArcCounter)
+{
+  std::size_t hash = 0;
+  for (const auto* p = theBegin; p != theEnd; ++p)
+  {
+    Fmi::hash_combine(hash, Fmi::hash_value(p->x));
+    Fmi::hash_combine(hash, Fmi::hash_value(p->y));
+  }
+
+  auto pos = theArcHashMap.find(hash);
+  if (pos != theArcHashMap.end())
+    return pos->second;
+
+  std::size_t reverse_hash = 0;
+  for (const auto* p = theEnd; p != theBegin;)
+  {
+    --p;
+    Fmi::hash_combine(reverse_hash, Fmi::hash_value(p->x));
+    Fmi::hash_combine(reverse_hash, Fmi::hash_value(p->y));
+  }
+
+  pos = theArcHashMap.find(reverse_hash);
+  if (pos != theArcHashMap.end())
+    return ~static_cast<long long>(pos->second);
+
+  const auto number = theArcCounter++;
+  theArcHashMap.emplace(hash, number);
+
+  if (!itsNewArcs.empty())
+    itsNewArcs += ',';
+  itsNewArcs += '[';
+  appendPoint(itsNewArcs, *theBegin);
+  for (const auto* p = theBegin + 1; p != theEnd; ++p)
+  {
+    itsNewArcs += ',';
+    appendPoint(itsNewArcs, Point{p->x - (p - 1)->x, p->y - (p - 1)->y});
+  }
+  itsNewArcs += ']';
+
+  return number;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cut the paths into arcs at junctions and write the arc references
+ */
+// ----------------------------------------------------------------------
+
+void TopologyEncoder::encode(std::unordered_map<std::size_t, uint>& theArcHashMap,
+                             uint& theArcCounter)
+{
+  try
+  {
+    // The neighbours of each vertex. A vertex is a junction if another path passes
+    // through it from or to a different vertex, or if an open line ends at it.
+
+    struct Node
+    {
+      Point a;
+      Point b;
+      bool junction = false;
+    };
+
+    std::size_t npoints = 0;
+    for (const auto& path : itsPaths)
+      npoints += path.points.size();
+
+    std::unordered_map<Point, Node, PointHash> nodes;
+    nodes.reserve(npoints);
+
+    auto visit = [&nodes](const Point& thePoint, const Point& thePrev, const Point& theNext)
+    {
+      const auto& a = std::min(thePrev, theNext);
+      const auto& b = std::max(thePrev, theNext);
+      auto result = nodes.try_emplace(thePoint, Node{a, b, false});
+      auto& node = result.first->second;
+      if (!result.second && (node.a != a || node.b != b))
+        node.junction = true;
+    };
+
+    for (const auto& path : itsPaths)
+    {
+      const auto& points = path.points;
+      const auto n = points.size();
+      if (path.ring)
+      {
+        for (std::size_t i = 0; i < n - 1; i++)
+          visit(points[i], points[i > 0 ? i - 1 : n - 2], points[i + 1]);
+      }
+      else
+      {
+        nodes[points.front()].junction = true;
+        nodes[points.back()].junction = true;
+        for (std::size_t i = 1; i < n - 1; i++)
+          visit(points[i], points[i - 1], points[i + 1]);
+      }
+    }
+
+    auto is_junction = [&nodes](const Point& thePoint) { return nodes.at(thePoint).junction; };
+
+    std::vector<Point> rotated;
+    for (auto& path : itsPaths)
+    {
+      const auto* begin = path.points.data();
+      const auto* end = begin + path.points.size();
+
+      // Rings start from a junction, or from the smallest vertex if there are none so
+      // that identical rings produce identical arcs whatever their starting points.
+      if (path.ring)
+      {
+        const auto* last = end - 1;
+        const auto* start = std::find_if(begin, last, is_junction);
+        if (start == last)
+          start = std::min_element(begin, last);
+
+        rotated.assign(start, last);
+        rotated.insert(rotated.end(), begin, start);
+        rotated.push_back(*start);
+        begin = rotated.data();
+        end = begin + rotated.size();
+      }
+
+      const auto* first = begin;
+      for (const auto* p = begin + 1; p != end; ++p)
+      {
+        if (p + 1 == end || is_junction(*p))
+        {
+          path.arcs.push_back(arc(first, p + 1, theArcHashMap, theArcCounter));
+          first = p;
+        }
+      }
+    }
+
+    itsArcs.resize(itsShapes.size());
+    for (std::size_t i = 0; i < itsShapes.size(); i++)
+      writeArcs(itsArcs[i], itsShapes[i]);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the arc references of a shape, nothing if it is empty
+ */
+// ----------------------------------------------------------------------
+
+void TopologyEncoder::writeArcs(std::string& theBuffer, const Shape& theShape) const
+{
+  auto write_path = [this, &theBuffer](std::size_t thePath)
+  {
+    theBuffer += '[';
+    const auto& arcs = itsPaths[thePath].arcs;
+    for (std::size_t i = 0; i < arcs.size(); i++)
+    {
+      if (i > 0)
+        theBuffer += ',';
+      append(theBuffer, arcs[i]);
+    }
+    theBuffer += ']';
+  };
+
+  switch (theShape.kind)
+  {
+    case Shape::Kind::Points:
+      break;
+    case Shape::Kind::Line:
+      if (!theShape.paths.empty())
+        write_path(theShape.paths.front());
+      break;
+    case Shape::Kind::Lines:
+      if (!theShape.paths.empty())
+      {
+        theBuffer += '[';
+        for (std::size_t i = 0; i < theShape.paths.size(); i++)
+        {
+          if (i > 0)
+            theBuffer += ',';
+          write_path(theShape.paths[i]);
+        }
+        theBuffer += ']';
+      }
+      break;
+    case Shape::Kind::Collection:
+    {
+      std::string members;
+      for (const auto& member : theShape.members)
+      {
+        std::string arcs;
+        writeArcs(arcs, member);
+        if (arcs.empty())
+          continue;
+        if (!members.empty())
+          members += ',';
+        members += arcs;
+      }
+      if (!members.empty())
+      {
+        theBuffer += '[';
+        theBuffer += members;
+        theBuffer += ']';
+      }
+      break;
+    }
+  }
+}
+
+const std::string& TopologyEncoder::arcs(std::size_t theIndex) const
+{
+  return itsArcs.at(theIndex);
+}
+
+const std::string& TopologyEncoder::coordinates(std::size_t theIndex) const
+{
+  return itsCoordinates.at(theIndex);
+}
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,122 @@
+// ======================================================================
+/*!
+ * \brief TopoJSON encoder with shared arcs
+ *
+ * Geometries are quantised to integers and their lines and rings are
+ * cut at junctions, the vertices where the neighbouring vertices differ
+ * between two paths passing through them, or where an open line ends.
+ * The boundary shared by two adjacent polygons, such as neighbouring
+ * isobands, then becomes a single arc referenced by both polygons,
+ * one of them in reverse.
+ *
+ * Junctions are only found between geometries added to the same
+ * encoder, so all geometries of a layer should be added before
+ * encoding. Arcs are also reused from earlier encoders of the same
+ * request through the hash map of the arcs already output.
+ *
+ * Arcs are written as quantised deltas, the first point being absolute.
+ */
+// ======================================================================
+
+#pragma once
+
+#include <ogr_geometry.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Dali
+{
+class TopologyEncoder
+{
+ public:
+  // The coordinates are multiplied by 10^precision and truncated towards zero
+  explicit TopologyEncoder(double thePrecision);
+
+  // Add a geometry to the topology, returns the index of the geometry
+  std::size_t add(const OGRGeometry& theGeom);
+
+  // Build the arcs. Arcs found in the map are referenced, new arcs are numbered
+  // starting from the counter and added to the map.
+  void encode(std::unordered_map<std::size_t, uint>& theArcHashMap, uint& theArcCounter);
+
+  // The "arcs" member of a geometry, empty for points and empty geometries
+  const std::string& arcs(std::size_t theIndex) const;
+
+  // The "coordinates" member of a point geometry, empty for other geometries
+  const std::string& coordinates(std::size_t theIndex) const;
+
+  // The new arcs, separated by commas
+  const std::string& newArcs() const { return itsNewArcs; }
+
+ private:
+  struct Point
+  {
+    long long x = 0;
+    long long y = 0;
+
+    bool operator==(const Point& theOther) const { return x == theOther.x && y == theOther.y; }
+    bool operator!=(const Point& theOther) const { return !(*this == theOther); }
+    bool operator<(const Point& theOther) const
+    {
+      return x < theOther.x || (x == theOther.x && y < theOther.y);
+    }
+  };
+
+  struct PointHash
+  {
+    std::size_t operator()(const Point& thePoint) const
+    {
+      return std::hash<long long>()(thePoint.x) * 31 + std::hash<long long>()(thePoint.y);
+    }
+  };
+
+  struct Path
+  {
+    std::vector<Point> points;  // rings are closed
+    bool ring = false;
+    std::vector<long long> arcs;  // arc references, negative ones reversed
+  };
+
+  struct Shape
+  {
+    enum class Kind
+    {
+      Points,      // coordinates only
+      Line,        // arcs of a single path
+      Lines,       // arcs of each path, for multilines and polygons
+      Collection,  // arcs of each member, for multipolygons and collections
+    };
+
+    Kind kind = Kind::Points;
+    std::vector<std::size_t> paths;
+    std::vector<Shape> members;
+  };
+
+  Shape shape(const OGRGeometry& theGeom, std::string& theCoordinates);
+  bool addPath(const OGRLineString& theLine, bool theRing, Shape& theShape);
+  Point quantise(double theX, double theY) const;
+  void appendPoint(std::string& theBuffer, const Point& thePoint) const;
+  long long arc(const Point* theBegin,
+                const Point* theEnd,
+                std::unordered_map<std::size_t, uint>& theArcHashMap,
+                uint& theArcCounter);
+  void writeArcs(std::string& theBuffer, const Shape& theShape) const;
+
+  double itsScale = 1;
+
+  std::vector<Path> itsPaths;
+  std::vector<Shape> itsShapes;
+  std::vector<std::string> itsArcs;
+  std::vector<std::string> itsCoordinates;
+  std::string itsNewArcs;
+};
+
+}  // namespace Dali
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -141,6 +141,18 @@ void View::getFeatureInfo(CTPP::CDT& theInfo, const State& theState)
   layers.getFeatureInfo(theInfo, theState);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move the valid time of the view and its layers
+ */
+// ----------------------------------------------------------------------
+
+void View::shiftValidTime(const Fmi::TimeDuration& theOffset)
+{
+  Properties::shiftValidTime(theOffset);
+  layers.shiftValidTime(theOffset);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Hash value = combined hash from all layers
@@ -47,6 +47,9 @@ class View : public Properties
   void generate(CTPP::CDT& theGlobals, CTPP::CDT& theViewCdt, State& theState);
   void getFeatureInfo(CTPP::CDT& theInfo, const State& theState);
 
+  // Move the valid times of all layers, for example for the next step of a time series
+  void shiftValidTime(const Fmi::TimeDuration& theOffset);
+
   std::size_t hash_value(const State& theState) const;
 
   void addGridParameterInfo(ParameterInfos& infos, const State& theState) const;
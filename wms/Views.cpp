@@ -105,6 +105,18 @@ void Views::getFeatureInfo(CTPP::CDT& theInfo, const State& theState)
     view->getFeatureInfo(theInfo, theState);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move the valid times of all views
+ */
+// ----------------------------------------------------------------------
+
+void Views::shiftValidTime(const Fmi::TimeDuration& theOffset)
+{
+  for (const auto& view : views)
+    view->shiftValidTime(theOffset);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Hash value = combined hash from all views
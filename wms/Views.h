@@ -38,6 +38,7 @@ class Views
 
   void generate(CTPP::CDT& theGlobals, State& theState);
   void getFeatureInfo(CTPP::CDT& theInfo, const State& theState);
+  void shiftValidTime(const Fmi::TimeDuration& theOffset);
 
   std::size_t hash_value(const State& theState) const;
 
@@ -168,7 +168,7 @@ void WKTLayer::generate(CTPP::CDT& theGlobals, CTPP::CDT& theLayersCdt, State& t
 
     CTPP::CDT wkt_cdt(CTPP::CDT::HASH_VAL);
     wkt_cdt["iri"] = iri;
-    wkt_cdt["data"] = Geometry::toString(*geom, theState.getType(), box, crs, precision);
+    wkt_cdt["data"] = Geometry::toString(*geom, theState, box, crs, precision);
     wkt_cdt["type"] = Geometry::name(*geom, theState.getType());
     wkt_cdt["layertype"] = "wkt";
 
@@ -10,6 +10,7 @@
 #include "Select.h"
 #include "State.h"
 #include "Stations.h"
+#include "ValueTools.h"
 #include "WindRose.h"
 #include <boost/math/constants/constants.hpp>
 #include <boost/timer/timer.hpp>
@@ -36,6 +37,8 @@ namespace Dali
 {
 namespace
 {
+// Observations of one station
+using TimedValues = std::vector<TS::TimedValue>;
 
 #if 0
 struct value_printer : public boost::static_visitor<std::string>
@@ -60,9 +63,9 @@ struct value_printer : public boost::static_visitor<std::string>
  */
 // ----------------------------------------------------------------------
 
-bool is_rose_data_valid(const TS::TimeSeries& directions,
-                        const TS::TimeSeries& speeds,
-                        const TS::TimeSeries& temperatures)
+bool is_rose_data_valid(const TimedValues& directions,
+                        const TimedValues& speeds,
+                        const TimedValues& temperatures)
 {
   try
   {
@@ -118,7 +121,7 @@ bool is_rose_data_valid(const TS::TimeSeries& directions,
  */
 // ----------------------------------------------------------------------
 
-double mean(const TS::TimeSeries& tseries)
+double mean(const TimedValues& tseries)
 {
   try
   {
@@ -149,7 +152,7 @@ double mean(const TS::TimeSeries& tseries)
  */
 // ----------------------------------------------------------------------
 
-double max(const TS::TimeSeries& tseries)
+double max(const TimedValues& tseries)
 {
   try
   {
@@ -241,7 +244,7 @@ double sector_end_angle(int sector, int sectors)
  */
 // ----------------------------------------------------------------------
 
-std::vector<double> calculate_rose_distribution(const TS::TimeSeries& directions, int sectors)
+std::vector<double> calculate_rose_distribution(const TimedValues& directions, int sectors)
 {
   try
   {
@@ -281,8 +284,8 @@ std::vector<double> calculate_rose_distribution(const TS::TimeSeries& directions
  */
 // ----------------------------------------------------------------------
 
-std::vector<double> calculate_rose_maxima(const TS::TimeSeries& directions,
-                                          const TS::TimeSeries& speeds,
+std::vector<double> calculate_rose_maxima(const TimedValues& directions,
+                                          const TimedValues& speeds,
                                           int sectors)
 {
   try
@@ -701,62 +704,107 @@ std::map<int, WindRoseData> WindRoseLayer::getObservations(State& theState,
     settings.timezone = timezone;
     settings.useCommonQueryMethod = true;
 
-    auto& observation = theState.getObsEngine();
-    settings.parameters.push_back(TS::makeParameter("WindDirection"));
-    settings.parameters.push_back(TS::makeParameter("WindSpeedMS"));
-    settings.parameters.push_back(TS::makeParameter("t2m"));
-    settings.parameters.push_back(TS::makeParameter("stationlongitude"));
-    settings.parameters.push_back(TS::makeParameter("stationlatitude"));
+    // Statistics already calculated for the same observations are shared by all requests
 
-    // settings.debug_options = Engine::Observation::Settings::DUMP_SETTINGS;
+    const Fmi::TimePeriod period(theStartTime, theEndTime);
+    const auto version = theState.getObservationHash(settings.stationtype, period);
+
+    auto station_hash = [&](int fmisid) -> std::size_t
+    {
+      if (version == Fmi::bad_hash)
+        return Fmi::bad_hash;
+      auto hash = version;
+      Fmi::hash_combine(hash, Fmi::hash_value(fmisid));
+      Fmi::hash_combine(hash, Fmi::hash_value(timezone));
+      Fmi::hash_combine(hash, Fmi::hash_value(windrose.sectors));
+      return hash;
+    };
 
     std::map<int, WindRoseData> result;
 
     for (const auto& station : stations.stations)
     {
-      settings.taggedFMISIDs.clear();
       if (!station.fmisid)
         throw Fmi::Exception(BCP, "Station fmisid is required for wind roses");
 
-      settings.taggedFMISIDs.emplace_back(Fmi::to_string(*station.fmisid), *station.fmisid);
+      const int fmisid = *station.fmisid;
+      if (result.find(fmisid) != result.end())
+        continue;
 
-      auto res = observation.values(settings);
+      if (auto cached = theState.findWindRose(station_hash(fmisid)))
+        result[fmisid] = *cached;
+      else if (std::none_of(settings.taggedFMISIDs.begin(),
+                            settings.taggedFMISIDs.end(),
+                            [fmisid](const auto& tagged) { return tagged.fmisid == fmisid; }))
+        settings.taggedFMISIDs.emplace_back(Fmi::to_string(fmisid), fmisid);
+    }
 
-      // We skip stations with missing data
+    if (settings.taggedFMISIDs.empty())
+      return result;
 
-      if (!res || res->size() != 5)
-        continue;
+    // Fetch all the remaining stations at once and split the rows by station
 
-      const auto& values = *res;
+    auto& observation = theState.getObsEngine();
+    settings.parameters.push_back(TS::makeParameter("WindDirection"));
+    settings.parameters.push_back(TS::makeParameter("WindSpeedMS"));
+    settings.parameters.push_back(TS::makeParameter("t2m"));
+    settings.parameters.push_back(TS::makeParameter("stationlongitude"));
+    settings.parameters.push_back(TS::makeParameter("stationlatitude"));
+    settings.parameters.push_back(TS::makeParameter("fmisid"));
+
+    // settings.debug_options = Engine::Observation::Settings::DUMP_SETTINGS;
+
+    auto res = observation.values(settings);
+
+    // We skip stations with missing data
 
-      const auto& directions = values[0];
-      const auto& speeds = values[1];
-      const auto& temperatures = values[2];
-      const auto& longitudes = values[3];
-      const auto& latitudes = values[4];
+    if (!res || res->size() != 6)
+      return result;
 
-      if (latitudes.empty() || longitudes.empty() || temperatures.empty() || speeds.empty() ||
-          directions.empty())
+    const auto& values = *res;
+    const auto nparams = values.size() - 1;
+
+    std::map<int, std::vector<TimedValues>> station_values;
+    for (std::size_t row = 0; row < values[nparams].size(); row++)
+    {
+      const auto fmisid = get_fmisid(values[nparams][row]);
+      auto& series = station_values[fmisid];
+      if (series.empty())
+        series.resize(nparams);
+      for (std::size_t i = 0; i < nparams; i++)
+        series[i].push_back(values[i].at(row));
+    }
+
+    for (const auto& tagged : settings.taggedFMISIDs)
+    {
+      const auto pos = station_values.find(tagged.fmisid);
+      if (pos == station_values.end())
       {
         // No data for this station, continue to the next
-        std::cerr << "No data for " << *station.fmisid << '\n';
-
+        std::cerr << "No data for " << tagged.fmisid << '\n';
         continue;
       }
 
+      const auto& directions = pos->second[0];
+      const auto& speeds = pos->second[1];
+      const auto& temperatures = pos->second[2];
+      const auto& longitudes = pos->second[3];
+      const auto& latitudes = pos->second[4];
+
       WindRoseData rosedata;
       rosedata.mean_wind = mean(speeds);
       rosedata.max_wind = max(speeds);
-      rosedata.mean_temperature = mean((*res)[2]);
+      rosedata.mean_temperature = mean(temperatures);
 
-      rosedata.longitude = std::get<double>(longitudes[0].value);
-      rosedata.latitude = std::get<double>(latitudes[0].value);
+      rosedata.longitude = get_double(longitudes[0]);
+      rosedata.latitude = get_double(latitudes[0]);
 
       rosedata.percentages = calculate_rose_distribution(directions, windrose.sectors);
       rosedata.max_winds = calculate_rose_maxima(directions, speeds, windrose.sectors);
       rosedata.valid = is_rose_data_valid(directions, speeds, temperatures);
 
-      result[*station.fmisid] = rosedata;
+      theState.insertWindRose(station_hash(tagged.fmisid), rosedata);
+      result[tagged.fmisid] = rosedata;
     }
 
     return result;
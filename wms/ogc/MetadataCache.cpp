@@ -0,0 +1,129 @@
+#include "MetadataCache.h"
+#include <fmt/printf.h>
+#include <macgyver/Exception.h>
+#include <macgyver/Hash.h>
+#include <array>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace OGC
+{
+namespace
+{
+// Documents are regenerated at least this often, since the time dimensions
+// of observation layers advance with the wall clock. Same as for the WMS
+// GetCapabilities cache.
+constexpr long kMetadataCacheTtlSeconds = 30;
+
+// Request parameters which affect the documents
+constexpr std::array<const char*, 3> kMetadataKeyParams = {"f", "format", "language"};
+
+// Request headers used to construct absolute URLs and to control apikey embedding
+constexpr std::array<const char*, 3> kMetadataKeyHeaders = {
+    "Host",
+    "X-Forwarded-Proto",
+    "omit-fmi-apikey",
+};
+
+std::size_t metadata_key(const Spine::HTTP::Request& theRequest,
+                         const std::optional<std::string>& theApiKey)
+{
+  auto hash = Fmi::hash_value(theRequest.getResource());
+
+  for (const auto* name : kMetadataKeyParams)
+  {
+    Fmi::hash_combine(hash, Fmi::hash_value(std::string{name}));
+    Fmi::hash_combine(hash, Fmi::hash_value(theRequest.getParameter(name).value_or("")));
+  }
+
+  for (const auto* name : kMetadataKeyHeaders)
+  {
+    Fmi::hash_combine(hash, Fmi::hash_value(std::string{name}));
+    Fmi::hash_combine(hash, Fmi::hash_value(theRequest.getHeader(name).value_or("")));
+  }
+
+  Fmi::hash_combine(hash, Fmi::hash_value(theRequest.getProtocol().value_or("")));
+  Fmi::hash_combine(hash, Fmi::hash_value(theApiKey.value_or("")));
+  return hash;
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache(std::size_t theMaxEntries) : itsCache(theMaxEntries) {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Serve a cached document or generate a new one
+ *
+ * Failed responses, such as unknown collections, are passed through
+ * without caching.
+ */
+// ----------------------------------------------------------------------
+
+QueryStatus MetadataCache::respond(const Spine::HTTP::Request& theRequest,
+                                   Spine::HTTP::Response& theResponse,
+                                   const std::optional<std::string>& theApiKey,
+                                   const Fmi::DateTime& theVersion,
+                                   const Generator& theGenerator)
+{
+  try
+  {
+    const auto key = metadata_key(theRequest, theApiKey);
+    const auto now = Fmi::SecondClock::universal_time();
+
+    std::optional<Document> document;
+    if (auto hit = itsCache.find(key))
+    {
+      if (hit->version == theVersion &&
+          (now - hit->built_at) < Fmi::Seconds(kMetadataCacheTtlSeconds))
+        document = std::move(*hit);
+    }
+
+    if (!document)
+    {
+      auto status = theGenerator(theResponse);
+      if (status != QueryStatus::OK || theResponse.getStatus() != Spine::HTTP::Status::ok)
+        return status;
+
+      Document entry;
+      entry.body = std::make_shared<std::string>(theResponse.getContent());
+      entry.content_type = theResponse.getHeader("Content-Type").value_or("");
+      entry.etag = fmt::sprintf("\"%x\"", Fmi::hash_value(*entry.body));
+      entry.version = theVersion;
+      entry.built_at = now;
+      itsCache.insert(key, entry);
+      document = std::move(entry);
+    }
+
+    theResponse.setHeader("Content-Type", document->content_type);
+    theResponse.setHeader("ETag", document->etag);
+
+    // The frontend probes for the ETag before fetching the body
+    if (theRequest.getHeader("X-Request-ETag"))
+    {
+      theResponse.setStatus(Spine::HTTP::Status::no_content);
+      theResponse.setContent(std::string());
+      return QueryStatus::OK;
+    }
+
+    if (auto status = Spine::HTTP::conditionalResponseStatus(theRequest, document->etag))
+    {
+      theResponse.setStatus(*status);
+      theResponse.setContent(std::string());
+      return QueryStatus::OK;
+    }
+
+    theResponse.setContent(*document->body);
+    return QueryStatus::OK;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace OGC
+}  // namespace Plugin
+}  // namespace SmartMet
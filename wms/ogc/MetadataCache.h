@@ -0,0 +1,72 @@
+// ======================================================================
+/*!
+ * \brief Response cache for WMTS and OGC API - Tiles metadata documents
+ *
+ * The WMTS capabilities and the OGC API - Tiles collection, tile matrix
+ * set and tileset documents are built from the WMS layer capabilities,
+ * which is expensive, yet map clients fetch them on every page load.
+ *
+ * The documents are cached by the resource, the apikey and the request
+ * inputs which affect the generated URLs and texts. A document is
+ * regenerated when the WMS layer metadata changes, or at the latest
+ * after a short time to follow the advancing time dimensions of
+ * observation layers, the same way as the WMS GetCapabilities cache.
+ *
+ * Responses carry an ETag, and conditional requests are answered with
+ * 304 Not Modified without a body.
+ */
+// ======================================================================
+
+#pragma once
+
+#include "QueryStatus.h"
+#include <macgyver/Cache.h>
+#include <macgyver/DateTime.h>
+#include <spine/HTTP.h>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace OGC
+{
+class MetadataCache
+{
+ public:
+  // Writes the document into the response
+  using Generator = std::function<QueryStatus(Spine::HTTP::Response&)>;
+
+  explicit MetadataCache(std::size_t theMaxEntries);
+
+  MetadataCache(const MetadataCache&) = delete;
+  MetadataCache& operator=(const MetadataCache&) = delete;
+
+  // Serve the document from the cache, or generate it and cache it if it succeeds
+  QueryStatus respond(const Spine::HTTP::Request& theRequest,
+                      Spine::HTTP::Response& theResponse,
+                      const std::optional<std::string>& theApiKey,
+                      const Fmi::DateTime& theVersion,
+                      const Generator& theGenerator);
+
+  Fmi::Cache::CacheStats statistics() const { return itsCache.statistics(); }
+
+ private:
+  struct Document
+  {
+    std::shared_ptr<std::string> body;
+    std::string content_type;
+    std::string etag;
+    Fmi::DateTime version;   // WMS layer metadata generation at render
+    Fmi::DateTime built_at;  // wall-clock at render, used for the time limit
+  };
+
+  mutable Fmi::Cache::Cache<std::size_t, Document> itsCache;
+};
+
+}  // namespace OGC
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -8,6 +8,7 @@
 #include "../Hash.h"
 #include "../MapboxStyle.h"
 #include "../Mime.h"
+#include "../PMTiles.h"
 #include "../Plugin.h"
 #include "../Product.h"
 #include "../State.h"
@@ -15,13 +16,21 @@
 #include "../ogc/StyleSelection.h"
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <mutex>
 #include <optional>
 #include <fmt/format.h>
 #include <fmt/printf.h>
 #include <json/json.h>
 #include <json/writer.h>
+#include <macgyver/DateTime.h>
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
+#include <macgyver/TimeParser.h>
 #include <spine/Convenience.h>
 #include <spine/FmiApiKey.h>
 #include <spine/Json.h>
@@ -40,6 +49,11 @@ using OGC::useStyle;
 namespace
 {
 
+// Max entries in the metadata document cache. The key contains the
+// collection and tile matrix set of the resource, so the cache must hold
+// a few documents for each layer.
+constexpr std::size_t kMetadataCacheMaxEntries = 1000;
+
 // -----------------------------------------------------------------------
 // Path utilities
 // -----------------------------------------------------------------------
@@ -120,6 +134,41 @@ std::string extensionOrParamToMime(const std::string& f)
   return {};
 }
 
+// -----------------------------------------------------------------------
+// Tile baking
+// -----------------------------------------------------------------------
+
+// PMTiles tile type for a baked format, Unknown if the format cannot be baked
+Dali::PMTiles::TileType bakeTileType(const std::string& mime)
+{
+  if (mime == "image/png")
+    return Dali::PMTiles::TileType::PNG;
+  if (mime == "image/webp")
+    return Dali::PMTiles::TileType::WEBP;
+  if (mime == "application/vnd.mapbox-vector-tile")
+    return Dali::PMTiles::TileType::MVT;
+  return Dali::PMTiles::TileType::Unknown;
+}
+
+// Keep only characters which are safe in file names, e.g. 2026-01-01T06:00:00Z -> 20260101T060000Z
+std::string fileNamePart(const std::string& value, const std::string& fallback)
+{
+  std::string ret;
+  for (char ch : value)
+    if (std::isalnum(static_cast<unsigned char>(ch)) != 0 || ch == '_')
+      ret += ch;
+  return ret.empty() ? fallback : ret;
+}
+
+// Block of adjacent tiles rendered by the same worker
+struct MetaTile
+{
+  unsigned zoom;
+  const WMTS::TileMatrix* matrix;
+  unsigned row;
+  unsigned col;
+};
+
 }  // namespace
 
 // -----------------------------------------------------------------------
@@ -129,6 +178,7 @@ Handler::Handler(const Dali::Config& daliConfig) : itsDaliConfig(daliConfig) {}
 void Handler::init(std::unique_ptr<Config> tilesConfig)
 {
   itsTilesConfig = std::move(tilesConfig);
+  itsMetadataCache = std::make_unique<OGC::MetadataCache>(kMetadataCacheMaxEntries);
 }
 
 void Handler::shutdown()
@@ -136,6 +186,35 @@ void Handler::shutdown()
   // Stateless per request — nothing to tear down.
 }
 
+Fmi::Cache::CacheStats Handler::getMetadataCacheStats() const
+{
+  if (itsMetadataCache)
+    return itsMetadataCache->statistics();
+  return {};
+}
+
+// -----------------------------------------------------------------------
+/*!
+ * \brief Serve a metadata document cached until the WMS layers change
+ */
+// -----------------------------------------------------------------------
+QueryStatus Handler::cachedMetadata(Dali::State& theState,
+                                    const Spine::HTTP::Request& theRequest,
+                                    Spine::HTTP::Response& theResponse,
+                                    const OGC::MetadataCache::Generator& theGenerator)
+{
+  const auto& wmsConfig = itsTilesConfig->wmsConfig();
+  theState.updateExpirationTime(wmsConfig.getCapabilitiesExpirationTime());
+  theState.updateModificationTime(wmsConfig.getCapabilitiesModificationTime());
+
+  const bool check_token = true;
+  return itsMetadataCache->respond(theRequest,
+                                   theResponse,
+                                   Spine::FmiApiKey::getFmiApiKey(theRequest, check_token),
+                                   wmsConfig.getCapabilitiesModificationTime(),
+                                   theGenerator);
+}
+
 // -----------------------------------------------------------------------
 /*!
  * \brief Main OGC API - Tiles entry point
@@ -165,7 +244,11 @@ QueryStatus Handler::query(Spine::Reactor& /* theReactor */,
     if (parts[0] == "tileMatrixSets")
     {
       if (parts.size() == 1)
-        return handleTileMatrixSets(base, theResponse);
+        return cachedMetadata(theState,
+                              theRequest,
+                              theResponse,
+                              [&](Spine::HTTP::Response& resp)
+                              { return handleTileMatrixSets(base, resp); });
       if (parts.size() == 2)
         return handleTileMatrixSet(base, parts[1], theResponse);
     }
@@ -178,18 +261,31 @@ QueryStatus Handler::query(Spine::Reactor& /* theReactor */,
     if (parts[0] == "collections")
     {
       if (parts.size() == 1)
-        return handleCollections(base, theState, theRequest, theResponse);
+        return cachedMetadata(theState,
+                              theRequest,
+                              theResponse,
+                              [&](Spine::HTTP::Response& resp)
+                              { return handleCollections(base, theState, theRequest, resp); });
 
       const std::string& collId = parts[1];
 
       if (parts.size() == 2)
-        return handleCollection(base, collId, theState, theRequest, theResponse);
+        return cachedMetadata(
+            theState,
+            theRequest,
+            theResponse,
+            [&](Spine::HTTP::Response& resp)
+            { return handleCollection(base, collId, theState, theRequest, resp); });
 
       if (parts.size() == 3 && parts[2] == "tiles")
         return handleCollectionTilesets(base, collId, theResponse);
 
       if (parts.size() == 4 && parts[2] == "tiles")
-        return handleTilesetMetadata(base, collId, parts[3], theResponse);
+        return cachedMetadata(theState,
+                              theRequest,
+                              theResponse,
+                              [&](Spine::HTTP::Response& resp)
+                              { return handleTilesetMetadata(base, collId, parts[3], resp); });
 
       // --- /collections/{id}/styles (OGC API - Styles) ---
       if (parts.size() == 3 && parts[2] == "styles")
@@ -198,6 +294,13 @@ QueryStatus Handler::query(Spine::Reactor& /* theReactor */,
       if (parts.size() == 4 && parts[2] == "styles")
         return handleStyle(base, collId, parts[3], theState, theRequest, theResponse);
 
+      // /collections/{id}/tiles/{tmsId}/bake
+      if (parts.size() == 5 && parts[2] == "tiles" && parts[4] == "bake")
+      {
+        std::string format = negotiateFormat(theRequest);
+        return handleBake(theState, theRequest, theResponse, collId, parts[3], format);
+      }
+
       // /collections/{id}/tiles/{tmsId}/{tm}/{row}/{col}
       if (parts.size() == 7 && parts[2] == "tiles")
       {
@@ -1271,6 +1374,287 @@ QueryStatus Handler::handleGetTile(Dali::State& theState,
   }
 }
 
+// -----------------------------------------------------------------------
+/*!
+ * \brief Bake a tile pyramid into PMTiles archives
+ *
+ * Renders every tile of the requested zoom levels through handleGetTile,
+ * once for each valid time, and writes one archive per model run and
+ * valid time. The tiles are rendered by bake.threads threads, one bake
+ * at a time. A thread renders a metatile of adjacent tiles one after
+ * another, which lets them share the sampled data when the sample cache
+ * expands the sampled areas (sample_cache.expand). The
+ * archives are indexed by the product hashes of the tiles, which makes
+ * the image cache lookups find them. Archives of model runs older than
+ * the baked run are removed. Only the apikeys listed in bake.apikeys may
+ * bake.
+ *
+ *   GET .../collections/{collId}/tiles/{tmsId}/bake?maxzoom=6[&minzoom=0]
+ *       [&datetime=t1,t2,...][&reference_time=t][&f=png|webp|mvt]
+ */
+// -----------------------------------------------------------------------
+QueryStatus Handler::handleBake(Dali::State& theState,
+                                const Spine::HTTP::Request& theRequest,
+                                Spine::HTTP::Response& theResponse,
+                                const std::string& collId,
+                                const std::string& tmsId,
+                                const std::string& format)
+{
+  try
+  {
+    auto& bakery = theState.getPlugin().getTileBakery();
+    if (!bakery.enabled())
+    {
+      sendError(403, "Forbidden", "Tile baking is not enabled", theResponse);
+      return QueryStatus::OK;
+    }
+
+    const bool check_token = true;
+    if (!bakery.authorized(Spine::FmiApiKey::getFmiApiKey(theRequest, check_token)))
+    {
+      sendError(403, "Forbidden", "Tile baking requires an authorized apikey", theResponse);
+      return QueryStatus::OK;
+    }
+
+    if (!itsTilesConfig->isValidCollection(collId))
+    {
+      sendError(404, "Not Found", "Collection not found: " + collId, theResponse);
+      return QueryStatus::OK;
+    }
+
+    // The threads of one bake are the only threads a bake may use
+    auto reservation = bakery.reserve();
+    if (!reservation.owns_lock())
+    {
+      sendError(409, "Conflict", "Another bake is in progress", theResponse);
+      return QueryStatus::OK;
+    }
+
+    const auto* tms = itsTilesConfig->findTileMatrixSet(tmsId);
+    if (tms == nullptr)
+    {
+      sendError(404, "Not Found", "TileMatrixSet not found: " + tmsId, theResponse);
+      return QueryStatus::OK;
+    }
+
+    const auto tile_type = bakeTileType(format);
+    if (tile_type == Dali::PMTiles::TileType::Unknown)
+    {
+      sendError(400, "Bad Request", "Only PNG, WebP and MVT tiles can be baked", theResponse);
+      return QueryStatus::OK;
+    }
+
+    auto maxzoom = theRequest.getParameter("maxzoom");
+    if (!maxzoom)
+    {
+      sendError(400, "Bad Request", "Parameter maxzoom is required", theResponse);
+      return QueryStatus::OK;
+    }
+    const unsigned max_zoom = Fmi::stoul(*maxzoom);
+    const unsigned min_zoom =
+        Fmi::stoul(Spine::optional_string(theRequest.getParameter("minzoom"), "0"));
+
+    // PMTiles addresses tiles as a quadtree, which rules out for example
+    // the 2x1 top level of geographic tile matrix sets
+
+    std::vector<MetaTile> metatiles;
+    std::size_t ntiles = 0;
+    const unsigned size = itsDaliConfig.bakeMetaTileSize();
+    for (unsigned z = min_zoom; z <= max_zoom; z++)
+    {
+      const auto* tm = itsTilesConfig->findTileMatrix(*tms, Fmi::to_string(z));
+      if (tm == nullptr)
+      {
+        sendError(400,
+                  "Bad Request",
+                  fmt::format("TileMatrix '{}' not found in: {}", z, tmsId),
+                  theResponse);
+        return QueryStatus::OK;
+      }
+      if (z > 31 || tm->matrix_width > (1U << z) || tm->matrix_height > (1U << z))
+      {
+        sendError(400, "Bad Request", "Only quadtree tile matrix sets can be baked", theResponse);
+        return QueryStatus::OK;
+      }
+      ntiles += static_cast<std::size_t>(tm->matrix_width) * tm->matrix_height;
+      for (unsigned row = 0; row < tm->matrix_height; row += size)
+        for (unsigned col = 0; col < tm->matrix_width; col += size)
+          metatiles.push_back(MetaTile{z, tm, row, col});
+    }
+
+    // Valid times, by default the most current one
+
+    const auto& wmsConfig = itsTilesConfig->wmsConfig();
+
+    // The reference time is normalized so that runs can be ordered by it when pruning
+
+    std::optional<Fmi::DateTime> reftime;
+    std::string reference_time;
+    auto reftime_param = theRequest.getParameter("reference_time");
+    if (reftime_param && !reftime_param->empty())
+    {
+      reftime = Fmi::TimeParser::parse(*reftime_param);
+      reference_time = Fmi::to_iso_string(*reftime);
+    }
+
+    std::vector<std::string> times;
+    auto datetime = theRequest.getParameter("datetime");
+    if (datetime && !datetime->empty())
+      boost::algorithm::split(times, *datetime, boost::is_any_of(","));
+    else if (wmsConfig.isTemporal(collId))
+      times.push_back(Fmi::to_iso_string(wmsConfig.mostCurrentTime(collId, reftime)));
+    else
+      times.emplace_back();
+
+    if (ntiles * times.size() > itsDaliConfig.bakeMaxTiles())
+    {
+      sendError(400,
+                "Bad Request",
+                fmt::format("Baking {} tiles exceeds the limit of {} tiles",
+                            ntiles * times.size(),
+                            itsDaliConfig.bakeMaxTiles()),
+                theResponse);
+      return QueryStatus::OK;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    const auto baked = Fmi::to_iso_string(Fmi::SecondClock::universal_time());
+    const auto directory = bakery.directory() + "/" + fileNamePart(collId, "default") + "/" +
+                           fileNamePart(tmsId, "default") + "/" +
+                           fileNamePart(reference_time, "latest");
+    std::filesystem::create_directories(directory);
+
+    Json::Value result;
+    result["collection"] = collId;
+    result["tileMatrixSet"] = tmsId;
+    result["archives"] = Json::Value(Json::arrayValue);
+
+    for (const auto& time : times)
+    {
+      Dali::PMTiles::Writer writer(tile_type, Dali::PMTiles::Compression::None);
+      Json::Value hashes(Json::objectValue);
+      std::mutex mutex;
+      std::atomic<std::size_t> failures{0};
+
+      // The model run of the tiles decides which earlier archives are superseded
+      Fmi::DateTime origin_time = (reftime ? *reftime : Fmi::DateTime::NOT_A_DATE_TIME);
+
+      auto bake = [&](unsigned z, const WMTS::TileMatrix& tm, unsigned row, unsigned col)
+      {
+        auto req = theRequest;
+        req.removeParameter("minzoom");
+        req.removeParameter("maxzoom");
+        req.removeParameter("datetime");
+        if (!time.empty())
+          req.addParameter("datetime", time);
+
+        Dali::State state(theState.getPlugin(), req);
+        state.useWms(true);
+
+        Spine::HTTP::Response resp;
+        resp.setStatus(Spine::HTTP::Status::ok);
+        handleGetTile(state, req, resp, collId, tmsId, tm.identifier, row, col, format);
+
+        auto etag = resp.getHeader("ETag");
+        auto content = resp.getContent();
+        if (resp.getStatus() != Spine::HTTP::Status::ok || !etag || etag->size() < 3 ||
+            content.empty())
+        {
+          ++failures;
+          return;
+        }
+
+        writer.add(static_cast<uint8_t>(z), col, row, content);
+
+        Fmi::DateTime tile_origin = Fmi::DateTime::NOT_A_DATE_TIME;
+        if (!reftime)
+        {
+          for (const auto& producer : state.getLatestProducers())
+          {
+            auto q = state.getModel(producer);
+            if (q && (tile_origin.is_not_a_date_time() || tile_origin < q->originTime()))
+              tile_origin = q->originTime();
+          }
+        }
+
+        const auto tile_id = Dali::PMTiles::zxy_to_tileid(static_cast<uint8_t>(z), col, row);
+        std::lock_guard<std::mutex> lock(mutex);
+        hashes[Fmi::to_string(tile_id)] = etag->substr(1, etag->size() - 2);
+        if (!tile_origin.is_not_a_date_time() &&
+            (origin_time.is_not_a_date_time() || origin_time < tile_origin))
+          origin_time = tile_origin;
+      };
+
+      // Workers take metatiles in turn until all have been rendered
+      std::atomic<std::size_t> next{0};
+      auto work = [&]()
+      {
+        for (std::size_t i = next++; i < metatiles.size(); i = next++)
+        {
+          const auto& meta = metatiles[i];
+          const auto& tm = *meta.matrix;
+          for (unsigned row = meta.row; row < std::min(meta.row + size, tm.matrix_height); row++)
+            for (unsigned col = meta.col; col < std::min(meta.col + size, tm.matrix_width); col++)
+              bake(meta.zoom, tm, row, col);
+        }
+      };
+
+      const auto nworkers =
+          std::min<std::size_t>(metatiles.size(), itsDaliConfig.bakeThreads());
+      std::vector<std::future<void>> workers;
+      for (std::size_t i = 1; i < nworkers; i++)
+        workers.push_back(std::async(std::launch::async, work));
+      work();
+      for (auto& worker : workers)
+        worker.get();
+
+      Json::Value metadata;
+      metadata["name"] = collId;
+      metadata["format"] =
+          (tile_type == Dali::PMTiles::TileType::MVT ? "pbf" : demimetype(format));
+      metadata["dali"]["collection"] = collId;
+      metadata["dali"]["tileMatrixSet"] = tmsId;
+      metadata["dali"]["datetime"] = time;
+      metadata["dali"]["reference_time"] = reference_time;
+      metadata["dali"]["origin_time"] =
+          (origin_time.is_not_a_date_time() ? std::string() : Fmi::to_iso_string(origin_time));
+      metadata["dali"]["baked"] = baked;
+      metadata["dali"]["hashes"] = hashes;
+
+      const auto path = directory + "/" + fileNamePart(time, "static") + "." +
+                        fileNamePart(demimetype(format), "tile") + ".pmtiles";
+      const auto bytes = writer.write(path, toJson(metadata));
+      bakery.add(path);
+
+      Json::Value archive;
+      archive["path"] = path;
+      archive["datetime"] = time;
+      archive["tiles"] = Json::UInt64(writer.tiles());
+      archive["failed"] = Json::UInt64(failures.load());
+      archive["bytes"] = Json::UInt64(bytes);
+      result["archives"].append(archive);
+    }
+
+    std::size_t removed = 0;
+    for (const auto& archive : result["archives"])
+      removed += bakery.prune(archive["path"].asString());
+    result["removed"] = Json::UInt64(removed);
+
+    result["seconds"] =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    theResponse.setStatus(Spine::HTTP::Status::ok);
+    setJsonResponse(theResponse, toJson(result));
+    return QueryStatus::OK;
+  }
+  catch (...)
+  {
+    Fmi::Exception ex(BCP, "OGC Tiles bake failed!", nullptr);
+    sendError(500, "Internal Server Error", ex.what(), theResponse);
+    return QueryStatus::OK;
+  }
+}
+
 // -----------------------------------------------------------------------
 /*!
  * \brief Run the Dali rendering pipeline and return the tile image.
@@ -1295,7 +1679,8 @@ QueryStatus Handler::generateTile(Dali::State& theState,
 
     if (product_hash != Fmi::bad_hash)
     {
-      auto etag = fmt::sprintf("\"%x\"", product_hash);
+      auto etag = fmt::sprintf(
+          "\"%x\"", theState.getPlugin().responseHash(product_hash, theProduct.type, theRequest));
       theResponse.setHeader("ETag", etag);
 
       // Standalone conditional handling (RFC 7232): If-None-Match -> 304,
@@ -1307,7 +1692,8 @@ QueryStatus Handler::generateTile(Dali::State& theState,
       }
     }
 
-    auto cached = theState.getPlugin().findInImageCache(product_hash);
+    auto cached = theState.getPlugin().findInImageCache(
+        product_hash, theProduct.type, theRequest, theResponse);
     if (cached)
     {
       theResponse.setHeader("Content-Type", mimeType(theProduct.type));
@@ -1356,6 +1742,10 @@ QueryStatus Handler::generateTile(Dali::State& theState,
     CTPP::CDT hash(CTPP::CDT::HASH_VAL);
     theProduct.generate(hash, theState);
 
+    if (theState.getPlugin().renderDirect(
+            hash, theProduct, theResponse, theState.useTimer(), product_hash))
+      return QueryStatus::OK;
+
     std::string output;
     std::string log;
     tmpl->process(hash, output, log);
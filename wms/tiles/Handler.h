@@ -13,6 +13,7 @@
  *   GET /tiles/collections/{collId}/tiles                       → Available tile sets
  *   GET /tiles/collections/{collId}/tiles/{tmsId}               → Tileset metadata
  *   GET /tiles/collections/{collId}/tiles/{tmsId}/{tm}/{row}/{col} → Tile image
+ *   GET /tiles/collections/{collId}/tiles/{tmsId}/bake          → Bake PMTiles archives
  *
  * OGC API - Styles (Mapbox style encoding), for styling the MVT output with the
  * real wms-conf colours:
@@ -29,6 +30,7 @@
 #pragma once
 
 #include "../MapboxStyle.h"
+#include "../ogc/MetadataCache.h"
 #include "../ogc/QueryStatus.h"
 #include "Config.h"
 #include <json/json.h>
@@ -75,6 +77,8 @@ class Handler
                     const Spine::HTTP::Request& theRequest,
                     Spine::HTTP::Response& theResponse);
 
+  Fmi::Cache::CacheStats getMetadataCacheStats() const;
+
  private:
   // Build "protocol://host[/apikey]/tiles" base URL for link generation
   std::string computeBaseUrl(const Spine::HTTP::Request& req) const;
@@ -82,6 +86,12 @@ class Handler
   // Negotiate tile image format from 'f' param or Accept header; default image/png
   std::string negotiateFormat(const Spine::HTTP::Request& req) const;
 
+  // Serve a metadata document from the cache, or generate it
+  QueryStatus cachedMetadata(Dali::State& theState,
+                             const Spine::HTTP::Request& theRequest,
+                             Spine::HTTP::Response& theResponse,
+                             const OGC::MetadataCache::Generator& theGenerator);
+
   // Metadata endpoints — all return JSON
   QueryStatus handleLandingPage(const std::string& base, Spine::HTTP::Response& resp);
   QueryStatus handleConformance(const std::string& base, Spine::HTTP::Response& resp);
@@ -140,6 +150,14 @@ class Handler
                             unsigned col,
                             const std::string& format);
 
+  // Render a zoom range into PMTiles archives (requires bake.directory)
+  QueryStatus handleBake(Dali::State& theState,
+                         const Spine::HTTP::Request& theRequest,
+                         Spine::HTTP::Response& theResponse,
+                         const std::string& collId,
+                         const std::string& tmsId,
+                         const std::string& format);
+
   QueryStatus generateTile(Dali::State& theState,
                            const Spine::HTTP::Request& theRequest,
                            Spine::HTTP::Response& theResponse,
@@ -155,6 +173,9 @@ class Handler
 
   const Dali::Config& itsDaliConfig;
   std::unique_ptr<Config> itsTilesConfig;
+
+  // Collection, tile matrix set and tileset documents, versioned by the WMS layer metadata
+  std::unique_ptr<OGC::MetadataCache> itsMetadataCache;
 };
 
 }  // namespace Tiles
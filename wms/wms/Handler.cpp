@@ -5,6 +5,7 @@
 // ======================================================================
 #include "Handler.h"
 #include "../CaseInsensitiveComparator.h"
+#include "../CostModel.h"
 #include "../Hash.h"
 #include "../JsonTools.h"
 #include "../Layer.h"
@@ -14,6 +15,7 @@
 #include "../Product.h"
 #include "../State.h"
 #include "../TextUtility.h"
+#include "../Timing.h"
 #include "../ogc/StyleSelection.h"
 #include "GetCapabilities.h"
 #include "GetLegendGraphic.h"
@@ -74,6 +76,9 @@ constexpr std::size_t kCapabilitiesCacheMaxEntries = 25;
 // (observation `metaData.period.end()` advances with wall clock).
 constexpr long kCapabilitiesCacheTtlSeconds = 30;
 
+// Maximum length of a GetFeatureInfo time series (TIMESTEPS vendor parameter)
+constexpr unsigned int kFeatureInfoMaxTimeSteps = 1000;
+
 // Names of URL parameters that influence the GetCapabilities response body.
 // Spine's getParameter() is case-insensitive, so these are listed in their
 // canonical lowercase form for readability. Anything not on this list is
@@ -881,6 +886,22 @@ QueryStatus Handler::wmsGetFeatureInfoQuery(Dali::State &theState,
             .disableLogging();
       }
 
+      if (Spine::optional_unsigned(theRequest.getParameter("TIMESTEPS"), 0) >
+          kFeatureInfoMaxTimeSteps)
+      {
+        throw Fmi::Exception(BCP, "Too many time steps requested")
+            .addParameter(WMS_EXCEPTION_CODE, WMS_INVALID_DIMENSION_VALUE)
+            .addParameter("max", Fmi::to_string(kFeatureInfoMaxTimeSteps))
+            .disableLogging();
+      }
+
+      if (Spine::optional_int(theRequest.getParameter("TIMESTEP"), 60) <= 0)
+      {
+        throw Fmi::Exception(BCP, "TIMESTEP must be a positive number of minutes")
+            .addParameter(WMS_EXCEPTION_CODE, WMS_INVALID_DIMENSION_VALUE)
+            .disableLogging();
+      }
+
       GetMap wmsGetMapRequest(*itsWMSConfig);
       wmsGetMapRequest.parseHTTPRequest(theState.getPlugin().getQEngine(), thisRequest);
 
@@ -1101,6 +1122,7 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
   std::size_t product_hash = 0;
   try
   {
+    Dali::Timing::ScopedSpan span("hash");
     product_hash = theProduct.hash_value(theState);
   }
   catch (const Fmi::Exception &exception)
@@ -1121,7 +1143,8 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
 
   if (product_hash != Fmi::bad_hash)
   {
-    auto etag = fmt::sprintf("\"%x\"", product_hash);
+    auto etag = fmt::sprintf(
+        "\"%x\"", theState.getPlugin().responseHash(product_hash, theProduct.type, theRequest));
     theResponse.setHeader("ETag", etag);
 
     // If request was an ETag request, we're done already
@@ -1142,7 +1165,8 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
     }
   }
 
-  auto obj = theState.getPlugin().findInImageCache(product_hash);
+  auto obj = theState.getPlugin().findInImageCache(
+      product_hash, theProduct.type, theRequest, theResponse);
   if (obj && !theProduct.animation.enabled)
   {
     theResponse.setHeader("Content-Type", mimeType(theProduct.type));
@@ -1189,10 +1213,15 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
   {
     try
     {
+      Dali::Timing::ScopedSpan span("generate", theProduct.type);
       theProduct.generate(hash, theState);
     }
     catch (...)
     {
+      // Expensive requests over the admission limit are rejected as a whole
+      if (Dali::CostModel::renderRejected())
+        throw;
+
       Fmi::Exception e(BCP, "Failed to generate product", nullptr);
       e.addParameter("URI", theRequest.getURI());
       e.addParameter("ClientIP", theRequest.getClientIP());
@@ -1203,6 +1232,14 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
       e.printError();
     }
 
+    const auto print_hash = Spine::optional_bool(theRequest.getParameter("printhash"), false);
+    if (print_hash)
+      std::cout << fmt::format("Generated CDT:\n{}\n", hash.RecursiveDump());
+
+    if (theState.getPlugin().renderDirect(
+            hash, theProduct, theResponse, theState.useTimer(), product_hash))
+      return QueryStatus::OK;
+
     // Build the template
     std::string output;
     std::string log;
@@ -1214,6 +1251,7 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
         std::string report = "Template processing finished in %t sec CPU, %w sec real\n";
         mytimer = std::make_unique<boost::timer::auto_cpu_timer>(2, report);
       }
+      Dali::Timing::ScopedSpan span("template", *theProduct.svg_tmpl);
       tmpl->process(hash, output, log);
     }
     catch (...)
@@ -1225,10 +1263,6 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
       return handleWmsException(ex, theState, theRequest, theResponse);
     }
 
-    const auto print_hash = Spine::optional_bool(theRequest.getParameter("printhash"), false);
-    if (print_hash)
-      std::cout << fmt::format("Generated CDT:\n{}\n", hash.RecursiveDump());
-
     theState.getPlugin().formatResponse(
         output, theProduct.type, theRequest, theResponse, theState.useTimer(), theProduct, product_hash);
 
@@ -1269,6 +1303,8 @@ QueryStatus Handler::wmsGenerateProduct(Dali::State &theState,
         }
         catch (...)
         {
+          if (Dali::CostModel::renderRejected())
+            throw;
         }
 
         std::string output;
@@ -1397,6 +1433,39 @@ QueryStatus Handler::wmsGenerateFeatureInfo(Dali::State &theState,
     info["features"] = CTPP::CDT(CTPP::CDT::HASH_VAL);
 
     theProduct.getFeatureInfo(info, theState);
+
+    // Vendor extension: TIMESTEPS=n returns the values at n times starting from the requested
+    // time, TIMESTEP minutes apart. The layers and data are set up only once, and the model
+    // data handles and probed values are shared through the State.
+
+    const auto timesteps = Spine::optional_unsigned(theRequest.getParameter("timesteps"), 0);
+    if (timesteps > 0)
+    {
+      const auto timestep = Spine::optional_int(theRequest.getParameter("timestep"), 60);
+
+      // The first step was probed above
+      CTPP::CDT first(CTPP::CDT::HASH_VAL);
+      first["x"] = info["x"];
+      first["y"] = info["y"];
+      first["features"] = info["features"];
+      if (info.Exists("time"))
+        first["time"] = info["time"];
+
+      info["series"] = CTPP::CDT(CTPP::CDT::ARRAY_VAL);
+      info["series"][0] = first;
+
+      for (unsigned int i = 1; i < timesteps; i++)
+      {
+        theProduct.shiftValidTime(Fmi::Minutes(timestep));
+
+        CTPP::CDT step(CTPP::CDT::HASH_VAL);
+        step["x"] = info["x"];
+        step["y"] = info["y"];
+        step["features"] = CTPP::CDT(CTPP::CDT::HASH_VAL);
+        theProduct.getFeatureInfo(step, theState);
+        info["series"][i] = step;
+      }
+    }
     // std::cout << fmt::format("Generated CDT:\n{}\n", info.RecursiveDump());
 
     auto tmpl_name = "wms_get_feature_info_" + theState.getType();
@@ -40,6 +40,10 @@ using OGC::useStyle;
 namespace
 {
 
+// Max entries in the GetCapabilities cache. The key depends only on the
+// apikey, language, host and protocol, so the working set is small.
+constexpr std::size_t kCapabilitiesCacheMaxEntries = 25;
+
 // WMTS REST URL structure after /wmts/:
 //   1.0.0/WMTSCapabilities.xml
 //   1.0.0/{layer}/{style}/{tileMatrixSet}/{tileMatrix}/{tileRow}/{tileCol}.{ext}
@@ -96,6 +100,7 @@ Handler::Handler(const Dali::Config& daliConfig) : itsDaliConfig(daliConfig) {}
 void Handler::init(std::unique_ptr<Config> wmtsConfig)
 {
   itsWMTSConfig = std::move(wmtsConfig);
+  itsCapabilitiesCache = std::make_unique<OGC::MetadataCache>(kCapabilitiesCacheMaxEntries);
 }
 
 void Handler::shutdown()
@@ -103,6 +108,13 @@ void Handler::shutdown()
   // Nothing to shut down — rendering pipeline is stateless per request.
 }
 
+Fmi::Cache::CacheStats Handler::getCapabilitiesCacheStats() const
+{
+  if (itsCapabilitiesCache)
+    return itsCapabilitiesCache->statistics();
+  return {};
+}
+
 // -----------------------------------------------------------------------
 /*!
  * \brief Main WMTS query entry point — parses REST path and routes request
@@ -127,8 +139,20 @@ QueryStatus Handler::query(Spine::Reactor& /* theReactor */,
 
     // parts[0] is the version (e.g. "1.0.0"); we accept any version prefix
     // GetCapabilities: version/WMTSCapabilities.xml
+    // The document is cached until the WMS layer metadata changes.
     if (parts.size() == 2 && parts[1] == "WMTSCapabilities.xml")
-      return handleGetCapabilities(theState, theRequest, theResponse);
+    {
+      const auto& wmsConfig = itsWMTSConfig->wmsConfig();
+      theState.updateExpirationTime(wmsConfig.getCapabilitiesExpirationTime());
+      theState.updateModificationTime(wmsConfig.getCapabilitiesModificationTime());
+      return itsCapabilitiesCache->respond(
+          theRequest,
+          theResponse,
+          Spine::FmiApiKey::getFmiApiKey(theRequest),
+          wmsConfig.getCapabilitiesModificationTime(),
+          [&](Spine::HTTP::Response& theResp)
+          { return handleGetCapabilities(theState, theRequest, theResp); });
+    }
 
     // GetTile (RESTful):
     //   version/layer/style[/dim…]/TileMatrixSet/TileMatrix/TileRow/TileCol.ext
@@ -740,7 +764,8 @@ QueryStatus Handler::generateTile(Dali::State& theState,
 
     if (product_hash != Fmi::bad_hash)
     {
-      auto etag = fmt::sprintf("\"%x\"", product_hash);
+      auto etag = fmt::sprintf(
+          "\"%x\"", theState.getPlugin().responseHash(product_hash, theProduct.type, theRequest));
       theResponse.setHeader("ETag", etag);
 
       // Standalone conditional handling (RFC 7232): If-None-Match -> 304,
@@ -753,7 +778,8 @@ QueryStatus Handler::generateTile(Dali::State& theState,
     }
 
     // Return cached tile if available
-    auto cached = theState.getPlugin().findInImageCache(product_hash);
+    auto cached = theState.getPlugin().findInImageCache(
+        product_hash, theProduct.type, theRequest, theResponse);
     if (cached)
     {
       theResponse.setHeader("Content-Type", mimeType(theProduct.type));
@@ -802,6 +828,10 @@ QueryStatus Handler::generateTile(Dali::State& theState,
     CTPP::CDT hash(CTPP::CDT::HASH_VAL);
     theProduct.generate(hash, theState);
 
+    if (theState.getPlugin().renderDirect(
+            hash, theProduct, theResponse, theState.useTimer(), product_hash))
+      return QueryStatus::OK;
+
     std::string output;
     std::string log;
     tmpl->process(hash, output, log);
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "Config.h"
+#include "../ogc/MetadataCache.h"
 #include "../ogc/QueryStatus.h"
 #include <spine/HTTP.h>
 #include <macgyver/Exception.h>
@@ -56,6 +57,8 @@ class Handler
                     const Spine::HTTP::Request& theRequest,
                     Spine::HTTP::Response& theResponse);
 
+  Fmi::Cache::CacheStats getCapabilitiesCacheStats() const;
+
  private:
   QueryStatus handleGetCapabilities(Dali::State& theState,
                                     const Spine::HTTP::Request& theRequest,
@@ -94,6 +97,9 @@ class Handler
   const Dali::Config& itsDaliConfig;
   std::unique_ptr<Config> itsWMTSConfig;
 
+  // Rendered GetCapabilities documents, versioned by the WMS layer metadata
+  std::unique_ptr<OGC::MetadataCache> itsCapabilitiesCache;
+
   mutable std::mutex itsDimNamesMutex;
   mutable std::map<std::string, std::vector<std::string>> itsDimNamesCache;
 };